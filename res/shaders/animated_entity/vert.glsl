@@ -14,8 +14,9 @@ out VertexOut {
     vec2 texture_coordinate;
 } vertex_out;
 
-// Per instance data
-uniform mat4 model_matrix;
+// Per model data, maps (possibly quantised) vertex positions back into model space
+uniform vec3 position_offset;
+uniform vec3 position_scale;
 
 // Material properties
 uniform vec3 diffuse_tint;
@@ -30,8 +31,12 @@ layout (std140) uniform PointLightArray {
 };
 #endif
 
-// Animation Data
-uniform mat4 bone_transforms[BONE_TRANSFORMS];
+// Per draw data, every draw's palette is written into one buffer each frame and bound by offset.
+// Each mat3x4 holds the top three rows of an affine transform (the last row is always 0, 0, 0, 1).
+layout (std140) uniform BonePalette {
+    mat3x4 palette_model_matrix;
+    mat3x4 bone_transforms[BONE_TRANSFORMS];
+};
 
 // Global data
 uniform vec3 ws_view_position;
@@ -39,21 +44,27 @@ uniform mat4 projection_view_matrix;
 
 uniform sampler2D specular_map_texture;
 
+// Rebuild a 4x4 matrix from its top three rows
+mat4 from_rows(mat3x4 rows) {
+    return transpose(mat4(rows[0], rows[1], rows[2], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
 void main() {
     // Transform vertices
     float sum = dot(bone_weights, vec4(1.0f));
 
-    mat4 bone_transform =
+    const mat3x4 identity_rows = mat3x4(vec4(1.0f, 0.0f, 0.0f, 0.0f), vec4(0.0f, 1.0f, 0.0f, 0.0f), vec4(0.0f, 0.0f, 1.0f, 0.0f));
+    mat3x4 bone_transform =
         bone_weights[0] * bone_transforms[bone_indices[0]]
         + bone_weights[1] * bone_transforms[bone_indices[1]]
         + bone_weights[2] * bone_transforms[bone_indices[2]]
         + bone_weights[3] * bone_transforms[bone_indices[3]]
-        + (1.0f - sum) * mat4(1.0f);
+        + (1.0f - sum) * identity_rows;
 
-    mat4 animation_matrix = model_matrix * bone_transform;
+    mat4 animation_matrix = from_rows(palette_model_matrix) * from_rows(bone_transform);
     mat3 normal_matrix = cofactor(animation_matrix);
 
-    vec3 ws_position = (animation_matrix * vec4(vertex_position, 1.0f)).xyz;
+    vec3 ws_position = (animation_matrix * vec4(position_offset + position_scale * vertex_position, 1.0f)).xyz;
     vec3 ws_normal = normalize(normal_matrix * normal);
     vertex_out.texture_coordinate = texture_coordinate;
 
@@ -0,0 +1,115 @@
+#version 410 core
+#include "../common/lights.glsl"
+#include "../common/maths.glsl"
+
+// Per vertex data
+layout(location = 0) in vec3 vertex_position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texture_coordinate;
+layout(location = 3) in vec4 bone_weights;
+layout(location = 4) in uvec4 bone_indices;
+
+out VertexOut {
+    LightingResult lighting_result;
+    vec2 texture_coordinate;
+} vertex_out;
+
+// Per crowd data, places the whole crowd
+uniform mat4 model_matrix;
+
+// Per instance data, 4 texels per instance, the top three rows of its transform then (animation, time offset, unused, unused)
+uniform samplerBuffer instances;
+
+// Per mesh data
+uniform mat4 mesh_transform;
+uniform int bone_offset;
+
+// Per model data, maps (possibly quantised) vertex positions back into model space
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
+// Material properties
+uniform vec3 diffuse_tint;
+uniform vec3 specular_tint;
+uniform vec3 ambient_tint;
+uniform float shininess;
+
+// Light Data
+#if NUM_PL > 0
+layout (std140) uniform PointLightArray {
+    PointLightData point_lights[NUM_PL];
+};
+#endif
+
+// Animation Data, one row per frame, 3 texels per bone holding the top three rows of its transform
+uniform sampler2D baked_bones;
+// [animation] -> (first_frame, frame_count, duration_seconds, unused)
+uniform vec4 animation_ranges[MAX_CROWD_ANIMATIONS];
+uniform float frames_per_second;
+uniform float time_seconds;
+
+// Global data
+uniform vec3 ws_view_position;
+uniform mat4 projection_view_matrix;
+
+uniform sampler2D specular_map_texture;
+
+// Rebuild a 4x4 matrix from its top three rows, as stored in the textures
+mat4 from_rows(vec4 row_0, vec4 row_1, vec4 row_2) {
+    return transpose(mat4(row_0, row_1, row_2, vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+mat4 fetch_bone(int frame, uint bone) {
+    int x = (bone_offset + int(bone)) * 3;
+    return from_rows(
+        texelFetch(baked_bones, ivec2(x, frame), 0),
+        texelFetch(baked_bones, ivec2(x + 1, frame), 0),
+        texelFetch(baked_bones, ivec2(x + 2, frame), 0)
+    );
+}
+
+void main() {
+    int instance = gl_InstanceID * 4;
+    mat4 instance_transform = from_rows(texelFetch(instances, instance), texelFetch(instances, instance + 1), texelFetch(instances, instance + 2));
+    vec4 instance_animation = texelFetch(instances, instance + 3);
+
+    // Transform vertices
+    mat4 bone_transform = mat4(1.0f);
+    int animation = int(instance_animation.x);
+    if (animation >= 0) {
+        vec4 range = animation_ranges[animation];
+        // Every instance loops its animation, blending between the two baked frames either side of its time
+        float time = range.z > 0.0f ? mod(time_seconds + instance_animation.y, range.z) : 0.0f;
+        float frame = time * frames_per_second;
+        int frame_0 = int(range.x) + min(int(frame), int(range.y) - 1);
+        int frame_1 = int(range.x) + min(int(frame) + 1, int(range.y) - 1);
+        float factor = fract(frame);
+
+        float sum = dot(bone_weights, vec4(1.0f));
+        bone_transform = (1.0f - sum) * mat4(1.0f);
+        for (int i = 0; i < 4; ++i) {
+            if (bone_weights[i] == 0.0f) continue;
+            bone_transform += bone_weights[i] * ((1.0f - factor) * fetch_bone(frame_0, bone_indices[i]) + factor * fetch_bone(frame_1, bone_indices[i]));
+        }
+    }
+
+    mat4 animation_matrix = model_matrix * instance_transform * mesh_transform * bone_transform;
+    mat3 normal_matrix = cofactor(animation_matrix);
+
+    vec3 ws_position = (animation_matrix * vec4(position_offset + position_scale * vertex_position, 1.0f)).xyz;
+    vec3 ws_normal = normalize(normal_matrix * normal);
+    vertex_out.texture_coordinate = texture_coordinate;
+
+    gl_Position = projection_view_matrix * vec4(ws_position, 1.0f);
+
+    // Per vertex light calcs are below this point
+    vec3 ws_view_dir = normalize(ws_view_position - ws_position);
+    LightCalculatioData light_calculation_data = LightCalculatioData(ws_position, ws_view_dir, ws_normal);
+    Material material = Material(diffuse_tint, specular_tint, ambient_tint, shininess);
+
+    vertex_out.lighting_result = total_light_calculation(light_calculation_data, material
+        #if NUM_PL > 0
+        ,point_lights
+        #endif
+    );
+}
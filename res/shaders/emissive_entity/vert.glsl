@@ -12,11 +12,15 @@ out VertexOut {
 // Per instance data
 uniform mat4 model_matrix;
 
+// Per model data, maps (possibly quantised) vertex positions back into model space
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
 // Global data
 uniform mat4 projection_view_matrix;
 
 void main() {
-    vertex_out.ws_position = (model_matrix * vec4(vertex_position, 1.0f)).xyz;
+    vertex_out.ws_position = (model_matrix * vec4(position_offset + position_scale * vertex_position, 1.0f)).xyz;
     vertex_out.texture_coordinate = texture_coordinate;
 
     gl_Position = projection_view_matrix * vec4(vertex_out.ws_position, 1.0f);
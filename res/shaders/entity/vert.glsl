@@ -15,6 +15,10 @@ out VertexOut {
 uniform mat4 model_matrix;
 uniform mat3 normal_matrix;
 
+// Per model data, maps (possibly quantised) vertex positions back into model space
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
 // Material properties
 uniform vec3 diffuse_tint;
 uniform vec3 specular_tint;
@@ -34,7 +38,7 @@ uniform mat4 projection_view_matrix;
 
 void main() {
     // Transform vertices
-    vec3 ws_position = (model_matrix * vec4(vertex_position, 1.0f)).xyz;
+    vec3 ws_position = (model_matrix * vec4(position_offset + position_scale * vertex_position, 1.0f)).xyz;
     vec3 ws_normal = normalize(normal_matrix * normal);
     vertex_out.texture_coordinate = texture_coordinate;
 
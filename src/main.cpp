@@ -2,6 +2,8 @@
 #include "rendering/imgui/ImGuiManager.h"
 #include "utility/OpenGL.h"
 #include "utility/PerformanceCounter.h"
+#include "utility/AssetRegistry.h"
+#include "rendering/memory/GpuMemory.h"
 #include "rendering/resources/ModelLoader.h"
 #include "rendering/resources/TextureLoader.h"
 #include "rendering/renders/MasterRenderer.h"
@@ -40,9 +42,21 @@ int main() {
         // Create an instance of the MasterRenderer which controls all the rendering
         MasterRenderer master_renderer{};
 
+        // Keep a record of every file in res, so the loaders can look files up without touching the disk,
+        // and so that changed files can be reloaded while the program is running.
+        AssetRegistry asset_registry{"res"};
+
         // Set up the model and texture loads, pointing them to a relative path to look in for files.
-        ModelLoader model_loader{"res/models"};
-        TextureLoader texture_loader{"res/textures"};
+        ModelLoader model_loader{"res/models", asset_registry};
+        TextureLoader texture_loader{"res/textures", asset_registry};
+
+        // Recompile the shaders whenever one of their files is saved
+        asset_registry.add_listener("res/shaders", [&master_renderer](const std::vector<std::string>& /*changed_files*/) {
+            int failures = master_renderer.refresh_shaders();
+            if (failures > 0) {
+                std::cerr << "[" << failures << "] shaders failed to reload, see above" << std::endl;
+            }
+        });
 
         // Create a scene manager and give it two scene constructors, one for the editor scene,
         // and another for an example second scene, this one just being a simple static scene.
@@ -85,15 +99,27 @@ int main() {
             }
             // Tell the MasterRenderer that we are staring a new frame
             master_renderer.update(window);
+            // Pick up any changed files, reloading the models, textures and shaders that use them
+            asset_registry.update();
+            // Upload any models that have finished loading in the background, within the loader's per-frame budget
+            model_loader.process_uploads();
+            // Likewise for the textures that have finished decoding, replacing their placeholders
+            texture_loader.process_uploads();
 
             if (scene_context.imgui_enabled) {
                 // Create an ImGUI window for global options, that are independent of the scene
                 if (ImGui::Begin("Options & Info", nullptr, ImGuiWindowFlags_NoFocusOnAppearing)) {
                     scene_manager.add_imgui_options_section(scene_context);
                     master_renderer.add_imgui_options_section(window_manager);
+                    model_loader.add_imgui_options_section();
+                    model_loader.add_imgui_import_statistics_section();
+                    texture_loader.add_imgui_options_section();
                     performance_counter.add_imgui_options_section((float) window_manager.get_delta_time());
                 }
                 ImGui::End();
+
+                // A separate window listing every GPU allocation, with how much memory each takes up
+                GpuMemory::global().add_imgui_window();
             }
 
             // Tick the scene, so it can do per-frame logic
@@ -109,6 +135,7 @@ int main() {
             // Swap the image buffers, and if needed sleep to limit the fps
             window.swap_buffers();
             master_renderer.sync();
+            GpuMemory::global().new_frame();
 
             scene_context.imgui_enabled = was_imgui_enabled;
         }
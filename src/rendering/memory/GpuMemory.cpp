@@ -0,0 +1,208 @@
+#include "GpuMemory.h"
+
+#include <tuple>
+#include <cstdio>
+#include <cfloat>
+#include <algorithm>
+
+#include <imgui/imgui.h>
+
+static const char* SORT_NAMES[] = {"Name", "Type", "Size", "Last Used"};
+
+static float to_mib(size_t bytes) {
+    return (float) bytes / (1024.0f * 1024.0f);
+}
+
+static std::string format_bytes(size_t bytes) {
+    if (bytes >= 1024 * 1024) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.2f MiB", to_mib(bytes));
+        return buffer;
+    }
+    if (bytes >= 1024) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.1f KiB", (float) bytes / 1024.0f);
+        return buffer;
+    }
+    return Formatter() << bytes << " B";
+}
+
+GpuMemory& GpuMemory::global() {
+    static GpuMemory gpu_memory{};
+    return gpu_memory;
+}
+
+const char* GpuMemory::get_type_name(GpuResourceType type) {
+    switch (type) {
+        case GpuResourceType::Model:
+            return "Model";
+        case GpuResourceType::Texture:
+            return "Texture";
+        case GpuResourceType::Buffer:
+            return "Buffer";
+        case GpuResourceType::Shader:
+            return "Shader";
+    }
+    return "Unknown";
+}
+
+std::pair<uint64_t, GpuMemory::Entry*> GpuMemory::add(GpuResourceType type, std::string name, size_t bytes) {
+    uint64_t id = next_id++;
+    // unordered_map never moves its elements, so the pointer stays valid until the entry is removed
+    Entry& entry = entries.emplace(id, Entry{type, std::move(name), 0}).first->second;
+    resize(entry, bytes);
+    return {id, &entry};
+}
+
+void GpuMemory::resize(Entry& entry, size_t bytes) {
+    auto& type_total = type_totals[(size_t) entry.type];
+    type_total = type_total - entry.bytes + bytes;
+    total_bytes = total_bytes - entry.bytes + bytes;
+    peak_bytes = std::max(peak_bytes, total_bytes);
+    entry.bytes = bytes;
+}
+
+void GpuMemory::remove(uint64_t id) {
+    auto existing = entries.find(id);
+    if (existing == entries.end()) return;
+    resize(existing->second, 0);
+    entries.erase(existing);
+}
+
+void GpuMemory::new_frame() {
+    if (history.size() == HISTORY_LENGTH) {
+        history[history_start] = to_mib(total_bytes);
+        history_start = (history_start + 1) % HISTORY_LENGTH;
+    } else {
+        history.push_back(to_mib(total_bytes));
+    }
+    frame++;
+}
+
+uint64_t GpuMemory::get_frame() const {
+    return frame;
+}
+
+size_t GpuMemory::get_total_bytes() const {
+    return total_bytes;
+}
+
+size_t GpuMemory::get_total_bytes(GpuResourceType type) const {
+    return type_totals[(size_t) type];
+}
+
+size_t GpuMemory::get_peak_bytes() const {
+    return peak_bytes;
+}
+
+float GpuMemory::history_getter(void* data, int idx) {
+    auto* self = static_cast<GpuMemory*>(data);
+    return self->history[(self->history_start + idx) % self->history.size()];
+}
+
+void GpuMemory::add_imgui_window() {
+    if (ImGui::Begin("Resources", nullptr, ImGuiWindowFlags_NoFocusOnAppearing)) {
+        ImGui::Text("Total: %s (peak %s) in %d allocations", format_bytes(total_bytes).c_str(), format_bytes(peak_bytes).c_str(), (int) entries.size());
+        for (auto i = 0u; i < TYPE_COUNT; ++i) {
+            ImGui::BulletText("%s: %s", get_type_name((GpuResourceType) i), format_bytes(type_totals[i]).c_str());
+        }
+        ImGui::TextDisabled("Estimated from the sizes and formats requested of GL");
+
+        if (!history.empty()) {
+            ImGui::PlotLines("Total (MiB)", history_getter, this, (int) history.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+        }
+
+        ImGui::Combo("Sort By", &sort_order, SORT_NAMES, IM_ARRAYSIZE(SORT_NAMES));
+
+        std::vector<const Entry*> sorted{};
+        sorted.reserve(entries.size());
+        for (const auto& [id, entry]: entries) {
+            sorted.push_back(&entry);
+        }
+        std::sort(sorted.begin(), sorted.end(), [this](const Entry* a, const Entry* b) {
+            switch (sort_order) {
+                case 0:
+                    return a->name < b->name;
+                case 1:
+                    return std::tie(a->type, a->name) < std::tie(b->type, b->name);
+                case 3:
+                    return a->last_used_frame > b->last_used_frame;
+                default:
+                    return a->bytes > b->bytes;
+            }
+        });
+
+        if (ImGui::BeginTable("Resource List", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) {
+            ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Type");
+            ImGui::TableSetupColumn("Size");
+            ImGui::TableSetupColumn("Refs");
+            ImGui::TableSetupColumn("Last Used");
+            ImGui::TableHeadersRow();
+
+            for (const auto* entry: sorted) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry->name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(get_type_name(entry->type));
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(format_bytes(entry->bytes).c_str());
+                ImGui::TableNextColumn();
+                if (entry->ref_count) {
+                    ImGui::Text("%ld", entry->ref_count());
+                } else {
+                    ImGui::TextDisabled("-");
+                }
+                ImGui::TableNextColumn();
+                if (entry->last_used_frame == 0) {
+                    ImGui::TextDisabled("Never");
+                } else {
+                    ImGui::Text("%llu (%llu ago)", (unsigned long long) entry->last_used_frame, (unsigned long long) (frame - entry->last_used_frame));
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+GpuAllocation::GpuAllocation(GpuResourceType type, std::string name, size_t bytes) {
+    std::tie(id, entry) = GpuMemory::global().add(type, std::move(name), bytes);
+}
+
+GpuAllocation::GpuAllocation(GpuAllocation&& other) noexcept : NonCopyable(), id(other.id), entry(other.entry) {
+    other.id = 0;
+    other.entry = nullptr;
+}
+
+GpuAllocation& GpuAllocation::operator=(GpuAllocation&& other) noexcept {
+    if (this != &other) {
+        GpuMemory::global().remove(id);
+        id = other.id;
+        entry = other.entry;
+        other.id = 0;
+        other.entry = nullptr;
+    }
+    return *this;
+}
+
+void GpuAllocation::resize(size_t bytes) {
+    if (entry != nullptr) GpuMemory::global().resize(*entry, bytes);
+}
+
+void GpuAllocation::rename(std::string name) {
+    if (entry != nullptr) entry->name = std::move(name);
+}
+
+void GpuAllocation::set_ref_count(std::function<long()> ref_count) {
+    if (entry != nullptr) entry->ref_count = std::move(ref_count);
+}
+
+size_t GpuAllocation::get_bytes() const {
+    return entry != nullptr ? entry->bytes : 0;
+}
+
+GpuAllocation::~GpuAllocation() {
+    if (entry != nullptr) GpuMemory::global().remove(id);
+}
@@ -0,0 +1,110 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include "utility/HelperTypes.h"
+
+/// The kinds of GPU resource that GpuMemory keeps totals for.
+enum class GpuResourceType {
+    Model,
+    Texture,
+    Buffer,
+    Shader,
+};
+
+/// A record of every GPU allocation the program makes, for seeing where the video memory goes.
+///
+/// The sizes are what was asked of GL, with textures and buffers estimated from their dimensions and formats,
+/// so it works on any driver without a vendor extension. The driver's own padding, alignment and compression
+/// aren't visible to it, so the totals are an estimate of the real usage rather than an exact figure.
+///
+/// Allocations are registered through a GpuAllocation member of the object owning the GL resource, and like the
+/// resources themselves must only be used from the GL thread.
+class GpuMemory : NonCopyable {
+public:
+    static constexpr size_t TYPE_COUNT = 4;
+    /// How many frames of the total are kept for the history graph
+    static constexpr size_t HISTORY_LENGTH = 300;
+
+    struct Entry {
+        GpuResourceType type;
+        std::string name;
+        size_t bytes = 0;
+        /// The frame the resource was last drawn with or bound, 0 if it never has been
+        uint64_t last_used_frame = 0;
+        /// How many shared_ptrs own the resource, empty if it isn't shared
+        std::function<long()> ref_count{};
+    };
+
+private:
+    uint64_t next_id = 1;
+    std::unordered_map<uint64_t, Entry> entries{};
+
+    std::array<size_t, TYPE_COUNT> type_totals{};
+    size_t total_bytes = 0;
+    size_t peak_bytes = 0;
+    uint64_t frame = 1;
+
+    // Ring buffer of the total in MiB at the end of each frame
+    std::vector<float> history{};
+    size_t history_start = 0;
+
+    // Index into SORT_NAMES, of what the resource list is ordered by
+    int sort_order = 2;
+
+    friend class GpuAllocation;
+
+    std::pair<uint64_t, Entry*> add(GpuResourceType type, std::string name, size_t bytes);
+    void resize(Entry& entry, size_t bytes);
+    void remove(uint64_t id);
+
+    static float history_getter(void* data, int idx);
+public:
+    static GpuMemory& global();
+
+    static const char* get_type_name(GpuResourceType type);
+
+    /// Record the total for the history graph and move on to the next frame, called once per frame.
+    void new_frame();
+
+    [[nodiscard]] uint64_t get_frame() const;
+    [[nodiscard]] size_t get_total_bytes() const;
+    [[nodiscard]] size_t get_total_bytes(GpuResourceType type) const;
+    [[nodiscard]] size_t get_peak_bytes() const;
+
+    /// Adds a "Resources" ImGUI window listing every allocation, with the totals and their history
+    void add_imgui_window();
+};
+
+/// An entry in GpuMemory::global() that lasts as long as this object, so should be a member of whatever owns the
+/// GL resource it describes. Its size is updated with resize whenever the resource is reallocated.
+class GpuAllocation : NonCopyable {
+    uint64_t id = 0;
+    GpuMemory::Entry* entry = nullptr;
+public:
+    GpuAllocation(GpuResourceType type, std::string name, size_t bytes = 0);
+    GpuAllocation(GpuAllocation&& other) noexcept;
+    GpuAllocation& operator=(GpuAllocation&& other) noexcept;
+
+    void resize(size_t bytes);
+    void rename(std::string name);
+    /// Report the owner's reference count alongside the allocation, e.g. from weak_from_this().use_count()
+    void set_ref_count(std::function<long()> ref_count);
+
+    /// Record that the resource is being used this frame, cheap enough to call for every draw
+    void mark_used() const {
+        if (entry != nullptr) entry->last_used_frame = GpuMemory::global().get_frame();
+    }
+
+    [[nodiscard]] size_t get_bytes() const;
+
+    ~GpuAllocation();
+};
+
+#endif //GPU_MEMORY_H
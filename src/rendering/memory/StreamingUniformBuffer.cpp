@@ -0,0 +1,119 @@
+#include "StreamingUniformBuffer.h"
+
+#include <cstring>
+
+StreamingUniformBuffer::StreamingUniformBuffer(size_t max_binding_size, std::string name, size_t initial_frame_capacity) : max_binding_size(max_binding_size), gpu_allocation(GpuResourceType::Buffer, std::move(name)) {
+    int offset_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+    if (offset_alignment > 0) alignment = (size_t) offset_alignment;
+
+    persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+    create(initial_frame_capacity);
+}
+
+void StreamingUniformBuffer::create(size_t capacity) {
+    frame_capacity = aligned_size(capacity);
+    region_size = frame_capacity + aligned_size(max_binding_size);
+    size_t total_size = region_size * FRAMES_IN_FLIGHT;
+    gpu_allocation.resize(total_size);
+
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, (GLsizeiptr) total_size, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, (GLsizeiptr) total_size, flags));
+        // The slack after each frame is never allocated, but is still inside the bound range, so it must not be left undefined
+        std::memset(mapped, 0, total_size);
+    } else {
+        staging.assign(total_size, 0);
+        glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr) total_size, staging.data(), GL_STREAM_DRAW);
+        mapped = staging.data();
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void StreamingUniformBuffer::destroy() {
+    for (auto& fence: fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (persistent && mapped != nullptr) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    mapped = nullptr;
+    glDeleteBuffers(1, &ubo);
+    ubo = 0;
+    gpu_allocation.resize(0);
+}
+
+void StreamingUniformBuffer::begin_frame(size_t required_size) {
+    // Every draw reading the previous frame has been issued by now, so fence it before moving on
+    if (frame_open) {
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frame_open = true;
+
+    if (required_size > frame_capacity) {
+        // GL keeps the old buffer alive until any draws using it are done, so it can just be replaced
+        destroy();
+        create(std::max(required_size, frame_capacity * 2));
+        frame = 0;
+    } else {
+        frame = (frame + 1) % FRAMES_IN_FLIGHT;
+    }
+    frame_offset = 0;
+
+    GLsync& fence = fences[frame];
+    if (fence != nullptr) {
+        // Usually already signalled, since the region was last used FRAMES_IN_FLIGHT - 1 frames ago
+        while (true) {
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) break;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+std::pair<size_t, void*> StreamingUniformBuffer::allocate(size_t size) {
+    size_t padded_size = aligned_size(size);
+    if (frame_offset + padded_size > frame_capacity) {
+        throw std::runtime_error(Formatter() << "StreamingUniformBuffer frame overflow, " << frame_offset + padded_size << " bytes used but only " << frame_capacity << " reserved in begin_frame");
+    }
+
+    size_t offset = frame * region_size + frame_offset;
+    frame_offset += padded_size;
+    // The padding is uploaded and bound along with the data, so clear whatever an earlier frame left there
+    std::memset(mapped + offset + size, 0, padded_size - size);
+    return {offset, mapped + offset};
+}
+
+void StreamingUniformBuffer::end_frame() {
+    if (!persistent && frame_offset > 0) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr) (frame * region_size), (GLsizeiptr) frame_offset, mapped + frame * region_size);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+void StreamingUniformBuffer::bind_range(uint binding, size_t offset) const {
+    gpu_allocation.mark_used();
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ubo, (GLintptr) offset, (GLsizeiptr) max_binding_size);
+}
+
+size_t StreamingUniformBuffer::aligned_size(size_t size) const {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+bool StreamingUniformBuffer::is_persistent() const {
+    return persistent;
+}
+
+StreamingUniformBuffer::~StreamingUniformBuffer() {
+    destroy();
+}
@@ -0,0 +1,71 @@
+#ifndef STREAMING_UNIFORM_BUFFER_H
+#define STREAMING_UNIFORM_BUFFER_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+
+#include "GpuMemory.h"
+#include "utility/HelperTypes.h"
+
+/// A Uniform Buffer Object that is rewritten every frame, split into a ring of regions so the CPU can fill one
+/// while the GPU is still reading the ones from previous frames.
+///
+/// Where buffer storage is available (GL 4.4 or ARB_buffer_storage) the buffer is persistently mapped and written
+/// directly. Otherwise each frame is written to a CPU side copy and uploaded with a single glBufferSubData.
+class StreamingUniformBuffer : NonCopyable {
+public:
+    static constexpr uint FRAMES_IN_FLIGHT = 3;
+
+private:
+    uint ubo = 0;
+    bool persistent = false;
+    unsigned char* mapped = nullptr;
+    std::vector<unsigned char> staging{};
+
+    // Bytes each frame can allocate
+    size_t frame_capacity = 0;
+    // Extra bytes after each frame's region, so a binding of max_binding_size from any allocation stays in the buffer
+    size_t max_binding_size;
+    size_t region_size = 0;
+    size_t alignment = 256;
+
+    uint frame = 0;
+    bool frame_open = false;
+    size_t frame_offset = 0;
+    std::array<GLsync, FRAMES_IN_FLIGHT> fences{};
+
+    GpuAllocation gpu_allocation;
+
+    void create(size_t capacity);
+    void destroy();
+public:
+    /// `max_binding_size` is the largest range that will ever be bound, usually the size of the uniform block.
+    /// `name` is what the buffer is listed as in GpuMemory.
+    explicit StreamingUniformBuffer(size_t max_binding_size, std::string name, size_t initial_frame_capacity = 64 * 1024);
+
+    /// Start writing a new frame that will need at most `required_size` bytes (including alignment padding),
+    /// waiting for the GPU to finish with the region if needed, and growing the buffer if it is too small.
+    void begin_frame(size_t required_size);
+
+    /// Reserve `size` bytes for this frame, returning the offset to bind and where to write the data.
+    /// The alignment padding after the data is zeroed, so a binding that reaches into it never reads garbage.
+    std::pair<size_t, void*> allocate(size_t size);
+
+    /// Make this frame's writes visible to the GPU, must be called before any draw that reads them.
+    /// The frame's region is fenced at the next begin_frame, once every draw reading it has been issued.
+    void end_frame();
+
+    /// Bind `max_binding_size` bytes, starting at an offset returned by allocate.
+    void bind_range(uint binding, size_t offset) const;
+
+    /// The size of an allocation once padded to the offset alignment
+    [[nodiscard]] size_t aligned_size(size_t size) const;
+
+    [[nodiscard]] bool is_persistent() const;
+
+    ~StreamingUniformBuffer();
+};
+
+#endif //STREAMING_UNIFORM_BUFFER_H
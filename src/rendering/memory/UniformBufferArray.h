@@ -2,21 +2,24 @@
 #define UNIFORM_BUFFER_ARRAY_H
 
 #include <array>
+#include <string>
 #include <glad/gl.h>
 
+#include "GpuMemory.h"
 #include "utility/HelperTypes.h"
 
 /// A helper class that abstracts over a Uniform Buffer Object as a type safe array of fixed size.
 template<typename T, unsigned int N>
 class UniformBufferArray : NonCopyable {
     uint ubo = 0;
+    GpuAllocation gpu_allocation;
 public:
     /// The CPU side buffer that will be mirror on the GPU
     std::array<T, N> data;
 
     /// Construct the UBO with an initial state.
-    /// is_state means that you do not intend to update it often
-    explicit UniformBufferArray(std::array<T, N> data, bool is_static = true);
+    /// is_state means that you do not intend to update it often, and name is what it is listed as in GpuMemory
+    explicit UniformBufferArray(std::array<T, N> data, bool is_static = true, std::string name = "Uniform Buffer Array");
     /// Upload the CPU side to the GPU, if a valid index is provided then it will only upload that one element
     void upload(int index = -1);
     /// Bind the UBO to the specified binding index
@@ -26,7 +29,7 @@ public:
 };
 
 template<typename T, unsigned int N>
-UniformBufferArray<T, N>::UniformBufferArray(std::array<T, N> data, bool is_static): data(data) {
+UniformBufferArray<T, N>::UniformBufferArray(std::array<T, N> data, bool is_static, std::string name): gpu_allocation(GpuResourceType::Buffer, std::move(name), N * sizeof(T)), data(data) {
     glGenBuffers(1, &ubo);
     glBindBuffer(GL_UNIFORM_BUFFER, ubo);
     glBufferData(GL_UNIFORM_BUFFER, N * sizeof(T), data.data(), is_static ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
@@ -46,6 +49,7 @@ void UniformBufferArray<T, N>::upload(int index) {
 
 template<typename T, unsigned int N>
 void UniformBufferArray<T, N>::bind(int binding) {
+    gpu_allocation.mark_used();
     glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
 }
 
@@ -1,5 +1,8 @@
 #include "AnimatedEntityRenderer.h"
 
+#include <cmath>
+#include <algorithm>
+
 AnimatedEntityRenderer::AnimatedEntityShader::AnimatedEntityShader() :
     BaseLitEntityShader("Animated Entity", "animated_entity/vert.glsl", "animated_entity/frag.glsl", {{"BONE_TRANSFORMS", BONE_TRANSFORMS_STR}}) {
 
@@ -8,23 +11,207 @@ AnimatedEntityRenderer::AnimatedEntityShader::AnimatedEntityShader() :
 
 void AnimatedEntityRenderer::AnimatedEntityShader::get_uniforms_set_bindings() {
     BaseLitEntityShader::get_uniforms_set_bindings(); // Call the base implementation to load all the common uniforms
-    bone_transforms_location = get_uniform_location("bone_transforms");
+    set_block_binding("BonePalette", BONE_PALETTE_BINDING);
+}
+
+/// Write the top three rows of an affine transform, which is all the shader needs to rebuild it
+static void write_palette_matrix(const glm::mat4& matrix, glm::vec4* out_rows) {
+    out_rows[0] = {matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]};
+    out_rows[1] = {matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]};
+    out_rows[2] = {matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]};
+}
+
+size_t AnimatedEntityRenderer::PoseKeyHash::operator()(const PoseKey& key) const {
+    size_t hash = std::hash<const void*>{}(key.mesh_hierarchy);
+    hash = hash * 31 + std::hash<uint>{}(key.animation_id);
+    hash = hash * 31 + std::hash<double>{}(key.time_seconds);
+    hash = hash * 31 + (size_t) key.lod;
+    return hash;
+}
+
+AnimatedEntityRenderer::AnimatedEntityRenderer::AnimatedEntityRenderer() : shader(), palette_buffer(AnimatedEntityShader::BONE_PALETTE_SIZE, "Bone Palettes") {}
+
+void AnimatedEntityRenderer::AnimatedEntityRenderer::evaluate_poses(const RenderScene& render_scene) {
+    unique_poses.clear();
+    pose_owners.clear();
+    entity_poses.clear();
+    animation_statistics = {};
+
+    for (const auto& entity: render_scene.entities) {
+        // An id past the end (e.g. from a scene file, or after the model changed) would throw on a pool thread, so treat it as not animated
+        if (entity->animation_id != NONE_ANIMATION && entity->animation_id >= entity->mesh_hierarchy->animations.size()) {
+            entity->animation_id = NONE_ANIMATION;
+        }
+        AnimationLod lod = select_animation_lod(*entity, render_scene.global_data.camera_position);
+        // The time doesn't matter when not animating, so every such instance of a hierarchy shares the bind pose
+        double time_seconds = entity->animation_id == NONE_ANIMATION ? 0.0 : entity->animation_time_seconds;
+        auto [iter, inserted] = unique_poses.emplace(PoseKey{entity->mesh_hierarchy.get(), entity->animation_id, time_seconds, lod}, (uint) pose_owners.size());
+        if (inserted) {
+            pose_owners.emplace_back(entity.get(), lod);
+            animation_statistics.poses_at_lod[(uint) lod]++;
+        }
+        entity_poses.push_back(&pose_owners[iter->second].first->animation_pose);
+    }
+
+    // Poses of the same clip next to each other, so a batch's channels come from fewer clips, sharing their keys in cache.
+    // entity_poses points at the entities themselves, so is unaffected by the reordering.
+    std::sort(pose_owners.begin(), pose_owners.end(), [](const auto& lhs, const auto& rhs) {
+        return std::make_pair(lhs.first->mesh_hierarchy.get(), lhs.first->animation_id) < std::make_pair(rhs.first->mesh_hierarchy.get(), rhs.first->animation_id);
+    });
+    queued_poses.assign(pose_owners.size(), QueuedPose{});
+
+    std::atomic<uint> bones_evaluated{0};
+    ThreadPool::global().parallel_for(pose_owners.size(), POSE_BATCH_SIZE, [this, &bones_evaluated](size_t begin, size_t end) {
+        // Shared by every pose in the batch, so their channels fill its lanes together rather than each pose flushing a partial batch
+        AnimationBatchSampler sampler{};
+        uint batch_bones_evaluated = 0;
+        for (auto i = begin; i < end; ++i) {
+            batch_bones_evaluated += queue_pose(*pose_owners[i].first, pose_owners[i].second, sampler, queued_poses[i]);
+        }
+        sampler.flush();
+        for (auto i = begin; i < end; ++i) {
+            finish_pose(*pose_owners[i].first, queued_poses[i]);
+        }
+        bones_evaluated += batch_bones_evaluated;
+    });
+
+    animation_statistics.instances = (uint) entity_poses.size();
+    animation_statistics.poses_evaluated = (uint) pose_owners.size();
+    animation_statistics.bones_evaluated = bones_evaluated.load();
+}
+
+AnimatedEntityRenderer::AnimationLod AnimatedEntityRenderer::AnimatedEntityRenderer::select_animation_lod(const Entity& entity, const glm::vec3& camera_position) const {
+    if (!animation_lod_settings.enabled || entity.animation_id == NONE_ANIMATION) return AnimationLod::Full;
+
+    float distance = glm::distance(glm::vec3(entity.instance_data.model_matrix[3]), camera_position);
+    if (distance >= animation_lod_settings.reduced_bones_distance) return AnimationLod::ReducedBones;
+    if (distance >= animation_lod_settings.reduced_rate_distance) return AnimationLod::ReducedRate;
+    return AnimationLod::Full;
+}
+
+uint AnimatedEntityRenderer::AnimatedEntityRenderer::queue_pose(Entity& entity, AnimationLod lod, AnimationBatchSampler& sampler, QueuedPose& out_queued) const {
+    const auto& mesh_hierarchy = *entity.mesh_hierarchy;
+    auto& cache = entity.animation_lod_cache;
+    double interval = animation_lod_settings.reduced_rate_interval;
+    out_queued = {};
+
+    if (entity.animation_id == NONE_ANIMATION) {
+        cache.valid = false;
+        return mesh_hierarchy.calculate_animation(NONE_ANIMATION, 0.0, entity.animation_pose);
+    }
+
+    if (lod == AnimationLod::Full || interval <= 0.0) {
+        cache.valid = false;
+        out_queued.full = true;
+        return mesh_hierarchy.sample_local_transforms(entity.animation_id, entity.animation_time_seconds, entity.animation_pose.local_transforms, sampler, &entity.animation_cursors);
+    }
+
+    uint min_importance = lod == AnimationLod::ReducedBones ? (uint) std::max(animation_lod_settings.min_bone_importance, 0) : 0;
+    auto step = (int64_t) std::floor(entity.animation_time_seconds / interval);
+    double start_time = (double) step * interval;
+
+    uint channels_sampled = 0;
+    bool cache_matches = cache.valid && cache.animation_id == entity.animation_id && cache.min_importance == min_importance && cache.interval == interval;
+    if (!cache_matches || cache.start_step != step) {
+        if (cache_matches && cache.start_step + 1 == step) {
+            // Playback moved on to the next step, so the old end pose is the new start pose
+            std::swap(cache.start_pose, cache.end_pose);
+        } else {
+            channels_sampled += mesh_hierarchy.sample_local_transforms(entity.animation_id, start_time, cache.start_pose.local_transforms, sampler, &entity.animation_cursors, min_importance);
+            out_queued.lod_start = true;
+        }
+        channels_sampled += mesh_hierarchy.sample_local_transforms(entity.animation_id, start_time + interval, cache.end_pose.local_transforms, sampler, &entity.animation_cursors, min_importance);
+        out_queued.lod_end = true;
+
+        cache.start_step = step;
+        cache.animation_id = entity.animation_id;
+        cache.min_importance = min_importance;
+        cache.interval = interval;
+        cache.valid = true;
+    }
+
+    return channels_sampled;
 }
 
-void AnimatedEntityRenderer::AnimatedEntityShader::set_model_matrix(const glm::mat4& model_matrix) {
-    glProgramUniformMatrix4fv(id(), model_matrix_location, 1, GL_FALSE, &model_matrix[0][0]);
+void AnimatedEntityRenderer::AnimatedEntityRenderer::finish_pose(Entity& entity, const QueuedPose& queued) const {
+    const auto& mesh_hierarchy = *entity.mesh_hierarchy;
+    auto& cache = entity.animation_lod_cache;
+
+    if (queued.full) {
+        mesh_hierarchy.calculate_pose(entity.animation_pose.local_transforms, entity.animation_pose);
+        return;
+    }
+    // Not animated, so the bind pose was already written by queue_pose
+    if (!cache.valid) return;
+
+    if (queued.lod_start) mesh_hierarchy.calculate_pose(cache.start_pose.local_transforms, cache.start_pose);
+    if (queued.lod_end) mesh_hierarchy.calculate_pose(cache.end_pose.local_transforms, cache.end_pose);
+
+    // Blending the skinning matrices directly isn't exact, but the poses are close enough together that it isn't noticeable at a distance
+    double start_time = (double) cache.start_step * cache.interval;
+    auto factor = (float) std::clamp((entity.animation_time_seconds - start_time) / cache.interval, 0.0, 1.0);
+    auto& bone_transforms = entity.animation_pose.bone_transforms;
+    bone_transforms.resize(cache.start_pose.bone_transforms.size());
+    for (auto mesh_id = 0u; mesh_id < bone_transforms.size(); ++mesh_id) {
+        const auto& start = cache.start_pose.bone_transforms[mesh_id];
+        const auto& end = cache.end_pose.bone_transforms[mesh_id];
+        bone_transforms[mesh_id].resize(start.size());
+        for (auto bone_id = 0u; bone_id < start.size(); ++bone_id) {
+            bone_transforms[mesh_id][bone_id] = start[bone_id] * (1.0f - factor) + end[bone_id] * factor;
+        }
+    }
 }
 
-void AnimatedEntityRenderer::AnimatedEntityShader::set_bone_transforms(const std::vector<glm::mat4>& bone_transforms) {
-    glProgramUniformMatrix4fv(id(), bone_transforms_location, std::min(BONE_TRANSFORMS, (int) bone_transforms.size()), GL_FALSE, &bone_transforms[0][0][0]);
+/// The number of bones written to a mesh's palette. Unweighted vertices still index bone 0 with a weight of 0, and 0 * NaN
+/// isn't 0, so even a mesh without bones gets one (identity) bone rather than leaving the shader to read whatever follows.
+template<typename Mesh>
+static size_t get_palette_bone_count(const Mesh& mesh) {
+    return std::clamp<size_t>(mesh.bones.size(), 1, BONE_TRANSFORMS);
 }
 
-AnimatedEntityRenderer::AnimatedEntityRenderer::AnimatedEntityRenderer() : shader() {}
+void AnimatedEntityRenderer::AnimatedEntityRenderer::write_palettes(const RenderScene& render_scene) {
+    // Only the bones a mesh actually has are written, since the slack after each frame keeps a full block binding in range
+    size_t required_size = 0;
+    for (const auto& entity: render_scene.entities) {
+        const auto& mesh_hierarchy = *entity->mesh_hierarchy;
+        for (const auto& [node, mesh_id]: mesh_hierarchy.mesh_draws) {
+            size_t bone_count = get_palette_bone_count(mesh_hierarchy.meshes[mesh_id]);
+            required_size += palette_buffer.aligned_size((1 + bone_count) * AnimatedEntityShader::PALETTE_MATRIX_SIZE);
+        }
+    }
+
+    palette_buffer.begin_frame(required_size);
+    palette_offsets.clear();
+
+    uint entity_index = 0;
+    for (const auto& entity: render_scene.entities) {
+        const auto& pose = *entity_poses[entity_index++];
+        const auto& mesh_hierarchy = *entity->mesh_hierarchy;
+        for (const auto& [node, mesh_id]: mesh_hierarchy.mesh_draws) {
+            const auto& bone_transforms = pose.bone_transforms[mesh_id];
+            size_t bone_count = get_palette_bone_count(mesh_hierarchy.meshes[mesh_id]);
+
+            auto [offset, data] = palette_buffer.allocate((1 + bone_count) * AnimatedEntityShader::PALETTE_MATRIX_SIZE);
+            auto* rows = static_cast<glm::vec4*>(data);
+            write_palette_matrix(entity->instance_data.model_matrix * mesh_hierarchy.node_bind_transforms[node], rows);
+            for (auto bone_id = 0u; bone_id < bone_count; ++bone_id) {
+                write_palette_matrix(bone_id < bone_transforms.size() ? bone_transforms[bone_id] : glm::mat4(1.0f), rows + 3 * (1 + bone_id));
+            }
+            palette_offsets.push_back(offset);
+        }
+    }
+
+    palette_buffer.end_frame();
+}
 
 void AnimatedEntityRenderer::AnimatedEntityRenderer::render(const RenderScene& render_scene, const LightScene& light_scene) {
+    evaluate_poses(render_scene);
+    write_palettes(render_scene);
+
     shader.use();
     shader.set_global_data(render_scene.global_data);
 
+    uint draw_index = 0;
     for (const auto& entity: render_scene.entities) {
         shader.set_instance_data(entity->instance_data);
 
@@ -41,19 +228,19 @@ void AnimatedEntityRenderer::AnimatedEntityRenderer::render(const RenderScene& r
         glBindTexture(GL_TEXTURE_2D, entity->render_data.diffuse_texture->get_texture_id());
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, entity->render_data.specular_map_texture->get_texture_id());
+        entity->render_data.diffuse_texture->mark_used();
+        entity->render_data.specular_map_texture->mark_used();
 
-        entity->mesh_hierarchy->calculate_animation(entity->animation_id, entity->animation_time_seconds);
-        entity->mesh_hierarchy->visit_nodes([this, &entity](const MeshHierarchyNode& node, glm::mat4 accumulated_transformation) {
-            for (const auto& mesh_id: node.meshes) {
-                const auto& mesh = entity->mesh_hierarchy->meshes[mesh_id];
+        for (const auto& [node, mesh_id]: entity->mesh_hierarchy->mesh_draws) {
+            const auto& mesh = entity->mesh_hierarchy->meshes[mesh_id];
 
-                shader.set_model_matrix(entity->instance_data.model_matrix * accumulated_transformation);
-                if (!mesh.bone_transforms.empty()) shader.set_bone_transforms(mesh.bone_transforms);
+            palette_buffer.bind_range(AnimatedEntityShader::BONE_PALETTE_BINDING, palette_offsets[draw_index++]);
+            shader.set_position_dequantisation(mesh.model->get_layout().dequantisation);
 
-                glBindVertexArray(mesh.model->get_vao());
-                glDrawElementsBaseVertex(GL_TRIANGLES, mesh.model->get_index_count(), GL_UNSIGNED_INT, nullptr, mesh.model->get_vertex_offset());
-            }
-        });
+            glBindVertexArray(mesh.model->get_vao());
+            mesh.model->mark_used();
+            glDrawElementsBaseVertex(GL_TRIANGLES, mesh.model->get_index_count(), mesh.model->get_index_type(), nullptr, mesh.model->get_vertex_offset());
+        }
     }
 }
 
@@ -61,38 +248,69 @@ bool AnimatedEntityRenderer::AnimatedEntityRenderer::refresh_shaders() {
     return shader.reload_files();
 }
 
-void AnimatedEntityRenderer::VertexData::from_mesh(const VertexCollection& vertex_collection, std::vector<VertexData>& out_vertices) {
-    out_vertices.reserve(out_vertices.size() + vertex_collection.positions.size());
+const AnimatedEntityRenderer::AnimationStatistics& AnimatedEntityRenderer::AnimatedEntityRenderer::get_animation_statistics() const {
+    return animation_statistics;
+}
+
+void AnimatedEntityRenderer::AnimatedEntityRenderer::set_animation_lod_settings(const AnimationLodSettings& settings) {
+    animation_lod_settings = settings;
+}
 
-    if (vertex_collection.bones.empty() || vertex_collection.bones.size() != vertex_collection.positions.size()) {
+bool AnimatedEntityRenderer::AnimatedEntityRenderer::is_palette_buffer_persistent() const {
+    return palette_buffer.is_persistent();
+}
+
+void AnimatedEntityRenderer::VertexData::from_mesh(const VertexCollection& vertex_collection, VertexData* out_vertices) {
+    if (vertex_collection.bones == nullptr) {
         throw std::runtime_error("AnimatedEntityRenderer::VertexData requires bones");
     }
-    if (vertex_collection.normals.empty() || vertex_collection.normals.size() != vertex_collection.positions.size()) {
+    if (vertex_collection.normals == nullptr) {
         throw std::runtime_error("AnimatedEntityRenderer::VertexData requires normals");
     }
 
-    if (vertex_collection.tex_coords.empty() || vertex_collection.tex_coords.size() != vertex_collection.positions.size()) {
+    if (vertex_collection.tex_coords == nullptr) {
 //        throw std::runtime_error("AnimatedEntityRenderer::VertexData requires texture coordinates");
     }
 
-    for (auto i = 0u; i < vertex_collection.positions.size(); i++) {
-        out_vertices.push_back(VertexData{
-            vertex_collection.positions[i],
-            vertex_collection.normals[i],
-            i < vertex_collection.tex_coords.size() ? vertex_collection.tex_coords[i] : glm::vec2{0.0f},
+    for (auto i = 0u; i < vertex_collection.vertex_count; i++) {
+        out_vertices[i] = VertexData{
+            vertex_collection.position(i),
+            vertex_collection.normal(i),
+            vertex_collection.tex_coords != nullptr ? vertex_collection.tex_coord(i) : glm::vec2{0.0f},
             vertex_collection.bones[i].first,
             vertex_collection.bones[i].second
-        });
+        };
     }
 }
 
 
-void AnimatedEntityRenderer::VertexData::setup_attrib_pointers() {
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, position));
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, normal));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, texture_coordinate));
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, bone_weights));
-    glVertexAttribIPointer(4, 4, GL_UNSIGNED_INT, sizeof(VertexData), (void*) offsetof(VertexData, bone_indices)); // Note the `I` in the function name, needed to have ints work as expected
+AnimatedEntityRenderer::VertexData::Packed AnimatedEntityRenderer::VertexData::pack(const VertexData& vertex, const PositionDequantisation& dequantisation) {
+    Packed packed{};
+    VertexPacking::quantise_position(vertex.position, dequantisation, packed.position);
+    packed.normal = VertexPacking::pack_snorm_10_10_10_2(vertex.normal);
+    packed.texture_coordinate[0] = VertexPacking::float_to_half(vertex.texture_coordinate.x);
+    packed.texture_coordinate[1] = VertexPacking::float_to_half(vertex.texture_coordinate.y);
+    VertexPacking::quantise_weights(vertex.bone_weights, packed.bone_weights);
+    for (auto i = 0; i < 4; ++i) {
+        packed.bone_indices[i] = (uint8_t) std::min(vertex.bone_indices[i], (uint) BONE_TRANSFORMS - 1);
+    }
+    return packed;
+}
+
+void AnimatedEntityRenderer::VertexData::setup_attrib_pointers(VertexFormat format) {
+    if (format == VertexFormat::Packed) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Packed), (void*) offsetof(Packed, position));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Packed), (void*) offsetof(Packed, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Packed), (void*) offsetof(Packed, texture_coordinate));
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Packed), (void*) offsetof(Packed, bone_weights));
+        glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, sizeof(Packed), (void*) offsetof(Packed, bone_indices));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, texture_coordinate));
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, bone_weights));
+        glVertexAttribIPointer(4, 4, GL_UNSIGNED_INT, sizeof(VertexData), (void*) offsetof(VertexData, bone_indices)); // Note the `I` in the function name, needed to have ints work as expected
+    }
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
@@ -4,6 +4,7 @@
 #include <utility>
 #include <vector>
 #include <unordered_set>
+#include <unordered_map>
 
 #include <glm/glm.hpp>
 
@@ -15,6 +16,8 @@
 #include "rendering/resources/ModelLoader.h"
 #include "rendering/resources/TextureHandle.h"
 #include "rendering/memory/UniformBufferArray.h"
+#include "rendering/memory/StreamingUniformBuffer.h"
+#include "utility/ThreadPool.h"
 
 #include "rendering/renders/shaders/BaseLitEntityShader.h"
 
@@ -29,8 +32,25 @@ namespace AnimatedEntityRenderer {
         glm::vec4 bone_weights;
         glm::uvec4 bone_indices;
 
-        static void from_mesh(const VertexCollection& vertex_collection, std::vector<VertexData>& out_vertices);
-        static void setup_attrib_pointers();
+        /// The VertexFormat::Packed layout, 24 bytes rather than 64
+        struct Packed {
+            // Unsigned normalised, dequantised in the shader, the 4th component is padding
+            uint16_t position[4];
+            // GL_INT_2_10_10_10_REV
+            uint32_t normal;
+            // Half floats
+            uint16_t texture_coordinate[2];
+            // Unsigned normalised
+            uint8_t bone_weights[4];
+            // Bone indices are always less than BONE_TRANSFORMS, so always fit in a byte
+            uint8_t bone_indices[4];
+        };
+
+        static Packed pack(const VertexData& vertex, const PositionDequantisation& dequantisation);
+
+        /// Write vertex_collection.vertex_count vertices to out_vertices, which must already have room for them
+        static void from_mesh(const VertexCollection& vertex_collection, VertexData* out_vertices);
+        static void setup_attrib_pointers(VertexFormat format = VertexFormat::Full);
     };
 
     using EntityMaterial = BaseLitEntityMaterial;
@@ -43,28 +63,120 @@ namespace AnimatedEntityRenderer {
     using RenderScene = RenderScene<Entity, GlobalData>;
 
     class AnimatedEntityShader : public BaseLitEntityShader {
-        // Animation Data
-        int bone_transforms_location{};
     public:
-        AnimatedEntityShader();
-
-        void set_model_matrix(const glm::mat4& model_matrix);
+        static const uint BONE_PALETTE_BINDING = 1;
+        /// Each matrix in the palette is stored as its top three rows, in std140 that is 3 vec4s
+        static constexpr size_t PALETTE_MATRIX_SIZE = 3 * sizeof(glm::vec4);
+        /// The size of the BonePalette block, a model matrix followed by BONE_TRANSFORMS bone transforms
+        static constexpr size_t BONE_PALETTE_SIZE = (1 + BONE_TRANSFORMS) * PALETTE_MATRIX_SIZE;
 
-        void set_bone_transforms(const std::vector<glm::mat4>& bone_transforms);
+        AnimatedEntityShader();
     private:
-        // Override get_uniforms_set_bindings to get the extra uniform for bone transforms
+        // Override get_uniforms_set_bindings to set the binding of the bone palette block
         void get_uniforms_set_bindings() override;
     };
 
+    /// How much of an instance's animation is evaluated each frame, chosen by its distance from the camera
+    enum class AnimationLod : uint {
+        Full,
+        // Poses are evaluated at fixed steps of animation time, and interpolated in between
+        ReducedRate,
+        // As ReducedRate, but the least important bones are also left in their bind pose
+        ReducedBones,
+    };
+
+    struct AnimationLodSettings {
+        bool enabled = true;
+        float reduced_rate_distance = 20.0f;
+        float reduced_bones_distance = 50.0f;
+        // Seconds of animation time between evaluated poses, at a reduced rate
+        float reduced_rate_interval = 0.1f;
+        // Bones with less than this many levels of descendants are skipped at ReducedBones, see MeshHierarchy::node_importance
+        int min_bone_importance = 1;
+    };
+
+    /// Counts from the last frame of pose evaluation
+    struct AnimationStatistics {
+        uint instances = 0;
+        uint poses_evaluated = 0;
+        // [AnimationLod] -> number of unique poses at that level
+        uint poses_at_lod[3] = {0, 0, 0};
+        // Animation channels (one per animated bone) sampled across every pose
+        uint bones_evaluated = 0;
+    };
+
+    /// Instances with the same key have identical poses, so only one of them needs evaluating
+    struct PoseKey {
+        const void* mesh_hierarchy;
+        uint animation_id;
+        double time_seconds;
+        AnimationLod lod;
+
+        bool operator==(const PoseKey& other) const {
+            return mesh_hierarchy == other.mesh_hierarchy && animation_id == other.animation_id && time_seconds == other.time_seconds && lod == other.lod;
+        }
+    };
+
+    struct PoseKeyHash {
+        size_t operator()(const PoseKey& key) const;
+    };
+
+    /// Which of an entity's poses had their channels queued on a sampler, so still need building once it is flushed
+    struct QueuedPose {
+        bool full = false;
+        bool lod_start = false;
+        bool lod_end = false;
+    };
+
     class AnimatedEntityRenderer {
         AnimatedEntityShader shader;
 
+        AnimationLodSettings animation_lod_settings{};
+        AnimationStatistics animation_statistics{};
+
+        // Rebuilt by each render for the poses it evaluates, but kept as members so their capacity carries over between frames
+        std::unordered_map<PoseKey, uint, PoseKeyHash> unique_poses{};
+        std::vector<std::pair<Entity*, AnimationLod>> pose_owners{};
+        // [pose_owners index] -> what was queued for it
+        std::vector<QueuedPose> queued_poses{};
+        // [entity, in scene iteration order] -> the pose to draw it with
+        std::vector<const AnimationPose*> entity_poses{};
+
+        // Every draw's model matrix and bone transforms for the frame, bound by offset rather than uploaded per draw
+        StreamingUniformBuffer palette_buffer;
+        // [draw, in scene then mesh_draws order] -> offset of its palette in palette_buffer
+        std::vector<size_t> palette_offsets{};
+
+        /// Write the palette of every draw into palette_buffer, after the poses have been evaluated
+        void write_palettes(const RenderScene& render_scene);
+
+        /// Evaluate the pose of every entity up front, once per unique (hierarchy, animation, time), on the thread pool
+        void evaluate_poses(const RenderScene& render_scene);
+
+        [[nodiscard]] AnimationLod select_animation_lod(const Entity& entity, const glm::vec3& camera_position) const;
+
+        /// Queue the channels an entity's pose needs at the given LOD on `sampler`, returning the number of animation channels queued.
+        /// Poses that need no sampling (not animated, or between two cached LOD poses) are left to finish_pose.
+        uint queue_pose(Entity& entity, AnimationLod lod, AnimationBatchSampler& sampler, QueuedPose& out_queued) const;
+
+        /// Build an entity's pose from its queued channels, once the sampler they were queued on has been flushed
+        void finish_pose(Entity& entity, const QueuedPose& queued) const;
     public:
+        /// The minimum number of poses evaluated per batch
+        static constexpr uint POSE_BATCH_SIZE = 4;
+
         AnimatedEntityRenderer();
 
         void render(const RenderScene& render_scene, const LightScene& light_scene);
 
         bool refresh_shaders();
+
+        [[nodiscard]] const AnimationStatistics& get_animation_statistics() const;
+
+        void set_animation_lod_settings(const AnimationLodSettings& settings);
+
+        /// Whether bone palettes are written straight into a persistently mapped buffer, rather than uploaded each frame
+        [[nodiscard]] bool is_palette_buffer_persistent() const;
     };
 }
 
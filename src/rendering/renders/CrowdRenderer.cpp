@@ -0,0 +1,192 @@
+#include "CrowdRenderer.h"
+
+#include <glad/gl.h>
+
+CrowdRenderer::Crowd::Crowd(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, InstanceData instance_data, RenderData render_data) :
+    mesh_hierarchy(mesh_hierarchy), instance_data(instance_data), render_data(std::move(render_data)) {
+    glGenBuffers(1, &instance_buffer);
+    glGenTextures(1, &instance_texture);
+}
+
+std::shared_ptr<CrowdRenderer::Crowd> CrowdRenderer::Crowd::create(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, InstanceData instance_data, RenderData render_data) {
+    return std::make_shared<Crowd>(mesh_hierarchy, instance_data, std::move(render_data));
+}
+
+const std::vector<CrowdRenderer::CrowdInstance>& CrowdRenderer::Crowd::get_instances() const {
+    return instances;
+}
+
+void CrowdRenderer::Crowd::set_instances(std::vector<CrowdInstance> new_instances) {
+    if (new_instances.size() > MAX_INSTANCES) {
+        throw std::runtime_error(Formatter() << "A crowd can have at most " << MAX_INSTANCES << " instances, but " << new_instances.size() << " were given");
+    }
+    instances = std::move(new_instances);
+    instances_dirty = true;
+}
+
+uint CrowdRenderer::Crowd::get_instance_texture() {
+    if (instances_dirty) {
+        // The top three rows of the transform, then (animation, time offset), with -1 meaning the bind pose
+        std::vector<glm::vec4> texels{};
+        texels.reserve(std::max<size_t>(instances.size(), 1) * TEXELS_PER_INSTANCE);
+        for (const auto& instance: instances) {
+            glm::mat4 transposed = glm::transpose(instance.transform);
+            texels.push_back(transposed[0]);
+            texels.push_back(transposed[1]);
+            texels.push_back(transposed[2]);
+            // The shader only has room for the first MAX_CROWD_ANIMATIONS animations, so any others are left in the bind pose
+            bool animated = instance.animation_id < mesh_hierarchy->animations.size() && instance.animation_id < MAX_CROWD_ANIMATIONS;
+            float animation = animated ? (float) instance.animation_id : -1.0f;
+            texels.emplace_back(animation, instance.time_offset_seconds, 0.0f, 0.0f);
+        }
+        // Buffer textures can't be empty
+        if (texels.empty()) texels.resize(TEXELS_PER_INSTANCE, glm::vec4{0.0f});
+
+        glBindBuffer(GL_TEXTURE_BUFFER, instance_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr) (texels.size() * sizeof(glm::vec4)), texels.data(), GL_STATIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, instance_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instance_buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        instance_allocation.resize(texels.size() * sizeof(glm::vec4));
+
+        instances_dirty = false;
+    }
+    instance_allocation.mark_used();
+    return instance_texture;
+}
+
+CrowdRenderer::Crowd::~Crowd() {
+    glDeleteTextures(1, &instance_texture);
+    glDeleteBuffers(1, &instance_buffer);
+}
+
+CrowdRenderer::CrowdShader::CrowdShader() :
+    BaseLitEntityShader("Crowd", "crowd/vert.glsl", "animated_entity/frag.glsl", {{"MAX_CROWD_ANIMATIONS", MAX_CROWD_ANIMATIONS_STR}}) {
+
+    get_uniforms_set_bindings();
+}
+
+void CrowdRenderer::CrowdShader::get_uniforms_set_bindings() {
+    BaseLitEntityShader::get_uniforms_set_bindings(); // Call the base implementation to load all the common uniforms
+    time_seconds_location = get_uniform_location("time_seconds");
+    frames_per_second_location = get_uniform_location("frames_per_second");
+    animation_ranges_location = get_uniform_location("animation_ranges");
+    mesh_transform_location = get_uniform_location("mesh_transform");
+    bone_offset_location = get_uniform_location("bone_offset");
+    // Texture sampler bindings
+    set_binding("baked_bones", BAKED_BONES_BINDING);
+    set_binding("instances", INSTANCES_BINDING);
+}
+
+void CrowdRenderer::CrowdShader::set_baked_animation(const BakedAnimation& baked_animation) {
+    const auto& animations = baked_animation.get_animations();
+    // (first_frame, frame_count, duration_seconds, unused)
+    std::vector<glm::vec4> ranges{};
+    for (auto i = 0u; i < std::min((uint) animations.size(), (uint) MAX_CROWD_ANIMATIONS); ++i) {
+        ranges.emplace_back((float) animations[i].first_frame, (float) animations[i].frame_count, animations[i].duration_seconds, 0.0f);
+    }
+
+    float frames_per_second = baked_animation.get_frames_per_second();
+    glProgramUniform1fv(id(), frames_per_second_location, 1, &frames_per_second);
+    if (!ranges.empty()) {
+        glProgramUniform4fv(id(), animation_ranges_location, (int) ranges.size(), &ranges[0][0]);
+    }
+}
+
+void CrowdRenderer::CrowdShader::set_time(double time_seconds) {
+    auto float_time = (float) time_seconds;
+    glProgramUniform1fv(id(), time_seconds_location, 1, &float_time);
+}
+
+void CrowdRenderer::CrowdShader::set_mesh(const glm::mat4& mesh_transform, uint bone_offset) {
+    glProgramUniformMatrix4fv(id(), mesh_transform_location, 1, GL_FALSE, &mesh_transform[0][0]);
+    glProgramUniform1i(id(), bone_offset_location, (int) bone_offset);
+}
+
+CrowdRenderer::CrowdRenderer::CrowdRenderer() : shader() {}
+
+const BakedAnimation& CrowdRenderer::CrowdRenderer::get_baked_animation(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy) {
+    auto baked = baked_animations.find(mesh_hierarchy.get());
+    // A different hierarchy may since have been allocated at the same address, so check it is still the same one
+    if (baked != baked_animations.end() && baked->second.first.lock() == mesh_hierarchy) {
+        return *baked->second.second;
+    }
+
+    // Drop bakes of freed hierarchies, while already paying for a bake
+    for (auto iter = baked_animations.begin(); iter != baked_animations.end();) {
+        iter = iter->second.first.expired() ? baked_animations.erase(iter) : std::next(iter);
+    }
+
+    auto baked_animation = BakedAnimation::bake(*mesh_hierarchy);
+    baked_animations[mesh_hierarchy.get()] = {mesh_hierarchy, baked_animation};
+    return *baked_animation;
+}
+
+void CrowdRenderer::CrowdRenderer::update(const RenderScene& render_scene, double dt) {
+    for (const auto& crowd: render_scene.entities) {
+        crowd->time_seconds += dt * crowd->speed;
+    }
+}
+
+void CrowdRenderer::CrowdRenderer::render(const RenderScene& render_scene, const LightScene& light_scene) {
+    crowd_statistics = {};
+
+    shader.use();
+    shader.set_global_data(render_scene.global_data);
+
+    for (const auto& crowd: render_scene.entities) {
+        const auto& instances = crowd->get_instances();
+        if (instances.empty()) continue;
+
+        const auto& baked_animation = get_baked_animation(crowd->mesh_hierarchy);
+
+        shader.set_instance_data(crowd->instance_data);
+        shader.set_baked_animation(baked_animation);
+        shader.set_time(crowd->time_seconds);
+
+        // The lights nearest the centre of the crowd light all of it, see the note in EntityRenderer::render about recompiles
+        glm::vec3 position = crowd->instance_data.model_matrix[3];
+        shader.set_point_lights(light_scene.get_nearest_point_lights(position, BaseLitEntityShader::MAX_PL, 1));
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, crowd->render_data.diffuse_texture->get_texture_id());
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, crowd->render_data.specular_map_texture->get_texture_id());
+        crowd->render_data.diffuse_texture->mark_used();
+        crowd->render_data.specular_map_texture->mark_used();
+        glActiveTexture(GL_TEXTURE0 + CrowdShader::BAKED_BONES_BINDING);
+        glBindTexture(GL_TEXTURE_2D, baked_animation.get_texture_id());
+        baked_animation.mark_used();
+        glActiveTexture(GL_TEXTURE0 + CrowdShader::INSTANCES_BINDING);
+        glBindTexture(GL_TEXTURE_BUFFER, crowd->get_instance_texture());
+
+        const auto& mesh_hierarchy = *crowd->mesh_hierarchy;
+        for (const auto& [node, mesh_id]: mesh_hierarchy.mesh_draws) {
+            const auto& mesh = mesh_hierarchy.meshes[mesh_id];
+
+            shader.set_mesh(mesh_hierarchy.node_bind_transforms[node], baked_animation.get_mesh_bone_offset(mesh_id));
+            shader.set_position_dequantisation(mesh.model->get_layout().dequantisation);
+
+            glBindVertexArray(mesh.model->get_vao());
+            mesh.model->mark_used();
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.model->get_index_count(), mesh.model->get_index_type(), nullptr, (int) instances.size(), mesh.model->get_vertex_offset());
+            crowd_statistics.draw_calls++;
+        }
+
+        crowd_statistics.crowds++;
+        crowd_statistics.instances += (uint) instances.size();
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    for (const auto& [hierarchy, baked]: baked_animations) {
+        crowd_statistics.baked_bytes += baked.second->get_size_bytes();
+    }
+}
+
+bool CrowdRenderer::CrowdRenderer::refresh_shaders() {
+    return shader.reload_files();
+}
+
+const CrowdRenderer::CrowdStatistics& CrowdRenderer::CrowdRenderer::get_crowd_statistics() const {
+    return crowd_statistics;
+}
@@ -0,0 +1,137 @@
+#ifndef CROWD_RENDERER_H
+#define CROWD_RENDERER_H
+
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "rendering/renders/shaders/ShaderInterface.h"
+#include "rendering/memory/GpuMemory.h"
+#include "rendering/scene/Lights.h"
+#include "rendering/scene/GlobalData.h"
+#include "rendering/scene/RenderScene.h"
+#include "rendering/resources/BakedAnimation.h"
+#include "rendering/resources/TextureHandle.h"
+
+#include "AnimatedEntityRenderer.h"
+
+#include "rendering/renders/shaders/BaseLitEntityShader.h"
+
+#define MAX_CROWD_ANIMATIONS 32
+#define MAX_CROWD_ANIMATIONS_STR "32"
+
+/// Renders crowds of identical animated characters, with every instance of a mesh in a single instanced draw.
+/// Instead of bone transforms being uploaded per instance, each instance only has an (animation, time offset),
+/// and the vertex shader fetches its bones from the hierarchy's BakedAnimation.
+namespace CrowdRenderer {
+    using VertexData = AnimatedEntityRenderer::VertexData;
+
+    using EntityMaterial = BaseLitEntityMaterial;
+    // The model matrix places the whole crowd, with each instance's transform relative to it
+    using InstanceData = BaseLitEntityInstanceData;
+    using GlobalData = BaseLitEntityGlobalData;
+    using RenderData = BaseLitEntityRenderData;
+
+    struct CrowdInstance {
+        glm::mat4 transform;
+        // NONE_ANIMATION for the bind pose
+        uint animation_id;
+        float time_offset_seconds;
+    };
+
+    /// A crowd of instances of one MeshHierarchy, which owns the buffer its instances are uploaded to
+    class Crowd : private NonCopyable {
+        std::vector<CrowdInstance> instances{};
+        bool instances_dirty = true;
+
+        uint instance_buffer{};
+        uint instance_texture{};
+        GpuAllocation instance_allocation{GpuResourceType::Buffer, "Crowd Instances"};
+    public:
+        /// The number of texels each instance takes in the instance buffer texture
+        static constexpr uint TEXELS_PER_INSTANCE = 4;
+        /// Texture buffers only have to support 65536 texels
+        static constexpr uint MAX_INSTANCES = 65536 / TEXELS_PER_INSTANCE;
+
+        std::shared_ptr<MeshHierarchy<VertexData>> mesh_hierarchy;
+        InstanceData instance_data;
+        RenderData render_data;
+
+        // Crowd wide playback time, each instance plays at this plus its offset
+        double time_seconds = 0.0;
+        double speed = 1.0;
+
+        Crowd(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, InstanceData instance_data, RenderData render_data);
+
+        static std::shared_ptr<Crowd> create(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, InstanceData instance_data, RenderData render_data);
+
+        [[nodiscard]] const std::vector<CrowdInstance>& get_instances() const;
+
+        /// Replace the instances, which are uploaded the next time the crowd is drawn. Throws if there are more than MAX_INSTANCES.
+        void set_instances(std::vector<CrowdInstance> new_instances);
+
+        /// Upload the instances if they have changed, and return the buffer texture holding them
+        uint get_instance_texture();
+
+        ~Crowd();
+    };
+
+    using Entity = Crowd;
+
+    using RenderScene = RenderScene<Entity, GlobalData>;
+
+    class CrowdShader : public BaseLitEntityShader {
+        int time_seconds_location{};
+        int frames_per_second_location{};
+        int animation_ranges_location{};
+        int mesh_transform_location{};
+        int bone_offset_location{};
+    public:
+        static constexpr uint BAKED_BONES_BINDING = 2;
+        static constexpr uint INSTANCES_BINDING = 3;
+
+        CrowdShader();
+
+        void set_baked_animation(const BakedAnimation& baked_animation);
+
+        void set_time(double time_seconds);
+
+        void set_mesh(const glm::mat4& mesh_transform, uint bone_offset);
+    private:
+        void get_uniforms_set_bindings() override;
+    };
+
+    /// Counts from the last frame
+    struct CrowdStatistics {
+        uint crowds = 0;
+        uint instances = 0;
+        uint draw_calls = 0;
+        size_t baked_bytes = 0;
+    };
+
+    class CrowdRenderer {
+        CrowdShader shader;
+
+        CrowdStatistics crowd_statistics{};
+
+        // Baked on first use, and kept until the hierarchy is freed
+        std::unordered_map<const MeshHierarchy<VertexData>*, std::pair<std::weak_ptr<MeshHierarchy<VertexData>>, std::shared_ptr<BakedAnimation>>> baked_animations{};
+
+        const BakedAnimation& get_baked_animation(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy);
+    public:
+        CrowdRenderer();
+
+        /// Advance the playback time of every crowd
+        void update(const RenderScene& render_scene, double dt);
+
+        void render(const RenderScene& render_scene, const LightScene& light_scene);
+
+        bool refresh_shaders();
+
+        [[nodiscard]] const CrowdStatistics& get_crowd_statistics() const;
+    };
+}
+
+#endif //CROWD_RENDERER_H
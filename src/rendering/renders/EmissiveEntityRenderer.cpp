@@ -33,9 +33,17 @@ void EmissiveEntityRenderer::EmissiveEntityRenderer::render(const RenderScene& r
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, entity->render_data.emission_texture->get_texture_id());
+        entity->render_data.emission_texture->mark_used();
 
-        glBindVertexArray(entity->model->get_vao());
-        glDrawElementsBaseVertex(GL_TRIANGLES, entity->model->get_index_count(), GL_UNSIGNED_INT, nullptr, entity->model->get_vertex_offset());
+        const auto& model = entity->model;
+        float screen_size = model->get_bounds().screen_size(entity->instance_data.model_matrix, render_scene.global_data.camera_position, render_scene.global_data.projection_scale);
+        entity->lod_level = model->select_lod(screen_size, entity->lod_level);
+        const auto& lod = model->get_lod(entity->lod_level);
+        shader.set_position_dequantisation(model->get_layout().dequantisation);
+
+        glBindVertexArray(model->get_vao());
+        model->mark_used();
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.index_count, model->get_index_type(), model->get_index_pointer(lod), model->get_vertex_offset());
     }
 }
 
@@ -32,6 +32,8 @@ void EntityRenderer::EntityRenderer::render(const RenderScene& render_scene, con
     shader.use();
     shader.set_global_data(render_scene.global_data);
 
+    meshlet_statistics = {};
+
     for (const auto& entity: render_scene.entities) {
         shader.set_instance_data(entity->instance_data);
 
@@ -48,41 +50,123 @@ void EntityRenderer::EntityRenderer::render(const RenderScene& render_scene, con
         glBindTexture(GL_TEXTURE_2D, entity->render_data.diffuse_texture->get_texture_id());
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, entity->render_data.specular_map_texture->get_texture_id());
+        entity->render_data.diffuse_texture->mark_used();
+        entity->render_data.specular_map_texture->mark_used();
+
+        const auto& model = entity->model;
+        float screen_size = model->get_bounds().screen_size(entity->instance_data.model_matrix, render_scene.global_data.camera_position, render_scene.global_data.projection_scale);
+        entity->lod_level = model->select_lod(screen_size, entity->lod_level);
+        const auto& lod = model->get_lod(entity->lod_level);
+        shader.set_position_dequantisation(model->get_layout().dequantisation);
+
+        glBindVertexArray(model->get_vao());
+        model->mark_used();
+        if (meshlet_culling && entity->lod_level == 0 && !model->get_meshlets().empty()) {
+            draw_meshlets(*entity, render_scene.global_data);
+        } else {
+            glDrawElementsBaseVertex(GL_TRIANGLES, lod.index_count, model->get_index_type(), model->get_index_pointer(lod), model->get_vertex_offset());
+        }
+    }
+}
 
-        glBindVertexArray(entity->model->get_vao());
-        glDrawElementsBaseVertex(GL_TRIANGLES, entity->model->get_index_count(), GL_UNSIGNED_INT, nullptr, entity->model->get_vertex_offset());
+void EntityRenderer::EntityRenderer::draw_meshlets(const Entity& entity, const GlobalData& global_data) {
+    const auto& model = entity.model;
+    const auto& meshlets = model->get_meshlets();
+
+    // Cull in model space, so the meshlet bounds and cones don't need transforming
+    const glm::mat4& model_matrix = entity.instance_data.model_matrix;
+    glm::vec3 model_space_camera = glm::inverse(model_matrix) * glm::vec4(global_data.camera_position, 1.0f);
+    MeshletFrustum frustum = MeshletFrustum::from_matrix(global_data.projection_view_matrix * model_matrix, model_space_camera);
+
+    meshlet_results.resize(meshlets.size());
+    ThreadPool::global().parallel_for(meshlets.size(), MESHLET_BATCH_SIZE, [this, &meshlets, &frustum](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            meshlet_results[i] = Meshlets::cull(meshlets[i], frustum);
+        }
+    });
+
+    // Merge consecutive visible meshlets into one range, since they are contiguous in the index buffer
+    draw_counts.clear();
+    draw_offsets.clear();
+    bool previous_visible = false;
+    for (auto i = 0u; i < meshlets.size(); ++i) {
+        const auto& meshlet = meshlets[i];
+        meshlet_statistics.meshlets++;
+        meshlet_statistics.triangles += meshlet.index_count / 3;
+
+        if (meshlet_results[i] != Meshlets::CullResult::Visible) {
+            if (meshlet_results[i] == Meshlets::CullResult::Frustum) meshlet_statistics.frustum_culled++;
+            else meshlet_statistics.backface_culled++;
+            meshlet_statistics.triangles_culled += meshlet.index_count / 3;
+            previous_visible = false;
+            continue;
+        }
+
+        if (previous_visible) {
+            draw_counts.back() += (int) meshlet.index_count;
+        } else {
+            draw_counts.push_back((int) meshlet.index_count);
+            draw_offsets.push_back(model->get_index_pointer(ModelLod{(int) meshlet.index_offset, (int) meshlet.index_count}));
+        }
+        previous_visible = true;
     }
+
+    if (draw_counts.empty()) return;
+
+    draw_base_vertices.assign(draw_counts.size(), model->get_vertex_offset());
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, draw_counts.data(), model->get_index_type(), draw_offsets.data(), (int) draw_counts.size(), draw_base_vertices.data());
+}
+
+void EntityRenderer::EntityRenderer::set_meshlet_culling(bool enabled) {
+    meshlet_culling = enabled;
+}
+
+const EntityRenderer::MeshletStatistics& EntityRenderer::EntityRenderer::get_meshlet_statistics() const {
+    return meshlet_statistics;
 }
 
 bool EntityRenderer::EntityRenderer::refresh_shaders() {
     return shader.reload_files();
 }
 
-void EntityRenderer::VertexData::from_mesh(const VertexCollection& vertex_collection, std::vector<VertexData>& out_vertices) {
-    out_vertices.reserve(out_vertices.size() + vertex_collection.positions.size());
-
-    if (vertex_collection.normals.empty() || vertex_collection.normals.size() != vertex_collection.positions.size()) {
+void EntityRenderer::VertexData::from_mesh(const VertexCollection& vertex_collection, VertexData* out_vertices) {
+    if (vertex_collection.normals == nullptr) {
         throw std::runtime_error("EntityRenderer::VertexData requires normals");
     }
 
-    if (vertex_collection.tex_coords.empty() || vertex_collection.tex_coords.size() != vertex_collection.positions.size()) {
+    if (vertex_collection.tex_coords == nullptr) {
         throw std::runtime_error("EntityRenderer::VertexData requires texture coordinates");
     }
 
-    for (auto i = 0u; i < vertex_collection.positions.size(); i++) {
-        out_vertices.push_back(VertexData{
-            vertex_collection.positions[i],
-            vertex_collection.normals[i],
-            vertex_collection.tex_coords[i]
-        });
+    for (auto i = 0u; i < vertex_collection.vertex_count; i++) {
+        out_vertices[i] = VertexData{
+            vertex_collection.position(i),
+            vertex_collection.normal(i),
+            vertex_collection.tex_coord(i)
+        };
     }
 }
 
 
-void EntityRenderer::VertexData::setup_attrib_pointers() {
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, position));
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, normal));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, texture_coordinate));
+EntityRenderer::VertexData::Packed EntityRenderer::VertexData::pack(const VertexData& vertex, const PositionDequantisation& dequantisation) {
+    Packed packed{};
+    VertexPacking::quantise_position(vertex.position, dequantisation, packed.position);
+    packed.normal = VertexPacking::pack_snorm_10_10_10_2(vertex.normal);
+    packed.texture_coordinate[0] = VertexPacking::float_to_half(vertex.texture_coordinate.x);
+    packed.texture_coordinate[1] = VertexPacking::float_to_half(vertex.texture_coordinate.y);
+    return packed;
+}
+
+void EntityRenderer::VertexData::setup_attrib_pointers(VertexFormat format) {
+    if (format == VertexFormat::Packed) {
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Packed), (void*) offsetof(Packed, position));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Packed), (void*) offsetof(Packed, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Packed), (void*) offsetof(Packed, texture_coordinate));
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*) offsetof(VertexData, texture_coordinate));
+    }
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
@@ -15,6 +15,7 @@
 #include "rendering/resources/ModelLoader.h"
 #include "rendering/resources/TextureHandle.h"
 #include "rendering/memory/UniformBufferArray.h"
+#include "utility/ThreadPool.h"
 
 #include "rendering/renders/shaders/BaseLitEntityShader.h"
 
@@ -24,8 +25,21 @@ namespace EntityRenderer {
         glm::vec3 normal;
         glm::vec2 texture_coordinate;
 
-        static void from_mesh(const VertexCollection& vertex_collection, std::vector<VertexData>& out_vertices);
-        static void setup_attrib_pointers();
+        /// The VertexFormat::Packed layout, 16 bytes rather than 32
+        struct Packed {
+            // Unsigned normalised, dequantised in the shader, the 4th component is padding
+            uint16_t position[4];
+            // GL_INT_2_10_10_10_REV
+            uint32_t normal;
+            // Half floats
+            uint16_t texture_coordinate[2];
+        };
+
+        static Packed pack(const VertexData& vertex, const PositionDequantisation& dequantisation);
+
+        /// Write vertex_collection.vertex_count vertices to out_vertices, which must already have room for them
+        static void from_mesh(const VertexCollection& vertex_collection, VertexData* out_vertices);
+        static void setup_attrib_pointers(VertexFormat format = VertexFormat::Full);
     };
 
     using EntityMaterial = BaseLitEntityMaterial;
@@ -47,15 +61,42 @@ namespace EntityRenderer {
         void get_uniforms_set_bindings() override;
     };
 
+    /// Counts from the last frame of meshlet culling
+    struct MeshletStatistics {
+        uint meshlets = 0;
+        uint frustum_culled = 0;
+        uint backface_culled = 0;
+        uint triangles = 0;
+        uint triangles_culled = 0;
+    };
+
     class EntityRenderer {
         EntityShader shader;
 
+        bool meshlet_culling = true;
+        MeshletStatistics meshlet_statistics{};
+
+        // Scratch buffers for meshlet culling, kept to avoid reallocating every frame
+        std::vector<Meshlets::CullResult> meshlet_results{};
+        std::vector<int> draw_counts{};
+        std::vector<const void*> draw_offsets{};
+        std::vector<int> draw_base_vertices{};
+
+        /// Cull the meshlets of an entity on the thread pool and draw the surviving ranges with a single multi-draw
+        void draw_meshlets(const Entity& entity, const GlobalData& global_data);
     public:
+        /// The minimum number of meshlets culled per batch, so smaller models are culled on the calling thread without waking the pool
+        static constexpr uint MESHLET_BATCH_SIZE = 256;
+
         EntityRenderer();
 
         void render(const RenderScene& render_scene, const LightScene& light_scene);
 
         bool refresh_shaders();
+
+        void set_meshlet_culling(bool enabled);
+
+        [[nodiscard]] const MeshletStatistics& get_meshlet_statistics() const;
     };
 }
 
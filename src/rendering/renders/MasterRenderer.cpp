@@ -4,7 +4,7 @@
 #include "rendering/imgui/ImGuiManager.h"
 #include "scene/SceneContext.h"
 
-MasterRenderer::MasterRenderer() : entity_renderer(), animated_entity_renderer(), emissive_entity_renderer(), render_settings() {
+MasterRenderer::MasterRenderer() : entity_renderer(), animated_entity_renderer(), emissive_entity_renderer(), crowd_renderer(), render_settings() {
     glEnable(GL_DEPTH_TEST);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     glEnable(GL_CULL_FACE);
@@ -20,8 +20,10 @@ void MasterRenderer::update(const Window& window) {
 
 void MasterRenderer::render_scene(MasterRenderScene& render_scene, const SceneContext& scene_context) {
     render_scene.animator.animate(scene_context.window_manager.get_delta_time());
+    crowd_renderer.update(render_scene.crowd_scene, scene_context.window_manager.get_delta_time());
     entity_renderer.render(render_scene.entity_scene, render_scene.light_scene);
     animated_entity_renderer.render(render_scene.animated_entity_scene, render_scene.light_scene);
+    crowd_renderer.render(render_scene.crowd_scene, render_scene.light_scene);
     emissive_entity_renderer.render(render_scene.emissive_entity_scene);
 }
 
@@ -31,6 +33,15 @@ void MasterRenderer::sync() {
     }
 }
 
+int MasterRenderer::refresh_shaders() {
+    int failures = 0;
+    failures += entity_renderer.refresh_shaders() ? 0 : 1;
+    failures += animated_entity_renderer.refresh_shaders() ? 0 : 1;
+    failures += emissive_entity_renderer.refresh_shaders() ? 0 : 1;
+    failures += crowd_renderer.refresh_shaders() ? 0 : 1;
+    return failures;
+}
+
 void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
     if (ImGui::CollapsingHeader("Render Settings")) {
         if (ImGui::Checkbox("Show Wireframe", &render_settings.show_wireframe)) {
@@ -57,6 +68,36 @@ void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
             window_manager.set_v_sync(render_settings.v_sync);
         }
 
+        if (ImGui::Checkbox("Meshlet Culling", &render_settings.meshlet_culling)) {
+            entity_renderer.set_meshlet_culling(render_settings.meshlet_culling);
+        }
+        if (render_settings.meshlet_culling) {
+            const auto& statistics = entity_renderer.get_meshlet_statistics();
+            ImGui::TextDisabled("Meshlets: %u, Frustum Culled: %u, Backface Culled: %u",
+                                statistics.meshlets, statistics.frustum_culled, statistics.backface_culled);
+            ImGui::TextDisabled("Meshlet Triangles: %u, Culled: %u", statistics.triangles, statistics.triangles_culled);
+        }
+
+        bool animation_lod_changed = ImGui::Checkbox("Animation LOD", &render_settings.animation_lod.enabled);
+        if (render_settings.animation_lod.enabled) {
+            animation_lod_changed |= ImGui::DragFloat("Reduced Rate Distance", &render_settings.animation_lod.reduced_rate_distance, 0.5f, 0.0f, FLT_MAX);
+            animation_lod_changed |= ImGui::DragFloat("Reduced Bones Distance", &render_settings.animation_lod.reduced_bones_distance, 0.5f, 0.0f, FLT_MAX);
+            animation_lod_changed |= ImGui::SliderFloat("Reduced Rate Interval", &render_settings.animation_lod.reduced_rate_interval, 1.0f / 60.0f, 0.5f);
+            animation_lod_changed |= ImGui::SliderInt("Min Bone Importance", &render_settings.animation_lod.min_bone_importance, 0, 4);
+        }
+        if (animation_lod_changed) {
+            animated_entity_renderer.set_animation_lod_settings(render_settings.animation_lod);
+        }
+        const auto& animation_statistics = animated_entity_renderer.get_animation_statistics();
+        ImGui::TextDisabled("Animated Instances: %u, Poses Evaluated: %u", animation_statistics.instances, animation_statistics.poses_evaluated);
+        ImGui::TextDisabled("Poses at LOD (Full/Rate/Bones): %u/%u/%u, Bones Evaluated: %u",
+                            animation_statistics.poses_at_lod[0], animation_statistics.poses_at_lod[1], animation_statistics.poses_at_lod[2], animation_statistics.bones_evaluated);
+        ImGui::TextDisabled("Bone Palettes: %s", animated_entity_renderer.is_palette_buffer_persistent() ? "Persistently Mapped" : "Uploaded Per Frame");
+
+        const auto& crowd_statistics = crowd_renderer.get_crowd_statistics();
+        ImGui::TextDisabled("Crowds: %u, Instances: %u, Draw Calls: %u, Baked Animations: %.2f MiB",
+                            crowd_statistics.crowds, crowd_statistics.instances, crowd_statistics.draw_calls, (double) crowd_statistics.baked_bytes / (1024.0 * 1024.0));
+
         ImGui::Checkbox("Enable FPS Cap", &render_settings.enable_fps_cap);
 
         if (ImGui::SliderFloat("FPS Cap", &render_settings.fps_cap, 24.0f, 240.0f)) {
@@ -71,10 +112,7 @@ void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
         static double last_time = -std::numeric_limits<double>::infinity();
         if (ImGui::Button("Reload Shader Files")) {
             last_time = glfwGetTime();
-            failures = 0;
-            failures += entity_renderer.refresh_shaders() ? 0 : 1;
-            failures += animated_entity_renderer.refresh_shaders() ? 0 : 1;
-            failures += emissive_entity_renderer.refresh_shaders() ? 0 : 1;
+            failures = refresh_shaders();
         }
         if (glfwGetTime() - 2.0 <= last_time) {
             ImGui::SameLine();
@@ -4,6 +4,7 @@
 #include "utility/SyncManager.h"
 #include "EntityRenderer.h"
 #include "EmissiveEntityRenderer.h"
+#include "CrowdRenderer.h"
 #include "rendering/scene/MasterRenderScene.h"
 #include "system_interfaces/WindowManager.h"
 #include "scene/SceneInterface.h"
@@ -14,6 +15,7 @@ class MasterRenderer {
     EntityRenderer::EntityRenderer entity_renderer;
     AnimatedEntityRenderer::AnimatedEntityRenderer animated_entity_renderer;
     EmissiveEntityRenderer::EmissiveEntityRenderer emissive_entity_renderer;
+    CrowdRenderer::CrowdRenderer crowd_renderer;
     SyncManager sync_manager;
 
     struct RenderSettings {
@@ -21,6 +23,8 @@ class MasterRenderer {
         bool cull_back_face = true;
         bool cull_front_face = false;
         bool v_sync = false;
+        bool meshlet_culling = true;
+        AnimatedEntityRenderer::AnimationLodSettings animation_lod{};
         bool enable_fps_cap = true;
         float fps_cap = 240.0f;
     } render_settings;
@@ -34,6 +38,9 @@ public:
     /// Synchronise the framerate if enabled.
     void sync();
 
+    /// Reload every renderer's shaders from disk, returning how many failed. Those that fail keep their previous version.
+    int refresh_shaders();
+
     /// Adds a control for editing the RenderSettings
     void add_imgui_options_section(WindowManager& window_manager);
 };
@@ -17,6 +17,9 @@ void BaseEntityShader::get_uniforms_set_bindings() {
     // Global
     ws_view_position_location = get_uniform_location("ws_view_position");
     inverse_gamma_location = get_uniform_location("inverse_gamma");
+    // Model
+    position_offset_location = get_uniform_location("position_offset");
+    position_scale_location = get_uniform_location("position_scale");
 }
 
 void BaseEntityShader::set_instance_data(const BaseEntityInstanceData& instance_data) {
@@ -28,4 +31,9 @@ void BaseEntityShader::set_global_data(const BaseEntityGlobalData& global_data)
     glProgramUniformMatrix4fv(id(), projection_view_matrix_location, 1, GL_FALSE, &global_data.projection_view_matrix[0][0]);
     glProgramUniform3fv(id(), ws_view_position_location, 1, &global_data.camera_position[0]);
     glProgramUniform1f(id(), inverse_gamma_location, 1.0f / global_data.gamma);
-}
\ No newline at end of file
+}
+
+void BaseEntityShader::set_position_dequantisation(const PositionDequantisation& dequantisation) {
+    glProgramUniform3fv(id(), position_offset_location, 1, &dequantisation.offset[0]);
+    glProgramUniform3fv(id(), position_scale_location, 1, &dequantisation.scale[0]);
+}
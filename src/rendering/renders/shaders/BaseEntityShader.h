@@ -30,11 +30,15 @@ struct BaseEntityGlobalData : public GlobalDataCameraInterface {
     glm::mat4 projection_view_matrix{};
     glm::vec3 camera_position{};
     float gamma = 1.0f;
+    // The [1][1] element of the projection matrix, used to estimate on screen sizes for level of detail selection
+    float projection_scale = 1.0f;
 
     void use_camera(const CameraInterface& camera_interface) override {
-        projection_view_matrix = camera_interface.get_projection_matrix() * camera_interface.get_view_matrix();
+        glm::mat4 projection_matrix = camera_interface.get_projection_matrix();
+        projection_view_matrix = projection_matrix * camera_interface.get_view_matrix();
         camera_position = camera_interface.get_position();
         gamma = camera_interface.get_gamma();
+        projection_scale = projection_matrix[1][1];
     }
 };
 
@@ -45,6 +49,9 @@ protected:
     // Global Data
     int ws_view_position_location{};
     int inverse_gamma_location{};
+    // Model Data
+    int position_offset_location{};
+    int position_scale_location{};
 public:
     BaseEntityShader(std::string name, const std::string& vertex_path, const std::string& fragment_path,
                      std::unordered_map<std::string, std::string> vert_defines = {},
@@ -53,6 +60,9 @@ public:
     void set_instance_data(const BaseEntityInstanceData& instance_data);
 
     void set_global_data(const BaseEntityGlobalData& global_data);
+
+    /// Set the transform from the model's (possibly quantised) vertex positions back to model space
+    void set_position_dequantisation(const PositionDequantisation& dequantisation);
 protected:
     virtual void get_uniforms_set_bindings();
 };
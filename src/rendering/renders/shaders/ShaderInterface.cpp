@@ -5,7 +5,7 @@ ShaderInterface::ShaderInterface(std::string name, const std::string& vertex_pat
                                  std::function<void()> setup,
                                  std::unordered_map<std::string, std::string> vert_defines,
                                  std::unordered_map<std::string, std::string> frag_defines)
-    : uniform_locations(), uniform_block_indices(), shader_name(std::move(name)), vertex_path(vertex_path), fragment_path(fragment_path), setup(std::move(setup)), vert_defines(std::move(vert_defines)), frag_defines(std::move(frag_defines)) {
+    : uniform_locations(), uniform_block_indices(), shader_name(std::move(name)), vertex_path(vertex_path), fragment_path(fragment_path), setup(std::move(setup)), vert_defines(std::move(vert_defines)), frag_defines(std::move(frag_defines)), gpu_allocation(GpuResourceType::Shader, shader_name) {
 
     vertex_code = load_shader_file(SHADER_DIR + "/" + vertex_path).value(); // Will throw exception on failure
     fragment_code = load_shader_file(SHADER_DIR + "/" + fragment_path).value(); // Will throw exception on failure
@@ -17,6 +17,7 @@ ShaderInterface::ShaderInterface(std::string name, const std::string& vertex_pat
     auto fragmentShader = compile_shader_code(realisedFragmentCode, GL_FRAGMENT_SHADER, shader_name).value(); // Will throw exception on failure
 
     program_id = link_program(vertexShader, fragmentShader, shader_name).value(); // Will throw exception on failure
+    gpu_allocation.resize(get_program_bytes(program_id));
 
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
@@ -27,6 +28,7 @@ uint ShaderInterface::id() const {
 }
 
 void ShaderInterface::use() const {
+    gpu_allocation.mark_used();
     glUseProgram(program_id);
 }
 
@@ -64,6 +66,7 @@ void ShaderInterface::recompile(
 
     auto old_program = program_id;
     program_id = link_program(vertex_shader, fragment_shader, shader_name).value(); // Will throw exception on failure
+    gpu_allocation.resize(get_program_bytes(program_id));
 
     glDeleteProgram(old_program);
     glDeleteShader(vertex_shader);
@@ -263,6 +266,13 @@ std::optional<uint> ShaderInterface::link_program(uint vertex_shader, uint fragm
     return program;
 }
 
+size_t ShaderInterface::get_program_bytes(uint program) {
+    // GL has no portable way to ask for a program's size, but the binary the driver would save is a close match
+    int binary_length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+    return (size_t) std::max(binary_length, 0);
+}
+
 int ShaderInterface::get_uniform_location(const std::string& name) {
     auto search = uniform_locations.find(name);
 
@@ -307,6 +317,7 @@ void ShaderInterface::cleanup() {
         glDeleteProgram(program_id);
         program_id = GL_INVALID_INDEX;
     }
+    gpu_allocation.resize(0);
 }
 
 ShaderInterface::~ShaderInterface() {
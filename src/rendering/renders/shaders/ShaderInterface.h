@@ -15,6 +15,7 @@
 #include "glad/gl.h"
 
 #include "utility/HelperTypes.h"
+#include "rendering/memory/GpuMemory.h"
 
 /// An interface for GLSL shaders with a bunch of helpers and things to make your life easier.
 class ShaderInterface {
@@ -35,6 +36,8 @@ class ShaderInterface {
 
     std::unordered_map<std::string, std::string> vert_defines;
     std::unordered_map<std::string, std::string> frag_defines;
+
+    GpuAllocation gpu_allocation;
 public:
     /// Construct the interface, proving the name of shaders (used for error formatting), the paths to the vertex
     /// and fragment shaders, also a setup function which is called initially and when the shader is reloaded from disk (hot loaded).
@@ -75,6 +78,9 @@ private:
 
     static std::optional<uint> link_program(uint vertex_shader, uint fragment_shader, const std::string& shader_name);
 
+    /// An estimate of the video memory a linked program takes up, from the size of its binary
+    static size_t get_program_bytes(uint program);
+
 protected:
     [[nodiscard]] int get_uniform_location(const std::string& name);
     [[nodiscard]] uint get_uniform_block_index(const std::string& name);
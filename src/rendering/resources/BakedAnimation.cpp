@@ -0,0 +1,56 @@
+#include "BakedAnimation.h"
+
+#include <glad/gl.h>
+
+BakedAnimation::BakedAnimation(uint texture_id, uint width, uint height, float frames_per_second, std::vector<AnimationRange> animations, std::vector<uint> mesh_bone_offsets) :
+    texture_id(texture_id), width(width), height(height), frames_per_second(frames_per_second), animations(std::move(animations)), mesh_bone_offsets(std::move(mesh_bone_offsets)),
+    gpu_allocation(GpuResourceType::Texture, "Baked Animation", get_size_bytes()) {}
+
+uint BakedAnimation::create_texture(const std::vector<glm::vec4>& texels, uint width, uint height) {
+    int max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (width > (uint) max_size || height > (uint) max_size) {
+        throw std::runtime_error(Formatter() << "Baked animation (" << width << "x" << height << ") exceeds the maximum texture size of " << max_size
+                                             << ", try baking at a lower rate");
+    }
+
+    uint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, (int) width, (int) height, 0, GL_RGBA, GL_FLOAT, texels.data());
+    // Only ever read with texelFetch, but the texture is incomplete without a non-mipmap filter
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texture_id;
+}
+
+uint BakedAnimation::get_texture_id() const {
+    return texture_id;
+}
+
+float BakedAnimation::get_frames_per_second() const {
+    return frames_per_second;
+}
+
+const std::vector<BakedAnimation::AnimationRange>& BakedAnimation::get_animations() const {
+    return animations;
+}
+
+uint BakedAnimation::get_mesh_bone_offset(uint mesh_id) const {
+    return mesh_bone_offsets[mesh_id];
+}
+
+size_t BakedAnimation::get_size_bytes() const {
+    return (size_t) width * height * sizeof(glm::vec4);
+}
+
+void BakedAnimation::mark_used() const {
+    gpu_allocation.mark_used();
+}
+
+BakedAnimation::~BakedAnimation() {
+    glDeleteTextures(1, &texture_id);
+}
@@ -0,0 +1,110 @@
+#ifndef BAKED_ANIMATION_H
+#define BAKED_ANIMATION_H
+
+#include <cmath>
+#include <vector>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include "MeshHierarchy.h"
+#include "utility/HelperTypes.h"
+#include "rendering/memory/GpuMemory.h"
+
+/// Every animation of a MeshHierarchy sampled at a fixed rate into a float texture, so the vertex shader can look up
+/// bone transforms itself instead of them being uploaded per instance.
+///
+/// Each row of the texture is one frame, and each bone takes BAKED_TEXELS_PER_BONE consecutive RGBA32F texels,
+/// holding the top three rows of its transform (the last row is always 0, 0, 0, 1).
+/// The animations are stacked vertically, and the bones of each mesh are placed side by side.
+class BakedAnimation : private NonCopyable {
+public:
+    static constexpr uint BAKED_TEXELS_PER_BONE = 3;
+    static constexpr float DEFAULT_FRAMES_PER_SECOND = 30.0f;
+
+    struct AnimationRange {
+        uint first_frame;
+        uint frame_count;
+        float duration_seconds;
+    };
+
+private:
+    uint texture_id;
+    uint width;
+    uint height;
+    float frames_per_second;
+    // [animation_id] -> rows of the texture
+    std::vector<AnimationRange> animations;
+    // [mesh_id] -> index of the mesh's first bone in a row
+    std::vector<uint> mesh_bone_offsets;
+    GpuAllocation gpu_allocation;
+
+    BakedAnimation(uint texture_id, uint width, uint height, float frames_per_second, std::vector<AnimationRange> animations, std::vector<uint> mesh_bone_offsets);
+
+    /// Upload the baked rows, checking they fit in a texture
+    static uint create_texture(const std::vector<glm::vec4>& texels, uint width, uint height);
+public:
+    /// Sample every animation of the hierarchy, from 0 to its duration inclusive, `frames_per_second` times a second.
+    template<typename VertexData>
+    static std::shared_ptr<BakedAnimation> bake(const MeshHierarchy<VertexData>& mesh_hierarchy, float frames_per_second = DEFAULT_FRAMES_PER_SECOND);
+
+    [[nodiscard]] uint get_texture_id() const;
+    [[nodiscard]] float get_frames_per_second() const;
+    [[nodiscard]] const std::vector<AnimationRange>& get_animations() const;
+    [[nodiscard]] uint get_mesh_bone_offset(uint mesh_id) const;
+    /// Size of the texture in bytes
+    [[nodiscard]] size_t get_size_bytes() const;
+    /// Record that the texture is being bound this frame, for GpuMemory
+    void mark_used() const;
+
+    ~BakedAnimation();
+};
+
+template<typename VertexData>
+std::shared_ptr<BakedAnimation> BakedAnimation::bake(const MeshHierarchy<VertexData>& mesh_hierarchy, float frames_per_second) {
+    std::vector<uint> mesh_bone_offsets{};
+    uint bone_count = 0;
+    for (const auto& mesh: mesh_hierarchy.meshes) {
+        mesh_bone_offsets.push_back(bone_count);
+        bone_count += (uint) mesh.bones.size();
+    }
+    // Always have at least one texel, so a hierarchy without bones still produces a valid texture
+    uint width = std::max(bone_count, 1u) * BAKED_TEXELS_PER_BONE;
+
+    std::vector<AnimationRange> animations{};
+    uint frame_count_total = 0;
+    for (const auto& [name, ticks_per_second, duration_ticks]: mesh_hierarchy.animations) {
+        auto duration_seconds = (float) (duration_ticks / ticks_per_second);
+        auto frame_count = (uint) std::ceil(duration_seconds * frames_per_second) + 1;
+        animations.push_back(AnimationRange{frame_count_total, frame_count, duration_seconds});
+        frame_count_total += frame_count;
+    }
+    uint height = std::max(frame_count_total, 1u);
+
+    std::vector<glm::vec4> texels(width * height, glm::vec4{0.0f});
+    AnimationPose pose{};
+    std::vector<AnimationCursor> cursors{};
+    for (auto animation_id = 0u; animation_id < animations.size(); ++animation_id) {
+        const auto& range = animations[animation_id];
+        for (auto frame = 0u; frame < range.frame_count; ++frame) {
+            double time_seconds = std::min((double) frame / frames_per_second, (double) range.duration_seconds);
+            mesh_hierarchy.calculate_animation(animation_id, time_seconds, pose, &cursors);
+
+            glm::vec4* row = &texels[(range.first_frame + frame) * width];
+            for (auto mesh_id = 0u; mesh_id < pose.bone_transforms.size(); ++mesh_id) {
+                const auto& bone_transforms = pose.bone_transforms[mesh_id];
+                for (auto bone_id = 0u; bone_id < bone_transforms.size(); ++bone_id) {
+                    glm::mat4 transposed = glm::transpose(bone_transforms[bone_id]);
+                    for (auto i = 0u; i < BAKED_TEXELS_PER_BONE; ++i) {
+                        row[(mesh_bone_offsets[mesh_id] + bone_id) * BAKED_TEXELS_PER_BONE + i] = transposed[(int) i];
+                    }
+                }
+            }
+        }
+    }
+
+    uint texture_id = create_texture(texels, width, height);
+    return std::shared_ptr<BakedAnimation>(new BakedAnimation(texture_id, width, height, frames_per_second, std::move(animations), std::move(mesh_bone_offsets)));
+}
+
+#endif //BAKED_ANIMATION_H
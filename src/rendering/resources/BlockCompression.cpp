@@ -0,0 +1,378 @@
+#include "BlockCompression.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <glad/gl.h>
+
+#include "utility/ThreadPool.h"
+
+// Rows of blocks encoded per batch on the thread pool
+static constexpr size_t ENCODE_BATCH_ROWS = 4;
+
+// A 4x4 block of texels, always with four channels
+using Block = std::array<std::array<float, 4>, 16>;
+
+const char* BlockCompression::get_name(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1:
+            return "BC1";
+        case BlockFormat::BC3:
+            return "BC3";
+        case BlockFormat::BC4:
+            return "BC4";
+        case BlockFormat::BC5:
+            return "BC5";
+        case BlockFormat::BC7:
+            return "BC7";
+    }
+    return "Unknown";
+}
+
+size_t BlockCompression::get_block_bytes(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t BlockCompression::get_level_bytes(BlockFormat format, uint width, uint height) {
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * get_block_bytes(format);
+}
+
+uint BlockCompression::get_gl_format(BlockFormat format, bool srgb) {
+    switch (format) {
+        case BlockFormat::BC1:
+            return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3:
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case BlockFormat::BC7:
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+bool BlockCompression::is_supported(BlockFormat format, bool srgb) {
+    switch (format) {
+        case BlockFormat::BC1:
+        case BlockFormat::BC3:
+            // Not core, but supported by every desktop driver. The sRGB forms come from EXT_texture_sRGB instead.
+            return GLAD_GL_EXT_texture_compression_s3tc != 0 && (!srgb || GLAD_GL_EXT_texture_sRGB != 0);
+        case BlockFormat::BC4:
+        case BlockFormat::BC5:
+            // Core since GL 3.0
+            return true;
+        case BlockFormat::BC7:
+            return GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_compression_bptc;
+    }
+    return false;
+}
+
+BlockFormat BlockCompression::choose_format(int channels) {
+    switch (channels) {
+        case 1:
+            return BlockFormat::BC4;
+        case 2:
+            return BlockFormat::BC5;
+        case 3:
+            return BlockFormat::BC1;
+        default:
+            return BlockFormat::BC3;
+    }
+}
+
+int BlockCompression::get_channels(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC4:
+            return 1;
+        case BlockFormat::BC5:
+            return 2;
+        case BlockFormat::BC1:
+            return 3;
+        case BlockFormat::BC3:
+        case BlockFormat::BC7:
+            return 4;
+    }
+    return 4;
+}
+
+static float srgb_to_linear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/// Halve the image in each dimension (down to 1), averaging each 2x2 group of texels
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& pixels, uint width, uint height, int channels, bool srgb) {
+    static const auto to_linear = []() {
+        std::array<float, 256> table{};
+        for (auto i = 0u; i < table.size(); ++i) {
+            table[i] = srgb_to_linear((float) i / 255.0f);
+        }
+        return table;
+    }();
+
+    uint next_width = std::max(width / 2, 1u);
+    uint next_height = std::max(height / 2, 1u);
+    std::vector<unsigned char> next((size_t) next_width * next_height * channels);
+
+    // Alpha is always linear
+    int colour_channels = srgb ? std::min(channels, 3) : 0;
+    ThreadPool::global().parallel_for(next_height, 16, [&](size_t begin, size_t end) {
+        for (auto y = (uint) begin; y < end; ++y) {
+            uint y0 = std::min(y * 2, height - 1);
+            uint y1 = std::min(y * 2 + 1, height - 1);
+            for (auto x = 0u; x < next_width; ++x) {
+                uint x0 = std::min(x * 2, width - 1);
+                uint x1 = std::min(x * 2 + 1, width - 1);
+                const unsigned char* texels[4] = {
+                    &pixels[((size_t) y0 * width + x0) * channels],
+                    &pixels[((size_t) y0 * width + x1) * channels],
+                    &pixels[((size_t) y1 * width + x0) * channels],
+                    &pixels[((size_t) y1 * width + x1) * channels],
+                };
+                unsigned char* out = &next[((size_t) y * next_width + x) * channels];
+                for (auto c = 0; c < channels; ++c) {
+                    if (c < colour_channels) {
+                        float sum = 0.0f;
+                        for (const auto* texel: texels) sum += to_linear[texel[c]];
+                        out[c] = (unsigned char) std::lround(std::clamp(linear_to_srgb(sum * 0.25f), 0.0f, 1.0f) * 255.0f);
+                    } else {
+                        uint sum = 0;
+                        for (const auto* texel: texels) sum += texel[c];
+                        out[c] = (unsigned char) ((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+    });
+
+    return next;
+}
+
+/// Read the block at (block_x, block_y), repeating the edge texels where it hangs over the edge of the image
+static Block read_block(const unsigned char* pixels, uint width, uint height, int channels, uint block_x, uint block_y) {
+    Block block{};
+    for (auto i = 0u; i < 16; ++i) {
+        uint x = std::min(block_x * 4 + i % 4, width - 1);
+        uint y = std::min(block_y * 4 + i / 4, height - 1);
+        const unsigned char* texel = &pixels[((size_t) y * width + x) * channels];
+        block[i] = {0.0f, 0.0f, 0.0f, 255.0f};
+        for (auto c = 0; c < channels; ++c) {
+            block[i][c] = texel[c];
+        }
+    }
+    return block;
+}
+
+static uint16_t pack_565(const std::array<float, 3>& colour) {
+    auto r = (uint16_t) std::lround(std::clamp(colour[0], 0.0f, 255.0f) * 31.0f / 255.0f);
+    auto g = (uint16_t) std::lround(std::clamp(colour[1], 0.0f, 255.0f) * 63.0f / 255.0f);
+    auto b = (uint16_t) std::lround(std::clamp(colour[2], 0.0f, 255.0f) * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static std::array<float, 3> unpack_565(uint16_t packed) {
+    uint r = (packed >> 11) & 31u;
+    uint g = (packed >> 5) & 63u;
+    uint b = packed & 31u;
+    return {(float) ((r << 3) | (r >> 2)), (float) ((g << 2) | (g >> 4)), (float) ((b << 3) | (b >> 2))};
+}
+
+/// Encode the RGB of a block as BC1, always in the four colour mode so it is also valid as the colour of a BC3 block
+static void encode_bc1_block(const Block& block, unsigned char* out) {
+    std::array<float, 3> mean{};
+    for (const auto& texel: block) {
+        for (auto c = 0; c < 3; ++c) mean[c] += texel[c] / 16.0f;
+    }
+
+    // The principal axis of the colours, from power iteration on their covariance
+    float covariance[3][3]{};
+    for (const auto& texel: block) {
+        float d[3] = {texel[0] - mean[0], texel[1] - mean[1], texel[2] - mean[2]};
+        for (auto i = 0; i < 3; ++i) {
+            for (auto j = 0; j < 3; ++j) covariance[i][j] += d[i] * d[j];
+        }
+    }
+    std::array<float, 3> axis{1.0f, 1.0f, 1.0f};
+    for (auto iteration = 0; iteration < 8; ++iteration) {
+        std::array<float, 3> next{};
+        for (auto i = 0; i < 3; ++i) {
+            next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+        }
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f) break;
+        axis = {next[0] / length, next[1] / length, next[2] / length};
+    }
+
+    float min_t = 0.0f;
+    float max_t = 0.0f;
+    for (const auto& texel: block) {
+        float t = (texel[0] - mean[0]) * axis[0] + (texel[1] - mean[1]) * axis[1] + (texel[2] - mean[2]) * axis[2];
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+    }
+    // Pull the endpoints in slightly, since the extremes are rarely worth reaching exactly at the cost of the middle
+    float inset = (max_t - min_t) / 16.0f;
+    min_t += inset;
+    max_t -= inset;
+
+    std::array<float, 3> end0{}, end1{};
+    for (auto c = 0; c < 3; ++c) {
+        end0[c] = mean[c] + axis[c] * max_t;
+        end1[c] = mean[c] + axis[c] * min_t;
+    }
+    uint16_t colour0 = pack_565(end0);
+    uint16_t colour1 = pack_565(end1);
+    if (colour0 < colour1) std::swap(colour0, colour1);
+
+    std::array<std::array<float, 3>, 4> palette{};
+    palette[0] = unpack_565(colour0);
+    palette[1] = unpack_565(colour1);
+    for (auto c = 0; c < 3; ++c) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    uint32_t indices = 0;
+    // With equal endpoints the block is in the three colour mode, where index 0 is still colour0
+    if (colour0 != colour1) {
+        for (auto i = 0u; i < 16; ++i) {
+            uint best = 0;
+            float best_error = std::numeric_limits<float>::max();
+            for (auto p = 0u; p < 4; ++p) {
+                float dr = block[i][0] - palette[p][0];
+                float dg = block[i][1] - palette[p][1];
+                float db = block[i][2] - palette[p][2];
+                float error = dr * dr + dg * dg + db * db;
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    out[0] = (unsigned char) (colour0 & 0xFF);
+    out[1] = (unsigned char) (colour0 >> 8);
+    out[2] = (unsigned char) (colour1 & 0xFF);
+    out[3] = (unsigned char) (colour1 >> 8);
+    for (auto i = 0; i < 4; ++i) {
+        out[4 + i] = (unsigned char) ((indices >> (i * 8)) & 0xFF);
+    }
+}
+
+/// Encode one channel of a block as BC4, in the eight value mode
+static void encode_bc4_block(const Block& block, int channel, unsigned char* out) {
+    float min_value = 255.0f;
+    float max_value = 0.0f;
+    for (const auto& texel: block) {
+        min_value = std::min(min_value, texel[channel]);
+        max_value = std::max(max_value, texel[channel]);
+    }
+    auto end0 = (uint) std::lround(max_value);
+    auto end1 = (uint) std::lround(min_value);
+
+    std::array<float, 8> palette{};
+    palette[0] = (float) end0;
+    palette[1] = (float) end1;
+    for (auto i = 1u; i < 7; ++i) {
+        palette[i + 1] = (float) ((7 - i) * end0 + i * end1) / 7.0f;
+    }
+
+    uint64_t indices = 0;
+    // With equal endpoints the block is in the six value mode, where index 0 is still end0
+    if (end0 != end1) {
+        for (auto i = 0u; i < 16; ++i) {
+            uint64_t best = 0;
+            float best_error = std::numeric_limits<float>::max();
+            for (auto p = 0u; p < 8; ++p) {
+                float error = std::abs(block[i][channel] - palette[p]);
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 3);
+        }
+    }
+
+    out[0] = (unsigned char) end0;
+    out[1] = (unsigned char) end1;
+    for (auto i = 0; i < 6; ++i) {
+        out[2 + i] = (unsigned char) ((indices >> (i * 8)) & 0xFF);
+    }
+}
+
+static void encode_level(const unsigned char* pixels, uint width, uint height, int channels, BlockFormat format, unsigned char* out) {
+    uint blocks_x = (width + 3) / 4;
+    uint blocks_y = (height + 3) / 4;
+    size_t block_bytes = BlockCompression::get_block_bytes(format);
+
+    ThreadPool::global().parallel_for(blocks_y, ENCODE_BATCH_ROWS, [&](size_t begin, size_t end) {
+        for (auto block_y = (uint) begin; block_y < end; ++block_y) {
+            for (auto block_x = 0u; block_x < blocks_x; ++block_x) {
+                Block block = read_block(pixels, width, height, channels, block_x, block_y);
+                unsigned char* block_out = out + ((size_t) block_y * blocks_x + block_x) * block_bytes;
+                switch (format) {
+                    case BlockFormat::BC1:
+                        encode_bc1_block(block, block_out);
+                        break;
+                    case BlockFormat::BC3:
+                        encode_bc4_block(block, 3, block_out);
+                        encode_bc1_block(block, block_out + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        encode_bc4_block(block, 0, block_out);
+                        break;
+                    case BlockFormat::BC5:
+                        encode_bc4_block(block, 0, block_out);
+                        encode_bc4_block(block, 1, block_out + 8);
+                        break;
+                    case BlockFormat::BC7:
+                        break;
+                }
+            }
+        }
+    });
+}
+
+CompressedTexture BlockCompression::encode(const unsigned char* pixels, uint width, uint height, int channels, bool srgb, BlockFormat format) {
+    if (format == BlockFormat::BC7) {
+        throw std::runtime_error("BC7 textures can only be loaded from files, not encoded");
+    }
+
+    CompressedTexture compressed{format, srgb, true};
+
+    // Size everything first, so the levels can be encoded straight into place
+    uint level_width = width;
+    uint level_height = height;
+    size_t total_size = 0;
+    while (true) {
+        size_t size = get_level_bytes(format, level_width, level_height);
+        compressed.levels.push_back({level_width, level_height, total_size, size});
+        total_size += size;
+        if (level_width == 1 && level_height == 1) break;
+        level_width = std::max(level_width / 2, 1u);
+        level_height = std::max(level_height / 2, 1u);
+    }
+    compressed.data.resize(total_size);
+
+    std::vector<unsigned char> level_pixels(pixels, pixels + (size_t) width * height * channels);
+    for (auto i = 0u; i < compressed.levels.size(); ++i) {
+        const auto& level = compressed.levels[i];
+        if (i > 0) {
+            const auto& previous = compressed.levels[i - 1];
+            level_pixels = downsample(level_pixels, previous.width, previous.height, channels, srgb);
+        }
+        encode_level(level_pixels.data(), level.width, level.height, channels, format, compressed.data.data() + level.offset);
+    }
+
+    return compressed;
+}
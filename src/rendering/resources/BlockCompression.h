@@ -0,0 +1,74 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "utility/HelperTypes.h"
+
+/// The block compressed formats a texture can be stored in on the GPU, each encoding 4x4 texels in a fixed number of bytes.
+enum class BlockFormat {
+    // RGB, 8 bytes per block
+    BC1,
+    // RGBA, a BC4 block of alpha then a BC1 block of colour, 16 bytes per block
+    BC3,
+    // One channel, 8 bytes per block
+    BC4,
+    // Two channels, as two BC4 blocks, 16 bytes per block
+    BC5,
+    // RGB(A) at a higher quality than BC1/BC3, 16 bytes per block. Only ever read from files, never encoded.
+    BC7,
+};
+
+/// A block compressed texture and its mip chain, with every level in one buffer.
+struct CompressedTexture {
+    struct Level {
+        uint width;
+        uint height;
+        // Where the level's blocks start in `data`
+        size_t offset;
+        size_t size;
+    };
+
+    BlockFormat format;
+    // Whether the texels are sRGB encoded, as far as the file says
+    bool srgb = false;
+    // Whether the file says either way, which DDS files without a DX10 header can't
+    bool srgb_known = false;
+    // [0] is the full size level
+    std::vector<Level> levels{};
+    std::vector<unsigned char> data{};
+};
+
+/// A CPU encoder for the block compressed formats, along with what is needed to upload them.
+///
+/// The encoder fits each block's endpoints to the principal axis of its texels' colours, which is fast enough to
+/// transcode a texture when it is first loaded, but isn't as good as an offline exhaustive search.
+namespace BlockCompression {
+    /// Increment whenever the encoder's output changes, so any cached textures are rebuilt
+    static constexpr uint32_t ENCODER_VERSION = 1;
+
+    const char* get_name(BlockFormat format);
+    [[nodiscard]] size_t get_block_bytes(BlockFormat format);
+    /// The size of one level of the given dimensions, in bytes
+    [[nodiscard]] size_t get_level_bytes(BlockFormat format, uint width, uint height);
+
+    /// The GL internal format to upload as. BC4 and BC5 have no sRGB form, so ignore `srgb`.
+    [[nodiscard]] uint get_gl_format(BlockFormat format, bool srgb);
+    /// Whether the GPU can sample the format, in sRGB if `srgb` is set and the format has an sRGB form.
+    /// May only be called once the GL functions are loaded.
+    [[nodiscard]] bool is_supported(BlockFormat format, bool srgb = false);
+
+    /// The format the encoder compresses an image with `channels` channels to
+    [[nodiscard]] BlockFormat choose_format(int channels);
+    /// The channels the format stores, the inverse of choose_format, except BC7 which has four
+    [[nodiscard]] int get_channels(BlockFormat format);
+
+    /// Encode an 8-bit image with `channels` interleaved channels, along with a full mip chain made with a box filter.
+    /// If `srgb` is set, the colour channels are averaged in linear space when making the mips.
+    /// Throws if the format can't be encoded, which is only BC7.
+    CompressedTexture encode(const unsigned char* pixels, uint width, uint height, int channels, bool srgb, BlockFormat format);
+}
+
+#endif //BLOCK_COMPRESSION_H
@@ -0,0 +1,73 @@
+#include "BoneWeights.h"
+
+#include <algorithm>
+
+#include <glm/gtx/component_wise.hpp>
+
+#include "utility/ThreadPool.h"
+
+std::vector<std::pair<glm::vec4, glm::uvec4>> BoneWeights::gather(const aiMesh* mesh) {
+    const auto vertex_count = mesh->mNumVertices;
+
+    // Regroup the weights by vertex, rather than by bone, so each vertex can then be processed independently.
+    // Counts each vertex's weights, then fills them in at the offsets given by the running total.
+    std::vector<uint> offsets(vertex_count + 1, 0);
+    for (auto bone_i = 0u; bone_i < mesh->mNumBones; ++bone_i) {
+        const auto* bone = mesh->mBones[bone_i];
+        for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
+            ++offsets[bone->mWeights[weight_i].mVertexId + 1];
+        }
+    }
+    for (auto vert_i = 0u; vert_i < vertex_count; ++vert_i) {
+        offsets[vert_i + 1] += offsets[vert_i];
+    }
+
+    // [(bone_weight, bone_id)], grouped by vertex
+    std::vector<std::pair<float, uint>> influences(offsets.back());
+    std::vector<uint> next(offsets.begin(), offsets.end() - 1);
+    for (auto bone_i = 0u; bone_i < mesh->mNumBones; ++bone_i) {
+        const auto* bone = mesh->mBones[bone_i];
+        for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
+            const auto& weight = bone->mWeights[weight_i];
+            influences[next[weight.mVertexId]++] = {weight.mWeight, bone_i};
+        }
+    }
+
+    // [vertex_id] -> ([bone_weight; 4], [bone_id; 4])
+    std::vector<std::pair<glm::vec4, glm::uvec4>> bone_weights(vertex_count, {glm::vec4{0.0f}, glm::uvec4{0u}});
+    ThreadPool::global().parallel_for(vertex_count, BATCH_SIZE, [&](size_t begin, size_t end) {
+        for (auto vert_i = begin; vert_i < end; ++vert_i) {
+            auto& [weights, bones] = bone_weights[vert_i];
+
+            // Insert each weight into the top 4, kept sorted by descending weight, then ascending bone id
+            uint count = 0;
+            for (auto i = offsets[vert_i]; i < offsets[vert_i + 1]; ++i) {
+                auto [weight, bone] = influences[i];
+
+                uint slot = 0;
+                while (slot < count && (weights[slot] > weight || (weights[slot] == weight && bones[slot] < bone))) {
+                    ++slot;
+                }
+                if (slot == 4) continue;
+                // The same bone given the same weight twice only counts once
+                if (slot < count && weights[slot] == weight && bones[slot] == bone) continue;
+
+                for (auto j = std::min(count, 3u); j > slot; --j) {
+                    weights[j] = weights[j - 1];
+                    bones[j] = bones[j - 1];
+                }
+                weights[slot] = weight;
+                bones[slot] = bone;
+                count = std::min(count + 1, 4u);
+            }
+
+            float weight_sum = glm::compAdd(weights);
+            if (weight_sum != 0.0f) {
+                // Normalise the sum of the weights
+                weights /= weight_sum;
+            }
+        }
+    });
+
+    return bone_weights;
+}
@@ -0,0 +1,24 @@
+#ifndef BONE_WEIGHTS_H
+#define BONE_WEIGHTS_H
+
+#include <vector>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include <assimp/scene.h>
+
+#include "utility/HelperTypes.h"
+
+/// Conversion of Assimp's per bone vertex weights into the 4 weights per vertex the animated shaders take.
+namespace BoneWeights {
+    /// Vertices per task when gathering bone weights
+    static constexpr uint BATCH_SIZE = 4096;
+
+    /// The (up to) 4 largest bone weights of each vertex of the mesh, normalised to sum to 1, and the bones they belong to.
+    /// Ties in weight prefer the lower bone id, and the same (weight, bone) pair given twice only counts once.
+    /// tests/BoneWeightsTests.cpp checks this against the std::map based gather it replaced.
+    std::vector<std::pair<glm::vec4, glm::uvec4>> gather(const aiMesh* mesh);
+}
+
+#endif //BONE_WEIGHTS_H
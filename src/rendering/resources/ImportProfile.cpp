@@ -0,0 +1,69 @@
+#include "ImportProfile.h"
+
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include <assimp/postprocess.h>
+
+#include "utility/JsonHelper.h"
+
+const char* ImportProfiles::get_name(ImportProfile profile) {
+    switch (profile) {
+        case ImportProfile::Quality:
+            return "quality";
+        case ImportProfile::Fast:
+            return "fast";
+        case ImportProfile::PreprocessedCache:
+            return "preprocessed-cache";
+    }
+    return "unknown";
+}
+
+std::optional<ImportProfile> ImportProfiles::from_name(const std::string& name) {
+    for (auto profile: ALL) {
+        if (name == get_name(profile)) return profile;
+    }
+    return std::nullopt;
+}
+
+unsigned int ImportProfiles::get_assimp_flags(ImportProfile profile) {
+    switch (profile) {
+        case ImportProfile::Quality:
+            return aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType;
+        case ImportProfile::Fast:
+            // Vertices are welded by ModelLoader::optimise_mesh regardless, so aiProcess_JoinIdenticalVertices isn't needed
+            return aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_GenUVCoords | aiProcess_TransformUVCoords | aiProcess_SortByPType;
+        case ImportProfile::PreprocessedCache:
+            return aiProcess_Triangulate | aiProcess_SortByPType;
+    }
+    return 0;
+}
+
+bool ImportProfiles::is_always_cached(ImportProfile profile) {
+    return profile == ImportProfile::PreprocessedCache;
+}
+
+bool ImportProfiles::is_sidecar(const std::string& path) {
+    std::string extension = SIDECAR_EXTENSION;
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+std::optional<ImportProfile> ImportProfiles::read_sidecar(const std::string& path) {
+    auto sidecar_path = path + SIDECAR_EXTENSION;
+    if (!std::filesystem::exists(sidecar_path)) return std::nullopt;
+
+    try {
+        std::ifstream file(sidecar_path);
+        json j = json::parse(file);
+        std::string name = j["profile"];
+        auto profile = from_name(name);
+        if (!profile.has_value()) {
+            std::cerr << "Ignoring import sidecar (" << sidecar_path << "): unknown profile \"" << name << "\"" << std::endl;
+        }
+        return profile;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring import sidecar (" << sidecar_path << "): " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef IMPORT_PROFILE_H
+#define IMPORT_PROFILE_H
+
+#include <string>
+#include <optional>
+
+/// How much post-processing Assimp does when importing a model file.
+/// Chosen per load, or per file with a sidecar "{file}.import.json" such as {"profile": "fast"}.
+enum class ImportProfile {
+    /// The full post-processing, for files straight out of a modelling tool
+    Quality,
+    /// Only what rendering needs, triangulating and generating any missing normals and texture coordinates
+    Fast,
+    /// For files that were already cleaned up offline, so Assimp only triangulates them.
+    /// The result always goes through the model cache, even if the loader's cache is turned off.
+    PreprocessedCache,
+};
+
+namespace ImportProfiles {
+    constexpr ImportProfile ALL[] = {ImportProfile::Quality, ImportProfile::Fast, ImportProfile::PreprocessedCache};
+    /// Appended to a model's file name to give the path of its sidecar
+    constexpr const char* SIDECAR_EXTENSION = ".import.json";
+
+    /// The name used in sidecar files and the UI, e.g. "preprocessed-cache"
+    const char* get_name(ImportProfile profile);
+
+    std::optional<ImportProfile> from_name(const std::string& name);
+
+    /// The aiPostProcessSteps passed to Assimp::Importer::ReadFile
+    unsigned int get_assimp_flags(ImportProfile profile);
+
+    /// Whether loads with this profile use the model cache regardless of the loader's setting
+    bool is_always_cached(ImportProfile profile);
+
+    /// Whether the path is a sidecar, rather than a model
+    bool is_sidecar(const std::string& path);
+
+    /// The profile set by the sidecar of the model at `path`, if it has one.
+    /// A sidecar that can't be read is reported and ignored.
+    std::optional<ImportProfile> read_sidecar(const std::string& path);
+}
+
+/// Where the time went in loading one model file, shown by ModelLoader's import statistics
+struct ImportTimings {
+    std::string file;
+    ImportProfile profile = ImportProfile::Quality;
+    bool hierarchy = false;
+    bool from_cache = false;
+    /// Assimp's ReadFile, or mapping and reading the model cache
+    double read_ms = 0.0;
+    /// Building, optimising and simplifying the meshes, compressing any animations, and saving the model cache
+    double convert_ms = 0.0;
+    /// Creating the GL buffers, on the GL thread
+    double upload_ms = 0.0;
+
+    [[nodiscard]] double total_ms() const {
+        return read_ms + convert_ms + upload_ms;
+    }
+};
+
+#endif //IMPORT_PROFILE_H
@@ -1,50 +1,475 @@
 #include "MeshHierarchy.h"
 
-glm::mat4 AnimationData::sample(double time) const {
-    glm::vec3 position{0.0f};
-    if (!positions.empty()) {
-        auto next_key = positions.lower_bound(time);
-        if (next_key == positions.end()) {
-            position = positions.rbegin()->second;
-        } else if (next_key->first == time || next_key == positions.begin()) {
-            position = next_key->second;
-        } else {
-            auto next = *next_key;
-            auto prev = *(--next_key);
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include <glm/gtc/constants.hpp>
+
+namespace {
+    /// Sort a channel by time, and remove duplicate times, keeping the last key added for each
+    template<typename Value>
+    void sort_channel(std::vector<float>& times, std::vector<Value>& values) {
+        std::vector<uint> order(times.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&times](uint lhs, uint rhs) { return times[lhs] < times[rhs]; });
+
+        std::vector<float> sorted_times{};
+        std::vector<Value> sorted_values{};
+        sorted_times.reserve(times.size());
+        sorted_values.reserve(values.size());
+        for (auto i: order) {
+            if (!sorted_times.empty() && sorted_times.back() == times[i]) {
+                sorted_values.back() = values[i];
+            } else {
+                sorted_times.push_back(times[i]);
+                sorted_values.push_back(values[i]);
+            }
+        }
+
+        times = std::move(sorted_times);
+        values = std::move(sorted_values);
+    }
+
+    /// Find the key at or before `time`, so that (key, key + 1) bracket it. Time before the first key gives 0.
+    uint find_key(const std::vector<uint16_t>& times, float time) {
+        auto next = std::upper_bound(times.begin(), times.end(), time);
+        return next == times.begin() ? 0u : (uint) (next - times.begin() - 1);
+    }
+
+    /// Like find_key, but start from the last key used, stepping forward one key at a time for sequential playback
+    uint find_key(const std::vector<uint16_t>& times, float time, uint& cursor) {
+        if (cursor >= times.size() || (float) times[cursor] > time) {
+            // Playback went backwards (e.g. looped) or the cursor was for another animation, so search from scratch
+            cursor = find_key(times, time);
+            return cursor;
+        }
+        while (cursor + 1 < times.size() && (float) times[cursor + 1] <= time) {
+            cursor++;
+        }
+        return cursor;
+    }
 
-            position = glm::mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+    /// The interpolation factor between the key `key` and the one after it, or 0 if there isn't one after it
+    float key_factor(const std::vector<uint16_t>& times, float time, uint key) {
+        if (key + 1 >= times.size() || time <= (float) times[key]) {
+            return 0.0f;
         }
+        return (time - (float) times[key]) / (float) (times[key + 1] - times[key]);
+    }
+
+    /// The angle of the rotation between two unit quaternions. Using atan2 rather than acos(dot) keeps it accurate for tiny angles.
+    float rotation_angle(const glm::quat& lhs, glm::quat rhs) {
+        if (glm::dot(lhs, rhs) < 0.0f) rhs = -rhs;
+        return 4.0f * std::atan2(glm::length(lhs - rhs), glm::length(lhs + rhs));
     }
 
-    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
-    if (!rotations.empty()) {
-        auto next_key = rotations.lower_bound(time);
-        if (next_key == rotations.end()) {
-            rotation = rotations.rbegin()->second;
-        } else if (next_key->first == time || next_key == rotations.begin()) {
-            rotation = next_key->second;
-        } else {
-            auto next = *next_key;
-            auto prev = *(--next_key);
+    float max_component_difference(const glm::vec3& lhs, const glm::vec3& rhs) {
+        glm::vec3 difference = glm::abs(lhs - rhs);
+        return std::max(difference.x, std::max(difference.y, difference.z));
+    }
 
-            rotation = glm::slerp(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+    /// Choose which of a channel's keys to keep, given their quantised times.
+    /// `decoded` holds the values as they will be after compression, which the interpolated values are checked with,
+    /// while the error is measured against the original `values`. Returns the indices of the keys to keep.
+    /// Each key is checked at its quantised time, the same as measure_error, since quantising only moves a key in time.
+    template<typename Value, typename Interpolate, typename Error>
+    std::vector<uint> reduce_channel(const std::vector<uint16_t>& quantised_times, const std::vector<Value>& values, const std::vector<Value>& decoded,
+                                     bool reduce, float tolerance, Interpolate interpolate, Error error) {
+        // Keys whose times quantise to the same value can't be told apart, so keep only the last of them
+        std::vector<uint> unique{};
+        for (auto i = 0u; i < quantised_times.size(); ++i) {
+            if (i + 1 < quantised_times.size() && quantised_times[i + 1] == quantised_times[i]) continue;
+            unique.push_back(i);
         }
+        if (!reduce || unique.size() <= 1) return unique;
+
+        // Constant channels (which most scaling channels are) only need a single key
+        bool constant = std::all_of(values.begin(), values.end(), [&](const Value& value) { return error(decoded[unique[0]], value) <= tolerance; });
+        if (constant) return {unique[0]};
+
+        // Greedily extend each segment from the last kept key, until interpolating across it misses one of the keys in between
+        auto segment_fits = [&](uint first, uint last) {
+            auto span = (float) (quantised_times[last] - quantised_times[first]);
+            for (auto key = first + 1; key < last; ++key) {
+                float factor = (float) (quantised_times[key] - quantised_times[first]) / span;
+                if (error(interpolate(decoded[first], decoded[last], factor), values[key]) > tolerance) return false;
+            }
+            return true;
+        };
+
+        std::vector<uint> kept{unique[0]};
+        uint anchor = 0;
+        for (auto candidate = 2u; candidate < unique.size(); ++candidate) {
+            if (!segment_fits(unique[anchor], unique[candidate])) {
+                anchor = candidate - 1;
+                kept.push_back(unique[anchor]);
+            }
+        }
+        kept.push_back(unique.back());
+        return kept;
     }
 
-    glm::vec3 scaling{1.0f};
-    if (!scalings.empty()) {
-        auto next_key = scalings.lower_bound(time);
-        if (next_key == scalings.end()) {
-            scaling = scalings.rbegin()->second;
-        } else if (next_key->first == time || next_key == scalings.begin()) {
-            scaling = next_key->second;
-        } else {
-            auto next = *next_key;
-            auto prev = *(--next_key);
+    /// Compress one vec3 channel, which keeps full precision values
+    void compress_vec3_channel(const AnimationData& data, const std::vector<float>& times, const std::vector<glm::vec3>& values,
+                               bool reduce, float tolerance, float (*error)(const glm::vec3&, const glm::vec3&),
+                               std::vector<uint16_t>& out_times, std::vector<glm::vec3>& out_values) {
+        std::vector<uint16_t> quantised_times{};
+        for (auto time: times) {
+            quantised_times.push_back(data.quantise_time(time));
+        }
 
-            scaling = glm::mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+        auto mix = [](const glm::vec3& lhs, const glm::vec3& rhs, float factor) { return glm::mix(lhs, rhs, factor); };
+        for (auto key: reduce_channel(quantised_times, values, values, reduce, tolerance, mix, error)) {
+            out_times.push_back(quantised_times[key]);
+            out_values.push_back(values[key]);
         }
     }
+}
+
+void AnimationKeys::add_position_key(double time, const glm::vec3& position) {
+    position_times.push_back((float) time);
+    positions.push_back(position);
+}
+
+void AnimationKeys::add_rotation_key(double time, const glm::quat& rotation) {
+    rotation_times.push_back((float) time);
+    rotations.push_back(rotation);
+}
+
+void AnimationKeys::add_scaling_key(double time, const glm::vec3& scaling) {
+    scaling_times.push_back((float) time);
+    scalings.push_back(scaling);
+}
+
+void AnimationKeys::sort_keys() {
+    sort_channel(position_times, positions);
+    sort_channel(rotation_times, rotations);
+    sort_channel(scaling_times, scalings);
+}
+
+size_t AnimationKeys::get_key_count() const {
+    return positions.size() + rotations.size() + scalings.size();
+}
+
+size_t AnimationKeys::get_size_bytes() const {
+    return (position_times.size() + rotation_times.size() + scaling_times.size()) * sizeof(float)
+           + positions.size() * sizeof(glm::vec3) + rotations.size() * sizeof(glm::quat) + scalings.size() * sizeof(glm::vec3);
+}
+
+void AnimationError::merge(const AnimationError& other) {
+    position = std::max(position, other.position);
+    rotation = std::max(rotation, other.rotation);
+    scaling = std::max(scaling, other.scaling);
+}
+
+bool AnimationError::within(const AnimationCompressionSettings& settings) const {
+    return position <= settings.position_tolerance
+           && rotation <= settings.rotation_tolerance + QuantisedQuat::MAX_ERROR
+           && scaling <= settings.scaling_tolerance;
+}
+
+QuantisedQuat QuantisedQuat::pack(const glm::quat& rotation) {
+    glm::quat normalised = glm::normalize(rotation);
+    float components[4] = {normalised.x, normalised.y, normalised.z, normalised.w};
+
+    uint largest = 0;
+    for (auto i = 1u; i < 4; ++i) {
+        if (std::abs(components[i]) > std::abs(components[largest])) largest = i;
+    }
+    // q and -q are the same rotation, so flip it to make the dropped component positive
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    // The other components are at most 1/sqrt(2) in magnitude, since the largest is at least as big as them
+    uint16_t quantised[3];
+    uint next = 0;
+    for (auto i = 0u; i < 4; ++i) {
+        if (i == largest) continue;
+        float unit = std::clamp(components[i] * sign * glm::root_two<float>() * 0.5f + 0.5f, 0.0f, 1.0f);
+        quantised[next++] = (uint16_t) std::lround(unit * 32767.0f);
+    }
+
+    return QuantisedQuat{{
+        (uint16_t) (quantised[0] | ((largest & 1u) << 15)),
+        (uint16_t) (quantised[1] | ((largest >> 1) << 15)),
+        quantised[2],
+    }};
+}
+
+glm::quat QuantisedQuat::unpack() const {
+    uint largest = (uint) (data[0] >> 15) | ((uint) (data[1] >> 15) << 1);
+
+    float smallest[3];
+    float sum_squares = 0.0f;
+    for (auto i = 0u; i < 3; ++i) {
+        smallest[i] = ((float) (data[i] & 0x7FFFu) / 32767.0f * 2.0f - 1.0f) * glm::one_over_root_two<float>();
+        sum_squares += smallest[i] * smallest[i];
+    }
+
+    float components[4];
+    uint next = 0;
+    for (auto i = 0u; i < 4; ++i) {
+        components[i] = i == largest ? std::sqrt(std::max(0.0f, 1.0f - sum_squares)) : smallest[next++];
+    }
+    return glm::normalize(glm::quat{components[3], components[0], components[1], components[2]});
+}
+
+AnimationData AnimationData::compress(const AnimationKeys& keys, const AnimationCompressionSettings& settings) {
+    AnimationData data{};
+
+    // Every channel shares the same time range, so that one normalised time can be used for all of them
+    float first_time = std::numeric_limits<float>::max();
+    float last_time = std::numeric_limits<float>::lowest();
+    for (const auto* times: {&keys.position_times, &keys.rotation_times, &keys.scaling_times}) {
+        if (times->empty()) continue;
+        first_time = std::min(first_time, times->front());
+        last_time = std::max(last_time, times->back());
+    }
+    if (first_time > last_time) return data;
+
+    data.start_time = first_time;
+    data.time_scale = last_time > first_time ? MAX_NORMALISED_TIME / (last_time - first_time) : 0.0f;
+
+    auto distance = [](const glm::vec3& lhs, const glm::vec3& rhs) { return glm::distance(lhs, rhs); };
+    compress_vec3_channel(data, keys.position_times, keys.positions, settings.reduce_keys, settings.position_tolerance, distance, data.position_times, data.positions);
+    compress_vec3_channel(data, keys.scaling_times, keys.scalings, settings.reduce_keys, settings.scaling_tolerance, max_component_difference, data.scaling_times, data.scalings);
+
+    // Rotations are quantised before being reduced, so the reduction accounts for the precision lost
+    std::vector<uint16_t> quantised_times{};
+    std::vector<glm::quat> normalised_rotations{};
+    std::vector<QuantisedQuat> quantised_rotations{};
+    std::vector<glm::quat> decoded_rotations{};
+    for (auto i = 0u; i < keys.rotations.size(); ++i) {
+        quantised_times.push_back(data.quantise_time(keys.rotation_times[i]));
+        normalised_rotations.push_back(glm::normalize(keys.rotations[i]));
+        quantised_rotations.push_back(QuantisedQuat::pack(keys.rotations[i]));
+        decoded_rotations.push_back(quantised_rotations.back().unpack());
+    }
+
+    auto slerp = [](const glm::quat& lhs, const glm::quat& rhs, float factor) { return glm::slerp(lhs, rhs, factor); };
+    for (auto key: reduce_channel(quantised_times, normalised_rotations, decoded_rotations, settings.reduce_keys, settings.rotation_tolerance, slerp, rotation_angle)) {
+        data.rotation_times.push_back(quantised_times[key]);
+        data.rotations.push_back(quantised_rotations[key]);
+    }
+
+    return data;
+}
+
+float AnimationData::normalise_time(double time) const {
+    return std::clamp((float) ((time - start_time) * time_scale), 0.0f, MAX_NORMALISED_TIME);
+}
+
+uint16_t AnimationData::quantise_time(double time) const {
+    return (uint16_t) std::lround(normalise_time(time));
+}
+
+glm::vec3 AnimationData::sample_position(float normalised_time, uint& cursor) const {
+    if (positions.empty()) return glm::vec3{0.0f};
+    uint key = find_key(position_times, normalised_time, cursor);
+    float factor = key_factor(position_times, normalised_time, key);
+    return factor == 0.0f ? positions[key] : glm::mix(positions[key], positions[key + 1], factor);
+}
+
+glm::quat AnimationData::sample_rotation(float normalised_time, uint& cursor) const {
+    if (rotations.empty()) return glm::quat{1.0f, 0.0f, 0.0f, 0.0f};
+    uint key = find_key(rotation_times, normalised_time, cursor);
+    float factor = key_factor(rotation_times, normalised_time, key);
+    return factor == 0.0f ? rotations[key].unpack() : glm::slerp(rotations[key].unpack(), rotations[key + 1].unpack(), factor);
+}
+
+glm::vec3 AnimationData::sample_scaling(float normalised_time, uint& cursor) const {
+    if (scalings.empty()) return glm::vec3{1.0f};
+    uint key = find_key(scaling_times, normalised_time, cursor);
+    float factor = key_factor(scaling_times, normalised_time, key);
+    return factor == 0.0f ? scalings[key] : glm::mix(scalings[key], scalings[key + 1], factor);
+}
 
+glm::mat4 AnimationData::sample(double time) const {
+    AnimationCursor cursor{UINT_MAX, UINT_MAX, UINT_MAX};
+    return sample(time, cursor);
+}
+
+glm::mat4 AnimationData::sample(double time, AnimationCursor& cursor) const {
+    float t = normalise_time(time);
+    glm::vec3 position = sample_position(t, cursor.position);
+    glm::quat rotation = sample_rotation(t, cursor.rotation);
+    glm::vec3 scaling = sample_scaling(t, cursor.scaling);
     return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scaling);
-}
\ No newline at end of file
+}
+
+void AnimationData::find_keys(double time, AnimationCursor& cursor, AnimationKeyPair& out_keys) const {
+    float t = normalise_time(time);
+
+    if (positions.empty()) {
+        out_keys.positions[0] = out_keys.positions[1] = glm::vec3{0.0f};
+        out_keys.position_factor = 0.0f;
+    } else {
+        uint key = find_key(position_times, t, cursor.position);
+        out_keys.positions[0] = positions[key];
+        out_keys.positions[1] = positions[std::min(key + 1, (uint) positions.size() - 1)];
+        out_keys.position_factor = key_factor(position_times, t, key);
+    }
+
+    if (rotations.empty()) {
+        out_keys.rotations[0] = out_keys.rotations[1] = glm::quat{1.0f, 0.0f, 0.0f, 0.0f};
+        out_keys.rotation_factor = 0.0f;
+    } else {
+        uint key = find_key(rotation_times, t, cursor.rotation);
+        out_keys.rotation_factor = key_factor(rotation_times, t, key);
+        out_keys.rotations[0] = rotations[key].unpack();
+        out_keys.rotations[1] = out_keys.rotation_factor == 0.0f ? out_keys.rotations[0] : rotations[key + 1].unpack();
+    }
+
+    if (scalings.empty()) {
+        out_keys.scalings[0] = out_keys.scalings[1] = glm::vec3{1.0f};
+        out_keys.scaling_factor = 0.0f;
+    } else {
+        uint key = find_key(scaling_times, t, cursor.scaling);
+        out_keys.scalings[0] = scalings[key];
+        out_keys.scalings[1] = scalings[std::min(key + 1, (uint) scalings.size() - 1)];
+        out_keys.scaling_factor = key_factor(scaling_times, t, key);
+    }
+}
+
+AnimationError AnimationData::measure_error(const AnimationKeys& keys) const {
+    AnimationError error{};
+    AnimationCursor cursor{UINT_MAX, UINT_MAX, UINT_MAX};
+    for (auto i = 0u; i < keys.positions.size(); ++i) {
+        error.position = std::max(error.position, glm::distance(sample_position(quantise_time(keys.position_times[i]), cursor.position), keys.positions[i]));
+    }
+    for (auto i = 0u; i < keys.rotations.size(); ++i) {
+        error.rotation = std::max(error.rotation, rotation_angle(sample_rotation(quantise_time(keys.rotation_times[i]), cursor.rotation), glm::normalize(keys.rotations[i])));
+    }
+    for (auto i = 0u; i < keys.scalings.size(); ++i) {
+        error.scaling = std::max(error.scaling, max_component_difference(sample_scaling(quantise_time(keys.scaling_times[i]), cursor.scaling), keys.scalings[i]));
+    }
+    return error;
+}
+
+size_t AnimationData::get_key_count() const {
+    return positions.size() + rotations.size() + scalings.size();
+}
+
+size_t AnimationData::get_size_bytes() const {
+    return (position_times.size() + rotation_times.size() + scaling_times.size()) * sizeof(uint16_t)
+           + positions.size() * sizeof(glm::vec3) + rotations.size() * sizeof(QuantisedQuat) + scalings.size() * sizeof(glm::vec3);
+}
+
+void AnimationCompressionStats::add(const AnimationKeys& keys, const AnimationData& data) {
+    keys_before += keys.get_key_count();
+    keys_after += data.get_key_count();
+    bytes_before += keys.get_size_bytes();
+    bytes_after += data.get_size_bytes();
+    max_error.merge(data.measure_error(keys));
+}
+
+void AnimationBatchSampler::add(const AnimationData& channel, double time, AnimationCursor& cursor, glm::mat4& out_transform) {
+    AnimationKeyPair keys;
+    channel.find_keys(time, cursor, keys);
+
+    uint lane = lane_count++;
+    for (auto i = 0; i < 3; ++i) {
+        position_from[i][lane] = keys.positions[0][i];
+        position_to[i][lane] = keys.positions[1][i];
+        scaling_from[i][lane] = keys.scalings[0][i];
+        scaling_to[i][lane] = keys.scalings[1][i];
+    }
+    position_factor[lane] = keys.position_factor;
+    scaling_factor[lane] = keys.scaling_factor;
+
+    const glm::quat& from = keys.rotations[0];
+    const glm::quat& to = keys.rotations[1];
+    rotation_from[0][lane] = from.x;
+    rotation_from[1][lane] = from.y;
+    rotation_from[2][lane] = from.z;
+    rotation_from[3][lane] = from.w;
+    rotation_to[0][lane] = to.x;
+    rotation_to[1][lane] = to.y;
+    rotation_to[2][lane] = to.z;
+    rotation_to[3][lane] = to.w;
+    rotation_factor[lane] = keys.rotation_factor;
+
+    outputs[lane] = &out_transform;
+    if (lane_count == BATCH_WIDTH) evaluate_lanes();
+}
+
+void AnimationBatchSampler::flush() {
+    if (lane_count > 0) evaluate_lanes();
+}
+
+template<bool SlerpCorrection>
+void AnimationBatchSampler::interpolate_lanes(float (&matrices)[16][BATCH_WIDTH]) const {
+    // Every lane is evaluated, even past lane_count, so the loop has a fixed trip count. Unused lanes are never written out.
+    for (auto lane = 0u; lane < BATCH_WIDTH; ++lane) {
+        float px = position_from[0][lane] + (position_to[0][lane] - position_from[0][lane]) * position_factor[lane];
+        float py = position_from[1][lane] + (position_to[1][lane] - position_from[1][lane]) * position_factor[lane];
+        float pz = position_from[2][lane] + (position_to[2][lane] - position_from[2][lane]) * position_factor[lane];
+
+        float sx = scaling_from[0][lane] + (scaling_to[0][lane] - scaling_from[0][lane]) * scaling_factor[lane];
+        float sy = scaling_from[1][lane] + (scaling_to[1][lane] - scaling_from[1][lane]) * scaling_factor[lane];
+        float sz = scaling_from[2][lane] + (scaling_to[2][lane] - scaling_from[2][lane]) * scaling_factor[lane];
+
+        float cos_angle = rotation_from[0][lane] * rotation_to[0][lane] + rotation_from[1][lane] * rotation_to[1][lane]
+                          + rotation_from[2][lane] * rotation_to[2][lane] + rotation_from[3][lane] * rotation_to[3][lane];
+        float t = rotation_factor[lane];
+        if constexpr (SlerpCorrection) {
+            // Fitted correction from nlerp's factor to slerp's, as a function of the angle between the rotations
+            float d = std::abs(cos_angle);
+            float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+            float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+            float k = a * (t - 0.5f) * (t - 0.5f) + b;
+            t = t + t * (t - 0.5f) * (t - 1.0f) * k;
+        }
+        // Interpolate along the shortest path
+        float from_weight = 1.0f - t;
+        float to_weight = cos_angle < 0.0f ? -t : t;
+        float qx = rotation_from[0][lane] * from_weight + rotation_to[0][lane] * to_weight;
+        float qy = rotation_from[1][lane] * from_weight + rotation_to[1][lane] * to_weight;
+        float qz = rotation_from[2][lane] * from_weight + rotation_to[2][lane] * to_weight;
+        float qw = rotation_from[3][lane] * from_weight + rotation_to[3][lane] * to_weight;
+        float inverse_length = 1.0f / std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+        qx *= inverse_length;
+        qy *= inverse_length;
+        qz *= inverse_length;
+        qw *= inverse_length;
+
+        // translate(p) * toMat4(q) * scale(s), column major
+        float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+        float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+        float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+        matrices[0][lane] = (1.0f - 2.0f * (yy + zz)) * sx;
+        matrices[1][lane] = 2.0f * (xy + wz) * sx;
+        matrices[2][lane] = 2.0f * (xz - wy) * sx;
+        matrices[3][lane] = 0.0f;
+        matrices[4][lane] = 2.0f * (xy - wz) * sy;
+        matrices[5][lane] = (1.0f - 2.0f * (xx + zz)) * sy;
+        matrices[6][lane] = 2.0f * (yz + wx) * sy;
+        matrices[7][lane] = 0.0f;
+        matrices[8][lane] = 2.0f * (xz + wy) * sz;
+        matrices[9][lane] = 2.0f * (yz - wx) * sz;
+        matrices[10][lane] = (1.0f - 2.0f * (xx + yy)) * sz;
+        matrices[11][lane] = 0.0f;
+        matrices[12][lane] = px;
+        matrices[13][lane] = py;
+        matrices[14][lane] = pz;
+        matrices[15][lane] = 1.0f;
+    }
+}
+
+void AnimationBatchSampler::evaluate_lanes() {
+    alignas(32) float matrices[16][BATCH_WIDTH];
+    if (slerp_correction) {
+        interpolate_lanes<true>(matrices);
+    } else {
+        interpolate_lanes<false>(matrices);
+    }
+
+    for (auto lane = 0u; lane < lane_count; ++lane) {
+        float* out = &(*outputs[lane])[0][0];
+        for (auto i = 0; i < 16; ++i) {
+            out[i] = matrices[i][lane];
+        }
+    }
+    lane_count = 0;
+}
@@ -2,9 +2,9 @@
 #define MESH_HIERARCHY_H
 
 #include <vector>
-#include <map>
+#include <cstdint>
 #include <memory>
-#include <functional>
+#include <algorithm>
 #include <unordered_map>
 
 #include <glm/glm.hpp>
@@ -15,22 +15,193 @@
 
 #define NONE_ANIMATION UINT_MAX
 
+/// The key indices last sampled for one node's AnimationData, kept per instance so that
+/// sequential playback only has to step forward a key at a time, instead of searching.
+struct AnimationCursor {
+    uint position = 0;
+    uint rotation = 0;
+    uint scaling = 0;
+};
+
+/// Keyframes for a single node as they are imported, at full precision, before being compressed into AnimationData.
+/// Each channel is stored as parallel arrays of sorted times (in ticks) and values.
+struct AnimationKeys {
+    std::vector<float> position_times{};
+    std::vector<glm::vec3> positions{};
+    std::vector<float> rotation_times{};
+    std::vector<glm::quat> rotations{};
+    std::vector<float> scaling_times{};
+    std::vector<glm::vec3> scalings{};
+
+    void add_position_key(double time, const glm::vec3& position);
+    void add_rotation_key(double time, const glm::quat& rotation);
+    void add_scaling_key(double time, const glm::vec3& scaling);
+
+    /// Sort each channel by time, keeping only the last key added for any duplicate time. Must be called after adding keys.
+    void sort_keys();
+
+    [[nodiscard]] size_t get_key_count() const;
+
+    [[nodiscard]] size_t get_size_bytes() const;
+};
+
+/// How AnimationKeys are compressed into AnimationData on import
+struct AnimationCompressionSettings {
+    // Remove keys that interpolating between the keys either side of them reproduces to within the tolerances below
+    bool reduce_keys = true;
+    // In model units
+    float position_tolerance = 0.0005f;
+    // In radians
+    float rotation_tolerance = 0.001f;
+    float scaling_tolerance = 0.0005f;
+};
+
+/// The largest difference between a channel's original keys and its compressed AnimationData, sampled at the original key times
+struct AnimationError {
+    // In model units
+    float position = 0.0f;
+    // In radians
+    float rotation = 0.0f;
+    float scaling = 0.0f;
+
+    void merge(const AnimationError& other);
+
+    /// Whether every error is within the settings' tolerances, allowing for the precision lost to quantising rotations
+    [[nodiscard]] bool within(const AnimationCompressionSettings& settings) const;
+};
+
+/// A unit quaternion in 48 bits, as its three smallest components (the largest can be rebuilt since the length is 1).
+/// Each is quantised to 15 bits, with the index of the dropped component in the top bits of the first two.
+struct QuantisedQuat {
+    // The largest error unpack can have, in radians
+    static constexpr float MAX_ERROR = 0.0002f;
+
+    uint16_t data[3];
+
+    static QuantisedQuat pack(const glm::quat& rotation);
+
+    [[nodiscard]] glm::quat unpack() const;
+};
+
+/// The keys either side of a time in each of a node's channels, and how far between them the time is
+struct AnimationKeyPair {
+    glm::vec3 positions[2];
+    float position_factor;
+    glm::quat rotations[2];
+    float rotation_factor;
+    glm::vec3 scalings[2];
+    float scaling_factor;
+};
+
+/// Compressed keyframes for a single node, each channel stored as parallel arrays of sorted times and values.
+/// Times are normalised to 16 bits across the range of the node's keys, and rotations are stored as QuantisedQuats.
 struct AnimationData {
-    std::map<double, glm::vec3> positions{};
-    std::map<double, glm::quat> rotations{};
-    std::map<double, glm::vec3> scalings{};
+    static constexpr float MAX_NORMALISED_TIME = 65535.0f;
+
+    // Normalised time = (time - start_time) * time_scale
+    float start_time = 0.0f;
+    float time_scale = 0.0f;
 
+    std::vector<uint16_t> position_times{};
+    std::vector<glm::vec3> positions{};
+    std::vector<uint16_t> rotation_times{};
+    std::vector<QuantisedQuat> rotations{};
+    std::vector<uint16_t> scaling_times{};
+    std::vector<glm::vec3> scalings{};
+
+    /// Quantise the keys, and if enabled remove those within tolerance of interpolating between their neighbours
+    static AnimationData compress(const AnimationKeys& keys, const AnimationCompressionSettings& settings);
+
+    /// Sample the transform at `time` with a binary search per channel.
     [[nodiscard]] glm::mat4 sample(double time) const;
+
+    /// Sample the transform at `time`, starting from and then updating the keys in `cursor`.
+    [[nodiscard]] glm::mat4 sample(double time, AnimationCursor& cursor) const;
+
+    /// Find the keys either side of `time` in each channel, for interpolating between elsewhere (see AnimationBatchSampler)
+    void find_keys(double time, AnimationCursor& cursor, AnimationKeyPair& out_keys) const;
+
+    /// Compare against the keys this was compressed from, at each of their quantised times.
+    /// Quantising a time moves the key by at most half a step (1 / 131070 of the animation), which isn't counted as error.
+    [[nodiscard]] AnimationError measure_error(const AnimationKeys& keys) const;
+
+    [[nodiscard]] size_t get_key_count() const;
+
+    [[nodiscard]] size_t get_size_bytes() const;
+
+    /// The normalised time a key at `time` is stored at
+    [[nodiscard]] uint16_t quantise_time(double time) const;
+private:
+    [[nodiscard]] float normalise_time(double time) const;
+
+    [[nodiscard]] glm::vec3 sample_position(float normalised_time, uint& cursor) const;
+    [[nodiscard]] glm::quat sample_rotation(float normalised_time, uint& cursor) const;
+    [[nodiscard]] glm::vec3 sample_scaling(float normalised_time, uint& cursor) const;
 };
 
-struct MeshHierarchyNode {
-    std::vector<uint> meshes{};
-    glm::mat4 transformation{1.0f};
-    // [(mesh_index, bone_id, offset_matrix)]
-    std::vector<std::tuple<uint, uint, glm::mat4>> bones{};
-    // { animation_id } -> { Animation Data }
-    std::unordered_map<int, AnimationData> animation_data{};
-    std::vector<MeshHierarchyNode> children{};
+/// Samples many AnimationData channels at once. Each channel's keys are found as it is added,
+/// then interpolated and composed into matrices BATCH_WIDTH channels at a time, with every lane's
+/// values in their own arrays so the arithmetic is the same for every lane and can be vectorised.
+///
+/// Rotations are interpolated with nlerp, which is cheap but speeds up towards the middle of the interval.
+/// With slerp correction enabled the interpolation factor is adjusted first, which brings it to within
+/// a fraction of a degree of slerp without any trigonometry.
+class AnimationBatchSampler : private NonCopyable {
+public:
+    /// Fills a 256 bit register group of floats, and two 128 bit ones
+    static constexpr uint BATCH_WIDTH = 8;
+
+private:
+    bool slerp_correction;
+
+    uint lane_count = 0;
+    glm::mat4* outputs[BATCH_WIDTH]{};
+
+    // [component][lane]
+    alignas(32) float position_from[3][BATCH_WIDTH]{};
+    alignas(32) float position_to[3][BATCH_WIDTH]{};
+    alignas(32) float position_factor[BATCH_WIDTH]{};
+    alignas(32) float rotation_from[4][BATCH_WIDTH]{};
+    alignas(32) float rotation_to[4][BATCH_WIDTH]{};
+    alignas(32) float rotation_factor[BATCH_WIDTH]{};
+    alignas(32) float scaling_from[3][BATCH_WIDTH]{};
+    alignas(32) float scaling_to[3][BATCH_WIDTH]{};
+    alignas(32) float scaling_factor[BATCH_WIDTH]{};
+
+    /// Interpolate every lane and compose the results into (column major) matrices, [element][lane]
+    template<bool SlerpCorrection>
+    void interpolate_lanes(float (&matrices)[16][BATCH_WIDTH]) const;
+
+    /// Evaluate every queued lane, and write the results to their outputs
+    void evaluate_lanes();
+public:
+    explicit AnimationBatchSampler(bool slerp_correction = true) : slerp_correction(slerp_correction) {}
+
+    /// Queue `channel` to be sampled at `time` (in ticks), updating `cursor` straight away.
+    /// The transform is written to `out_transform` once a batch fills, or at the latest when flush is called.
+    void add(const AnimationData& channel, double time, AnimationCursor& cursor, glm::mat4& out_transform);
+
+    /// Evaluate any channels still queued
+    void flush();
+};
+
+/// The totals over every channel of one animation, from compressing it
+struct AnimationCompressionStats {
+    size_t keys_before = 0;
+    size_t keys_after = 0;
+    size_t bytes_before = 0;
+    size_t bytes_after = 0;
+    AnimationError max_error{};
+
+    void add(const AnimationKeys& keys, const AnimationData& data);
+};
+
+/// A bone of a mesh, which follows the node it is attached to
+struct BoneBinding {
+    uint node;
+    uint mesh_id;
+    uint bone_id;
+    glm::mat4 offset_matrix;
 };
 
 template<typename VertexData>
@@ -38,22 +209,46 @@ struct ModelInfo {
     std::shared_ptr<ModelHandle<VertexData>> model{};
     // { bone_name } -> { bone_id }
     std::unordered_map<std::string, uint> bones{};
-    // Computed based on an input time
-    std::vector<glm::mat4> bone_transforms{};
 
-    ModelInfo(const std::shared_ptr<ModelHandle<VertexData>>& model, const std::unordered_map<std::string, uint>& bones) : model(model), bones(bones) {
-        bone_transforms.resize(bones.size(), glm::mat4{1.0f});
-    }
+    ModelInfo(const std::shared_ptr<ModelHandle<VertexData>>& model, const std::unordered_map<std::string, uint>& bones) : model(model), bones(bones) {}
+};
+
+/// The output of evaluating a MeshHierarchy at some time, owned by each instance so that
+/// instances sharing a hierarchy can be evaluated independently (and in parallel).
+struct AnimationPose {
+    // [mesh_id] -> [bone_id] -> transform
+    std::vector<std::vector<glm::mat4>> bone_transforms{};
+    // [node] -> local and world transforms, scratch space for evaluation
+    std::vector<glm::mat4> local_transforms{};
+    std::vector<glm::mat4> world_transforms{};
 };
 
 class BaseMeshHierarchy : private NonCopyable {
 public:
+    /// The model handles of every mesh in the hierarchy
+    [[nodiscard]] virtual std::vector<std::shared_ptr<BaseModelHandle>> get_model_handles() const = 0;
+
+    /// The memory used by the hierarchy's animation keys
+    [[nodiscard]] virtual size_t get_animation_bytes() const = 0;
+
+    /// The vertex format the hierarchy's meshes were uploaded with
+    [[nodiscard]] VertexFormat get_vertex_format() const {
+        auto handles = get_model_handles();
+        return handles.empty() ? VertexFormat::Full : handles[0]->get_layout().vertex_format;
+    }
+
     virtual ~BaseMeshHierarchy() = default;
 };
 
 /// A struct representing a hierarchy of meshes, for use in animation.
+///
+/// The node tree is stored linearised, with nodes in topological order (every parent before its children)
+/// and each property of the nodes in its own array, so the hierarchy can be evaluated with a single forward loop.
 template<typename VertexData>
 struct MeshHierarchy : public BaseMeshHierarchy {
+    static constexpr int NO_PARENT = -1;
+    static constexpr uint NO_CHANNEL = UINT_MAX;
+
     std::vector<ModelInfo<VertexData>> meshes{};
     // { bone_name } -> [(mesh_index, bone_id, offset_matrix)]
     std::unordered_map<std::string, std::vector<std::tuple<uint, uint, glm::mat4>>> total_bones{};
@@ -61,66 +256,192 @@ struct MeshHierarchy : public BaseMeshHierarchy {
     std::vector<std::tuple<std::string, double, double>> animations{};
     // The name of the file the MeshHierarchy was loaded from, if any
     std::optional<std::string> filename{};
-    MeshHierarchyNode root_node{};
+
+    // [node] -> index of the parent node, or NO_PARENT for the root
+    std::vector<int> node_parents{};
+    // [node] -> transform relative to the parent, in the bind pose
+    std::vector<glm::mat4> node_transforms{};
+    // [node] -> accumulated bind pose transform, used to place the meshes
+    std::vector<glm::mat4> node_bind_transforms{};
+    // [node] -> whether the node or one of its ancestors has bones, in which case its bind pose is used when not animated
+    std::vector<uint8_t> node_is_skeleton{};
+    // [node] -> how many levels of descendants the node has, so leaf bones (fingers, toes, etc.) are 0.
+    // Used as a bone importance mask by animation LOD, which can skip evaluating the least important nodes.
+    std::vector<uint8_t> node_importance{};
+    // [(node, mesh_id)] for every mesh drawn, in node order
+    std::vector<std::pair<uint, uint>> mesh_draws{};
+    // Every bone, in node order
+    std::vector<BoneBinding> bone_bindings{};
+    // [animation_id * node_count + node] -> index into channels, or NO_CHANNEL if the node isn't animated
+    std::vector<uint> channel_indices{};
+    std::vector<AnimationData> channels{};
 
     explicit MeshHierarchy(const std::optional<std::string>& filename = std::nullopt) : filename(filename) {}
 
-    /// Set the transformation field of each node to the correct state for the given time
-    void calculate_animation(uint animation_id, double time_seconds);
-    /// Recursively iterator over node tree
-    void visit_nodes(std::function<void(const MeshHierarchyNode& node, glm::mat4 accumulated_transformation)> fn);
+    [[nodiscard]] std::vector<std::shared_ptr<BaseModelHandle>> get_model_handles() const override {
+        std::vector<std::shared_ptr<BaseModelHandle>> handles{};
+        handles.reserve(meshes.size());
+        for (const auto& mesh: meshes) {
+            handles.push_back(mesh.model);
+        }
+        return handles;
+    }
+
+    [[nodiscard]] size_t get_animation_bytes() const override {
+        size_t bytes = 0;
+        for (const auto& channel: channels) {
+            bytes += channel.get_size_bytes();
+        }
+        return bytes;
+    }
+
+    [[nodiscard]] uint get_node_count() const {
+        return (uint) node_parents.size();
+    }
+
+    /// Append a node, whose parent must already have been added. Returns the new node's index.
+    uint add_node(int parent, const glm::mat4& transform);
+
+    /// Compute the derived per node data, once all the nodes, meshes and bones have been added.
+    void finalise_nodes();
+
+    /// The animation channel for a node, if it is animated by that animation
+    [[nodiscard]] const AnimationData* get_channel(uint animation_id, uint node) const;
+
+    /// Write the bone transforms of each mesh for the given time into `out_pose`, resizing it as needed.
+    /// If `cursors` is given, it holds the per node sampling state for one instance, and is resized as needed.
+    /// Nodes with a `node_importance` below `min_importance` are not sampled, and are left in their bind pose instead.
+    /// This only reads the hierarchy, so it is safe to call from multiple threads with different poses and cursors.
+    /// Returns the number of animation channels sampled.
+    uint calculate_animation(uint animation_id, double time_seconds, AnimationPose& out_pose, std::vector<AnimationCursor>* cursors = nullptr, uint min_importance = 0) const;
+
+    /// Write the local transform of every node for the given time of a (valid) animation into `out_local_transforms`, resizing it as needed.
+    /// The animated nodes are queued on `sampler`, so their transforms are only all written once it is flushed,
+    /// which lets several poses (e.g. of different instances) share batches. Nodes that aren't sampled get their bind pose.
+    /// `cursors` and `min_importance` are as for calculate_animation. Returns the number of animation channels queued.
+    uint sample_local_transforms(uint animation_id, double time_seconds, std::vector<glm::mat4>& out_local_transforms, AnimationBatchSampler& sampler,
+                                 std::vector<AnimationCursor>* cursors = nullptr, uint min_importance = 0) const;
+
+    /// Accumulate sampled local transforms down the hierarchy, and write the bone transforms of each mesh into `out_pose`
+    void calculate_pose(const std::vector<glm::mat4>& local_transforms, AnimationPose& out_pose) const;
 };
 
 template<typename VertexData>
-void MeshHierarchy<VertexData>::calculate_animation(uint animation_id, double time_seconds) {
+uint MeshHierarchy<VertexData>::add_node(int parent, const glm::mat4& transform) {
+    if (parent >= (int) node_parents.size()) {
+        throw std::runtime_error(Formatter() << "Node parent must be added before its children: " << parent);
+    }
+    node_parents.push_back(parent);
+    node_transforms.push_back(transform);
+    return (uint) node_parents.size() - 1;
+}
+
+template<typename VertexData>
+void MeshHierarchy<VertexData>::finalise_nodes() {
+    uint node_count = get_node_count();
+
+    std::vector<uint8_t> has_bones(node_count, 0);
+    for (const auto& bone: bone_bindings) {
+        has_bones[bone.node] = 1;
+    }
+
+    node_bind_transforms.resize(node_count);
+    node_is_skeleton.resize(node_count);
+    node_importance.assign(node_count, 0);
+    for (auto node = 0u; node < node_count; ++node) {
+        int parent = node_parents[node];
+        if (parent == NO_PARENT) {
+            node_bind_transforms[node] = node_transforms[node];
+            node_is_skeleton[node] = has_bones[node];
+        } else {
+            node_bind_transforms[node] = node_bind_transforms[parent] * node_transforms[node];
+            node_is_skeleton[node] = node_is_skeleton[parent] | has_bones[node];
+        }
+    }
+
+    // Children always come after their parent, so walking backwards finishes each subtree before its root
+    for (auto node = node_count; node > 0; --node) {
+        int parent = node_parents[node - 1];
+        if (parent != NO_PARENT && node_importance[node - 1] < UINT8_MAX) {
+            node_importance[parent] = std::max(node_importance[parent], (uint8_t) (node_importance[node - 1] + 1));
+        }
+    }
+
+    std::stable_sort(mesh_draws.begin(), mesh_draws.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    std::stable_sort(bone_bindings.begin(), bone_bindings.end(), [](const auto& lhs, const auto& rhs) { return lhs.node < rhs.node; });
+
+    channel_indices.resize(animations.size() * node_count, NO_CHANNEL);
+}
+
+template<typename VertexData>
+const AnimationData* MeshHierarchy<VertexData>::get_channel(uint animation_id, uint node) const {
+    uint channel = channel_indices[animation_id * get_node_count() + node];
+    return channel == NO_CHANNEL ? nullptr : &channels[channel];
+}
+
+template<typename VertexData>
+uint MeshHierarchy<VertexData>::calculate_animation(uint animation_id, double time_seconds, AnimationPose& out_pose, std::vector<AnimationCursor>* cursors, uint min_importance) const {
     if (animation_id == NONE_ANIMATION) {
-        for (auto& mesh: meshes) {
-            std::fill(mesh.bone_transforms.begin(), mesh.bone_transforms.end(), glm::mat4{1.0f});
+        out_pose.bone_transforms.resize(meshes.size());
+        for (auto mesh_id = 0u; mesh_id < meshes.size(); ++mesh_id) {
+            out_pose.bone_transforms[mesh_id].assign(meshes[mesh_id].bones.size(), glm::mat4{1.0f});
         }
-        return;
+        return 0;
     }
 
+    AnimationBatchSampler sampler{};
+    uint channels_sampled = sample_local_transforms(animation_id, time_seconds, out_pose.local_transforms, sampler, cursors, min_importance);
+    sampler.flush();
+    calculate_pose(out_pose.local_transforms, out_pose);
+    return channels_sampled;
+}
+
+template<typename VertexData>
+uint MeshHierarchy<VertexData>::sample_local_transforms(uint animation_id, double time_seconds, std::vector<glm::mat4>& out_local_transforms, AnimationBatchSampler& sampler,
+                                                        std::vector<AnimationCursor>* cursors, uint min_importance) const {
     if (animation_id >= animations.size()) {
         throw std::runtime_error(Formatter() << "Invalid animation id: " << animation_id);
     }
 
-    std::function<void(const MeshHierarchyNode& node, glm::mat4 accumulated_transformation, bool is_skeleton)> animate;
+    uint node_count = get_node_count();
+    out_local_transforms.resize(node_count);
     double time_ticks = time_seconds * std::get<1>(animations[animation_id]);
+    if (cursors != nullptr) cursors->resize(node_count);
 
-    animate = [&animate, this, animation_id, time_ticks](const MeshHierarchyNode& node, glm::mat4 accumulated_transformation, bool is_skeleton) {
-        is_skeleton |= !node.bones.empty();
-        glm::mat4 transform = is_skeleton ? node.transformation : glm::mat4{1.0f};
-        const auto animation = node.animation_data.find(animation_id);
-        if (animation != node.animation_data.end()) {
-            transform = animation->second.sample(time_ticks);
-        }
-        accumulated_transformation = accumulated_transformation * transform;
-
-        for (const auto& [mesh_id, bone_id, offset_matrix]: node.bones) {
-            meshes[mesh_id].bone_transforms[bone_id] = accumulated_transformation * offset_matrix;
-        }
-
-        for (const auto& child: node.children) {
-            animate(child, accumulated_transformation, is_skeleton);
+    const uint* node_channels = &channel_indices[animation_id * node_count];
+    uint channels_sampled = 0;
+    for (auto node = 0u; node < node_count; ++node) {
+        uint channel = node_channels[node];
+        if (channel != NO_CHANNEL && node_importance[node] >= min_importance) {
+            channels_sampled++;
+            AnimationCursor search_cursor{UINT_MAX, UINT_MAX, UINT_MAX};
+            sampler.add(channels[channel], time_ticks, cursors != nullptr ? (*cursors)[node] : search_cursor, out_local_transforms[node]);
+        } else {
+            out_local_transforms[node] = node_is_skeleton[node] ? node_transforms[node] : glm::mat4{1.0f};
         }
-    };
+    }
 
-    animate(root_node, glm::mat4{1.0f}, false);
+    return channels_sampled;
 }
 
 template<typename VertexData>
-void MeshHierarchy<VertexData>::visit_nodes(std::function<void(const MeshHierarchyNode&, glm::mat4)> fn) {
-    std::function<void(const MeshHierarchyNode& node, glm::mat4 accumulated_transformation)> visit;
-
-    visit = [&visit, &fn](const MeshHierarchyNode& node, glm::mat4 accumulated_transformation) {
-        accumulated_transformation = accumulated_transformation * node.transformation;
-        fn(node, accumulated_transformation);
-        for (const auto& child: node.children) {
-            visit(child, accumulated_transformation);
-        }
-    };
+void MeshHierarchy<VertexData>::calculate_pose(const std::vector<glm::mat4>& local_transforms, AnimationPose& out_pose) const {
+    out_pose.bone_transforms.resize(meshes.size());
+    for (auto mesh_id = 0u; mesh_id < meshes.size(); ++mesh_id) {
+        out_pose.bone_transforms[mesh_id].resize(meshes[mesh_id].bones.size());
+    }
 
-    visit(root_node, glm::mat4{1.0f});
+    uint node_count = get_node_count();
+    auto& world_transforms = out_pose.world_transforms;
+    world_transforms.resize(node_count);
+    for (auto node = 0u; node < node_count; ++node) {
+        int parent = node_parents[node];
+        world_transforms[node] = parent == NO_PARENT ? local_transforms[node] : world_transforms[parent] * local_transforms[node];
+    }
+
+    for (const auto& bone: bone_bindings) {
+        out_pose.bone_transforms[bone.mesh_id][bone.bone_id] = world_transforms[bone.node] * bone.offset_matrix;
+    }
 }
 
 #endif //MESH_HIERARCHY_H
@@ -0,0 +1,304 @@
+#include "MeshOptimiser.h"
+
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    /// Vertex -> [triangle] adjacency, stored as offsets into one flat list
+    struct TriangleAdjacency {
+        std::vector<uint> offsets;
+        std::vector<uint> triangles;
+
+        TriangleAdjacency(const std::vector<uint>& indices, uint vertex_count) : offsets(vertex_count + 1, 0u), triangles(indices.size()) {
+            for (auto index: indices) {
+                offsets[index + 1]++;
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+            std::vector<uint> fill(offsets.begin(), offsets.end() - 1);
+            for (auto i = 0u; i < indices.size(); ++i) {
+                triangles[fill[indices[i]]++] = i / 3;
+            }
+        }
+    };
+
+    /// A FIFO vertex cache, using timestamps rather than an actual queue
+    struct FifoCache {
+        std::vector<uint> timestamps;
+        uint time;
+        uint cache_size;
+
+        FifoCache(uint vertex_count, uint cache_size) : timestamps(vertex_count, 0u), time(cache_size + 1), cache_size(cache_size) {}
+
+        /// Returns true if the vertex was a miss, and so was transformed
+        bool access(uint vertex) {
+            if (time - timestamps[vertex] > cache_size) {
+                timestamps[vertex] = time++;
+                return true;
+            }
+            return false;
+        }
+
+        void flush() {
+            time += cache_size + 1;
+        }
+    };
+}
+
+MeshOptimiser::VertexCacheStatistics MeshOptimiser::analyse_vertex_cache(const std::vector<uint>& indices, uint vertex_count, uint cache_size) {
+    VertexCacheStatistics statistics{};
+    if (indices.empty()) return statistics;
+
+    FifoCache cache{vertex_count, cache_size};
+    std::vector<bool> referenced(vertex_count, false);
+    uint unique_vertices = 0;
+
+    for (auto index: indices) {
+        if (cache.access(index)) statistics.vertices_transformed++;
+        if (!referenced[index]) {
+            referenced[index] = true;
+            unique_vertices++;
+        }
+    }
+
+    statistics.acmr = (float) statistics.vertices_transformed / (float) (indices.size() / 3);
+    statistics.atvr = (float) statistics.vertices_transformed / (float) unique_vertices;
+    return statistics;
+}
+
+uint MeshOptimiser::generate_weld_remap(const void* vertices, uint vertex_count, size_t vertex_size, std::vector<uint>& out_remap) {
+    const auto* bytes = static_cast<const unsigned char*>(vertices);
+    auto hash = [bytes, vertex_size](uint vertex) {
+        // FNV-1a over the raw bytes of the vertex
+        size_t result = 14695981039346656037ull;
+        for (auto i = 0u; i < vertex_size; ++i) {
+            result = (result ^ bytes[vertex * vertex_size + i]) * 1099511628211ull;
+        }
+        return result;
+    };
+    auto equal = [bytes, vertex_size](uint lhs, uint rhs) {
+        return std::memcmp(bytes + lhs * vertex_size, bytes + rhs * vertex_size, vertex_size) == 0;
+    };
+
+    // {vertex} -> {first identical vertex}, using the vertex indices themselves as keys
+    std::unordered_map<uint, uint, decltype(hash), decltype(equal)> first_seen{vertex_count, hash, equal};
+
+    out_remap.assign(vertex_count, 0u);
+    uint unique_count = 0;
+    for (auto vertex = 0u; vertex < vertex_count; ++vertex) {
+        auto [iter, inserted] = first_seen.emplace(vertex, unique_count);
+        if (inserted) unique_count++;
+        out_remap[vertex] = iter->second;
+    }
+
+    return unique_count;
+}
+
+void MeshOptimiser::optimise_vertex_cache(std::vector<uint>& indices, uint vertex_count, std::vector<uint>* out_clusters, uint cache_size) {
+    const uint triangle_count = (uint) indices.size() / 3;
+    if (triangle_count == 0) return;
+
+    TriangleAdjacency adjacency{indices, vertex_count};
+
+    // Number of triangles not yet emitted, that use each vertex
+    std::vector<uint> live_triangles(vertex_count);
+    for (auto vertex = 0u; vertex < vertex_count; ++vertex) {
+        live_triangles[vertex] = adjacency.offsets[vertex + 1] - adjacency.offsets[vertex];
+    }
+
+    FifoCache cache{vertex_count, cache_size};
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint> dead_end_stack{};
+    std::vector<uint> candidates{};
+    std::vector<uint> result{};
+    result.reserve(indices.size());
+
+    if (out_clusters != nullptr) {
+        out_clusters->clear();
+        out_clusters->push_back(0);
+    }
+
+    // Start with the first vertex that is used, to skip over any unreferenced vertices
+    uint scan_cursor = 0;
+    while (scan_cursor < vertex_count && live_triangles[scan_cursor] == 0) scan_cursor++;
+    uint fanning_vertex = scan_cursor;
+
+    while (fanning_vertex < vertex_count) {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        for (auto i = adjacency.offsets[fanning_vertex]; i < adjacency.offsets[fanning_vertex + 1]; ++i) {
+            uint triangle = adjacency.triangles[i];
+            if (emitted[triangle]) continue;
+            emitted[triangle] = true;
+
+            for (auto k = 0u; k < 3; ++k) {
+                uint vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+                cache.access(vertex);
+            }
+        }
+
+        // Pick the candidate that is still in the cache after emitting its fan, preferring the oldest
+        uint next_vertex = UINT32_MAX;
+        int best_priority = -1;
+        for (auto vertex: candidates) {
+            if (live_triangles[vertex] == 0) continue;
+
+            int priority = 0;
+            uint age = cache.time - cache.timestamps[vertex];
+            if (age + 2 * live_triangles[vertex] <= cache_size) {
+                priority = (int) age;
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                next_vertex = vertex;
+            }
+        }
+
+        if (next_vertex == UINT32_MAX) {
+            // Dead end, so first try recently used vertices, then fall back to scanning in input order
+            while (!dead_end_stack.empty() && next_vertex == UINT32_MAX) {
+                uint vertex = dead_end_stack.back();
+                dead_end_stack.pop_back();
+                if (live_triangles[vertex] > 0) next_vertex = vertex;
+            }
+
+            if (next_vertex == UINT32_MAX) {
+                while (scan_cursor < vertex_count && live_triangles[scan_cursor] == 0) scan_cursor++;
+                next_vertex = scan_cursor;
+            }
+
+            // The cache is no longer warm, so this is a natural place to split clusters for overdraw optimisation
+            if (out_clusters != nullptr && next_vertex < vertex_count && result.size() / 3 != out_clusters->back()) {
+                out_clusters->push_back((uint) result.size() / 3);
+            }
+        }
+
+        fanning_vertex = next_vertex;
+    }
+
+    indices = std::move(result);
+}
+
+void MeshOptimiser::optimise_overdraw(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint>& clusters, float threshold, uint cache_size) {
+    const uint triangle_count = (uint) indices.size() / 3;
+    if (triangle_count == 0 || clusters.empty()) return;
+
+    auto hard_cluster_end = [&clusters, triangle_count](size_t cluster) {
+        return cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangle_count;
+    };
+
+    // Split each hard cluster into smaller soft clusters, at points where the cluster so far
+    // has a cache miss ratio no worse than the whole hard cluster, so splitting costs very little.
+    std::vector<uint> soft_clusters{};
+    FifoCache cache{(uint) positions.size(), cache_size};
+    for (auto cluster = 0u; cluster < clusters.size(); ++cluster) {
+        uint start = clusters[cluster];
+        uint end = hard_cluster_end(cluster);
+
+        cache.flush();
+        uint misses = 0;
+        for (auto t = start * 3; t < end * 3; ++t) {
+            misses += cache.access(indices[t]);
+        }
+        float cluster_acmr = (float) misses / (float) (end - start);
+
+        cache.flush();
+        soft_clusters.push_back(start);
+        uint soft_start = start;
+        uint soft_misses = 0;
+        for (auto t = start; t < end; ++t) {
+            for (auto k = 0u; k < 3; ++k) {
+                soft_misses += cache.access(indices[t * 3 + k]);
+            }
+
+            // Require a minimum size, otherwise every cluster's first triangle would qualify
+            uint soft_triangles = t + 1 - soft_start;
+            if (t + 1 < end && soft_triangles >= cache_size && (float) soft_misses / (float) soft_triangles <= cluster_acmr * threshold) {
+                soft_clusters.push_back(t + 1);
+                soft_start = t + 1;
+                soft_misses = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    // Area weighted centroid of the whole mesh
+    glm::vec3 mesh_centroid{0.0f};
+    float mesh_area = 0.0f;
+    for (auto t = 0u; t < triangle_count; ++t) {
+        const auto& p0 = positions[indices[t * 3]];
+        const auto& p1 = positions[indices[t * 3 + 1]];
+        const auto& p2 = positions[indices[t * 3 + 2]];
+        float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+        mesh_centroid += (p0 + p1 + p2) * (area / 3.0f);
+        mesh_area += area;
+    }
+    if (mesh_area > 0.0f) mesh_centroid /= mesh_area;
+
+    // How much each cluster faces away from the centre, those that face out the most are the most likely to occlude others
+    std::vector<float> occlusion_potential(soft_clusters.size());
+    for (auto cluster = 0u; cluster < soft_clusters.size(); ++cluster) {
+        uint start = soft_clusters[cluster];
+        uint end = cluster + 1 < soft_clusters.size() ? soft_clusters[cluster + 1] : triangle_count;
+
+        glm::vec3 centroid{0.0f};
+        glm::vec3 normal{0.0f};
+        float area = 0.0f;
+        for (auto t = start; t < end; ++t) {
+            const auto& p0 = positions[indices[t * 3]];
+            const auto& p1 = positions[indices[t * 3 + 1]];
+            const auto& p2 = positions[indices[t * 3 + 2]];
+            glm::vec3 area_normal = glm::cross(p1 - p0, p2 - p0);
+            float triangle_area = glm::length(area_normal);
+            centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            normal += area_normal;
+            area += triangle_area;
+        }
+        if (area > 0.0f) centroid /= area;
+
+        float normal_length = glm::length(normal);
+        occlusion_potential[cluster] = normal_length > 0.0f ? glm::dot(centroid - mesh_centroid, normal / normal_length) : 0.0f;
+    }
+
+    std::vector<uint> order(soft_clusters.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&occlusion_potential](uint lhs, uint rhs) {
+        return occlusion_potential[lhs] > occlusion_potential[rhs];
+    });
+
+    std::vector<uint> result{};
+    result.reserve(indices.size());
+    for (auto cluster: order) {
+        uint start = soft_clusters[cluster];
+        uint end = cluster + 1 < soft_clusters.size() ? soft_clusters[cluster + 1] : triangle_count;
+        result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+    }
+
+    indices = std::move(result);
+}
+
+uint MeshOptimiser::generate_vertex_fetch_remap(const std::vector<uint>& indices, uint vertex_count, std::vector<uint>& out_remap) {
+    out_remap.assign(vertex_count, UINT32_MAX);
+
+    uint next_vertex = 0;
+    for (auto index: indices) {
+        if (out_remap[index] == UINT32_MAX) {
+            out_remap[index] = next_vertex++;
+        }
+    }
+
+    return next_vertex;
+}
+
+void MeshOptimiser::remap_indices(std::vector<uint>& indices, const std::vector<uint>& remap) {
+    for (auto& index: indices) {
+        index = remap[index];
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef MESH_OPTIMISER_H
+#define MESH_OPTIMISER_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+
+/// Import time optimisations of an indexed triangle mesh, to make better use of the GPU's
+/// post-transform vertex cache, reduce overdraw and make vertex fetches more sequential.
+///
+/// The intended order is: weld_vertices, optimise_vertex_cache, optimise_overdraw, optimise_vertex_fetch.
+namespace MeshOptimiser {
+    /// The size of the FIFO cache that is optimised for, and simulated by analyse_vertex_cache.
+    static constexpr uint VERTEX_CACHE_SIZE = 16;
+
+    /// The result of simulating a FIFO post-transform vertex cache over a triangle list.
+    struct VertexCacheStatistics {
+        /// Number of vertex shader invocations (cache misses)
+        uint vertices_transformed = 0;
+        /// Average cache miss ratio, transformed vertices per triangle. 0.5 is optimal for large regular meshes, 3 is the worst case.
+        float acmr = 0.0f;
+        /// Average transform to vertex ratio, transformed vertices per referenced vertex. 1 is optimal.
+        float atvr = 0.0f;
+    };
+
+    /// Simulate a FIFO vertex cache of `cache_size` entries over the triangle list `indices`.
+    VertexCacheStatistics analyse_vertex_cache(const std::vector<uint>& indices, uint vertex_count, uint cache_size = VERTEX_CACHE_SIZE);
+
+    /// Generate a remap table that maps every vertex to the first vertex that is bitwise identical to it,
+    /// with the unique vertices compacted to the front. Returns the number of unique vertices.
+    uint generate_weld_remap(const void* vertices, uint vertex_count, size_t vertex_size, std::vector<uint>& out_remap);
+
+    /// Reorder the triangles of `indices` to improve vertex cache hits, using Tipsify.
+    /// If `out_clusters` is provided, it is filled with the (triangle) start of each cluster
+    /// that begins with the cache effectively flushed, for use with optimise_overdraw.
+    ///
+    /// See: https://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+    void optimise_vertex_cache(std::vector<uint>& indices, uint vertex_count, std::vector<uint>* out_clusters = nullptr, uint cache_size = VERTEX_CACHE_SIZE);
+
+    /// Reorder the clusters of an optimise_vertex_cache'd triangle list so that clusters facing outwards from the
+    /// centre of the mesh are drawn first, which tends to reduce overdraw from any view direction.
+    /// Clusters are further split wherever doing so keeps the ACMR within `threshold` times its current value.
+    void optimise_overdraw(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint>& clusters, float threshold = 1.05f, uint cache_size = VERTEX_CACHE_SIZE);
+
+    /// Generate a remap table that orders vertices by their first use in `indices`, so vertex fetches are close to sequential.
+    /// Vertices that are never referenced are removed. Returns the number of vertices kept.
+    uint generate_vertex_fetch_remap(const std::vector<uint>& indices, uint vertex_count, std::vector<uint>& out_remap);
+
+    /// Apply a remap table to an index buffer.
+    void remap_indices(std::vector<uint>& indices, const std::vector<uint>& remap);
+
+    /// Apply a remap table, as generated by generate_weld_remap or generate_vertex_fetch_remap, to a vertex buffer.
+    template<typename VertexData>
+    void remap_vertices(std::vector<VertexData>& vertices, const std::vector<uint>& remap, uint new_vertex_count);
+}
+
+template<typename VertexData>
+void MeshOptimiser::remap_vertices(std::vector<VertexData>& vertices, const std::vector<uint>& remap, uint new_vertex_count) {
+    std::vector<VertexData> remapped(new_vertex_count, vertices.empty() ? VertexData{} : vertices[0]);
+    for (auto i = 0u; i < vertices.size(); ++i) {
+        if (remap[i] != UINT32_MAX) {
+            remapped[remap[i]] = vertices[i];
+        }
+    }
+    vertices = std::move(remapped);
+}
+
+#endif //MESH_OPTIMISER_H
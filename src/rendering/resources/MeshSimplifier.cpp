@@ -0,0 +1,218 @@
+#include "MeshSimplifier.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+namespace {
+    /// A symmetric 4x4 matrix, representing the sum of the (weighted) squared distances to a set of planes.
+    struct Quadric {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+        double b2 = 0.0, bc = 0.0, bd = 0.0;
+        double c2 = 0.0, cd = 0.0;
+        double d2 = 0.0;
+
+        static Quadric from_plane(double a, double b, double c, double d, double weight) {
+            return {
+                weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+                weight * b * b, weight * b * c, weight * b * d,
+                weight * c * c, weight * c * d,
+                weight * d * d
+            };
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            return *this;
+        }
+
+        [[nodiscard]] double evaluate(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                           + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                           + c2 * z * z + 2.0 * cd * z
+                           + d2;
+            // Can go slightly negative due to floating point error
+            return std::max(error, 0.0);
+        }
+    };
+
+    /// A candidate collapse, moving vertex `from` onto vertex `to`
+    struct Collapse {
+        uint from;
+        uint to;
+        double cost;
+    };
+}
+
+std::vector<uint> MeshSimplifier::simplify(const std::vector<glm::vec3>& positions, const std::vector<uint>& indices, size_t target_index_count, float* out_error) {
+    std::vector<uint> result = indices;
+    const size_t vertex_count = positions.size();
+    double max_error = 0.0;
+
+    // Lock any vertex on an open border, found by looking for edges which only belong to one triangle.
+    // Since vertices are split along attribute seams, this also keeps seams intact.
+    std::vector<bool> locked(vertex_count, false);
+    {
+        std::vector<std::pair<uint, uint>> edges{};
+        edges.reserve(result.size());
+        for (auto t = 0u; t < result.size(); t += 3) {
+            for (auto e = 0u; e < 3; ++e) {
+                uint a = result[t + e];
+                uint b = result[t + (e + 1) % 3];
+                edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for (auto i = 0u; i < edges.size();) {
+            auto j = i;
+            while (j < edges.size() && edges[j] == edges[i]) ++j;
+            if (j - i == 1) {
+                locked[edges[i].first] = true;
+                locked[edges[i].second] = true;
+            }
+            i = j;
+        }
+    }
+
+    // Accumulate the area weighted plane of each triangle into each of its vertices
+    std::vector<Quadric> quadrics(vertex_count);
+    for (auto t = 0u; t < result.size(); t += 3) {
+        const glm::vec3& p0 = positions[result[t]];
+        const glm::vec3& p1 = positions[result[t + 1]];
+        const glm::vec3& p2 = positions[result[t + 2]];
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0.0) continue;
+
+        double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+        double d = -(a * p0.x + b * p0.y + c * p0.z);
+        Quadric quadric = Quadric::from_plane(a, b, c, d, length * 0.5);
+
+        quadrics[result[t]] += quadric;
+        quadrics[result[t + 1]] += quadric;
+        quadrics[result[t + 2]] += quadric;
+    }
+
+    std::vector<uint> remap(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<uint> adjacency_offsets(vertex_count + 1);
+    std::vector<uint> adjacency{};
+    std::vector<Collapse> collapses{};
+
+    // Each pass collapses a batch of the cheapest independent edges, then rebuilds the index list
+    while (result.size() > target_index_count) {
+        // Build the vertex -> [triangle] adjacency, used to check for flipped triangles
+        std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0u);
+        for (auto index: result) {
+            adjacency_offsets[index + 1]++;
+        }
+        std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+        adjacency.resize(result.size());
+        {
+            std::vector<uint> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+            for (auto i = 0u; i < result.size(); ++i) {
+                adjacency[fill[result[i]]++] = i / 3;
+            }
+        }
+
+        // Gather each edge, in whichever direction is the cheapest to collapse
+        collapses.clear();
+        for (auto t = 0u; t < result.size(); t += 3) {
+            for (auto e = 0u; e < 3; ++e) {
+                uint a = result[t + e];
+                uint b = result[t + (e + 1) % 3];
+                // Interior edges are seen twice, once from each triangle, so only take one of them
+                if (a > b) continue;
+
+                Quadric quadric = quadrics[a];
+                quadric += quadrics[b];
+
+                double cost_ab = locked[a] ? std::numeric_limits<double>::infinity() : quadric.evaluate(positions[b]);
+                double cost_ba = locked[b] ? std::numeric_limits<double>::infinity() : quadric.evaluate(positions[a]);
+                if (std::isinf(cost_ab) && std::isinf(cost_ba)) continue;
+
+                collapses.push_back(cost_ab <= cost_ba ? Collapse{a, b, cost_ab} : Collapse{b, a, cost_ba});
+            }
+        }
+
+        if (collapses.empty()) break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+        size_t triangles_removed = 0;
+        size_t collapse_count = 0;
+
+        for (const auto& collapse: collapses) {
+            if (triangles_removed >= triangles_to_remove) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            // Reject the collapse if it would flip, or turn by more than about 75 degrees, any of the remaining triangles around `from`.
+            // Only rejecting flips still lets an interior vertex collapse onto the border, folding its triangles into slivers along it.
+            bool flips = false;
+            for (auto i = adjacency_offsets[collapse.from]; i < adjacency_offsets[collapse.from + 1] && !flips; ++i) {
+                const uint* triangle = &result[adjacency[i] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) continue;
+
+                glm::vec3 p[3];
+                glm::vec3 q[3];
+                for (auto k = 0u; k < 3; ++k) {
+                    p[k] = positions[triangle[k]];
+                    q[k] = triangle[k] == collapse.from ? positions[collapse.to] : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            max_error = std::max(max_error, collapse.cost);
+            collapse_count++;
+
+            // Lock the one-ring of `from` for the rest of this pass, since those triangles have now changed
+            for (auto i = adjacency_offsets[collapse.from]; i < adjacency_offsets[collapse.from + 1]; ++i) {
+                const uint* triangle = &result[adjacency[i] * 3];
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    triangles_removed++;
+                }
+            }
+        }
+
+        if (collapse_count == 0) break;
+
+        // Apply the collapses and drop any triangles that have become degenerate
+        size_t write = 0;
+        for (auto t = 0u; t < result.size(); t += 3) {
+            uint a = remap[result[t]];
+            uint b = remap[result[t + 1]];
+            uint c = remap[result[t + 2]];
+            if (a == b || b == c || a == c) continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (out_error != nullptr) {
+        *out_error = (float) std::sqrt(max_error);
+    }
+
+    return result;
+}
@@ -0,0 +1,24 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+
+/// Quadric error metric mesh simplification, used to generate the levels of detail for a model at import time.
+///
+/// Edges are collapsed onto one of their existing endpoints, rather than to an optimal new position,
+/// which means the simplified index lists can all keep referencing the original vertex buffer.
+/// Vertices on an open border, which includes attribute seams (e.g. UV seams), are locked in place to avoid cracks.
+///
+/// See: https://www.cs.cmu.edu/~./garland/Papers/quadrics.pdf
+namespace MeshSimplifier {
+    /// Simplify the triangle list `indices` (referencing `positions`) to at most `target_index_count` indices, if possible.
+    /// Returns the new triangle list, which may be larger than the target if the mesh could not be reduced any further.
+    /// If `out_error` is provided, it is set to the largest quadric error (as a distance) introduced by a collapse.
+    std::vector<uint> simplify(const std::vector<glm::vec3>& positions, const std::vector<uint>& indices, size_t target_index_count, float* out_error = nullptr);
+}
+
+#endif //MESH_SIMPLIFIER_H
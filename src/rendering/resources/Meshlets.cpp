@@ -0,0 +1,125 @@
+#include "Meshlets.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+MeshletFrustum MeshletFrustum::from_matrix(const glm::mat4& projection_view_model, const glm::vec3& model_space_camera_position) {
+    // Gribb-Hartmann plane extraction, each plane is a sum or difference of the w row with another row
+    // See: https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+    auto row = [&projection_view_model](int i) {
+        return glm::vec4{projection_view_model[0][i], projection_view_model[1][i], projection_view_model[2][i], projection_view_model[3][i]};
+    };
+
+    glm::vec4 candidates[6] = {
+        row(3) + row(0), row(3) - row(0),
+        row(3) + row(1), row(3) - row(1),
+        row(3) + row(2), row(3) - row(2),
+    };
+
+    MeshletFrustum frustum{};
+    frustum.plane_count = 0;
+    frustum.camera_position = model_space_camera_position;
+    for (const auto& plane: candidates) {
+        float length = glm::length(glm::vec3(plane));
+        if (length < 1e-6f) continue;
+        frustum.planes[frustum.plane_count++] = plane / length;
+    }
+    return frustum;
+}
+
+std::vector<Meshlet> Meshlets::build(const std::vector<glm::vec3>& positions, const std::vector<uint>& indices, uint index_count, uint max_vertices, uint max_triangles) {
+    std::vector<Meshlet> meshlets{};
+
+    // Marks which meshlet each vertex was last added to, to count unique vertices without clearing a set each time
+    std::vector<uint> last_meshlet(positions.size(), std::numeric_limits<uint>::max());
+    std::vector<uint> meshlet_vertices{};
+
+    auto finish_meshlet = [&](uint start, uint end) {
+        Meshlet meshlet{start, end - start, glm::vec3{0.0f}, 0.0f, glm::vec3{0.0f}, 1.0f};
+
+        // Bounding sphere, centred on the bounding box
+        glm::vec3 min = positions[meshlet_vertices[0]];
+        glm::vec3 max = min;
+        for (auto vertex: meshlet_vertices) {
+            min = glm::min(min, positions[vertex]);
+            max = glm::max(max, positions[vertex]);
+        }
+        meshlet.centre = (min + max) * 0.5f;
+        for (auto vertex: meshlet_vertices) {
+            meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.centre, positions[vertex]));
+        }
+
+        // Normal cone, axis is the average of the unit normals, then find the widest angle from it
+        std::vector<glm::vec3> normals{};
+        glm::vec3 axis{0.0f};
+        for (auto i = start; i < end; i += 3) {
+            const auto& p0 = positions[indices[i]];
+            glm::vec3 normal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+            float length = glm::length(normal);
+            if (length == 0.0f) continue;
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+
+        float axis_length = glm::length(axis);
+        if (axis_length > 0.0f) {
+            axis /= axis_length;
+            float min_dot = 1.0f;
+            for (const auto& normal: normals) {
+                min_dot = std::min(min_dot, glm::dot(axis, normal));
+            }
+
+            meshlet.cone_axis = axis;
+            // Cones that are (close to) a hemisphere or more are never backfacing as a whole
+            meshlet.cone_cutoff = min_dot <= 0.1f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+        }
+
+        meshlets.push_back(meshlet);
+        meshlet_vertices.clear();
+    };
+
+    uint start = 0;
+    for (auto i = 0u; i + 2 < index_count; i += 3) {
+        uint new_vertices = 0;
+        for (auto k = 0u; k < 3; ++k) {
+            if (last_meshlet[indices[i + k]] != (uint) meshlets.size()) new_vertices++;
+        }
+
+        if (meshlet_vertices.size() + new_vertices > max_vertices || (i - start) / 3 >= max_triangles) {
+            finish_meshlet(start, i);
+            start = i;
+        }
+
+        for (auto k = 0u; k < 3; ++k) {
+            uint vertex = indices[i + k];
+            if (last_meshlet[vertex] != (uint) meshlets.size()) {
+                last_meshlet[vertex] = (uint) meshlets.size();
+                meshlet_vertices.push_back(vertex);
+            }
+        }
+    }
+    if (start < index_count) {
+        finish_meshlet(start, index_count);
+    }
+
+    return meshlets;
+}
+
+Meshlets::CullResult Meshlets::cull(const Meshlet& meshlet, const MeshletFrustum& frustum) {
+    for (auto i = 0u; i < frustum.plane_count; ++i) {
+        const auto& plane = frustum.planes[i];
+        if (glm::dot(glm::vec3(plane), meshlet.centre) + plane.w < -meshlet.radius) {
+            return CullResult::Frustum;
+        }
+    }
+
+    // Every triangle is backfacing if the camera is within the negative cone, which is tested conservatively with the bounding sphere
+    // See: https://github.com/zeux/meshoptimizer/blob/master/src/clusterizer.cpp
+    glm::vec3 view = meshlet.centre - frustum.camera_position;
+    if (glm::dot(view, meshlet.cone_axis) >= meshlet.cone_cutoff * glm::length(view) + meshlet.radius) {
+        return CullResult::Backface;
+    }
+
+    return CullResult::Visible;
+}
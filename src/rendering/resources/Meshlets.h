@@ -0,0 +1,54 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+
+/// A small cluster of triangles that is culled as a unit.
+/// The triangles are a contiguous range of the model's full detail index list.
+struct Meshlet {
+    uint index_offset;
+    uint index_count;
+    // Model space bounding sphere
+    glm::vec3 centre;
+    float radius;
+    // Normal cone, a cutoff of 1 or more means the cone is too wide to ever be backface culled
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+};
+
+/// Model space culling data for a single model instance, as used by Meshlets::cull
+struct MeshletFrustum {
+    glm::vec4 planes[6];
+    uint plane_count;
+    glm::vec3 camera_position;
+
+    /// Extract the frustum planes from a projection * view * model matrix, which gives them in model space.
+    /// Degenerate planes, such as the far plane of an infinite projection, are skipped.
+    static MeshletFrustum from_matrix(const glm::mat4& projection_view_model, const glm::vec3& model_space_camera_position);
+};
+
+namespace Meshlets {
+    static constexpr uint MAX_VERTICES = 64;
+    static constexpr uint MAX_TRIANGLES = 124;
+
+    enum class CullResult {
+        Visible,
+        Frustum,
+        Backface,
+    };
+
+    /// Split the first `index_count` indices into meshlets by walking the triangles in order, starting a new meshlet
+    /// once it would exceed `max_vertices` unique vertices or `max_triangles` triangles. Since this relies on the
+    /// triangle order for locality, the indices should already be optimised for the vertex cache.
+    std::vector<Meshlet> build(const std::vector<glm::vec3>& positions, const std::vector<uint>& indices, uint index_count,
+                               uint max_vertices = MAX_VERTICES, uint max_triangles = MAX_TRIANGLES);
+
+    /// Test a meshlet against a frustum, and then its normal cone against the camera position.
+    CullResult cull(const Meshlet& meshlet, const MeshletFrustum& frustum);
+}
+
+#endif //MESHLETS_H
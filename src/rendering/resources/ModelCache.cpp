@@ -0,0 +1,177 @@
+#include "ModelCache.h"
+
+#include <atomic>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        file_handle = nullptr;
+        throw std::runtime_error(Formatter() << "Failed to open file (" << path << ")");
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    size = (size_t) file_size.QuadPart;
+    if (size > 0) {
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_handle != nullptr) {
+            data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (data == nullptr) {
+            if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+            CloseHandle(file_handle);
+            throw std::runtime_error(Formatter() << "Failed to map file (" << path << ")");
+        }
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(Formatter() << "Failed to open file (" << path << ")");
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        throw std::runtime_error(Formatter() << "Failed to stat file (" << path << ")");
+    }
+    size = (size_t) file_stat.st_size;
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error(Formatter() << "Failed to map file (" << path << ")");
+        }
+        data = static_cast<const unsigned char*>(mapped);
+    }
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+#endif
+}
+
+const unsigned char* MappedFile::get_data() const {
+    return data;
+}
+
+size_t MappedFile::get_size() const {
+    return size;
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+    if (file_handle != nullptr) CloseHandle(file_handle);
+#else
+    if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+void BinaryWriter::write_string(const std::string& value) {
+    write((uint64_t) value.size());
+    write_bytes(value.data(), value.size());
+}
+
+void BinaryWriter::write_bytes(const void* data, size_t size) {
+    const auto* begin = static_cast<const unsigned char*>(data);
+    bytes.insert(bytes.end(), begin, begin + size);
+}
+
+const std::vector<unsigned char>& BinaryWriter::get_bytes() const {
+    return bytes;
+}
+
+void BinaryReader::require(size_t count) const {
+    if (offset > size || count > size - offset) {
+        throw std::runtime_error(Formatter() << "Unexpected end of file, reading " << count << " bytes at " << offset << " of " << size);
+    }
+}
+
+std::string BinaryReader::read_string() {
+    auto length = read<uint64_t>();
+    require(length);
+    std::string value(reinterpret_cast<const char*>(data + offset), length);
+    offset += length;
+    return value;
+}
+
+uint64_t ModelCache::hash(const std::string& description) {
+    uint64_t hash = 14695981039346656037ull;
+    for (auto c: description) {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ModelCache::Header ModelCache::make_header(const std::string& source_path, uint64_t format_hash) {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.format_hash = format_hash;
+    header.source_write_time = (int64_t) std::filesystem::last_write_time(source_path).time_since_epoch().count();
+    header.source_size = (uint64_t) std::filesystem::file_size(source_path);
+    return header;
+}
+
+std::string ModelCache::get_cache_path(const std::string& import_path, const std::string& file, uint64_t format_hash) {
+    return Formatter() << import_path << "/" << CACHE_DIRECTORY << "/" << file << "." << std::hex << format_hash << ".bin";
+}
+
+std::unique_ptr<MappedFile> ModelCache::open(const std::string& cache_path, const Header& expected) {
+    if (!std::filesystem::exists(cache_path)) return nullptr;
+
+    auto mapped = std::make_unique<MappedFile>(cache_path);
+    if (mapped->get_size() < sizeof(Header)) return nullptr;
+
+    Header header{};
+    std::memcpy(&header, mapped->get_data(), sizeof(Header));
+    bool matches = std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+                   && header.version == expected.version
+                   && header.format_hash == expected.format_hash
+                   && header.source_write_time == expected.source_write_time
+                   && header.source_size == expected.source_size;
+    return matches ? std::move(mapped) : nullptr;
+}
+
+std::string ModelCache::get_temporary_path(const std::string& cache_path) {
+    // Random per run of the program, to tell it apart from other instances, then counted within it
+    static const uint64_t process_id = ((uint64_t) std::random_device{}() << 32u) | std::random_device{}();
+    static std::atomic<uint64_t> next_id{0};
+    return Formatter() << cache_path << "." << std::hex << process_id << "-" << next_id++ << ".tmp";
+}
+
+void ModelCache::save(const std::string& cache_path, const BinaryWriter& writer) {
+    auto temporary_path = get_temporary_path(cache_path);
+    try {
+        std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path());
+
+        {
+            std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+            const auto& bytes = writer.get_bytes();
+            out.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize) bytes.size());
+            if (!out) {
+                throw std::runtime_error("Failed to write the file");
+            }
+        }
+        // Atomically replaces any cache already there, so whichever racing writer renames last wins, with a whole file
+        std::filesystem::rename(temporary_path, cache_path);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to save model cache (" << cache_path << "): " << e.what() << std::endl;
+        std::error_code error{};
+        std::filesystem::remove(temporary_path, error);
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "utility/HelperTypes.h"
+
+/// A whole file mapped read only into memory, which is unmapped when destroyed
+class MappedFile : private NonCopyable {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+public:
+    /// Map the file at `path`, throwing if it can't be opened
+    explicit MappedFile(const std::string& path);
+
+    [[nodiscard]] const unsigned char* get_data() const;
+    [[nodiscard]] size_t get_size() const;
+
+    ~MappedFile();
+};
+
+/// Builds a binary file in memory. Arrays are aligned to ARRAY_ALIGNMENT from the start of the file,
+/// so that once the file is mapped they can be used in place.
+class BinaryWriter {
+    std::vector<unsigned char> bytes{};
+public:
+    static constexpr size_t ARRAY_ALIGNMENT = 16;
+
+    template<typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written directly");
+        write_bytes(&value, sizeof(T));
+    }
+
+    /// Write the size, then the elements starting at the next aligned offset
+    template<typename T>
+    void write_array(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written directly");
+        write((uint64_t) count);
+        bytes.resize((bytes.size() + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT, 0);
+        write_bytes(values, sizeof(T) * count);
+    }
+
+    template<typename T>
+    void write_vector(const std::vector<T>& values) {
+        write_array(values.data(), values.size());
+    }
+
+    void write_string(const std::string& value);
+
+    void write_bytes(const void* data, size_t size);
+
+    [[nodiscard]] const std::vector<unsigned char>& get_bytes() const;
+};
+
+/// Reads back a file written by BinaryWriter, throwing if it reads past the end
+class BinaryReader {
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+
+    void require(size_t count) const;
+public:
+    BinaryReader(const unsigned char* data, size_t size, size_t offset = 0) : data(data), size(size), offset(offset) {}
+
+    template<typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read directly");
+        require(sizeof(T));
+        T value;
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    /// A pointer to an array in place, and its length, without copying it
+    template<typename T>
+    std::pair<const T*, size_t> read_array() {
+        auto count = read<uint64_t>();
+        offset = (offset + BinaryWriter::ARRAY_ALIGNMENT - 1) / BinaryWriter::ARRAY_ALIGNMENT * BinaryWriter::ARRAY_ALIGNMENT;
+        if (count > (size - std::min(offset, size)) / std::max<size_t>(sizeof(T), 1)) {
+            throw std::runtime_error(Formatter() << "Array of " << count << " elements runs past the end of the file");
+        }
+        const auto* values = reinterpret_cast<const T*>(data + offset);
+        offset += sizeof(T) * count;
+        return {values, (size_t) count};
+    }
+
+    template<typename T>
+    std::vector<T> read_vector() {
+        auto [values, count] = read_array<T>();
+        return std::vector<T>(values, values + count);
+    }
+
+    std::string read_string();
+};
+
+/// The versioned binary files that ModelLoader stores fully processed models in, so later runs can skip importing them.
+/// They are kept in a CACHE_DIRECTORY beside the source files, one per (source file, format hash).
+namespace ModelCache {
+    /// Increment whenever the layout of the cache files, or anything written into them, changes
+    static constexpr uint32_t VERSION = 1;
+    static constexpr char MAGIC[4] = {'M', 'C', 'C', 'H'};
+    static constexpr const char* CACHE_DIRECTORY = ".cache";
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        // Identifies the vertex type and every setting that changes the processed data, see ModelLoader::get_format_hash
+        uint64_t format_hash;
+        // The source file the cache was built from
+        int64_t source_write_time;
+        uint64_t source_size;
+    };
+
+    /// 64-bit FNV-1a
+    uint64_t hash(const std::string& description);
+
+    /// The header a cache of `source_path` should have, for the source file as it is now
+    Header make_header(const std::string& source_path, uint64_t format_hash);
+
+    /// Where the cache for `file` (relative to `import_path`) is stored
+    std::string get_cache_path(const std::string& import_path, const std::string& file, uint64_t format_hash);
+
+    /// Map the cache file if it exists and its header matches `expected`, otherwise return nullptr
+    std::unique_ptr<MappedFile> open(const std::string& cache_path, const Header& expected);
+
+    /// A path beside `cache_path` to write it to before renaming it into place, unique to this call, so that writers racing
+    /// to save the same cache (from other threads, or other instances of the program) never write into the same file
+    std::string get_temporary_path(const std::string& cache_path);
+
+    /// Write the cache file, through a temporary file so a partially written cache is never read.
+    /// Failing to write is reported, but not an error, since the model is still usable.
+    void save(const std::string& cache_path, const BinaryWriter& writer);
+}
+
+#endif //MODEL_CACHE_H
@@ -2,14 +2,102 @@
 #define MODEL_HANDLE_H
 
 #include <string>
+#include <vector>
+#include <limits>
+#include <memory>
+#include <utility>
 #include <optional>
+#include <algorithm>
 
 #include <glad/gl.h>
+#include <glm/glm.hpp>
+
 #include "utility/HelperTypes.h"
+#include "rendering/memory/GpuMemory.h"
+#include "VertexFormat.h"
+#include "Meshlets.h"
+
+/// A contiguous range of a model's index buffer, which draws the model at a specific level of detail.
+struct ModelLod {
+    int index_offset;
+    int index_count;
+};
+
+/// A sphere enclosing all the vertices of a model, in model space.
+struct BoundingSphere {
+    glm::vec3 centre{0.0f};
+    float radius = 0.0f;
+
+    /// Estimate the fraction of the screen height the sphere covers once transformed by model_matrix,
+    /// where projection_scale is the [1][1] element of the projection matrix (cot(fov / 2)).
+    [[nodiscard]] float screen_size(const glm::mat4& model_matrix, const glm::vec3& camera_position, float projection_scale) const {
+        glm::vec3 ws_centre = model_matrix * glm::vec4(centre, 1.0f);
+        float max_scale_2 = std::max({
+            glm::dot(glm::vec3(model_matrix[0]), glm::vec3(model_matrix[0])),
+            glm::dot(glm::vec3(model_matrix[1]), glm::vec3(model_matrix[1])),
+            glm::dot(glm::vec3(model_matrix[2]), glm::vec3(model_matrix[2]))
+        });
+        float ws_radius = radius * std::sqrt(max_scale_2);
+        float distance = glm::distance(ws_centre, camera_position);
+        if (distance <= ws_radius) {
+            // Camera is inside the sphere, so it covers the whole screen
+            return std::numeric_limits<float>::infinity();
+        }
+        return ws_radius * projection_scale / distance;
+    }
+};
+
+/// Describes how a model's vertices and indices are laid out in GPU memory.
+struct ModelLayout {
+    VertexFormat vertex_format = VertexFormat::Full;
+    PositionDequantisation dequantisation{};
+    uint vertex_stride = 0;
+    // The stride the vertices would have if they were stored in VertexFormat::Full
+    uint full_vertex_stride = 0;
+    uint vertex_count = 0;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    uint index_type = GL_UNSIGNED_INT;
+    // Number of indices in the index buffer, across all LODs
+    uint index_total = 0;
+
+    [[nodiscard]] uint index_size() const {
+        return index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    [[nodiscard]] size_t vertex_bytes() const {
+        return (size_t) vertex_stride * vertex_count;
+    }
+
+    [[nodiscard]] size_t index_bytes() const {
+        return (size_t) index_size() * index_total;
+    }
+
+    /// The size the buffers would be with full float vertices and 32-bit indices
+    [[nodiscard]] size_t full_bytes() const {
+        return (size_t) full_vertex_stride * vertex_count + sizeof(uint32_t) * index_total;
+    }
+};
 
 /// A type-erased version of ModelHandle for polymorphic usages
-class BaseModelHandle : private NonCopyable {
+class BaseModelHandle : private NonCopyable, public std::enable_shared_from_this<BaseModelHandle> {
+protected:
+    ModelLayout layout;
+    // The vertex and index buffers, as listed in GpuMemory
+    GpuAllocation gpu_allocation;
 public:
+    BaseModelHandle(const ModelLayout& layout, std::string name) : layout(layout), gpu_allocation(GpuResourceType::Model, std::move(name), layout.vertex_bytes() + layout.index_bytes()) {
+        gpu_allocation.set_ref_count([this]() { return weak_from_this().use_count(); });
+    }
+
+    [[nodiscard]] const ModelLayout& get_layout() const {
+        return layout;
+    }
+
+    /// Record that the model is being drawn this frame, for GpuMemory
+    void mark_used() const {
+        gpu_allocation.mark_used();
+    }
+
     virtual ~BaseModelHandle() = default;
 };
 
@@ -19,26 +107,51 @@ class ModelHandle : public BaseModelHandle {
     uint vertex_vbo;
     uint index_vbo;
     uint vao;
-    int index_count;
+    // [lod_level] -> index range, where level 0 is the full detail model
+    std::vector<ModelLod> lods;
+    BoundingSphere bounds;
+    // Clusters of the full detail level, for culling within the model, empty if the model is too small to benefit
+    std::vector<Meshlet> meshlets{};
     int vertex_offset;
 
     std::optional<std::string> filename{};
 public:
-    ModelHandle(uint vertex_vbo, uint index_vbo, uint vao, int index_count, int vertex_offset, std::optional<std::string> filename = {});
+    /// The screen size (fraction of screen height) below which LOD 1 is used, halving for each level after that.
+    static constexpr float LOD_SCREEN_SIZE = 0.25f;
+    /// How far past a threshold (as a fraction of it) the screen size must go before changing level, to prevent popping.
+    static constexpr float LOD_HYSTERESIS = 0.1f;
+
+    ModelHandle(uint vertex_vbo, uint index_vbo, uint vao, std::vector<ModelLod> lods, BoundingSphere bounds, const ModelLayout& layout, int vertex_offset, std::optional<std::string> filename = {});
 
     [[nodiscard]] uint get_vertex_vbo() const;
     [[nodiscard]] uint get_index_vbo() const;
     [[nodiscard]] uint get_vao() const;
     [[nodiscard]] int get_index_count() const;
+    [[nodiscard]] uint get_index_type() const;
+    /// Byte offset into the index buffer to start drawing the given LOD from, for use with glDrawElements*
+    [[nodiscard]] const void* get_index_pointer(const ModelLod& lod) const;
+    [[nodiscard]] const std::vector<ModelLod>& get_lods() const;
+    [[nodiscard]] const ModelLod& get_lod(uint lod_level) const;
+    [[nodiscard]] const BoundingSphere& get_bounds() const;
+    [[nodiscard]] const std::vector<Meshlet>& get_meshlets() const;
+    /// Meshlets are generated after upload, so are set separately from the constructor
+    void set_meshlets(std::vector<Meshlet> new_meshlets);
     [[nodiscard]] int get_vertex_offset() const;
     [[nodiscard]] const std::optional<std::string>& get_filename() const;
 
+    /// Select the level of detail to draw at, given the screen_size of the bounding sphere and the previously used level.
+    [[nodiscard]] uint select_lod(float screen_size, uint current_lod) const;
+
+    /// Swap the buffers, and everything describing them, with `other`, keeping the filename.
+    /// Used to reload a model in place, so every entity using the handle draws the new version.
+    void swap_buffers(ModelHandle& other);
+
     ~ModelHandle() override;
 };
 
 template<typename VertexData>
-ModelHandle<VertexData>::ModelHandle(uint vertex_vbo, uint index_vbo, uint vao, int index_count, int vertex_offset, std::optional<std::string> filename)
-    : BaseModelHandle(), vertex_vbo(vertex_vbo), index_vbo(index_vbo), vao(vao), index_count(index_count), vertex_offset(vertex_offset), filename(std::move(filename)) {}
+ModelHandle<VertexData>::ModelHandle(uint vertex_vbo, uint index_vbo, uint vao, std::vector<ModelLod> lods, BoundingSphere bounds, const ModelLayout& layout, int vertex_offset, std::optional<std::string> filename)
+    : BaseModelHandle(layout, filename.value_or("Generated Model")), vertex_vbo(vertex_vbo), index_vbo(index_vbo), vao(vao), lods(std::move(lods)), bounds(bounds), vertex_offset(vertex_offset), filename(std::move(filename)) {}
 
 template<typename VertexData>
 uint ModelHandle<VertexData>::get_vertex_vbo() const {
@@ -57,7 +170,56 @@ uint ModelHandle<VertexData>::get_vao() const {
 
 template<typename VertexData>
 int ModelHandle<VertexData>::get_index_count() const {
-    return index_count;
+    return lods[0].index_count;
+}
+
+template<typename VertexData>
+uint ModelHandle<VertexData>::get_index_type() const {
+    return layout.index_type;
+}
+
+template<typename VertexData>
+const void* ModelHandle<VertexData>::get_index_pointer(const ModelLod& lod) const {
+    return (const void*) ((size_t) lod.index_offset * layout.index_size());
+}
+
+template<typename VertexData>
+const std::vector<ModelLod>& ModelHandle<VertexData>::get_lods() const {
+    return lods;
+}
+
+template<typename VertexData>
+const ModelLod& ModelHandle<VertexData>::get_lod(uint lod_level) const {
+    return lods[std::min(lod_level, (uint) lods.size() - 1)];
+}
+
+template<typename VertexData>
+const BoundingSphere& ModelHandle<VertexData>::get_bounds() const {
+    return bounds;
+}
+
+template<typename VertexData>
+const std::vector<Meshlet>& ModelHandle<VertexData>::get_meshlets() const {
+    return meshlets;
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::set_meshlets(std::vector<Meshlet> new_meshlets) {
+    meshlets = std::move(new_meshlets);
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::swap_buffers(ModelHandle& other) {
+    std::swap(layout, other.layout);
+    std::swap(vertex_vbo, other.vertex_vbo);
+    std::swap(index_vbo, other.index_vbo);
+    std::swap(vao, other.vao);
+    std::swap(lods, other.lods);
+    std::swap(bounds, other.bounds);
+    std::swap(meshlets, other.meshlets);
+    std::swap(vertex_offset, other.vertex_offset);
+    gpu_allocation.resize(layout.vertex_bytes() + layout.index_bytes());
+    other.gpu_allocation.resize(other.layout.vertex_bytes() + other.layout.index_bytes());
 }
 
 template<typename VertexData>
@@ -70,6 +232,21 @@ const std::optional<std::string>& ModelHandle<VertexData>::get_filename() const
     return filename;
 }
 
+template<typename VertexData>
+uint ModelHandle<VertexData>::select_lod(float screen_size, uint current_lod) const {
+    // The threshold between level i and i + 1 is LOD_SCREEN_SIZE / 2^i
+    auto threshold = [](uint level) { return LOD_SCREEN_SIZE / (float) (1u << level); };
+
+    uint lod = std::min(current_lod, (uint) lods.size() - 1);
+    while (lod + 1 < lods.size() && screen_size < threshold(lod) * (1.0f - LOD_HYSTERESIS)) {
+        lod++;
+    }
+    while (lod > 0 && screen_size > threshold(lod - 1) * (1.0f + LOD_HYSTERESIS)) {
+        lod--;
+    }
+    return lod;
+}
+
 template<typename VertexData>
 ModelHandle<VertexData>::~ModelHandle() {
     glDeleteVertexArrays(1, &vao);
@@ -1,16 +1,367 @@
 #include "ModelLoader.h"
+#include <chrono>
 #include <filesystem>
 
-const std::vector<std::string>& ModelLoader::get_available_models(bool force_refresh) {
-    if (!force_refresh && available_models.has_value()) {
+ModelLoader::ModelLoader(std::string import_path, AssetRegistry& asset_registry) : import_path(std::move(import_path)), asset_registry(asset_registry) {
+    asset_registry.add_listener(this->import_path, [this](const std::vector<std::string>& changed_files) {
+        on_files_changed(changed_files);
+    });
+}
+
+const std::vector<std::string>& ModelLoader::get_available_models() {
+    if (available_models.has_value() && available_models_generation == asset_registry.get_generation()) {
         return available_models.value();
     }
     available_models = std::vector<std::string>{};
+    available_models_generation = asset_registry.get_generation();
 
-    for (auto const& dir_entry: std::filesystem::recursive_directory_iterator(import_path)) {
-        available_models->push_back(std::filesystem::relative(dir_entry, import_path).string());
+    auto cache_prefix = std::string(ModelCache::CACHE_DIRECTORY) + "/";
+    for (auto& file: asset_registry.list_files(import_path)) {
+        // Skip the model caches and sidecars, which aren't models themselves
+        if (file.compare(0, cache_prefix.size(), cache_prefix) == 0 || ImportProfiles::is_sidecar(file)) continue;
+        available_models->push_back(std::move(file));
     }
-    std::sort(available_models.value().begin(), available_models.value().end());
 
     return available_models.value();
-}
\ No newline at end of file
+}
+
+std::filesystem::file_time_type ModelLoader::get_last_write_time(const std::string& file) const {
+    auto path = import_path + "/" + file;
+    auto last_write_time = asset_registry.get_last_write_time(path);
+    if (!last_write_time.has_value()) {
+        throw std::runtime_error(Formatter() << "Failed to load model (" << path << "): \n\t File does not exist");
+    }
+    return last_write_time.value();
+}
+
+void ModelLoader::on_files_changed(const std::vector<std::string>& changed_files) {
+    auto cache_prefix = std::string(ModelCache::CACHE_DIRECTORY) + "/";
+    std::unordered_set<std::string> changed_models{};
+    for (const auto& file: changed_files) {
+        if (file.compare(0, cache_prefix.size(), cache_prefix) == 0) continue;
+        if (ImportProfiles::is_sidecar(file)) {
+            // A new profile changes how the model is imported
+            changed_models.insert(file.substr(0, file.size() - std::string(ImportProfiles::SIDECAR_EXTENSION).size()));
+        } else {
+            changed_models.insert(file);
+        }
+    }
+
+    // Collected first, so the reloaders can't change while they are iterated
+    std::vector<std::function<void()>> to_reload{};
+    for (auto iter = reloaders.begin(); iter != reloaders.end();) {
+        auto model = cache.find(iter->first);
+        if (model == cache.end() || model->second.second.expired()) {
+            // Nothing left to reload
+            iter = reloaders.erase(iter);
+            continue;
+        }
+        if (changed_models.count(iter->first.first) != 0) {
+            to_reload.push_back(iter->second);
+        }
+        ++iter;
+    }
+    for (const auto& reload: to_reload) {
+        reload();
+    }
+}
+
+std::vector<ModelLod> ModelLoader::generate_lods(const std::vector<glm::vec3>& positions, std::vector<uint>& indices) {
+    std::vector<ModelLod> lods{{0, (int) indices.size()}};
+
+    // Each level targets half the triangles of the last, simplifying from the previous level rather than the original
+    std::vector<uint> previous{indices};
+    while (lods.size() < MAX_LOD_LEVELS && previous.size() / 3 >= MIN_LOD_TRIANGLES) {
+        auto simplified = MeshSimplifier::simplify(positions, previous, previous.size() / 2);
+
+        // Stop if the mesh couldn't be meaningfully reduced, e.g. it is mostly seams and borders
+        if (simplified.empty() || simplified.size() > previous.size() * 9 / 10) break;
+
+        // Collapsing edges scrambles the cache locality of the previous level, so restore it
+        MeshOptimiser::optimise_vertex_cache(simplified, (uint) positions.size());
+
+        lods.push_back({(int) indices.size(), (int) simplified.size()});
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        previous = std::move(simplified);
+    }
+
+    return lods;
+}
+
+size_t ModelLoader::get_resident_bytes(const BaseModelHandle& model) {
+    return model.get_layout().vertex_bytes() + model.get_layout().index_bytes();
+}
+
+size_t ModelLoader::get_resident_bytes(const BaseMeshHierarchy& mesh_hierarchy) {
+    size_t bytes = 0;
+    for (const auto& model: mesh_hierarchy.get_model_handles()) {
+        bytes += get_resident_bytes(*model);
+    }
+    return bytes;
+}
+
+void ModelLoader::report_memory(const std::string& name, const BaseModelHandle& model) {
+    const auto& layout = model.get_layout();
+    size_t bytes = layout.vertex_bytes() + layout.index_bytes();
+    size_t full_bytes = layout.full_bytes();
+    std::cout << "Loaded model [" << name << "]: "
+              << layout.vertex_count << " vertices @ " << layout.vertex_stride << " B, "
+              << layout.index_total << " indices @ " << layout.index_size() << " B, "
+              << bytes / 1024 << " KiB (" << full_bytes / 1024 << " KiB with the full format)" << std::endl;
+}
+
+void ModelLoader::write_model(BinaryWriter& writer, const PreparedModel& prepared) {
+    writer.write(prepared.layout);
+    writer.write(prepared.bounds);
+    writer.write_vector(prepared.lods);
+    writer.write_vector(prepared.meshlets);
+    writer.write_array(static_cast<const unsigned char*>(prepared.get_vertex_data()), prepared.layout.vertex_bytes());
+    writer.write_array(static_cast<const unsigned char*>(prepared.get_index_data()), prepared.layout.index_bytes());
+}
+
+ModelLoader::PreparedModel ModelLoader::read_model(BinaryReader& reader, const std::shared_ptr<const MappedFile>& mapped_file) {
+    PreparedModel prepared{};
+    prepared.layout = reader.read<ModelLayout>();
+    prepared.bounds = reader.read<BoundingSphere>();
+    prepared.lods = reader.read_vector<ModelLod>();
+    prepared.meshlets = reader.read_vector<Meshlet>();
+    auto [vertex_data, vertex_size] = reader.read_array<unsigned char>();
+    auto [index_data, index_size] = reader.read_array<unsigned char>();
+    if (vertex_size != prepared.layout.vertex_bytes() || index_size != prepared.layout.index_bytes() || prepared.lods.empty()) {
+        throw std::runtime_error("Model buffers don't match their layout");
+    }
+    // Anything else would be passed straight to glDrawElements, or change how index_size() reads the buffer
+    if (prepared.layout.index_type != GL_UNSIGNED_SHORT && prepared.layout.index_type != GL_UNSIGNED_INT) {
+        throw std::runtime_error("Unknown model index type");
+    }
+    // Compared in 64 bits, so a corrupt offset and count can't wrap around to pass
+    for (const auto& lod: prepared.lods) {
+        if (lod.index_offset < 0 || lod.index_count < 0 || (int64_t) lod.index_offset + lod.index_count > (int64_t) prepared.layout.index_total) {
+            throw std::runtime_error("Model LOD out of range");
+        }
+    }
+    // Meshlets are whole triangles within the index buffer
+    for (const auto& meshlet: prepared.meshlets) {
+        if (meshlet.index_count % 3 != 0 || (uint64_t) meshlet.index_offset + meshlet.index_count > prepared.layout.index_total) {
+            throw std::runtime_error("Meshlet out of range");
+        }
+    }
+    // And every index has to name a vertex that exists, or the GPU would read past the vertex buffer
+    uint max_index = 0;
+    if (prepared.layout.index_type == GL_UNSIGNED_SHORT) {
+        const auto* indices = reinterpret_cast<const uint16_t*>(index_data);
+        for (auto i = 0u; i < prepared.layout.index_total; ++i) max_index = std::max<uint>(max_index, indices[i]);
+    } else {
+        const auto* indices = reinterpret_cast<const uint32_t*>(index_data);
+        for (auto i = 0u; i < prepared.layout.index_total; ++i) max_index = std::max<uint>(max_index, indices[i]);
+    }
+    if (prepared.layout.index_total > 0 && max_index >= prepared.layout.vertex_count) {
+        throw std::runtime_error("Model index out of range");
+    }
+
+    prepared.mapped_file = mapped_file;
+    prepared.mapped_vertex_offset = (size_t) (vertex_data - mapped_file->get_data());
+    prepared.mapped_index_offset = (size_t) (index_data - mapped_file->get_data());
+    return prepared;
+}
+
+void ModelLoader::count_node_elements(const aiScene* scene, const aiNode* node, size_t& vertex_count, size_t& index_count) {
+    for (auto mesh_i = 0u; mesh_i < node->mNumMeshes; ++mesh_i) {
+        const auto mesh = scene->mMeshes[node->mMeshes[mesh_i]];
+        if ((mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) == 0) continue;
+
+        vertex_count += mesh->mNumVertices;
+        for (auto i = 0u; i < mesh->mNumFaces; ++i) {
+            index_count += mesh->mFaces[i].mNumIndices;
+        }
+    }
+
+    for (auto i = 0u; i < node->mNumChildren; ++i) {
+        count_node_elements(scene, node->mChildren[i], vertex_count, index_count);
+    }
+}
+
+ModelLoader::LoadSettings ModelLoader::get_load_settings(const std::string& path, std::optional<ImportProfile> profile) const {
+    if (!profile.has_value() && asset_registry.exists(path + ImportProfiles::SIDECAR_EXTENSION)) {
+        profile = ImportProfiles::read_sidecar(path);
+    }
+    auto import_profile = profile.value_or(default_import_profile);
+    return {vertex_format, animation_compression, use_model_cache || ImportProfiles::is_always_cached(import_profile), import_profile};
+}
+
+void ModelLoader::record_import(const ImportTimings& timings) {
+    if (log_imports) {
+        std::cout << "Imported " << (timings.hierarchy ? "hierarchy" : "model") << " [" << timings.file << "] "
+                  << (timings.from_cache ? "from cache" : "with profile " + std::string(ImportProfiles::get_name(timings.profile))) << ": "
+                  << "read " << timings.read_ms << " ms, convert " << timings.convert_ms << " ms, upload " << timings.upload_ms << " ms" << std::endl;
+    }
+
+    import_history.push_back(timings);
+    if (import_history.size() > MAX_IMPORT_HISTORY) {
+        import_history.pop_front();
+    }
+}
+
+Assimp::Importer& ModelLoader::get_importer() {
+    thread_local Assimp::Importer importer{};
+    return importer;
+}
+
+void ModelLoader::process_uploads() {
+    residency.trim();
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    uploads_last_frame = 0;
+    // Indexed, since completing a load runs callbacks that may start more
+    for (size_t i = 0; i < pending_loads.size();) {
+        // Always complete at least one, so a model that takes longer than the whole budget still loads
+        if (uploads_last_frame > 0 && elapsed_ms() >= upload_budget_ms) break;
+
+        if (!pending_loads[i]->is_prepared()) {
+            ++i;
+            continue;
+        }
+        auto pending = pending_loads[i];
+        pending_loads.erase(pending_loads.begin() + (long) i);
+        pending->complete();
+        uploads_last_frame++;
+    }
+    upload_time_last_frame_ms = elapsed_ms();
+
+    for (auto iter = in_flight.begin(); iter != in_flight.end();) {
+        auto pending = iter->second.lock();
+        iter = pending == nullptr || pending->is_ready() ? in_flight.erase(iter) : std::next(iter);
+    }
+}
+
+void ModelLoader::finish_all_loads() {
+    // Completing a load runs callbacks that may start more, so keep going until there are none left
+    while (!pending_loads.empty()) {
+        auto pending = pending_loads.front();
+        pending_loads.pop_front();
+        pending->complete();
+    }
+    in_flight.clear();
+}
+
+std::optional<std::string> ModelLoader::get_loading_name(const void* slot) const {
+    auto loading = loading_slots.find(slot);
+    if (loading == loading_slots.end()) return std::nullopt;
+    return std::string(Formatter() << loading->second.file << " (Loading)");
+}
+
+void ModelLoader::check_animation_compression(const std::string& name, const AnimationCompressionStats& stats, const AnimationCompressionSettings& settings) {
+    if (!stats.max_error.within(settings)) {
+        std::cerr << "Warning: animation [" << name << "] exceeds the compression tolerances after quantisation, max error "
+                  << stats.max_error.position << " position, " << stats.max_error.rotation << " rad rotation, "
+                  << stats.max_error.scaling << " scaling" << std::endl;
+    }
+}
+
+void ModelLoader::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Model Loader")) {
+        bool packed = vertex_format == VertexFormat::Packed;
+        if (ImGui::Checkbox("Packed Vertex Format", &packed)) {
+            vertex_format = packed ? VertexFormat::Packed : VertexFormat::Full;
+        }
+        ImGui::Checkbox("Reduce Animation Keys", &animation_compression.reduce_keys);
+        if (animation_compression.reduce_keys) {
+            ImGui::DragFloat("Position Tolerance", &animation_compression.position_tolerance, 0.0001f, 0.0f, 1.0f, "%.4f");
+            ImGui::DragFloat("Rotation Tolerance (rad)", &animation_compression.rotation_tolerance, 0.0001f, 0.0f, 0.1f, "%.4f");
+            ImGui::DragFloat("Scaling Tolerance", &animation_compression.scaling_tolerance, 0.0001f, 0.0f, 1.0f, "%.4f");
+        }
+        ImGui::Checkbox("Use Model Cache", &use_model_cache);
+        if (ImGui::BeginCombo("Default Import Profile", ImportProfiles::get_name(default_import_profile), 0)) {
+            for (auto profile: ImportProfiles::ALL) {
+                const bool is_selected = profile == default_import_profile;
+                if (ImGui::Selectable(ImportProfiles::get_name(profile), is_selected)) {
+                    default_import_profile = profile;
+                }
+                if (is_selected)
+                    ImGui::SetItemDefaultFocus();
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::TextDisabled("(Applies to models loaded after the change)");
+        ImGui::DragFloat("Upload Budget (ms)", &upload_budget_ms, 0.05f, 0.0f, 100.0f, "%.2f");
+        ImGui::Text("Loading In Background: %zu", pending_loads.size());
+        ImGui::Text("Uploaded Last Frame: %u (%.2f ms)", uploads_last_frame, upload_time_last_frame_ms);
+        residency.add_imgui_options("Kept Loaded While Unused");
+
+        // Gather every live model, including the meshes of hierarchies, without counting any twice
+        std::unordered_set<const BaseModelHandle*> models{};
+        for (const auto& [key, entry]: cache) {
+            if (auto handle = entry.second.lock()) models.insert(handle.get());
+        }
+        size_t animation_bytes = 0;
+        for (const auto& [key, entry]: hierarchy_cache) {
+            if (auto hierarchy = entry.second.lock()) {
+                for (const auto& handle: hierarchy->get_model_handles()) models.insert(handle.get());
+                animation_bytes += hierarchy->get_animation_bytes();
+            }
+        }
+
+        size_t vertex_bytes = 0;
+        size_t index_bytes = 0;
+        size_t full_bytes = 0;
+        for (const auto* model: models) {
+            const auto& layout = model->get_layout();
+            vertex_bytes += layout.vertex_bytes();
+            index_bytes += layout.index_bytes();
+            full_bytes += layout.full_bytes();
+        }
+
+        size_t total_bytes = vertex_bytes + index_bytes;
+        ImGui::Text("Loaded Models: %zu", models.size());
+        ImGui::Text("Vertex Memory: %.1f KiB", (double) vertex_bytes / 1024.0);
+        ImGui::Text("Index Memory: %.1f KiB", (double) index_bytes / 1024.0);
+        ImGui::Text("Animation Memory: %.1f KiB", (double) animation_bytes / 1024.0);
+        ImGui::Text("Full Format Memory: %.1f KiB", (double) full_bytes / 1024.0);
+        if (full_bytes > 0) {
+            ImGui::Text("Saved: %.1f%%", 100.0 * (1.0 - (double) total_bytes / (double) full_bytes));
+        }
+    }
+}
+
+void ModelLoader::add_imgui_import_statistics_section() {
+    if (ImGui::CollapsingHeader("Model Import Statistics")) {
+        ImGui::Checkbox("Log Imports", &log_imports);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Also print each import's timings and memory use to the console");
+        }
+
+        ImportTimings total{};
+        uint from_cache = 0;
+        for (const auto& timings: import_history) {
+            total.read_ms += timings.read_ms;
+            total.convert_ms += timings.convert_ms;
+            total.upload_ms += timings.upload_ms;
+            if (timings.from_cache) from_cache++;
+        }
+
+        ImGui::Text("Imports: %zu (%u from cache)", import_history.size(), from_cache);
+        ImGui::Text("Total Read: %.1f ms", total.read_ms);
+        ImGui::Text("Total Convert: %.1f ms", total.convert_ms);
+        ImGui::Text("Total Upload: %.1f ms", total.upload_ms);
+        ImGui::Text("Total: %.1f ms", total.total_ms());
+
+        // Newest first
+        for (auto iter = import_history.rbegin(); iter != import_history.rend(); ++iter) {
+            const auto& timings = *iter;
+            ImGui::PushID(&timings);
+            if (ImGui::TreeNode("##import", "%s (%.1f ms)", timings.file.c_str(), timings.total_ms())) {
+                ImGui::Text("Profile: %s%s", ImportProfiles::get_name(timings.profile), timings.from_cache ? " (from cache)" : "");
+                ImGui::Text("Type: %s", timings.hierarchy ? "Hierarchy" : "Model");
+                ImGui::Text("Read: %.2f ms", timings.read_ms);
+                ImGui::Text("Convert: %.2f ms", timings.convert_ms);
+                ImGui::Text("Upload: %.2f ms", timings.upload_ms);
+                ImGui::TreePop();
+            }
+            ImGui::PopID();
+        }
+    }
+}
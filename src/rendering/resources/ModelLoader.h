@@ -1,8 +1,8 @@
 #ifndef MODEL_LOADER_H
 #define MODEL_LOADER_H
 
-#include <map>
-#include <set>
+#include <deque>
+#include <chrono>
 #include <utility>
 #include <vector>
 #include <memory>
@@ -21,65 +21,418 @@
 #include <imgui/imgui.h>
 
 #include "ModelHandle.h"
+#include "BoneWeights.h"
 #include "MeshHierarchy.h"
-
+#include "MeshSimplifier.h"
+#include "MeshOptimiser.h"
+#include "ModelCache.h"
+#include "PendingLoad.h"
+#include "ImportProfile.h"
+#include "ResidencyCache.h"
+#include "utility/ThreadPool.h"
+#include "utility/AssetRegistry.h"
+
+/// A view of one mesh's vertex attributes, pointing straight at the importer's arrays rather than copying them.
+/// Any attribute may be missing (null). The transform is applied as each vertex is read, so the arrays are never modified.
 struct VertexCollection {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> tex_coords;
+    uint vertex_count = 0;
+    const glm::vec3* positions = nullptr;
+    const glm::vec3* normals = nullptr;
+    // Assimp stores texture coordinates in 3D, only x and y are used
+    const glm::vec3* tex_coords = nullptr;
     // [(bone_weights, bone_indices)]
-    std::vector<std::pair<glm::vec4, glm::uvec4>> bones;
+    const std::pair<glm::vec4, glm::uvec4>* bones = nullptr;
+
+    glm::mat4 transform{1.0f};
+    // Transforms the normals, see ModelLoader::load_node
+    glm::mat3 normal_matrix{1.0f};
+
+    /// A view of the mesh, without any transform
+    static VertexCollection from_mesh(const aiMesh* mesh) {
+        VertexCollection vertex_collection{};
+        vertex_collection.vertex_count = mesh->mNumVertices;
+        vertex_collection.positions = reinterpret_cast<const glm::vec3*>(mesh->mVertices);
+        vertex_collection.normals = reinterpret_cast<const glm::vec3*>(mesh->mNormals);
+        vertex_collection.tex_coords = reinterpret_cast<const glm::vec3*>(mesh->mTextureCoords[0]);
+        return vertex_collection;
+    }
+
+    [[nodiscard]] glm::vec3 position(uint i) const {
+        return transform * glm::vec4(positions[i], 1.0f);
+    }
+
+    [[nodiscard]] glm::vec3 normal(uint i) const {
+        return normal_matrix * normals[i];
+    }
+
+    [[nodiscard]] glm::vec2 tex_coord(uint i) const {
+        return tex_coords[i];
+    }
 };
 
 /// A loader class intended for the use of loading models from disk. Includes caching functionality.
 class ModelLoader {
     std::string import_path;
-    Assimp::Importer importer{};
+    AssetRegistry& asset_registry;
 
     std::optional<std::vector<std::string>> available_models{};
+    // The asset registry's generation when available_models was listed
+    uint available_models_generation = 0;
+
+    // The vertex format newly loaded models are uploaded with
+    VertexFormat vertex_format = VertexFormat::Full;
+    // How the animations of newly loaded hierarchies are compressed
+    AnimationCompressionSettings animation_compression{};
+    // Whether processed models are saved to, and loaded from, binary caches beside the source files
+    bool use_model_cache = true;
+    // The profile for files without a sidecar, when a load doesn't ask for one
+    ImportProfile default_import_profile = ImportProfile::Quality;
+
+    // The most recent imports, newest last, shown by add_imgui_import_statistics_section
+    std::deque<ImportTimings> import_history{};
+    static constexpr size_t MAX_IMPORT_HISTORY = 64;
+    // Whether each import's timings and memory are also printed, rather than only kept in import_history
+    bool log_imports = false;
 
     // Map (relative_path, vertex_type) -> (last_modified, weak_handle)
     std::unordered_map<std::pair<std::string, std::type_index>, std::pair<std::filesystem::file_time_type, std::weak_ptr<BaseModelHandle>>, PairHash> cache{};
     std::unordered_map<std::pair<std::string, std::type_index>, std::pair<std::filesystem::file_time_type, std::weak_ptr<BaseMeshHierarchy>>, PairHash> hierarchy_cache{};
+    // Keeps the recently used models and hierarchies alive, keyed by (relative_path, resource_type)
+    ResidencyCache<std::pair<std::string, std::type_index>, PairHash> residency{DEFAULT_RESIDENCY_BUDGET};
+    // Map (relative_path, vertex_type) -> reloads the model in `cache` in place, when its file changes
+    std::unordered_map<std::pair<std::string, std::type_index>, std::function<void()>, PairHash> reloaders{};
+
+    // Async loads waiting on their worker, or for their turn to upload, in the order they were started
+    std::deque<std::shared_ptr<BasePendingLoad>> pending_loads{};
+    // Map (relative_path, resource_type) -> load in progress, so a file requested again while loading is only loaded once
+    std::unordered_map<std::pair<std::string, std::type_index>, std::weak_ptr<BasePendingLoad>, PairHash> in_flight{};
+
+    /// A model (or hierarchy) variable an ImGui selector is loading a file into, showing a placeholder until then
+    struct LoadingSlot {
+        uint64_t load_id;
+        std::string file;
+        std::weak_ptr<void> owner;
+        // What the slot held before the placeholder, restored if the load fails
+        std::shared_ptr<void> previous;
+    };
+    // Map slot_address -> the load it is waiting for
+    std::unordered_map<const void*, LoadingSlot> loading_slots{};
+    uint64_t last_load_id = 0;
+
+    // The GL time process_uploads may spend each frame, though it always completes at least one load
+    float upload_budget_ms = 2.0f;
+    uint uploads_last_frame = 0;
+    double upload_time_last_frame_ms = 0.0;
+
+    /// The settings a load uses, copied when it starts, so a load on a worker thread never reads the loader
+    struct LoadSettings {
+        VertexFormat vertex_format;
+        AnimationCompressionSettings animation_compression;
+        bool use_model_cache;
+        ImportProfile import_profile;
+    };
 public:
+    /// The maximum number of levels of detail generated for a model loaded with load_from_file, including the full detail level.
+    static constexpr uint MAX_LOD_LEVELS = 4;
+    /// Models (or levels) with fewer triangles than this are not simplified any further.
+    static constexpr uint MIN_LOD_TRIANGLES = 256;
+    /// Models with fewer triangles than this are culled as a whole, rather than being split into meshlets.
+    static constexpr uint MIN_MESHLET_TRIANGLES = 16384;
+    /// Shown by the ImGui selectors while the model selected is loading.
+    static constexpr const char* PLACEHOLDER_MODEL = "cube.obj";
+    /// The GPU memory the models kept loaded after they go unused may add up to, before the least recently used are freed.
+    static constexpr size_t DEFAULT_RESIDENCY_BUDGET = 256 * 1024 * 1024;
+
     /// Construct the loader with a import_path which is prepended to any path you try and load.
-    /// It also scans the directory for all files, which is used to populate the list of get_available_models()
-    explicit ModelLoader(std::string import_path) : import_path(std::move(import_path)) {}
+    /// Files are looked up in the asset_registry, which must cover import_path, and models are reloaded in place when their files change.
+    ModelLoader(std::string import_path, AssetRegistry& asset_registry);
 
     /// Loads the provided model data into GPU memory
     template<typename VertexData>
-    static std::shared_ptr<ModelHandle<VertexData>> load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename = {});
+    static std::shared_ptr<ModelHandle<VertexData>> load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename = {}, VertexFormat vertex_format = VertexFormat::Full);
+
+    /// Loads the provided model data into GPU memory, where indices contains each level of detail back to back, as described by lods.
+    template<typename VertexData>
+    static std::shared_ptr<ModelHandle<VertexData>> load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::vector<ModelLod> lods, std::optional<std::string> filename = {}, VertexFormat vertex_format = VertexFormat::Full);
 
-    /// Loads the file specified from disk into GPU memory
+    /// Loads the file specified from disk into GPU memory.
+    /// It is imported with `profile` if given, otherwise the profile in the file's sidecar, otherwise the default profile.
+    /// A file already in memory is returned as is, whichever profile it was imported with.
     template<typename VertexData>
-    std::shared_ptr<ModelHandle<VertexData>> load_from_file(const std::string& file);
+    std::shared_ptr<ModelHandle<VertexData>> load_from_file(const std::string& file, std::optional<ImportProfile> profile = std::nullopt);
 
     /// Load the file specified, as a hierarchy of meshes, for use with animated models.
     template<typename VertexData>
-    std::shared_ptr<MeshHierarchy<VertexData>> load_hierarchy_from_file(const std::string& file);
+    std::shared_ptr<MeshHierarchy<VertexData>> load_hierarchy_from_file(const std::string& file, std::optional<ImportProfile> profile = std::nullopt);
+
+    /// Starts loading the file in the background, without blocking the frame. The file is imported and processed on a worker
+    /// thread, then uploaded by process_uploads. Throws straight away if the file doesn't exist, any other error is
+    /// reported through the returned handle. If the model is already in memory, the handle is ready immediately.
+    template<typename VertexData>
+    std::shared_ptr<PendingLoad<ModelHandle<VertexData>>> load_from_file_async(const std::string& file, std::optional<ImportProfile> profile = std::nullopt);
+
+    /// The same as load_from_file_async, but loading the file as a hierarchy, like load_hierarchy_from_file.
+    template<typename VertexData>
+    std::shared_ptr<PendingLoad<MeshHierarchy<VertexData>>> load_hierarchy_from_file_async(const std::string& file, std::optional<ImportProfile> profile = std::nullopt);
+
+    /// Upload the async loads whose background work has finished, in the order they were started,
+    /// until upload_budget_ms has been spent, and trim the residency cache. Must be called on the GL thread, once per frame.
+    void process_uploads();
+
+    /// Complete every async load now, ignoring the budget and blocking until their background work is done.
+    /// For when every model is needed at once, such as when loading a scene.
+    void finish_all_loads();
 
     /// Helper method to provide a selector over all the model files in the import_path directory.
+    /// The model selected is loaded in the background, with model_handle set to a placeholder until it is ready.
+    /// `owner` must own model_handle (e.g. the entity it is in), the model is only assigned if the owner still exists.
     template<typename VertexData>
-    bool add_imgui_model_selector(const std::string& caption, std::shared_ptr<ModelHandle<VertexData>>& model_handle);
+    bool add_imgui_model_selector(const std::string& caption, std::shared_ptr<ModelHandle<VertexData>>& model_handle, const std::shared_ptr<void>& owner);
 
     /// Helper method to provide a selector over all the model files in the import_path directory, but to be loaded as a hierarchy.
+    /// Loads in the background the same as add_imgui_model_selector.
     template<typename VertexData>
-    bool add_imgui_hierarchy_selector(const std::string& caption, std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy);
+    bool add_imgui_hierarchy_selector(const std::string& caption, std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, const std::shared_ptr<void>& owner);
 
     /// Helper method to provide a selector over all the model files in the import_path directory.
-    /// if force_refresh is selected, it will rescan the directory, otherwise it just uses a cached list from the last scan.
-    const std::vector<std::string>& get_available_models(bool force_refresh = false);
-
-    /// Free up any resources.
-    void cleanup() {}
+    /// The list is rebuilt from the asset registry whenever a file has been added or removed since it was last built.
+    const std::vector<std::string>& get_available_models();
+
+    /// Adds the ImGUI controls for the loader's settings, and a summary of the memory used by the loaded models
+    void add_imgui_options_section();
+
+    /// Adds an ImGUI section with the time spent in each stage of the most recent imports
+    void add_imgui_import_statistics_section();
+
+    /// Free up any resources. Async loads still in progress are abandoned.
+    void cleanup() {
+        pending_loads.clear();
+        in_flight.clear();
+        loading_slots.clear();
+        reloaders.clear();
+        residency.clear();
+    }
 
 private:
+    // Writes and reads models in the cache format directly, to check that corrupt caches are rejected
+    friend struct ModelCacheTests;
+
+    /// A model's vertices and indices in the layout they are uploaded with, along with what is needed to draw them.
+    /// Building one needs no GL context, so it can be done on a worker thread.
+    struct PreparedModel {
+        ModelLayout layout{};
+        BoundingSphere bounds{};
+        std::vector<ModelLod> lods{};
+        std::vector<Meshlet> meshlets{};
+        std::vector<unsigned char> vertex_bytes{};
+        std::vector<unsigned char> index_bytes{};
+        // When read from a cache, the buffers are used in place in the mapped file, rather than copied into the vectors above
+        std::shared_ptr<const MappedFile> mapped_file{};
+        size_t mapped_vertex_offset = 0;
+        size_t mapped_index_offset = 0;
+        // Everything but upload_ms, which is filled in by finish_model
+        ImportTimings timings{};
+
+        [[nodiscard]] const void* get_vertex_data() const {
+            return mapped_file ? mapped_file->get_data() + mapped_vertex_offset : vertex_bytes.data();
+        }
+
+        [[nodiscard]] const void* get_index_data() const {
+            return mapped_file ? mapped_file->get_data() + mapped_index_offset : index_bytes.data();
+        }
+    };
+
+    /// A hierarchy that is complete, apart from the model of each of its meshes, which are uploaded from `meshes`
+    template<typename VertexData>
+    struct PreparedHierarchy {
+        std::shared_ptr<MeshHierarchy<VertexData>> mesh_hierarchy;
+        // [mesh_id] -> the mesh's model
+        std::vector<PreparedModel> meshes;
+        ImportTimings timings{};
+    };
+
+    /// The settings to load the file at `path` with, resolving its profile from `profile`, its sidecar, or the default
+    [[nodiscard]] LoadSettings get_load_settings(const std::string& path, std::optional<ImportProfile> profile) const;
+
+    /// Add an import to the history, and print its timings
+    void record_import(const ImportTimings& timings);
+
+    /// When the file was last written, according to the asset registry. Throws if it doesn't exist.
+    [[nodiscard]] std::filesystem::file_time_type get_last_write_time(const std::string& file) const;
+
+    /// Reload the models whose files (or sidecars) changed, called by the asset registry
+    void on_files_changed(const std::vector<std::string>& changed_files);
+
+    /// Re-import the file in the background, then swap the result into `model`, so everything using it sees the new version.
+    /// `profile` is the one the model was first loaded with, if any, otherwise the sidecar or default is looked up again.
+    template<typename VertexData>
+    void reload_model(const std::string& file, std::optional<ImportProfile> profile, const std::weak_ptr<ModelHandle<VertexData>>& model);
+
+    /// Assimp::Importer isn't thread safe, so each thread imports with its own
+    static Assimp::Importer& get_importer();
+
+    /// The in memory copy of the file, if it is still loaded, up to date, and in `vertex_format`.
+    /// Counts towards the residency hits, and marks the model as just used. Callers count the miss or join, which depends on
+    /// whether they then find the file already loading.
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> find_cached_model(const std::string& file, std::filesystem::file_time_type last_write_time);
+
+    template<typename VertexData>
+    std::shared_ptr<MeshHierarchy<VertexData>> find_cached_hierarchy(const std::string& file, std::filesystem::file_time_type last_write_time);
+
+    /// The GPU memory used by the buffers of a model, or all the meshes of a hierarchy, as counted against the residency budget
+    static size_t get_resident_bytes(const BaseModelHandle& model);
+    static size_t get_resident_bytes(const BaseMeshHierarchy& mesh_hierarchy);
+
+    /// Everything in loading a model that doesn't need the GL context: reading its cache, or otherwise importing and processing
+    /// the file, then writing its cache. Touches nothing in the loader, so can run on any thread.
+    template<typename VertexData>
+    static PreparedModel prepare_model_from_file(const std::string& import_path, const std::string& file, const LoadSettings& settings);
+
+    template<typename VertexData>
+    static PreparedHierarchy<VertexData> prepare_hierarchy_from_file(const std::string& import_path, const std::string& file, const LoadSettings& settings);
+
+    /// The GL thread half of load_from_file, uploading the prepared model and adding it to the in memory cache,
+    /// along with a reloader that imports it again with the same requested `profile`
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> finish_model(const std::string& file, std::optional<ImportProfile> profile, std::filesystem::file_time_type last_write_time, const PreparedModel& prepared);
+
+    template<typename VertexData>
+    std::shared_ptr<MeshHierarchy<VertexData>> finish_hierarchy(const std::string& file, std::filesystem::file_time_type last_write_time, const PreparedHierarchy<VertexData>& prepared);
+
+    /// Queue `load` to be uploaded by process_uploads, and track it so the same file isn't loaded twice at once
+    template<typename Resource>
+    std::shared_ptr<PendingLoad<Resource>> start_async_load(const std::string& file, std::future<typename PendingLoad<Resource>::Upload> prepared);
+
+    /// The async load of `file` already in progress, if there is one
+    template<typename Resource>
+    std::shared_ptr<PendingLoad<Resource>> find_in_flight(const std::string& file) const;
+
+    /// Set `slot` to `placeholder` until `pending` is ready, then to the loaded resource, or back to what it was if the load fails.
+    /// Only assigns the loaded resource if `owner` still exists and no other file has since been selected into the slot.
+    template<typename Resource>
+    void load_into_slot(std::shared_ptr<Resource>& slot, const std::shared_ptr<void>& owner, const std::shared_ptr<PendingLoad<Resource>>& pending, std::shared_ptr<Resource> placeholder);
+
+    /// The name a selector shows for `slot`, which is "{file} (Loading)" while a file is loading into it
+    [[nodiscard]] std::optional<std::string> get_loading_name(const void* slot) const;
+
+    /// Compute the bounds and layout, and convert the vertices and indices to the format they are uploaded in
+    template<typename VertexData>
+    static PreparedModel prepare_model(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::vector<ModelLod> lods, VertexFormat vertex_format);
+
+    /// Create the buffers and vertex array for a prepared model
+    template<typename VertexData>
+    static std::shared_ptr<ModelHandle<VertexData>> upload_model(const PreparedModel& prepared, std::optional<std::string> filename);
+
+    /// Identifies the vertex type and every setting that changes what is cached, so a cache is only used if they all match
+    template<typename VertexData>
+    static uint64_t get_format_hash(const LoadSettings& settings, bool hierarchy);
+
+    static void write_model(BinaryWriter& writer, const PreparedModel& prepared);
+
+    /// Read a model written by write_model, leaving its buffers in place in the mapped file
+    static PreparedModel read_model(BinaryReader& reader, const std::shared_ptr<const MappedFile>& mapped_file);
+
+    template<typename VertexData>
+    static void write_hierarchy(BinaryWriter& writer, const MeshHierarchy<VertexData>& mesh_hierarchy, const std::vector<PreparedModel>& prepared_meshes);
+
+    template<typename VertexData>
+    static PreparedHierarchy<VertexData> read_hierarchy(BinaryReader& reader, const std::shared_ptr<const MappedFile>& mapped_file, const std::string& file);
+
+    /// Add up the vertices and indices load_node will produce for the node and its children
+    static void count_node_elements(const aiScene* scene, const aiNode* node, size_t& vertex_count, size_t& index_count);
+
     template<typename VertexData>
     static void load_node(const aiScene* scene, const aiNode* node, std::vector<VertexData>& vertices, std::vector<uint>& indices, glm::mat4 parent_transform);
+
+    /// Weld identical vertices, then reorder the triangles for the vertex cache and overdraw, and the vertices for fetching.
+    /// tests/MeshOptimiserTests.cpp checks the same steps never make the simulated vertex cache worse.
+    template<typename VertexData>
+    static void optimise_mesh(std::vector<VertexData>& vertices, std::vector<uint>& indices);
+
+    /// Print a summary of the model's GPU memory use, compared to the full vertex format and 32-bit indices
+    static void report_memory(const std::string& name, const BaseModelHandle& model);
+
+    /// Warn if an animation's error after compression is outside the tolerances, which tests/AnimationCompressionTests.cpp
+    /// checks can't happen for the tolerances it covers
+    static void check_animation_compression(const std::string& name, const AnimationCompressionStats& stats, const AnimationCompressionSettings& settings);
+
+    /// Generate the simplified levels of detail for a mesh, appending them to the end of indices.
+    static std::vector<ModelLod> generate_lods(const std::vector<glm::vec3>& positions, std::vector<uint>& indices);
 };
 
 template<typename VertexData>
-std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename) {
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename, VertexFormat vertex_format) {
+    return load_from_data(vertices, indices, {ModelLod{0, (int) indices.size()}}, std::move(filename), vertex_format);
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::vector<ModelLod> lods, std::optional<std::string> filename, VertexFormat vertex_format) {
+    return upload_model<VertexData>(prepare_model(vertices, indices, std::move(lods), vertex_format), std::move(filename));
+}
+
+template<typename VertexData>
+ModelLoader::PreparedModel ModelLoader::prepare_model(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::vector<ModelLod> lods, VertexFormat vertex_format) {
+    PreparedModel prepared{};
+    prepared.lods = std::move(lods);
+
+    // Bounding box, used for the bounding sphere and position quantisation
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+    if (!vertices.empty()) {
+        min = vertices[0].position;
+        max = vertices[0].position;
+        for (const auto& vertex: vertices) {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+    }
+
+    // Bounding sphere, centred on the bounding box
+    prepared.bounds = BoundingSphere{(min + max) * 0.5f, 0.0f};
+    for (const auto& vertex: vertices) {
+        prepared.bounds.radius = std::max(prepared.bounds.radius, glm::distance(prepared.bounds.centre, vertex.position));
+    }
+
+    auto& layout = prepared.layout;
+    layout.vertex_format = vertex_format;
+    layout.full_vertex_stride = sizeof(VertexData);
+    layout.vertex_count = (uint) vertices.size();
+    // 16-bit indices are enough to address every vertex, so use them to halve the index buffer
+    layout.index_type = vertices.size() < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    layout.index_total = (uint) indices.size();
+
+    if (vertex_format == VertexFormat::Packed) {
+        layout.dequantisation = PositionDequantisation::from_bounds(min, max);
+        layout.vertex_stride = sizeof(typename VertexData::Packed);
+        prepared.vertex_bytes.resize(layout.vertex_bytes());
+        auto* packed_vertices = reinterpret_cast<typename VertexData::Packed*>(prepared.vertex_bytes.data());
+        for (auto i = 0u; i < vertices.size(); ++i) {
+            packed_vertices[i] = VertexData::pack(vertices[i], layout.dequantisation);
+        }
+    } else {
+        layout.vertex_stride = sizeof(VertexData);
+        prepared.vertex_bytes.resize(layout.vertex_bytes());
+        std::memcpy(prepared.vertex_bytes.data(), vertices.data(), layout.vertex_bytes());
+    }
+
+    prepared.index_bytes.resize(layout.index_bytes());
+    if (layout.index_type == GL_UNSIGNED_SHORT) {
+        auto* short_indices = reinterpret_cast<uint16_t*>(prepared.index_bytes.data());
+        for (auto i = 0u; i < indices.size(); ++i) {
+            short_indices[i] = (uint16_t) indices[i];
+        }
+    } else {
+        std::memcpy(prepared.index_bytes.data(), indices.data(), layout.index_bytes());
+    }
+
+    return prepared;
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::upload_model(const PreparedModel& prepared, std::optional<std::string> filename) {
+    const auto& layout = prepared.layout;
+
     uint vao;
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
@@ -87,39 +440,269 @@ std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const std::
     uint vertex_vbo;
     glGenBuffers(1, &vertex_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
-    glBufferData(GL_ARRAY_BUFFER, (long) (sizeof(VertexData) * vertices.size()), vertices.data(), GL_STATIC_DRAW);
-    VertexData::setup_attrib_pointers();
+    glBufferData(GL_ARRAY_BUFFER, (long) layout.vertex_bytes(), prepared.get_vertex_data(), GL_STATIC_DRAW);
+    VertexData::setup_attrib_pointers(layout.vertex_format);
 
     uint index_vbo;
     glGenBuffers(1, &index_vbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (long) (sizeof(uint) * indices.size()), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (long) layout.index_bytes(), prepared.get_index_data(), GL_STATIC_DRAW);
 
     glBindVertexArray(0);
 
-    return std::make_shared<ModelHandle<VertexData>>(vertex_vbo, index_vbo, vao, (int) indices.size(), 0, std::move(filename));
+    auto model = std::make_shared<ModelHandle<VertexData>>(vertex_vbo, index_vbo, vao, prepared.lods, prepared.bounds, layout, 0, std::move(filename));
+    model->set_meshlets(prepared.meshlets);
+    return model;
 }
 
 template<typename VertexData>
-std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file(const std::string& file) {
-    auto path = import_path + "/" + file;
-    if (!std::filesystem::exists(path)) {
-        throw std::runtime_error(Formatter() << "Failed to load model (" << path << "): \n\t File does not exist");
+uint64_t ModelLoader::get_format_hash(const LoadSettings& settings, bool hierarchy) {
+    const auto& compression = settings.animation_compression;
+    Formatter description{};
+    description << ModelCache::VERSION << " " << typeid(VertexData).name() << " " << sizeof(VertexData) << " " << sizeof(typename VertexData::Packed)
+                << " " << (int) settings.vertex_format << " " << (int) settings.import_profile << " " << MAX_LOD_LEVELS << " " << MIN_LOD_TRIANGLES << " " << MIN_MESHLET_TRIANGLES;
+    if (hierarchy) {
+        description << " hierarchy " << compression.reduce_keys << " " << compression.position_tolerance
+                    << " " << compression.rotation_tolerance << " " << compression.scaling_tolerance;
     }
+    return ModelCache::hash(description);
+}
 
-    auto last_write_time = std::filesystem::last_write_time(path);
+template<typename VertexData>
+void ModelLoader::write_hierarchy(BinaryWriter& writer, const MeshHierarchy<VertexData>& mesh_hierarchy, const std::vector<PreparedModel>& prepared_meshes) {
+    writer.write((uint64_t) mesh_hierarchy.meshes.size());
+    for (auto mesh_id = 0u; mesh_id < mesh_hierarchy.meshes.size(); ++mesh_id) {
+        write_model(writer, prepared_meshes[mesh_id]);
+        writer.write((uint64_t) mesh_hierarchy.meshes[mesh_id].bones.size());
+        for (const auto& [name, bone_id]: mesh_hierarchy.meshes[mesh_id].bones) {
+            writer.write_string(name);
+            writer.write(bone_id);
+        }
+    }
+
+    writer.write((uint64_t) mesh_hierarchy.total_bones.size());
+    for (const auto& [name, bones]: mesh_hierarchy.total_bones) {
+        writer.write_string(name);
+        writer.write((uint64_t) bones.size());
+        for (const auto& [mesh_id, bone_id, offset_matrix]: bones) {
+            writer.write(mesh_id);
+            writer.write(bone_id);
+            writer.write(offset_matrix);
+        }
+    }
+
+    writer.write((uint64_t) mesh_hierarchy.animations.size());
+    for (const auto& [name, ticks_per_second, duration_ticks]: mesh_hierarchy.animations) {
+        writer.write_string(name);
+        writer.write(ticks_per_second);
+        writer.write(duration_ticks);
+    }
+
+    writer.write_vector(mesh_hierarchy.node_parents);
+    writer.write_vector(mesh_hierarchy.node_transforms);
+    writer.write((uint64_t) mesh_hierarchy.mesh_draws.size());
+    for (const auto& [node, mesh_id]: mesh_hierarchy.mesh_draws) {
+        writer.write(node);
+        writer.write(mesh_id);
+    }
+    writer.write_vector(mesh_hierarchy.bone_bindings);
+
+    writer.write_vector(mesh_hierarchy.channel_indices);
+    writer.write((uint64_t) mesh_hierarchy.channels.size());
+    for (const auto& channel: mesh_hierarchy.channels) {
+        writer.write(channel.start_time);
+        writer.write(channel.time_scale);
+        writer.write_vector(channel.position_times);
+        writer.write_vector(channel.positions);
+        writer.write_vector(channel.rotation_times);
+        writer.write_vector(channel.rotations);
+        writer.write_vector(channel.scaling_times);
+        writer.write_vector(channel.scalings);
+    }
+}
+
+template<typename VertexData>
+ModelLoader::PreparedHierarchy<VertexData> ModelLoader::read_hierarchy(BinaryReader& reader, const std::shared_ptr<const MappedFile>& mapped_file, const std::string& file) {
+    PreparedHierarchy<VertexData> prepared{std::make_shared<MeshHierarchy<VertexData>>(file), {}};
+    auto& mesh_hierarchy = prepared.mesh_hierarchy;
+
+    auto mesh_count = reader.read<uint64_t>();
+    for (auto mesh_id = 0u; mesh_id < mesh_count; ++mesh_id) {
+        prepared.meshes.push_back(read_model(reader, mapped_file));
+        std::unordered_map<std::string, uint> bones{};
+        auto bone_count = reader.read<uint64_t>();
+        for (auto i = 0u; i < bone_count; ++i) {
+            auto name = reader.read_string();
+            bones[name] = reader.read<uint>();
+        }
+        // Poses size each mesh's bone transforms by its bone count, so every id must index into that
+        for (const auto& [name, bone_id]: bones) {
+            if (bone_id >= bones.size()) throw std::runtime_error("Bone id out of range");
+        }
+        // The model is uploaded later, by finish_hierarchy
+        mesh_hierarchy->meshes.push_back(ModelInfo<VertexData>{nullptr, bones});
+    }
+
+    auto total_bone_count = reader.read<uint64_t>();
+    for (auto i = 0u; i < total_bone_count; ++i) {
+        auto& bones = mesh_hierarchy->total_bones[reader.read_string()];
+        auto count = reader.read<uint64_t>();
+        for (auto j = 0u; j < count; ++j) {
+            auto mesh_id = reader.read<uint>();
+            auto bone_id = reader.read<uint>();
+            if (mesh_id >= mesh_count || bone_id >= mesh_hierarchy->meshes[mesh_id].bones.size()) {
+                throw std::runtime_error("Bone out of range");
+            }
+            bones.emplace_back(mesh_id, bone_id, reader.read<glm::mat4>());
+        }
+    }
+
+    auto animation_count = reader.read<uint64_t>();
+    for (auto i = 0u; i < animation_count; ++i) {
+        auto name = reader.read_string();
+        auto ticks_per_second = reader.read<double>();
+        mesh_hierarchy->animations.emplace_back(name, ticks_per_second, reader.read<double>());
+    }
+
+    mesh_hierarchy->node_parents = reader.read_vector<int>();
+    mesh_hierarchy->node_transforms = reader.read_vector<glm::mat4>();
+    auto draw_count = reader.read<uint64_t>();
+    for (auto i = 0u; i < draw_count; ++i) {
+        auto node = reader.read<uint>();
+        mesh_hierarchy->mesh_draws.emplace_back(node, reader.read<uint>());
+    }
+    mesh_hierarchy->bone_bindings = reader.read_vector<BoneBinding>();
 
+    uint node_count = mesh_hierarchy->get_node_count();
+    if (mesh_hierarchy->node_transforms.size() != node_count) {
+        throw std::runtime_error("Node arrays have different lengths");
+    }
+    for (auto node = 0u; node < node_count; ++node) {
+        auto parent = mesh_hierarchy->node_parents[node];
+        if (parent >= (int) node) throw std::runtime_error("Node parent after its child");
+        if (parent < -1) throw std::runtime_error("Node parent out of range");
+    }
+    for (const auto& [node, mesh_id]: mesh_hierarchy->mesh_draws) {
+        if (node >= node_count || mesh_id >= mesh_count) throw std::runtime_error("Mesh draw out of range");
+    }
+    for (const auto& bone: mesh_hierarchy->bone_bindings) {
+        if (bone.node >= node_count || bone.mesh_id >= mesh_count || bone.bone_id >= mesh_hierarchy->meshes[bone.mesh_id].bones.size()) {
+            throw std::runtime_error("Bone binding out of range");
+        }
+    }
+    mesh_hierarchy->finalise_nodes();
+
+    mesh_hierarchy->channel_indices = reader.read_vector<uint>();
+    auto channel_count = reader.read<uint64_t>();
+    for (auto i = 0u; i < channel_count; ++i) {
+        auto& channel = mesh_hierarchy->channels.emplace_back();
+        channel.start_time = reader.read<float>();
+        channel.time_scale = reader.read<float>();
+        channel.position_times = reader.read_vector<uint16_t>();
+        channel.positions = reader.read_vector<glm::vec3>();
+        channel.rotation_times = reader.read_vector<uint16_t>();
+        channel.rotations = reader.read_vector<QuantisedQuat>();
+        channel.scaling_times = reader.read_vector<uint16_t>();
+        channel.scalings = reader.read_vector<glm::vec3>();
+        if (channel.position_times.size() != channel.positions.size() || channel.rotation_times.size() != channel.rotations.size() || channel.scaling_times.size() != channel.scalings.size()) {
+            throw std::runtime_error("Animation channel arrays have different lengths");
+        }
+    }
+    if (mesh_hierarchy->channel_indices.size() != animation_count * node_count) {
+        throw std::runtime_error("Channel indices don't match the nodes and animations");
+    }
+    for (auto channel: mesh_hierarchy->channel_indices) {
+        if (channel != MeshHierarchy<VertexData>::NO_CHANNEL && channel >= channel_count) throw std::runtime_error("Channel index out of range");
+    }
+
+    return prepared;
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::find_cached_model(const std::string& file, std::filesystem::file_time_type last_write_time) {
     auto existing = cache.find({file, std::type_index(typeid(VertexData))});
     if (existing != cache.end()) {
         // Cache exist, so try lock
         auto handle = existing->second.second.lock();
-        if (handle != nullptr && existing->second.first >= last_write_time) {
+        if (handle != nullptr && existing->second.first >= last_write_time && handle->get_layout().vertex_format == vertex_format) {
             // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            residency.record_hit();
+            residency.touch({file, std::type_index(typeid(ModelHandle<VertexData>))}, handle, get_resident_bytes(*handle));
             return std::dynamic_pointer_cast<ModelHandle<VertexData>>(handle);
         }
     }
+    return nullptr;
+}
 
-    const aiScene* scene = importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType);
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file(const std::string& file, std::optional<ImportProfile> profile) {
+    auto path = import_path + "/" + file;
+    auto last_write_time = get_last_write_time(file);
+    if (auto model = find_cached_model<VertexData>(file, last_write_time)) {
+        return model;
+    }
+    residency.record_miss();
+
+    auto prepared = prepare_model_from_file<VertexData>(import_path, file, get_load_settings(path, profile));
+    return finish_model<VertexData>(file, profile, last_write_time, prepared);
+}
+
+template<typename VertexData>
+std::shared_ptr<PendingLoad<ModelHandle<VertexData>>> ModelLoader::load_from_file_async(const std::string& file, std::optional<ImportProfile> profile) {
+    using Pending = PendingLoad<ModelHandle<VertexData>>;
+
+    auto path = import_path + "/" + file;
+    auto last_write_time = get_last_write_time(file);
+    if (auto model = find_cached_model<VertexData>(file, last_write_time)) {
+        return std::make_shared<Pending>(file, model);
+    }
+    if (auto pending = find_in_flight<ModelHandle<VertexData>>(file)) {
+        residency.record_join();
+        return pending;
+    }
+    residency.record_miss();
+
+    auto prepared = ThreadPool::global().submit([this, import_path = import_path, file, profile, settings = get_load_settings(path, profile), last_write_time]() -> typename Pending::Upload {
+        auto prepared = std::make_shared<PreparedModel>(prepare_model_from_file<VertexData>(import_path, file, settings));
+        // Only the returned upload uses the loader, and it runs on the GL thread
+        return [this, file, profile, last_write_time, prepared]() {
+            return finish_model<VertexData>(file, profile, last_write_time, *prepared);
+        };
+    });
+    return start_async_load<ModelHandle<VertexData>>(file, std::move(prepared));
+}
+
+template<typename VertexData>
+ModelLoader::PreparedModel ModelLoader::prepare_model_from_file(const std::string& import_path, const std::string& file, const LoadSettings& settings) {
+    auto path = import_path + "/" + file;
+
+    ImportTimings timings{file, settings.import_profile, false};
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto cache_header = ModelCache::make_header(path, get_format_hash<VertexData>(settings, false));
+    auto cache_path = ModelCache::get_cache_path(import_path, file, cache_header.format_hash);
+    if (settings.use_model_cache) {
+        try {
+            if (std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, cache_header)) {
+                BinaryReader reader{mapped->get_data(), mapped->get_size(), sizeof(ModelCache::Header)};
+                auto prepared = read_model(reader, mapped);
+                prepared.timings = timings;
+                prepared.timings.from_cache = true;
+                prepared.timings.read_ms = elapsed_ms();
+                return prepared;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Ignoring model cache (" << cache_path << "): " << e.what() << std::endl;
+        }
+    }
+
+    auto& importer = get_importer();
+    const aiScene* scene = importer.ReadFile(path, ImportProfiles::get_assimp_flags(settings.import_profile));
+    timings.read_ms = elapsed_ms();
+    start = std::chrono::steady_clock::now();
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << importer.GetErrorString());
@@ -140,20 +723,102 @@ std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file(const std::
         throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << "No triangle meshes");
     }
 
+    // Sized up front, so each mesh is written straight into place
+    size_t vertex_count = 0;
+    size_t index_count = 0;
+    count_node_elements(scene, scene->mRootNode, vertex_count, index_count);
     std::vector<VertexData> vertices{};
     std::vector<uint> indices{};
+    vertices.reserve(vertex_count);
+    indices.reserve(index_count);
 
     load_node(scene, scene->mRootNode, vertices, indices, glm::mat4{1.0f});
 
-    auto model = load_from_data(vertices, indices, file);
-
     importer.FreeScene();
 
+    optimise_mesh(vertices, indices);
+
+    // Keep a copy of just the positions, for generating levels of detail
+    std::vector<glm::vec3> positions{};
+    positions.reserve(vertices.size());
+    for (const auto& vertex: vertices) {
+        positions.push_back(vertex.position);
+    }
+
+    auto lods = generate_lods(positions, indices);
+    auto full_index_count = (uint) lods[0].index_count;
+
+    auto prepared = prepare_model(vertices, indices, std::move(lods), settings.vertex_format);
+    if (full_index_count / 3 >= MIN_MESHLET_TRIANGLES) {
+        prepared.meshlets = Meshlets::build(positions, indices, full_index_count);
+    }
+
+    if (settings.use_model_cache) {
+        BinaryWriter writer{};
+        writer.write(cache_header);
+        write_model(writer, prepared);
+        ModelCache::save(cache_path, writer);
+    }
+
+    timings.convert_ms = elapsed_ms();
+    prepared.timings = timings;
+    return prepared;
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::finish_model(const std::string& file, std::optional<ImportProfile> profile, std::filesystem::file_time_type last_write_time, const PreparedModel& prepared) {
+    auto start = std::chrono::steady_clock::now();
+    auto model = upload_model<VertexData>(prepared, file);
+    auto timings = prepared.timings;
+    timings.upload_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    record_import(timings);
+    if (log_imports) report_memory(file, *model);
+
     cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, model};
+    residency.touch({file, std::type_index(typeid(ModelHandle<VertexData>))}, model, get_resident_bytes(*model));
+    reloaders[{file, std::type_index(typeid(VertexData))}] = [this, file, profile, weak_model = std::weak_ptr<ModelHandle<VertexData>>(model)]() {
+        reload_model<VertexData>(file, profile, weak_model);
+    };
 
     return model;
 }
 
+template<typename VertexData>
+void ModelLoader::reload_model(const std::string& file, std::optional<ImportProfile> profile, const std::weak_ptr<ModelHandle<VertexData>>& model) {
+    using Pending = PendingLoad<ModelHandle<VertexData>>;
+
+    auto path = import_path + "/" + file;
+    auto last_write_time = asset_registry.get_last_write_time(path);
+    // Deleted files are left as they were
+    if (!last_write_time.has_value() || model.expired()) return;
+
+    auto prepared = ThreadPool::global().submit([this, import_path = import_path, file, settings = get_load_settings(path, profile), last_write_time = last_write_time.value(), model]() -> typename Pending::Upload {
+        auto prepared = std::make_shared<PreparedModel>(prepare_model_from_file<VertexData>(import_path, file, settings));
+        // Only the returned upload uses the loader, and it runs on the GL thread
+        return [this, file, last_write_time, prepared, model]() -> std::shared_ptr<ModelHandle<VertexData>> {
+            auto existing = model.lock();
+            if (existing == nullptr) return nullptr;
+
+            // The old buffers are freed along with `reloaded`
+            auto reloaded = upload_model<VertexData>(*prepared, file);
+            existing->swap_buffers(*reloaded);
+            cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, existing};
+            residency.touch({file, std::type_index(typeid(ModelHandle<VertexData>))}, existing, get_resident_bytes(*existing));
+            return existing;
+        };
+    });
+
+    // Not tracked as in flight, since it completes to the existing handle rather than a new one
+    auto pending = std::make_shared<Pending>(file, std::move(prepared));
+    pending->on_ready([](const Pending& loaded) {
+        if (loaded.get_error().has_value()) {
+            std::cerr << "Error while trying to reload model file:" << std::endl;
+            std::cerr << loaded.get_error().value() << std::endl;
+        }
+    });
+    pending_loads.push_back(pending);
+}
+
 template<typename VertexData>
 void ModelLoader::load_node(const aiScene* scene, const aiNode* node, std::vector<VertexData>& vertices, std::vector<uint>& indices, glm::mat4 parent_transform) {
     glm::mat4 node_transform;
@@ -178,29 +843,16 @@ void ModelLoader::load_node(const aiScene* scene, const aiNode* node, std::vecto
         const auto mesh = scene->mMeshes[node->mMeshes[mesh_i]];
         if ((mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) == 0) continue;
 
-        const auto v = reinterpret_cast<glm::vec3*>(mesh->mVertices);
-        const auto n = reinterpret_cast<glm::vec3*>(mesh->mNormals);
-        const auto t = reinterpret_cast<glm::vec3*>(mesh->mTextureCoords[0]);
-
-        VertexCollection vertex_collection{
-            v ? std::vector<glm::vec3>{v, v + mesh->mNumVertices} : std::vector<glm::vec3>{},
-            n ? std::vector<glm::vec3>{n, n + mesh->mNumVertices} : std::vector<glm::vec3>{},
-            t ? std::vector<glm::vec2>{t, t + mesh->mNumVertices} : std::vector<glm::vec2>{},
-            {}
-        };
-
-        for (auto& position: vertex_collection.positions) {
-            position = total_transform * glm::vec4(position, 1.0f);
-        }
-
-        for (auto& normal: vertex_collection.normals) {
-            normal = normal_matrix * normal;
-        }
+        auto vertex_collection = VertexCollection::from_mesh(mesh);
+        vertex_collection.transform = total_transform;
+        vertex_collection.normal_matrix = normal_matrix;
 
-        VertexData::from_mesh(vertex_collection, vertices);
+        // Within the capacity reserved from count_node_elements, so never reallocates
+        vertices.resize(vertices.size() + mesh->mNumVertices);
+        VertexData::from_mesh(vertex_collection, vertices.data() + index_offset);
 
         for (auto i = 0u; i < mesh->mNumFaces; ++i) {
-            aiFace face = mesh->mFaces[i];
+            const aiFace& face = mesh->mFaces[i];
             for (auto j = 0u; j < face.mNumIndices; j++) {
                 indices.push_back(face.mIndices[j] + index_offset);
             }
@@ -213,24 +865,112 @@ void ModelLoader::load_node(const aiScene* scene, const aiNode* node, std::vecto
 }
 
 template<typename VertexData>
-std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file(const std::string& file) {
-    auto path = import_path + "/" + file;
-    if (!std::filesystem::exists(path)) {
-        throw std::runtime_error(Formatter() << "Failed to load model (" << path << "): \n\t File does not exist");
+void ModelLoader::optimise_mesh(std::vector<VertexData>& vertices, std::vector<uint>& indices) {
+    std::vector<uint> remap{};
+    uint unique_vertices = MeshOptimiser::generate_weld_remap(vertices.data(), (uint) vertices.size(), sizeof(VertexData), remap);
+    MeshOptimiser::remap_indices(indices, remap);
+    MeshOptimiser::remap_vertices(vertices, remap, unique_vertices);
+
+    std::vector<uint> clusters{};
+    MeshOptimiser::optimise_vertex_cache(indices, (uint) vertices.size(), &clusters);
+
+    std::vector<glm::vec3> positions{};
+    positions.reserve(vertices.size());
+    for (const auto& vertex: vertices) {
+        positions.push_back(vertex.position);
     }
-    auto last_write_time = std::filesystem::last_write_time(path);
+    MeshOptimiser::optimise_overdraw(indices, positions, clusters);
 
+    uint used_vertices = MeshOptimiser::generate_vertex_fetch_remap(indices, (uint) vertices.size(), remap);
+    MeshOptimiser::remap_indices(indices, remap);
+    MeshOptimiser::remap_vertices(vertices, remap, used_vertices);
+}
+
+template<typename VertexData>
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::find_cached_hierarchy(const std::string& file, std::filesystem::file_time_type last_write_time) {
     auto existing = hierarchy_cache.find({file, std::type_index(typeid(VertexData))});
     if (existing != hierarchy_cache.end()) {
         // Cache exist, so try lock
         auto handle = existing->second.second.lock();
-        if (handle != nullptr && existing->second.first >= last_write_time) {
+        if (handle != nullptr && existing->second.first >= last_write_time && handle->get_vertex_format() == vertex_format) {
             // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            residency.record_hit();
+            residency.touch({file, std::type_index(typeid(MeshHierarchy<VertexData>))}, handle, get_resident_bytes(*handle));
             return std::dynamic_pointer_cast<MeshHierarchy<VertexData>>(handle);
         }
     }
+    return nullptr;
+}
+
+template<typename VertexData>
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file(const std::string& file, std::optional<ImportProfile> profile) {
+    auto path = import_path + "/" + file;
+    auto last_write_time = get_last_write_time(file);
+    if (auto mesh_hierarchy = find_cached_hierarchy<VertexData>(file, last_write_time)) {
+        return mesh_hierarchy;
+    }
+    residency.record_miss();
+
+    auto prepared = prepare_hierarchy_from_file<VertexData>(import_path, file, get_load_settings(path, profile));
+    return finish_hierarchy<VertexData>(file, last_write_time, prepared);
+}
+
+template<typename VertexData>
+std::shared_ptr<PendingLoad<MeshHierarchy<VertexData>>> ModelLoader::load_hierarchy_from_file_async(const std::string& file, std::optional<ImportProfile> profile) {
+    using Pending = PendingLoad<MeshHierarchy<VertexData>>;
+
+    auto path = import_path + "/" + file;
+    auto last_write_time = get_last_write_time(file);
+    if (auto mesh_hierarchy = find_cached_hierarchy<VertexData>(file, last_write_time)) {
+        return std::make_shared<Pending>(file, mesh_hierarchy);
+    }
+    if (auto pending = find_in_flight<MeshHierarchy<VertexData>>(file)) {
+        residency.record_join();
+        return pending;
+    }
+    residency.record_miss();
+
+    auto prepared = ThreadPool::global().submit([this, import_path = import_path, file, settings = get_load_settings(path, profile), last_write_time]() -> typename Pending::Upload {
+        auto prepared = std::make_shared<PreparedHierarchy<VertexData>>(prepare_hierarchy_from_file<VertexData>(import_path, file, settings));
+        // Only the returned upload uses the loader, and it runs on the GL thread
+        return [this, file, last_write_time, prepared]() {
+            return finish_hierarchy<VertexData>(file, last_write_time, *prepared);
+        };
+    });
+    return start_async_load<MeshHierarchy<VertexData>>(file, std::move(prepared));
+}
+
+template<typename VertexData>
+ModelLoader::PreparedHierarchy<VertexData> ModelLoader::prepare_hierarchy_from_file(const std::string& import_path, const std::string& file, const LoadSettings& settings) {
+    auto path = import_path + "/" + file;
+
+    ImportTimings timings{file, settings.import_profile, true};
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto cache_header = ModelCache::make_header(path, get_format_hash<VertexData>(settings, true));
+    auto cache_path = ModelCache::get_cache_path(import_path, file, cache_header.format_hash);
+    if (settings.use_model_cache) {
+        try {
+            if (std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, cache_header)) {
+                BinaryReader reader{mapped->get_data(), mapped->get_size(), sizeof(ModelCache::Header)};
+                auto prepared = read_hierarchy<VertexData>(reader, mapped, file);
+                prepared.timings = timings;
+                prepared.timings.from_cache = true;
+                prepared.timings.read_ms = elapsed_ms();
+                return prepared;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Ignoring model cache (" << cache_path << "): " << e.what() << std::endl;
+        }
+    }
 
-    const aiScene* scene = importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType);
+    auto& importer = get_importer();
+    const aiScene* scene = importer.ReadFile(path, ImportProfiles::get_assimp_flags(settings.import_profile));
+    timings.read_ms = elapsed_ms();
+    start = std::chrono::steady_clock::now();
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << importer.GetErrorString());
@@ -240,10 +980,13 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
         throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << "No meshes");
     }
 
-    auto mesh_hierarchy = std::make_shared<MeshHierarchy<VertexData>>(file);
+    PreparedHierarchy<VertexData> prepared_hierarchy{std::make_shared<MeshHierarchy<VertexData>>(file), {}};
+    auto& mesh_hierarchy = prepared_hierarchy.mesh_hierarchy;
 
     // {index into scene->mMeshes} -> {index into mesh_hierarchy->models}
     std::unordered_map<uint, uint> mesh_index_map{};
+    // [mesh_id] -> the mesh as it will be uploaded
+    auto& prepared_meshes = prepared_hierarchy.meshes;
 
     for (auto mesh_i = 0u; mesh_i < scene->mNumMeshes; ++mesh_i) {
         const auto* mesh = scene->mMeshes[mesh_i];
@@ -251,57 +994,24 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
             continue;
         }
 
-        const auto v = reinterpret_cast<glm::vec3*>(mesh->mVertices);
-        const auto n = reinterpret_cast<glm::vec3*>(mesh->mNormals);
-        const auto t = reinterpret_cast<glm::vec3*>(mesh->mTextureCoords[0]);
-
         // { bone_name } -> { bone_id }
         std::unordered_map<std::string, uint> bone_names{};
 
-        // [vertex_id] -> (bone_weight -> bone_id)
-        std::vector<std::map<float, std::set<uint>>> bone_weights_total{};
-        bone_weights_total.resize(mesh->mNumVertices, {});
         for (auto bone_i = 0u; bone_i < mesh->mNumBones; ++bone_i) {
             const auto* bone = mesh->mBones[bone_i];
             bone_names[bone->mName.C_Str()] = bone_i;
             auto ai_offset_matrix = bone->mOffsetMatrix;
             mesh_hierarchy->total_bones[bone->mName.C_Str()].push_back({mesh_i, bone_i, reinterpret_cast<glm::mat4&>(ai_offset_matrix.Transpose())});
-
-            for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
-                const auto* weight = &bone->mWeights[weight_i];
-                bone_weights_total[weight->mVertexId][weight->mWeight].insert(bone_i);
-            }
         }
 
-        // [vertex_id] -> ([bone_id; 4], [bone_weight; 4])
-        std::vector<std::pair<glm::vec4, glm::uvec4>> bone_weights;
-        bone_weights.resize(mesh->mNumVertices, {});
-        for (auto vert_i = 0u; vert_i < mesh->mNumVertices; ++vert_i) {
-            const auto& vert = bone_weights_total[vert_i];
-            auto i = 0;
-            for (auto iter = vert.rbegin(); i < 4 && iter != vert.rend(); ++iter) {
-                for (auto inner_iter = iter->second.begin(); i < 4 && inner_iter != iter->second.end(); ++inner_iter) {
-                    bone_weights[vert_i].first[i] = iter->first;
-                    bone_weights[vert_i].second[i] = *inner_iter;
-                    ++i;
-                }
-            }
-            float weight_sum = glm::compAdd(bone_weights[vert_i].first);
-            if (weight_sum != 0.0f) {
-                // Normalise the sum of the weights
-                bone_weights[vert_i].first /= weight_sum;
-            }
-        }
+        // [vertex_id] -> ([bone_weight; 4], [bone_id; 4])
+        auto bone_weights = BoneWeights::gather(mesh);
 
-        VertexCollection vertex_collection{
-            v ? std::vector<glm::vec3>{v, v + mesh->mNumVertices} : std::vector<glm::vec3>{},
-            n ? std::vector<glm::vec3>{n, n + mesh->mNumVertices} : std::vector<glm::vec3>{},
-            t ? std::vector<glm::vec2>{t, t + mesh->mNumVertices} : std::vector<glm::vec2>{},
-            bone_weights
-        };
+        auto vertex_collection = VertexCollection::from_mesh(mesh);
+        vertex_collection.bones = bone_weights.data();
 
-        std::vector<VertexData> vertices{};
-        VertexData::from_mesh(vertex_collection, vertices);
+        std::vector<VertexData> vertices(mesh->mNumVertices);
+        VertexData::from_mesh(vertex_collection, vertices.data());
 
         std::vector<uint> indices{};
         for (auto face_i = 0u; face_i < mesh->mNumFaces; ++face_i) {
@@ -309,11 +1019,12 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
             indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
         }
 
+        optimise_mesh(vertices, indices);
+
         mesh_index_map[mesh_i] = (int) mesh_hierarchy->meshes.size();
-        mesh_hierarchy->meshes.push_back(ModelInfo{
-            load_from_data(vertices, indices),
-            bone_names
-        });
+        prepared_meshes.push_back(prepare_model(vertices, indices, {ModelLod{0, (int) indices.size()}}, settings.vertex_format));
+        // The model is uploaded later, by finish_hierarchy
+        mesh_hierarchy->meshes.push_back(ModelInfo<VertexData>{nullptr, bone_names});
     }
 
     if (mesh_hierarchy->meshes.empty()) {
@@ -336,66 +1047,168 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
         }
     }
 
-    std::function<void(const aiNode* node, MeshHierarchyNode& hierarchy_node)> load_hierarchy_node;
+    // Linearise the node tree in pre-order, so every parent is added before its children.
+    // [(node, parent_index)]
+    std::vector<std::pair<const aiNode*, int>> node_stack{{scene->mRootNode, MeshHierarchy<VertexData>::NO_PARENT}};
+    // [node_index] -> node
+    std::vector<const aiNode*> nodes{};
+    while (!node_stack.empty()) {
+        auto [node, parent] = node_stack.back();
+        node_stack.pop_back();
 
-    load_hierarchy_node = [&mesh_index_map, &load_hierarchy_node, &mesh_hierarchy, &animations](const aiNode* node, MeshHierarchyNode& hierarchy_node) {
         auto ai_transformation = node->mTransformation;
-        hierarchy_node.transformation = reinterpret_cast<glm::mat4&>(ai_transformation.Transpose());
+        uint node_index = mesh_hierarchy->add_node(parent, reinterpret_cast<glm::mat4&>(ai_transformation.Transpose()));
+        nodes.push_back(node);
+
         for (auto mesh_i = 0u; mesh_i < node->mNumMeshes; ++mesh_i) {
-            hierarchy_node.meshes.push_back(mesh_index_map[node->mMeshes[mesh_i]]);
+            mesh_hierarchy->mesh_draws.emplace_back(node_index, mesh_index_map[node->mMeshes[mesh_i]]);
         }
-        const auto& bones = mesh_hierarchy->total_bones[node->mName.C_Str()];
-        hierarchy_node.bones.insert(hierarchy_node.bones.end(), bones.begin(), bones.end());
-
-        const auto animation = animations.find(node->mName.C_Str());
-        if (animation != animations.end()) {
-            for (const auto& [animation_id, node_animation]: animation->second) {
-                auto& animation_data = hierarchy_node.animation_data[animation_id];
-                for (auto i = 0u; i < node_animation->mNumPositionKeys; ++i) {
-                    const auto& key = node_animation->mPositionKeys[i];
-                    animation_data.positions[key.mTime] = glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z};
-                }
-                for (auto i = 0u; i < node_animation->mNumRotationKeys; ++i) {
-                    const auto& key = node_animation->mRotationKeys[i];
-                    animation_data.rotations[key.mTime] = glm::quat{key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z};
-                }
-                for (auto i = 0u; i < node_animation->mNumScalingKeys; ++i) {
-                    const auto& key = node_animation->mScalingKeys[i];
-                    animation_data.scalings[key.mTime] = glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z};
-                }
+        const auto bones = mesh_hierarchy->total_bones.find(node->mName.C_Str());
+        if (bones != mesh_hierarchy->total_bones.end()) {
+            for (const auto& [mesh_id, bone_id, offset_matrix]: bones->second) {
+                mesh_hierarchy->bone_bindings.push_back(BoneBinding{node_index, mesh_id, bone_id, offset_matrix});
             }
         }
 
-        hierarchy_node.children.resize(node->mNumChildren);
-        for (auto child_i = 0u; child_i < node->mNumChildren; ++child_i) {
-            load_hierarchy_node(node->mChildren[child_i], hierarchy_node.children[child_i]);
+        // Pushed in reverse, so that children are still visited in the file's order
+        for (auto child_i = node->mNumChildren; child_i > 0; --child_i) {
+            node_stack.emplace_back(node->mChildren[child_i - 1], (int) node_index);
         }
-    };
+    }
+
+    mesh_hierarchy->finalise_nodes();
+
+    // [animation_id] -> totals over its channels
+    std::vector<AnimationCompressionStats> compression_stats(mesh_hierarchy->animations.size());
+    for (auto node_index = 0u; node_index < nodes.size(); ++node_index) {
+        const auto animation = animations.find(nodes[node_index]->mName.C_Str());
+        if (animation == animations.end()) continue;
+
+        for (const auto& [animation_id, node_animation]: animation->second) {
+            mesh_hierarchy->channel_indices[animation_id * nodes.size() + node_index] = (uint) mesh_hierarchy->channels.size();
+            AnimationKeys animation_keys{};
+            for (auto i = 0u; i < node_animation->mNumPositionKeys; ++i) {
+                const auto& key = node_animation->mPositionKeys[i];
+                animation_keys.add_position_key(key.mTime, glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z});
+            }
+            for (auto i = 0u; i < node_animation->mNumRotationKeys; ++i) {
+                const auto& key = node_animation->mRotationKeys[i];
+                animation_keys.add_rotation_key(key.mTime, glm::quat{key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z});
+            }
+            for (auto i = 0u; i < node_animation->mNumScalingKeys; ++i) {
+                const auto& key = node_animation->mScalingKeys[i];
+                animation_keys.add_scaling_key(key.mTime, glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z});
+            }
+            animation_keys.sort_keys();
 
-    load_hierarchy_node(scene->mRootNode, mesh_hierarchy->root_node);
+            const auto& animation_data = mesh_hierarchy->channels.emplace_back(AnimationData::compress(animation_keys, settings.animation_compression));
+            compression_stats[animation_id].add(animation_keys, animation_data);
+        }
+    }
+
+    for (auto animation_id = 0u; animation_id < compression_stats.size(); ++animation_id) {
+        check_animation_compression(Formatter() << file << " [" << std::get<0>(mesh_hierarchy->animations[animation_id]) << "]", compression_stats[animation_id], settings.animation_compression);
+    }
 
     importer.FreeScene();
 
+    if (settings.use_model_cache) {
+        BinaryWriter writer{};
+        writer.write(cache_header);
+        write_hierarchy(writer, *mesh_hierarchy, prepared_meshes);
+        ModelCache::save(cache_path, writer);
+    }
+
+    timings.convert_ms = elapsed_ms();
+    prepared_hierarchy.timings = timings;
+    return prepared_hierarchy;
+}
+
+template<typename VertexData>
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::finish_hierarchy(const std::string& file, std::filesystem::file_time_type last_write_time, const PreparedHierarchy<VertexData>& prepared) {
+    auto start = std::chrono::steady_clock::now();
+    const auto& mesh_hierarchy = prepared.mesh_hierarchy;
+    for (auto mesh_id = 0u; mesh_id < mesh_hierarchy->meshes.size(); ++mesh_id) {
+        mesh_hierarchy->meshes[mesh_id].model = upload_model<VertexData>(prepared.meshes[mesh_id], std::nullopt);
+    }
+    auto timings = prepared.timings;
+    timings.upload_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    record_import(timings);
+
     hierarchy_cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, mesh_hierarchy};
+    residency.touch({file, std::type_index(typeid(MeshHierarchy<VertexData>))}, mesh_hierarchy, get_resident_bytes(*mesh_hierarchy));
 
     return mesh_hierarchy;
 }
 
+template<typename Resource>
+std::shared_ptr<PendingLoad<Resource>> ModelLoader::find_in_flight(const std::string& file) const {
+    auto loading = in_flight.find({file, std::type_index(typeid(Resource))});
+    if (loading == in_flight.end()) return nullptr;
+
+    auto pending = loading->second.lock();
+    if (pending == nullptr || pending->is_ready()) return nullptr;
+    return std::static_pointer_cast<PendingLoad<Resource>>(pending);
+}
+
+template<typename Resource>
+std::shared_ptr<PendingLoad<Resource>> ModelLoader::start_async_load(const std::string& file, std::future<typename PendingLoad<Resource>::Upload> prepared) {
+    auto pending = std::make_shared<PendingLoad<Resource>>(file, std::move(prepared));
+    pending_loads.push_back(pending);
+    in_flight[{file, std::type_index(typeid(Resource))}] = pending;
+    return pending;
+}
+
+template<typename Resource>
+void ModelLoader::load_into_slot(std::shared_ptr<Resource>& slot, const std::shared_ptr<void>& owner, const std::shared_ptr<PendingLoad<Resource>>& pending, std::shared_ptr<Resource> placeholder) {
+    const void* slot_address = &slot;
+    auto& loading_slot = loading_slots[slot_address];
+    // If the slot was already loading something, it only holds the placeholder, so keep what it had before that.
+    // Unless its owner has since been freed, and this is a new one at the same address.
+    if (loading_slot.owner.lock() != owner) {
+        loading_slot.owner = owner;
+        loading_slot.previous = slot;
+    }
+    auto load_id = ++last_load_id;
+    loading_slot.load_id = load_id;
+    loading_slot.file = pending->get_file();
+    slot = std::move(placeholder);
+
+    // Shares ownership with `owner`, so the slot can be checked for still existing when the load is ready
+    std::weak_ptr<std::shared_ptr<Resource>> weak_slot = std::shared_ptr<std::shared_ptr<Resource>>(owner, &slot);
+    pending->on_ready([this, slot_address, load_id, weak_slot](const PendingLoad<Resource>& loaded) {
+        auto loading = loading_slots.find(slot_address);
+        // Another file has since been selected into the slot
+        if (loading == loading_slots.end() || loading->second.load_id != load_id) return;
+        auto previous = std::static_pointer_cast<Resource>(loading->second.previous);
+        loading_slots.erase(loading);
+
+        auto slot = weak_slot.lock();
+        if (slot == nullptr) return;
+
+        if (loaded.get() != nullptr) {
+            *slot = loaded.get();
+        } else {
+            std::cerr << "Error while trying to update model file:" << std::endl;
+            std::cerr << loaded.get_error().value_or("Unknown error") << std::endl;
+            *slot = previous;
+        }
+    });
+}
+
 template<typename VertexData>
-bool ModelLoader::add_imgui_model_selector(const std::string& caption, std::shared_ptr<ModelHandle<VertexData>>& model_handle) {
-    std::string current_selection = model_handle->get_filename().value_or("Generated Model");
+bool ModelLoader::add_imgui_model_selector(const std::string& caption, std::shared_ptr<ModelHandle<VertexData>>& model_handle, const std::shared_ptr<void>& owner) {
+    std::string current_selection = get_loading_name(&model_handle).value_or(model_handle->get_filename().value_or("Generated Model"));
 
     bool changed = false;
-    static bool just_opened = true;
     if (ImGui::BeginCombo(caption.c_str(), current_selection.c_str(), 0)) {
-        const auto& models = get_available_models(just_opened);
-        just_opened = false;
+        const auto& models = get_available_models();
 
         for (const auto& model: models) {
             const bool is_selected = model_handle->get_filename().has_value() && current_selection == model;
             if (ImGui::Selectable(model.c_str(), is_selected)) {
                 try {
-                    model_handle = load_from_file<VertexData>(model);
+                    load_into_slot(model_handle, owner, load_from_file_async<VertexData>(model), load_from_file<VertexData>(PLACEHOLDER_MODEL));
                     changed = true;
                 } catch (const std::exception& e) {
                     std::cerr << "Error while trying to update model file:" << std::endl;
@@ -408,28 +1221,33 @@ bool ModelLoader::add_imgui_model_selector(const std::string& caption, std::shar
                 ImGui::SetItemDefaultFocus();
         }
         ImGui::EndCombo();
-    } else {
-        just_opened = true;
     }
 
+    // Show the triangle count of each level of detail
+    std::string lod_triangles = "LOD Triangles:";
+    for (const auto& lod: model_handle->get_lods()) {
+        lod_triangles += Formatter() << " " << lod.index_count / 3;
+    }
+    ImGui::TextDisabled("%s", lod_triangles.c_str());
+    const auto& layout = model_handle->get_layout();
+    ImGui::TextDisabled("Vertex Stride: %u B (Full: %u B), Index Size: %u B", layout.vertex_stride, layout.full_vertex_stride, layout.index_size());
+
     return changed;
 }
 
 template<typename VertexData>
-bool ModelLoader::add_imgui_hierarchy_selector(const std::string& caption, std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy) {
-    std::string current_selection = mesh_hierarchy->filename.value_or("Generated Model");
+bool ModelLoader::add_imgui_hierarchy_selector(const std::string& caption, std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, const std::shared_ptr<void>& owner) {
+    std::string current_selection = get_loading_name(&mesh_hierarchy).value_or(mesh_hierarchy->filename.value_or("Generated Model"));
 
     bool changed = false;
-    static bool just_opened = true;
     if (ImGui::BeginCombo(caption.c_str(), current_selection.c_str(), 0)) {
-        const auto& models = get_available_models(just_opened);
-        just_opened = false;
+        const auto& models = get_available_models();
 
         for (const auto& model: models) {
             const bool is_selected = mesh_hierarchy->filename.has_value() && current_selection == model;
             if (ImGui::Selectable(model.c_str(), is_selected)) {
                 try {
-                    mesh_hierarchy = load_hierarchy_from_file<VertexData>(model);
+                    load_into_slot(mesh_hierarchy, owner, load_hierarchy_from_file_async<VertexData>(model), load_hierarchy_from_file<VertexData>(PLACEHOLDER_MODEL));
                     changed = true;
                 } catch (const std::exception& e) {
                     std::cerr << "Error while trying to update model hierarchy file:" << std::endl;
@@ -442,8 +1260,6 @@ bool ModelLoader::add_imgui_hierarchy_selector(const std::string& caption, std::
                 ImGui::SetItemDefaultFocus();
         }
         ImGui::EndCombo();
-    } else {
-        just_opened = true;
     }
 
     return changed;
@@ -0,0 +1,103 @@
+#ifndef PENDING_LOAD_H
+#define PENDING_LOAD_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <functional>
+
+/// The type erased part of a PendingLoad, so the loader can keep every kind of load in one queue.
+class BasePendingLoad {
+public:
+    /// Whether the background part of the load has finished, so complete() won't block
+    [[nodiscard]] virtual bool is_prepared() const = 0;
+
+    /// Run the part of the load that needs the GL context, then any on_ready callbacks.
+    /// Must be called on the GL thread, and blocks until the background part is finished.
+    virtual void complete() = 0;
+
+    /// Whether the load has completed, successfully or not
+    [[nodiscard]] virtual bool is_ready() const = 0;
+
+    virtual ~BasePendingLoad() = default;
+};
+
+/// A future-like handle to a resource being loaded in the background, returned by ModelLoader's async loads.
+/// The file is read and processed on a worker thread, after which the GL resources are created on the GL thread
+/// by ModelLoader::process_uploads, at which point the handle becomes ready.
+template<typename Resource>
+class PendingLoad : public BasePendingLoad {
+public:
+    /// Runs on the GL thread to create the resource, from whatever the worker thread prepared
+    using Upload = std::function<std::shared_ptr<Resource>()>;
+    using Callback = std::function<void(const PendingLoad&)>;
+
+private:
+    std::string file;
+    std::future<Upload> prepared{};
+    std::shared_ptr<Resource> resource{};
+    std::optional<std::string> error{};
+    bool ready = false;
+    std::vector<Callback> callbacks{};
+
+public:
+    /// A load whose background part is running (or queued) on a worker thread
+    PendingLoad(std::string file, std::future<Upload> prepared) : file(std::move(file)), prepared(std::move(prepared)) {}
+
+    /// A load that is already complete, e.g. as the resource was already in memory
+    PendingLoad(std::string file, std::shared_ptr<Resource> resource) : file(std::move(file)), resource(std::move(resource)), ready(true) {}
+
+    [[nodiscard]] const std::string& get_file() const {
+        return file;
+    }
+
+    [[nodiscard]] bool is_prepared() const override {
+        return ready || prepared.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void complete() override {
+        if (ready) return;
+
+        try {
+            resource = prepared.get()();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        ready = true;
+
+        // Taken first, in case a callback adds another
+        auto ready_callbacks = std::move(callbacks);
+        callbacks.clear();
+        for (const auto& callback: ready_callbacks) {
+            callback(*this);
+        }
+    }
+
+    [[nodiscard]] bool is_ready() const override {
+        return ready;
+    }
+
+    /// The loaded resource, or nullptr if it isn't ready yet or failed to load
+    [[nodiscard]] std::shared_ptr<Resource> get() const {
+        return resource;
+    }
+
+    /// Why the load failed, if it did
+    [[nodiscard]] const std::optional<std::string>& get_error() const {
+        return error;
+    }
+
+    /// Call `callback` on the GL thread once the load is ready, or immediately if it already is
+    void on_ready(Callback callback) {
+        if (ready) {
+            callback(*this);
+        } else {
+            callbacks.push_back(std::move(callback));
+        }
+    }
+};
+
+#endif //PENDING_LOAD_H
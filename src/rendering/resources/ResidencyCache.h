@@ -0,0 +1,141 @@
+#ifndef RESIDENCY_CACHE_H
+#define RESIDENCY_CACHE_H
+
+#include <list>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#include <imgui/imgui.h>
+
+/// Keeps the most recently used resources of a loader alive, up to a memory budget, so that a resource that goes unused
+/// for a moment (e.g. while switching scenes) isn't freed and then loaded again straight after.
+/// The loaders' own caches only hold weak references, so this decides how long an unused resource stays loaded.
+/// Only the resources nothing else holds count towards the budget, since letting go of one still in use wouldn't free it.
+/// When those add up to more than the budget, the least recently used of them are let go.
+template<typename Key, typename Hash>
+class ResidencyCache {
+    struct Entry {
+        Key key;
+        std::shared_ptr<void> resource;
+        size_t bytes;
+    };
+
+    // Most recently used first
+    std::list<Entry> entries{};
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> entry_index{};
+
+    size_t budget_bytes;
+    // Every entry, whether or not it is in use
+    size_t resident_bytes = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t joins = 0;
+    uint64_t evictions = 0;
+
+    /// Whether the cache holds the only reference to the entry's resource
+    static bool is_unused(const Entry& entry) {
+        return entry.resource.use_count() == 1;
+    }
+
+    /// The bytes of the entries that nothing but the cache is using
+    [[nodiscard]] size_t get_unused_bytes() const {
+        size_t bytes = 0;
+        for (const auto& entry: entries) {
+            if (is_unused(entry)) bytes += entry.bytes;
+        }
+        return bytes;
+    }
+
+    void evict_over_budget() {
+        size_t unused_bytes = get_unused_bytes();
+        // Least recently used first, skipping those still in use, which are kept for when they are next let go of
+        for (auto iter = entries.end(); unused_bytes > budget_bytes && iter != entries.begin();) {
+            --iter;
+            if (!is_unused(*iter)) continue;
+
+            unused_bytes -= iter->bytes;
+            resident_bytes -= iter->bytes;
+            entry_index.erase(iter->key);
+            iter = entries.erase(iter);
+            evictions++;
+        }
+    }
+
+public:
+    explicit ResidencyCache(size_t budget_bytes) : budget_bytes(budget_bytes) {}
+
+    /// Mark the resource as just used, keeping it alive, and let go of the least recently used if that puts the cache over budget
+    void touch(const Key& key, std::shared_ptr<void> resource, size_t bytes) {
+        auto existing = entry_index.find(key);
+        if (existing != entry_index.end()) {
+            // Replaced, in case it was reloaded into a new resource
+            resident_bytes -= existing->second->bytes;
+            entries.erase(existing->second);
+        }
+        entries.push_front({key, std::move(resource), bytes});
+        entry_index[key] = entries.begin();
+        resident_bytes += bytes;
+
+        evict_over_budget();
+    }
+
+    /// Count a request that found its resource already loaded
+    void record_hit() {
+        hits++;
+    }
+
+    /// Count a request that had to load its resource
+    void record_miss() {
+        misses++;
+    }
+
+    /// Count a request that found its resource already being loaded, and waits on that load rather than starting another
+    void record_join() {
+        joins++;
+    }
+
+    /// Let go of the least recently used unused resources, if they are over budget.
+    /// Called once a frame, since resources that stop being used between touches would otherwise wait for the next one.
+    void trim() {
+        evict_over_budget();
+    }
+
+    void set_budget(size_t new_budget_bytes) {
+        budget_bytes = new_budget_bytes;
+        evict_over_budget();
+    }
+
+    [[nodiscard]] size_t get_budget() const {
+        return budget_bytes;
+    }
+
+    /// Let go of every resource
+    void clear() {
+        entries.clear();
+        entry_index.clear();
+        resident_bytes = 0;
+    }
+
+    /// Adds the controls for the budget, and the cache's counters
+    void add_imgui_options(const char* label) {
+        ImGui::PushID(label);
+        ImGui::TextUnformatted(label);
+        auto budget_mib = (int) (budget_bytes / (1024 * 1024));
+        if (ImGui::DragInt("Residency Budget (MiB)", &budget_mib, 1.0f, 0, 16384)) {
+            set_budget((size_t) std::max(budget_mib, 0) * 1024 * 1024);
+        }
+        size_t unused_count = std::count_if(entries.begin(), entries.end(), is_unused);
+        size_t unused_bytes = get_unused_bytes();
+        ImGui::Text("Unused: %zu (%.1f MiB)", unused_count, (double) unused_bytes / (1024.0 * 1024.0));
+        ImGui::Text("In Use: %zu (%.1f MiB)", entries.size() - unused_count, (double) (resident_bytes - unused_bytes) / (1024.0 * 1024.0));
+        ImGui::Text("Hits: %llu, Joined: %llu, Misses: %llu, Evictions: %llu",
+                    (unsigned long long) hits, (unsigned long long) joins, (unsigned long long) misses, (unsigned long long) evictions);
+        ImGui::PopID();
+    }
+};
+
+#endif //RESIDENCY_CACHE_H
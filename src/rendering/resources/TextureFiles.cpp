@@ -0,0 +1,428 @@
+#include "TextureFiles.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#include "ModelCache.h"
+
+namespace {
+    constexpr uint32_t make_four_cc(char a, char b, char c, char d) {
+        return (uint32_t) (unsigned char) a | ((uint32_t) (unsigned char) b << 8) | ((uint32_t) (unsigned char) c << 16) | ((uint32_t) (unsigned char) d << 24);
+    }
+
+    constexpr uint32_t DDS_MAGIC = make_four_cc('D', 'D', 'S', ' ');
+    // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE
+    constexpr uint32_t DDS_HEADER_FLAGS = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+    constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    constexpr uint32_t DDPF_FOURCC = 0x4;
+    // DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP
+    constexpr uint32_t DDS_CAPS = 0x8 | 0x1000 | 0x400000;
+    constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+    struct DdsPixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t four_cc;
+        uint32_t rgb_bit_count;
+        uint32_t r_mask;
+        uint32_t g_mask;
+        uint32_t b_mask;
+        uint32_t a_mask;
+    };
+
+    struct DdsHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitch_or_linear_size;
+        uint32_t depth;
+        uint32_t mip_map_count;
+        // Unused by the format, so the texture cache keeps its stamp here
+        uint32_t reserved1[11];
+        DdsPixelFormat pixel_format;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+    static_assert(sizeof(DdsHeader) == 124, "DDS header must match the file layout");
+    static_assert(sizeof(TextureCache::Stamp) <= sizeof(DdsHeader::reserved1), "The cache stamp must fit in the reserved space");
+
+    struct DdsHeaderDx10 {
+        uint32_t dxgi_format;
+        uint32_t resource_dimension;
+        uint32_t misc_flag;
+        uint32_t array_size;
+        uint32_t misc_flags2;
+    };
+
+    constexpr unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct Ktx2Header {
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+    };
+    static_assert(sizeof(Ktx2Header) == 36, "KTX2 header must match the file layout");
+
+    // Where the data format descriptor, key/value data and supercompression data are, none of which are needed here
+    constexpr size_t KTX2_INDEX_SIZE = 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+    struct Ktx2Level {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+
+    std::vector<unsigned char> read_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            throw std::runtime_error(Formatter() << "Failed to open texture file: " << path);
+        }
+        std::vector<unsigned char> bytes((size_t) in.tellg());
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(bytes.data()), (std::streamsize) bytes.size());
+        if (!in) {
+            throw std::runtime_error(Formatter() << "Failed to read texture file: " << path);
+        }
+        return bytes;
+    }
+
+    template<typename T>
+    T read_at(const std::vector<unsigned char>& bytes, size_t offset, const std::string& path) {
+        if (offset > bytes.size() || sizeof(T) > bytes.size() - offset) {
+            throw std::runtime_error(Formatter() << "Texture file is truncated: " << path);
+        }
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        return value;
+    }
+
+    /// Add a level of `format` to the texture, copying its blocks from `source`
+    void add_level(CompressedTexture& texture, uint width, uint height, const std::vector<unsigned char>& bytes, size_t source_offset, const std::string& path) {
+        size_t size = BlockCompression::get_level_bytes(texture.format, width, height);
+        // Written so that an offset near the top of the range from a corrupt file can't wrap around and pass
+        if (source_offset > bytes.size() || size > bytes.size() - source_offset) {
+            throw std::runtime_error(Formatter() << "Texture file is truncated: " << path);
+        }
+        texture.levels.push_back({width, height, texture.data.size(), size});
+        texture.data.insert(texture.data.end(), bytes.begin() + (long) source_offset, bytes.begin() + (long) (source_offset + size));
+    }
+
+    /// The number of levels in a full mip chain down to 1x1, which is as many as a file can usefully have
+    uint get_full_mip_levels(uint width, uint height) {
+        uint levels = 1;
+        for (uint size = std::max(width, height); size > 1; size /= 2) {
+            levels++;
+        }
+        return levels;
+    }
+
+    CompressedTexture parse_dds(const std::vector<unsigned char>& bytes, const std::string& path, DdsHeader& header) {
+        if (read_at<uint32_t>(bytes, 0, path) != DDS_MAGIC) {
+            throw std::runtime_error(Formatter() << "Not a DDS file: " << path);
+        }
+        header = read_at<DdsHeader>(bytes, sizeof(uint32_t), path);
+        if (header.size != sizeof(DdsHeader) || header.width == 0 || header.height == 0) {
+            throw std::runtime_error(Formatter() << "Invalid DDS header: " << path);
+        }
+        if ((header.caps2 & DDSCAPS2_CUBEMAP) != 0 || header.depth > 1) {
+            throw std::runtime_error(Formatter() << "Only 2D DDS textures are supported: " << path);
+        }
+
+        size_t data_offset = sizeof(uint32_t) + sizeof(DdsHeader);
+        CompressedTexture texture{BlockFormat::BC1};
+        if ((header.pixel_format.flags & DDPF_FOURCC) == 0) {
+            throw std::runtime_error(Formatter() << "Only block compressed DDS textures are supported: " << path);
+        }
+        switch (header.pixel_format.four_cc) {
+            case make_four_cc('D', 'X', 'T', '1'):
+                texture.format = BlockFormat::BC1;
+                break;
+            case make_four_cc('D', 'X', 'T', '5'):
+                texture.format = BlockFormat::BC3;
+                break;
+            case make_four_cc('A', 'T', 'I', '1'):
+            case make_four_cc('B', 'C', '4', 'U'):
+                texture.format = BlockFormat::BC4;
+                break;
+            case make_four_cc('A', 'T', 'I', '2'):
+            case make_four_cc('B', 'C', '5', 'U'):
+                texture.format = BlockFormat::BC5;
+                break;
+            case make_four_cc('D', 'X', '1', '0'): {
+                auto dx10 = read_at<DdsHeaderDx10>(bytes, data_offset, path);
+                data_offset += sizeof(DdsHeaderDx10);
+                if (dx10.resource_dimension != DDS_DIMENSION_TEXTURE2D || dx10.array_size > 1) {
+                    throw std::runtime_error(Formatter() << "Only 2D DDS textures are supported: " << path);
+                }
+                switch (dx10.dxgi_format) {
+                    // DXGI_FORMAT_BC1_UNORM(_SRGB)
+                    case 71:
+                    case 72:
+                        texture.format = BlockFormat::BC1;
+                        break;
+                    // DXGI_FORMAT_BC3_UNORM(_SRGB)
+                    case 77:
+                    case 78:
+                        texture.format = BlockFormat::BC3;
+                        break;
+                    // DXGI_FORMAT_BC4_UNORM
+                    case 80:
+                        texture.format = BlockFormat::BC4;
+                        break;
+                    // DXGI_FORMAT_BC5_UNORM
+                    case 83:
+                        texture.format = BlockFormat::BC5;
+                        break;
+                    // DXGI_FORMAT_BC7_UNORM(_SRGB)
+                    case 98:
+                    case 99:
+                        texture.format = BlockFormat::BC7;
+                        break;
+                    default:
+                        throw std::runtime_error(Formatter() << "Unsupported DDS DXGI format " << dx10.dxgi_format << ": " << path);
+                }
+                texture.srgb = dx10.dxgi_format == 72 || dx10.dxgi_format == 78 || dx10.dxgi_format == 99;
+                texture.srgb_known = true;
+                break;
+            }
+            default:
+                throw std::runtime_error(Formatter() << "Unsupported DDS format: " << path);
+        }
+
+        // Any levels past 1x1 are ignored, rather than trusting a corrupt count to size the loop
+        uint level_count = (header.flags & DDSD_MIPMAPCOUNT) != 0 ? std::clamp(header.mip_map_count, 1u, get_full_mip_levels(header.width, header.height)) : 1;
+        uint width = header.width;
+        uint height = header.height;
+        for (auto level = 0u; level < level_count; ++level) {
+            add_level(texture, width, height, bytes, data_offset, path);
+            data_offset += texture.levels.back().size;
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+        return texture;
+    }
+
+    std::string get_extension(const std::string& path) {
+        std::string extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+        return extension;
+    }
+}
+
+bool TextureFiles::is_compressed_file(const std::string& path) {
+    auto extension = get_extension(path);
+    return extension == ".dds" || extension == ".ktx2";
+}
+
+CompressedTexture TextureFiles::read(const std::string& path) {
+    return get_extension(path) == ".ktx2" ? read_ktx2(path) : read_dds(path);
+}
+
+CompressedTexture TextureFiles::read_dds(const std::string& path) {
+    DdsHeader header{};
+    return parse_dds(read_file(path), path, header);
+}
+
+CompressedTexture TextureFiles::read_ktx2(const std::string& path) {
+    auto bytes = read_file(path);
+    if (bytes.size() < sizeof(KTX2_IDENTIFIER) || std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error(Formatter() << "Not a KTX2 file: " << path);
+    }
+    auto header = read_at<Ktx2Header>(bytes, sizeof(KTX2_IDENTIFIER), path);
+    if (header.supercompression_scheme != 0) {
+        throw std::runtime_error(Formatter() << "Supercompressed KTX2 files are not supported: " << path);
+    }
+    if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1) {
+        throw std::runtime_error(Formatter() << "Only 2D KTX2 textures are supported: " << path);
+    }
+
+    // Every VkFormat says whether it is sRGB
+    CompressedTexture texture{BlockFormat::BC1, false, true};
+    switch (header.vk_format) {
+        // VK_FORMAT_BC1_RGB(A)_UNORM/SRGB_BLOCK
+        case 131:
+        case 132:
+        case 133:
+        case 134:
+            texture.format = BlockFormat::BC1;
+            texture.srgb = header.vk_format == 132 || header.vk_format == 134;
+            break;
+        // VK_FORMAT_BC3_UNORM/SRGB_BLOCK
+        case 137:
+        case 138:
+            texture.format = BlockFormat::BC3;
+            texture.srgb = header.vk_format == 138;
+            break;
+        // VK_FORMAT_BC4_UNORM_BLOCK
+        case 139:
+            texture.format = BlockFormat::BC4;
+            break;
+        // VK_FORMAT_BC5_UNORM_BLOCK
+        case 141:
+            texture.format = BlockFormat::BC5;
+            break;
+        // VK_FORMAT_BC7_UNORM/SRGB_BLOCK
+        case 145:
+        case 146:
+            texture.format = BlockFormat::BC7;
+            texture.srgb = header.vk_format == 146;
+            break;
+        default:
+            throw std::runtime_error(Formatter() << "Unsupported KTX2 format " << header.vk_format << ": " << path);
+    }
+
+    // A level count of 0 asks for the mips to be generated, which can't be done for compressed formats, so just use the one
+    // Any levels past 1x1 are ignored, rather than trusting a corrupt count to size the loop
+    uint level_count = std::clamp(header.level_count, 1u, get_full_mip_levels(header.pixel_width, header.pixel_height));
+    size_t level_index_offset = sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header) + KTX2_INDEX_SIZE;
+    uint width = header.pixel_width;
+    uint height = header.pixel_height;
+    for (auto level = 0u; level < level_count; ++level) {
+        auto level_info = read_at<Ktx2Level>(bytes, level_index_offset + level * sizeof(Ktx2Level), path);
+        if (level_info.byte_length < BlockCompression::get_level_bytes(texture.format, width, height)) {
+            throw std::runtime_error(Formatter() << "KTX2 level " << level << " is smaller than its dimensions need: " << path);
+        }
+        add_level(texture, width, height, bytes, (size_t) level_info.byte_offset, path);
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return texture;
+}
+
+uint64_t TextureCache::get_settings_hash(bool srgb, bool flip_vertical) {
+    return ModelCache::hash(Formatter() << "srgb=" << srgb << ";flip=" << flip_vertical << ";encoder=" << BlockCompression::ENCODER_VERSION);
+}
+
+TextureCache::Stamp TextureCache::make_stamp(const std::string& source_path, uint64_t settings_hash) {
+    Stamp stamp{};
+    std::memcpy(stamp.magic, MAGIC, sizeof(MAGIC));
+    stamp.version = VERSION;
+    stamp.settings_hash = settings_hash;
+    stamp.source_write_time = (int64_t) std::filesystem::last_write_time(source_path).time_since_epoch().count();
+    stamp.source_size = (uint64_t) std::filesystem::file_size(source_path);
+    return stamp;
+}
+
+std::string TextureCache::get_cache_path(const std::string& import_path, const std::string& file, uint64_t settings_hash) {
+    return Formatter() << import_path << "/" << CACHE_DIRECTORY << "/" << file << "." << std::hex << settings_hash << ".dds";
+}
+
+std::optional<CompressedTexture> TextureCache::open(const std::string& cache_path, const Stamp& expected) {
+    if (!std::filesystem::exists(cache_path)) return std::nullopt;
+
+    DdsHeader header{};
+    auto texture = parse_dds(read_file(cache_path), cache_path, header);
+
+    Stamp stamp{};
+    std::memcpy(&stamp, header.reserved1, sizeof(Stamp));
+    bool matches = std::memcmp(stamp.magic, expected.magic, sizeof(stamp.magic)) == 0
+                   && stamp.version == expected.version
+                   && stamp.settings_hash == expected.settings_hash
+                   && stamp.source_write_time == expected.source_write_time
+                   && stamp.source_size == expected.source_size;
+    if (!matches) return std::nullopt;
+    return texture;
+}
+
+void TextureCache::save(const std::string& cache_path, const CompressedTexture& texture, const Stamp& stamp) {
+    auto temporary_path = ModelCache::get_temporary_path(cache_path);
+    try {
+        DdsHeader header{};
+        header.size = sizeof(DdsHeader);
+        header.flags = DDS_HEADER_FLAGS;
+        header.width = texture.levels[0].width;
+        header.height = texture.levels[0].height;
+        header.pitch_or_linear_size = (uint32_t) texture.levels[0].size;
+        header.mip_map_count = (uint32_t) texture.levels.size();
+        std::memcpy(header.reserved1, &stamp, sizeof(Stamp));
+        header.pixel_format.size = sizeof(DdsPixelFormat);
+        header.pixel_format.flags = DDPF_FOURCC;
+        header.caps = DDS_CAPS;
+
+        DdsHeaderDx10 dx10{};
+        bool write_dx10 = false;
+        switch (texture.format) {
+            case BlockFormat::BC1:
+                header.pixel_format.four_cc = make_four_cc('D', 'X', 'T', '1');
+                break;
+            case BlockFormat::BC3:
+                header.pixel_format.four_cc = make_four_cc('D', 'X', 'T', '5');
+                break;
+            case BlockFormat::BC4:
+                header.pixel_format.four_cc = make_four_cc('A', 'T', 'I', '1');
+                break;
+            case BlockFormat::BC5:
+                header.pixel_format.four_cc = make_four_cc('A', 'T', 'I', '2');
+                break;
+            case BlockFormat::BC7:
+                // BC7 has no FourCC code of its own
+                header.pixel_format.four_cc = make_four_cc('D', 'X', '1', '0');
+                dx10 = {texture.srgb ? 99u : 98u, DDS_DIMENSION_TEXTURE2D, 0, 1, 0};
+                write_dx10 = true;
+                break;
+        }
+
+        std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path());
+
+        {
+            std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&DDS_MAGIC), sizeof(DDS_MAGIC));
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if (write_dx10) out.write(reinterpret_cast<const char*>(&dx10), sizeof(dx10));
+            out.write(reinterpret_cast<const char*>(texture.data.data()), (std::streamsize) texture.data.size());
+            if (!out) {
+                throw std::runtime_error("Failed to write the file");
+            }
+        }
+        std::filesystem::rename(temporary_path, cache_path);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to save texture cache (" << cache_path << "): " << e.what() << std::endl;
+        std::error_code error{};
+        std::filesystem::remove(temporary_path, error);
+        return;
+    }
+    remove_stale(cache_path);
+}
+
+void TextureCache::remove_stale(const std::string& cache_path) {
+    // Cache paths are <file>.<settings hash>.dds, so the caches of the same file are the siblings with the same <file>. prefix
+    auto path = std::filesystem::path(cache_path);
+    auto stem = path.stem().string();
+    auto prefix = stem.substr(0, stem.rfind('.') + 1);
+
+    std::vector<std::string> current_hashes{};
+    for (bool srgb: {false, true}) {
+        for (bool flip_vertical: {false, true}) {
+            current_hashes.push_back(Formatter() << std::hex << get_settings_hash(srgb, flip_vertical));
+        }
+    }
+
+    try {
+        for (const auto& entry: std::filesystem::directory_iterator(path.parent_path())) {
+            auto name = entry.path().filename().string();
+            if (name.compare(0, prefix.size(), prefix) != 0 || entry.path().extension() != ".dds") continue;
+            // Anything but a hash between them is another file's cache, such as "a.png.b.png" for "a.png"
+            auto hash = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+            if (hash.empty() || hash.find_first_not_of("0123456789abcdef") != std::string::npos) continue;
+            if (std::find(current_hashes.begin(), current_hashes.end(), hash) != current_hashes.end()) continue;
+
+            std::filesystem::remove(entry.path());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to remove stale texture caches (" << cache_path << "): " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef TEXTURE_FILES_H
+#define TEXTURE_FILES_H
+
+#include <string>
+#include <cstdint>
+#include <optional>
+
+#include "BlockCompression.h"
+
+/// Reading and writing block compressed textures, as DDS or KTX2 containers.
+namespace TextureFiles {
+    /// Whether the file is a DDS or KTX2 container (by extension), rather than an image for stb to decode
+    [[nodiscard]] bool is_compressed_file(const std::string& path);
+
+    /// Read a DDS or KTX2 file, throwing if it can't be read or isn't a 2D BC1/BC3/BC4/BC5/BC7 texture.
+    CompressedTexture read(const std::string& path);
+
+    CompressedTexture read_dds(const std::string& path);
+    /// Only KTX2 files without supercompression can be read
+    CompressedTexture read_ktx2(const std::string& path);
+}
+
+/// The DDS files that TextureLoader stores block compressed copies of image files in, so later runs can skip encoding them.
+/// They are kept in a CACHE_DIRECTORY beside the source files, one per (source file, settings hash), and are ordinary
+/// DDS files that any viewer can open, with a Stamp recording what they were built from in the header's reserved space.
+namespace TextureCache {
+    /// Increment whenever the layout of the cache files changes
+    static constexpr uint32_t VERSION = 1;
+    static constexpr char MAGIC[4] = {'T', 'X', 'C', 'H'};
+    static constexpr const char* CACHE_DIRECTORY = ".cache";
+
+    struct Stamp {
+        char magic[4];
+        uint32_t version;
+        // Identifies the flags and encoder version, see get_settings_hash
+        uint64_t settings_hash;
+        // The source file the cache was built from
+        int64_t source_write_time;
+        uint64_t source_size;
+    };
+
+    /// The format isn't included, since it is picked from the image's channels, and the cache is rebuilt when the image changes
+    [[nodiscard]] uint64_t get_settings_hash(bool srgb, bool flip_vertical);
+
+    /// The stamp a cache of `source_path` should have, for the source file as it is now
+    Stamp make_stamp(const std::string& source_path, uint64_t settings_hash);
+
+    /// Where the cache for `file` (relative to `import_path`) is stored
+    std::string get_cache_path(const std::string& import_path, const std::string& file, uint64_t settings_hash);
+
+    /// Read the cache file if it exists and its stamp matches `expected`
+    std::optional<CompressedTexture> open(const std::string& cache_path, const Stamp& expected);
+
+    /// Write the cache file, through a temporary file so a partially written cache is never read, then remove_stale.
+    /// Failing to write is reported, but not an error, since the texture is still usable.
+    void save(const std::string& cache_path, const CompressedTexture& texture, const Stamp& stamp);
+
+    /// Remove the caches of the same file built with settings hashes that are no longer made, such as by an older encoder,
+    /// which would otherwise be left in the cache directory forever. The caches for the file's other flags are kept.
+    void remove_stale(const std::string& cache_path);
+}
+
+#endif //TEXTURE_FILES_H
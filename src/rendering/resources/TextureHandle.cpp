@@ -1,8 +1,14 @@
 #include "TextureHandle.h"
 
+#include <algorithm>
+
 #include <glad/gl.h>
 
-TextureHandle::TextureHandle(uint texture_id, uint width, uint height, bool srgb, bool flipped, std::optional<std::string> filename) : texture_id(texture_id), width(width), height(height), srgb(srgb), flipped(flipped), filename(std::move(filename)) {}
+TextureHandle::TextureHandle(uint texture_id, uint width, uint height, uint internal_format, uint mip_levels, bool srgb, bool flipped, std::optional<std::string> filename) :
+    texture_id(texture_id), width(width), height(height), internal_format(internal_format), mip_levels(mip_levels), srgb(srgb), flipped(flipped),
+    filename(std::move(filename)), gpu_allocation(GpuResourceType::Texture, this->filename.value_or("Generated Texture"), get_gpu_bytes()) {
+    gpu_allocation.set_ref_count([this]() { return weak_from_this().use_count(); });
+}
 
 uint TextureHandle::get_texture_id() const {
     return texture_id;
@@ -20,6 +26,76 @@ uint TextureHandle::get_height() const {
     return height;
 }
 
+uint TextureHandle::get_internal_format() const {
+    return internal_format;
+}
+
+uint TextureHandle::get_mip_levels() const {
+    return mip_levels;
+}
+
+size_t TextureHandle::get_gpu_bytes() const {
+    size_t bytes = 0;
+    for (auto level = 0u; level < mip_levels; ++level) {
+        bytes += get_level_bytes(internal_format, std::max(width >> level, 1u), std::max(height >> level, 1u));
+    }
+    return bytes;
+}
+
+void TextureHandle::mark_used() const {
+    gpu_allocation.mark_used();
+}
+
+uint TextureHandle::full_mip_levels(uint width, uint height) {
+    uint levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+size_t TextureHandle::get_bytes_per_texel(uint internal_format) {
+    switch (internal_format) {
+        case GL_R8:
+            return 1;
+        case GL_RG8:
+        case GL_R16F:
+            return 2;
+        case GL_RGBA16F:
+        case GL_RGB16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGBA32F:
+        case GL_RGB32F:
+            return 16;
+        case GL_R32F:
+        case GL_RGB8:
+        case GL_SRGB8:
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8:
+        default:
+            return 4;
+    }
+}
+
+size_t TextureHandle::get_level_bytes(uint internal_format, uint width, uint height) {
+    size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+    switch (internal_format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+            return blocks * 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            return blocks * 16;
+        default:
+            return (size_t) width * height * get_bytes_per_texel(internal_format);
+    }
+}
+
 bool TextureHandle::is_srgb() const {
     return srgb;
 }
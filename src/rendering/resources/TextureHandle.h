@@ -2,32 +2,55 @@
 #define TEXTURE_HANDLE_H
 
 #include <string>
+#include <memory>
 #include <optional>
 
 #include <glm/glm.hpp>
 #include "utility/HelperTypes.h"
+#include "rendering/memory/GpuMemory.h"
 
 class TextureLoader;
 
 /// A class representing a handle to a loaded texture, also storing some of its configuration data.
-class TextureHandle : private NonCopyable {
+class TextureHandle : private NonCopyable, public std::enable_shared_from_this<TextureHandle> {
     uint texture_id;
     uint width;
     uint height;
+    // The sized internal format the texture was created with, e.g. GL_SRGB8
+    uint internal_format;
+    uint mip_levels;
 
     bool srgb = true;
     bool flipped = false;
     std::optional<std::string> filename{};
 
+    GpuAllocation gpu_allocation;
+
     friend class TextureLoader;
 
 public:
-    TextureHandle(uint texture_id, uint width, uint height, bool srgb = true, bool flipped = false, std::optional<std::string> filename = {});
+    TextureHandle(uint texture_id, uint width, uint height, uint internal_format, uint mip_levels, bool srgb = true, bool flipped = false, std::optional<std::string> filename = {});
 
     [[nodiscard]] uint get_texture_id() const;
     [[nodiscard]] glm::uvec2 get_size() const;
     [[nodiscard]] uint get_width() const;
     [[nodiscard]] uint get_height() const;
+    [[nodiscard]] uint get_internal_format() const;
+    /// The number of levels in the mip chain, 1 if the texture isn't mipmapped
+    [[nodiscard]] uint get_mip_levels() const;
+
+    /// The video memory the texture takes up, across the whole mip chain
+    [[nodiscard]] size_t get_gpu_bytes() const;
+    /// Record that the texture is being bound this frame, for GpuMemory
+    void mark_used() const;
+
+    /// The number of levels in a full mip chain for a texture of the given size
+    static uint full_mip_levels(uint width, uint height);
+    /// The bytes each texel of the internal format takes up, with three channel formats counted as four,
+    /// since drivers pad them out to keep the texels aligned
+    static size_t get_bytes_per_texel(uint internal_format);
+    /// The bytes one level of the given size takes up, which for block compressed formats is a whole number of 4x4 blocks
+    static size_t get_level_bytes(uint internal_format, uint width, uint height);
 
     [[nodiscard]] bool is_flipped() const;
     [[nodiscard]] bool is_srgb() const;
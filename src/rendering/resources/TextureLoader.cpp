@@ -1,5 +1,8 @@
 #include "TextureLoader.h"
 
+#include <tuple>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 
@@ -8,11 +11,64 @@
 #include <stb/stb_image.h>
 #include <glad/gl.h>
 
+#include "TextureFiles.h"
+#include "utility/ThreadPool.h"
+
 #define WHITE_TEXTURE_NAME "[WHITE]"
 #define BLACK_TEXTURE_NAME "[BLACK]"
 
-TextureLoader::TextureLoader(std::string import_path) : import_path(std::move(import_path)), special_names({WHITE_TEXTURE_NAME, BLACK_TEXTURE_NAME}) {
+TextureLoader::TextureLoader(std::string import_path, AssetRegistry& asset_registry) : import_path(std::move(import_path)), asset_registry(asset_registry), special_names({WHITE_TEXTURE_NAME, BLACK_TEXTURE_NAME}) {
     std::fill_n(default_white_texture_data, DEFAULT_TEXTURE_LEN, (unsigned char) 0xFF);
+    asset_registry.add_listener(this->import_path, [this](const std::vector<std::string>& changed_files) {
+        on_files_changed(changed_files);
+    });
+}
+
+/// The sized internal format and pixel format to upload 8-bit images with the given channels as.
+/// There are no sRGB forms of GL_R8 and GL_RG8 in core GL, so sRGB images are always decoded to at least three channels.
+static std::pair<uint, uint> get_pixel_formats(int channels, bool srgb) {
+    switch (channels) {
+        case 1:
+            return {GL_R8, GL_RED};
+        case 2:
+            return {GL_RG8, GL_RG};
+        case 3:
+            return {srgb ? GL_SRGB8 : GL_RGB8, GL_RGB};
+        default:
+            return {srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, GL_RGBA};
+    }
+}
+
+/// Drop the channels the image doesn't use: the alpha if every texel is opaque, and the green and blue if every texel
+/// is grey, as long as `allow_grey` is set. The texels are compacted in place, and the channels left are returned.
+static int reduce_channels(unsigned char* pixels, int width, int height, int channels, bool allow_grey) {
+    size_t texels = (size_t) width * height;
+    bool has_alpha = channels == 2 || channels == 4;
+    int colour_channels = has_alpha ? channels - 1 : channels;
+
+    bool opaque = has_alpha;
+    bool grey = allow_grey && colour_channels == 3;
+    for (size_t i = 0; i < texels && (opaque || grey); ++i) {
+        const unsigned char* texel = pixels + i * channels;
+        if (opaque && texel[channels - 1] != 0xFF) opaque = false;
+        if (grey && (texel[0] != texel[1] || texel[0] != texel[2])) grey = false;
+    }
+
+    int reduced_colour_channels = grey ? 1 : colour_channels;
+    bool keep_alpha = has_alpha && !opaque;
+    int reduced_channels = reduced_colour_channels + (keep_alpha ? 1 : 0);
+    if (reduced_channels == channels) return channels;
+
+    // Each texel only ever moves towards the start, so copying forwards never overwrites a channel before it is read
+    for (size_t i = 0; i < texels; ++i) {
+        const unsigned char* in = pixels + i * channels;
+        unsigned char* out = pixels + i * reduced_channels;
+        for (auto c = 0; c < reduced_colour_channels; ++c) {
+            out[c] = in[c];
+        }
+        if (keep_alpha) out[reduced_colour_channels] = in[channels - 1];
+    }
+    return reduced_channels;
 }
 
 float get_max_anisotropy() {
@@ -36,30 +92,310 @@ std::shared_ptr<TextureHandle> TextureLoader::load_from_file(const std::string&
 
     std::string full_path = import_path + "/" + file;
 
-    if (!std::filesystem::exists(full_path)) {
+    auto last_write_time = asset_registry.get_last_write_time(full_path);
+    if (!last_write_time.has_value()) {
         throw std::runtime_error(Formatter() << "Failed to load texture file: " << full_path << "\n\t Reason: File does not exist");
     }
 
-    static float max_ani = get_max_anisotropy();
-    auto last_write_time = std::filesystem::last_write_time(full_path);
+    if (auto texture = find_cached(file, srgb, flip_vertical, last_write_time.value())) {
+        return texture;
+    }
+
+    return upload(file, srgb, flip_vertical, last_write_time.value(), decode_file(import_path, file, srgb, flip_vertical, should_compress(srgb)));
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::load_from_file_async(const std::string& file, bool srgb, bool flip_vertical) {
+    if (special_names.count(file) != 0) return load_from_file(file, srgb, flip_vertical);
+
+    std::string full_path = import_path + "/" + file;
+
+    auto last_write_time = asset_registry.get_last_write_time(full_path);
+    if (!last_write_time.has_value()) {
+        throw std::runtime_error(Formatter() << "Failed to load texture file: " << full_path << "\n\t Reason: File does not exist");
+    }
+
+    if (auto texture = find_cached(file, srgb, flip_vertical, last_write_time.value())) {
+        return texture;
+    }
+
+    // A single grey texel, which is about the average of most textures, so the placeholder doesn't stand out
+    static const unsigned char placeholder_pixel[3] = {0x80, 0x80, 0x80};
+    uint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, placeholder_pixel);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    auto texture = std::make_shared<TextureHandle>(texture_id, 1, 1, GL_RGB8, 1, srgb, flip_vertical, file);
+
+    // Cached straight away, so loading the file again while it decodes gives the same handle
+    cache[{file, srgb, flip_vertical}] = {last_write_time.value(), texture};
+    residency.touch({file, srgb, flip_vertical}, texture, get_resident_bytes(*texture));
+
+    queue_decode({file, srgb, flip_vertical}, last_write_time.value(), texture, false);
+
+    return texture;
+}
+
+void TextureLoader::queue_decode(const std::tuple<std::string, bool, bool>& key, std::filesystem::file_time_type last_write_time, const std::shared_ptr<TextureHandle>& handle, bool reload) {
+    const auto& [file, srgb, flip_vertical] = key;
+    auto decoded = ThreadPool::global().submit([import_path = import_path, file = file, srgb = srgb, flip_vertical = flip_vertical, compress = should_compress(srgb)]() {
+        return decode_file(import_path, file, srgb, flip_vertical, compress);
+    });
+    pending_textures.push_back({key, last_write_time, handle, std::move(decoded), reload});
+}
+
+std::vector<std::shared_ptr<TextureHandle>> TextureLoader::load_all_from_files(const std::vector<TextureRequest>& requests) {
+    std::vector<std::shared_ptr<TextureHandle>> textures{};
+
+    std::unordered_set<std::tuple<std::string, bool, bool>, TripleHash> seen{};
+    for (const auto& request: requests) {
+        if (special_names.count(request.file) != 0) continue;
+        if (!seen.insert({request.file, request.srgb, request.flip_vertical}).second) continue;
+        if (!asset_registry.exists(import_path + "/" + request.file)) continue;
+
+        // Every decode is queued before any finishes, so they all run at once across the thread pool
+        textures.push_back(load_from_file_async(request.file, request.srgb, request.flip_vertical));
+    }
+
+    return textures;
+}
+
+void TextureLoader::process_uploads() {
+    residency.trim();
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // Stale textures to decode again, once the loop is done with pending_textures: (key, handle, reload)
+    std::vector<std::tuple<std::tuple<std::string, bool, bool>, std::shared_ptr<TextureHandle>, bool>> to_requeue{};
+
+    uploads_last_frame = 0;
+    for (auto iter = pending_textures.begin(); iter != pending_textures.end();) {
+        // Always upload at least one, so a texture that takes longer than the whole budget still loads
+        if (uploads_last_frame > 0 && elapsed_ms() >= upload_budget_ms) break;
+
+        if (iter->decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++iter;
+            continue;
+        }
 
+        const auto& [file, srgb, flip_vertical] = iter->key;
+        auto existing = iter->handle.lock();
+        if (existing == nullptr) {
+            // Nothing is using the texture any more, so there is no need to upload it
+            iter = pending_textures.erase(iter);
+            continue;
+        }
+
+        // Every staging buffer is still being read by the GPU, so leave the rest for next frame rather than stall
+        if (!acquire_staging_buffer(false)) break;
+
+        std::shared_ptr<TextureHandle> uploaded;
+        try {
+            uploaded = create_texture(file, srgb, flip_vertical, iter->decoded.get());
+        } catch (const std::exception& e) {
+            std::cerr << "Error while trying to " << (iter->reload ? "reload" : "load") << " texture file:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            if (iter->stale) {
+                // The error may have come from the old file, so the new one gets its chance
+                to_requeue.emplace_back(iter->key, existing, iter->reload);
+            } else if (!iter->reload) {
+                // A failed reload keeps the last version that loaded. Otherwise the texture is forgotten, so that loading it
+                // again reports the error rather than finding the placeholder
+                cache.erase(iter->key);
+            }
+            iter = pending_textures.erase(iter);
+            continue;
+        }
+
+        replace_texture(*existing, *uploaded);
+        cache[iter->key] = {iter->last_write_time, existing};
+        residency.touch(iter->key, existing, get_resident_bytes(*existing));
+        if (iter->stale) to_requeue.emplace_back(iter->key, existing, true);
+
+        iter = pending_textures.erase(iter);
+        uploads_last_frame++;
+    }
+
+    for (const auto& [key, existing, reload]: to_requeue) {
+        auto last_write_time = asset_registry.get_last_write_time(import_path + "/" + std::get<0>(key));
+        // Deleted files are left as they were
+        if (!last_write_time.has_value()) continue;
+
+        cache[key] = {last_write_time.value(), existing};
+        queue_decode(key, last_write_time.value(), existing, reload);
+    }
+    upload_time_last_frame_ms = elapsed_ms();
+}
+
+size_t TextureLoader::get_pending_count() const {
+    return pending_textures.size();
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::find_cached(const std::string& file, bool srgb, bool flip_vertical, std::filesystem::file_time_type last_write_time) {
     auto existing = cache.find({file, srgb, flip_vertical});
     if (existing != cache.end()) {
         // Cache exist, so try lock
         auto handle = existing->second.second.lock();
         if (handle != nullptr && existing->second.first >= last_write_time) {
-            // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            // Lock was successful and the cache is for an up-to-date version of the file, so can use it.
+            // If it is still a placeholder, this shares the decode already under way
+            if (is_pending({file, srgb, flip_vertical})) {
+                residency.record_join();
+            } else {
+                residency.record_hit();
+            }
+            residency.touch({file, srgb, flip_vertical}, handle, get_resident_bytes(*handle));
             return handle;
         }
     }
+    residency.record_miss();
+    return nullptr;
+}
 
-    stbi_set_flip_vertically_on_load(flip_vertical);
+size_t TextureLoader::get_resident_bytes(const TextureHandle& texture) {
+    return texture.get_gpu_bytes();
+}
 
-    int width, height;
-    stbi_uc* data = stbi_load(full_path.c_str(), &width, &height, nullptr, STBI_rgb);
+TextureLoader::DecodedTexture TextureLoader::decode_file(const std::string& import_path, const std::string& file, bool srgb, bool flip_vertical, bool compress) {
+    std::string full_path = import_path + "/" + file;
+    if (TextureFiles::is_compressed_file(file)) {
+        auto compressed = TextureFiles::read(full_path);
+        // The file's own colour space wins, since that is what its texels were encoded in. BC4 and BC5 have no sRGB form to differ.
+        bool has_srgb_form = compressed.format != BlockFormat::BC4 && compressed.format != BlockFormat::BC5;
+        if (!compressed.srgb_known) {
+            compressed.srgb = srgb && has_srgb_form;
+        } else if (compressed.srgb != srgb && has_srgb_form) {
+            std::cerr << "Texture file [" << file << "] is stored as " << (compressed.srgb ? "sRGB" : "linear") << " but was loaded as "
+                      << (srgb ? "sRGB" : "linear") << ", so is sampled as the file says" << std::endl;
+        }
+        int width = (int) compressed.levels[0].width;
+        int height = (int) compressed.levels[0].height;
+        int channels = BlockCompression::get_channels(compressed.format);
+        // Only one channel is taken to be grey, since two are more likely a normal map's X and Y than grey and alpha
+        return {width, height, channels, channels == 1, nullptr, std::move(compressed)};
+    }
+
+    std::string cache_path{};
+    TextureCache::Stamp stamp{};
+    if (compress) {
+        auto settings_hash = TextureCache::get_settings_hash(srgb, flip_vertical);
+        cache_path = TextureCache::get_cache_path(import_path, file, settings_hash);
+        try {
+            stamp = TextureCache::make_stamp(full_path, settings_hash);
+            if (auto cached = TextureCache::open(cache_path, stamp)) {
+                // Saved without a DX10 header, but the cache is per colour space, so it was encoded as asked
+                cached->srgb = srgb;
+                int width = (int) cached->levels[0].width;
+                int height = (int) cached->levels[0].height;
+                int channels = BlockCompression::get_channels(cached->format);
+                // The encoder only makes one and two channel formats from grey images
+                return {width, height, channels, channels <= 2, nullptr, std::move(cached)};
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Ignoring texture cache (" << cache_path << "): " << e.what() << std::endl;
+        }
+    }
+
+    // stb's flip setting is global, so it is left off and the rows flipped here instead, letting files decode in parallel
+    int width, height, channels;
+    if (!stbi_info(full_path.c_str(), &width, &height, &channels)) {
+        throw std::runtime_error(Formatter() << "Failed to load texture file: " << full_path << "\n\t Reason: " << stbi_failure_reason());
+    }
+    // Grey sRGB images are expanded to RGB(A), as there is nothing smaller to upload them as
+    if (srgb && channels <= 2) channels += 2;
+    stbi_uc* data = stbi_load(full_path.c_str(), &width, &height, nullptr, channels);
     if (!data) {
         throw std::runtime_error(Formatter() << "Failed to load texture file: " << full_path << "\n\t Reason: " << stbi_failure_reason());
     }
+    // Many single channel maps are saved as RGB, so look at what is in the image rather than trusting the file's channels
+    channels = reduce_channels(data, width, height, channels, !srgb);
+    DecodedTexture decoded{width, height, channels, channels <= 2, std::shared_ptr<unsigned char>(data, stbi_image_free)};
+
+    if (flip_vertical) {
+        auto row_size = (size_t) width * channels;
+        for (auto row = 0; row < height / 2; ++row) {
+            std::swap_ranges(data + row * row_size, data + (row + 1) * row_size, data + (height - 1 - row) * row_size);
+        }
+    }
+
+    if (compress) {
+        BlockFormat format = BlockCompression::choose_format(channels);
+        auto compressed = BlockCompression::encode(data, width, height, channels, srgb, format);
+        TextureCache::save(cache_path, compressed, stamp);
+
+        size_t uncompressed_bytes = 0;
+        for (const auto& level: compressed.levels) {
+            uncompressed_bytes += TextureHandle::get_level_bytes(get_pixel_formats(channels, srgb).first, level.width, level.height);
+        }
+        return {width, height, channels, decoded.grey, nullptr, std::move(compressed), uncompressed_bytes};
+    }
+
+    return decoded;
+}
+
+bool TextureLoader::should_compress(bool srgb) const {
+    return compress_textures && BlockCompression::is_supported(BlockFormat::BC1, srgb) && BlockCompression::is_supported(BlockFormat::BC3, srgb);
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::upload(const std::string& file, bool srgb, bool flip_vertical, std::filesystem::file_time_type last_write_time, const DecodedTexture& decoded) {
+    auto texture = create_texture(file, srgb, flip_vertical, decoded);
+
+    cache[{file, srgb, flip_vertical}] = {last_write_time, texture};
+    residency.touch({file, srgb, flip_vertical}, texture, get_resident_bytes(*texture));
+
+    return texture;
+}
+
+bool TextureLoader::acquire_staging_buffer(bool wait) {
+    GLsync& fence = staging_buffers[next_staging_buffer].fence;
+    if (fence == nullptr) return true;
+
+    while (true) {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000 : 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) break;
+        if (!wait) return false;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+    return true;
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::create_texture(const std::string& file, bool srgb, bool flip_vertical, const DecodedTexture& decoded) {
+    static float max_ani = get_max_anisotropy();
+
+    const auto& compressed = decoded.compressed;
+    if (compressed.has_value() && !BlockCompression::is_supported(compressed->format, compressed->srgb)) {
+        throw std::runtime_error(Formatter() << "Failed to load texture file: " << file << "\n\t Reason: " << BlockCompression::get_name(compressed->format)
+                                             << (compressed->srgb ? " (sRGB)" : "") << " isn't supported by the GPU");
+    }
+
+    acquire_staging_buffer(true);
+    StagingBuffer& staging = staging_buffers[next_staging_buffer];
+    next_staging_buffer = (next_staging_buffer + 1) % STAGING_BUFFER_COUNT;
+
+    size_t size = compressed.has_value() ? compressed->data.size() : (size_t) decoded.width * decoded.height * decoded.channels;
+    const unsigned char* source = compressed.has_value() ? compressed->data.data() : decoded.pixels.get();
+    if (staging.pbo == 0) glGenBuffers(1, &staging.pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.pbo);
+    if (size > staging.capacity) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) size, nullptr, GL_STREAM_DRAW);
+        staging_allocation.resize(staging_allocation.get_bytes() - staging.capacity + size);
+        staging.capacity = size;
+    }
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr) size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (mapped != nullptr) {
+        std::memcpy(mapped, source, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    } else {
+        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr) size, source);
+    }
 
     uint texture_id;
     glGenTextures(1, &texture_id);
@@ -71,16 +407,101 @@ std::shared_ptr<TextureHandle> TextureLoader::load_from_file(const std::string&
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, max_ani);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB : GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if (decoded.grey) {
+        // Spread the grey over RGB, so shaders sample it the same as they would an RGB texture
+        int swizzle[4] = {GL_RED, GL_RED, GL_RED, decoded.channels == 2 ? GL_GREEN : GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
 
-    stbi_image_free(data);
+    uint internal_format;
+    uint mip_levels;
+    if (compressed.has_value()) {
+        // Which for files may differ from `srgb`, see decode_file
+        internal_format = BlockCompression::get_gl_format(compressed->format, compressed->srgb);
+        mip_levels = (uint) compressed->levels.size();
+        // The file may not have the full chain, so stop sampling at the last level it has
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int) mip_levels - 1);
+        for (auto level = 0u; level < mip_levels; ++level) {
+            const auto& info = compressed->levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, (int) level, internal_format, (int) info.width, (int) info.height, 0, (GLsizei) info.size,
+                                   reinterpret_cast<const void*>(info.offset));
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        // The rows are tightly packed, so aren't 4 byte aligned unless the width happens to make them
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        uint pixel_format;
+        std::tie(internal_format, pixel_format) = get_pixel_formats(decoded.channels, srgb);
+        mip_levels = TextureHandle::full_mip_levels(decoded.width, decoded.height);
+        // With a pixel unpack buffer bound the data pointer is an offset into it, and the copy happens on the GPU's timeline
+        glTexImage2D(GL_TEXTURE_2D, 0, (int) internal_format, decoded.width, decoded.height, 0, pixel_format, GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
 
-    auto texture = std::make_shared<TextureHandle>(texture_id, width, height, srgb, flip_vertical, file);
+    staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-    cache[{file, srgb, flip_vertical}] = {last_write_time, texture};
+    // Counted here, rather than where it was encoded, since that may have been on a worker thread
+    if (decoded.encoded_from_bytes != 0) {
+        compressed_count++;
+        compressed_from_bytes += decoded.encoded_from_bytes;
+        compressed_to_bytes += decoded.compressed->data.size();
+        if (log_compression) {
+            std::cout << "Compressed texture [" << file << "] to " << BlockCompression::get_name(decoded.compressed->format) << ": "
+                      << decoded.encoded_from_bytes / 1024 << " KiB -> " << decoded.compressed->data.size() / 1024 << " KiB" << std::endl;
+        }
+    }
 
-    return texture;
+    return std::make_shared<TextureHandle>(texture_id, decoded.width, decoded.height, internal_format, mip_levels, srgb, flip_vertical, file);
+}
+
+void TextureLoader::replace_texture(TextureHandle& existing, TextureHandle& replacement) {
+    std::swap(existing.texture_id, replacement.texture_id);
+    std::swap(existing.width, replacement.width);
+    std::swap(existing.height, replacement.height);
+    std::swap(existing.internal_format, replacement.internal_format);
+    std::swap(existing.mip_levels, replacement.mip_levels);
+    existing.gpu_allocation.resize(existing.get_gpu_bytes());
+    replacement.gpu_allocation.resize(replacement.get_gpu_bytes());
+}
+
+bool TextureLoader::is_pending(const std::tuple<std::string, bool, bool>& key) const {
+    return std::any_of(pending_textures.begin(), pending_textures.end(), [&key](const PendingTexture& pending) {
+        return pending.key == key;
+    });
+}
+
+void TextureLoader::on_files_changed(const std::vector<std::string>& changed_files) {
+    std::unordered_set<std::string> changed(changed_files.begin(), changed_files.end());
+
+    // A decode already under way may have read the file before it changed. Rather than racing a second decode against it,
+    // which could finish first and then be overwritten by the old version, it is decoded again once it has been uploaded.
+    for (auto& pending: pending_textures) {
+        if (changed.count(std::get<0>(pending.key)) != 0) pending.stale = true;
+    }
+
+    // The textures still in use whose files changed, in each of the ways they were loaded
+    std::vector<std::pair<std::tuple<std::string, bool, bool>, std::shared_ptr<TextureHandle>>> to_reload{};
+    for (const auto& [key, entry]: cache) {
+        if (changed.count(std::get<0>(key)) == 0) continue;
+        // Marked stale above instead
+        if (is_pending(key)) continue;
+        if (auto handle = entry.second.lock()) {
+            to_reload.emplace_back(key, handle);
+        }
+    }
+
+    for (const auto& [key, existing]: to_reload) {
+        auto last_write_time = asset_registry.get_last_write_time(import_path + "/" + std::get<0>(key));
+        // Deleted files are left as they were
+        if (!last_write_time.has_value()) continue;
+
+        // Decoded in the background like any other load, with the old version shown until the new one is uploaded in its place.
+        // Cached as up to date straight away, so loading the file meanwhile gives the handle being reloaded rather than a second copy.
+        cache[key] = {last_write_time.value(), existing};
+        queue_decode(key, last_write_time.value(), existing, true);
+    }
 }
 
 std::shared_ptr<TextureHandle> TextureLoader::default_white_texture() {
@@ -95,9 +516,9 @@ std::shared_ptr<TextureHandle> TextureLoader::default_white_texture() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, &default_white_texture_data[0]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, &default_white_texture_data[0]);
 
-    default_white_texture_cache = std::make_shared<TextureHandle>(texture_id, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, false, false, WHITE_TEXTURE_NAME);
+    default_white_texture_cache = std::make_shared<TextureHandle>(texture_id, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, GL_RGB8, 1, false, false, WHITE_TEXTURE_NAME);
     return default_white_texture_cache;
 }
 
@@ -113,15 +534,45 @@ std::shared_ptr<TextureHandle> TextureLoader::default_black_texture() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, &default_black_texture_data[0]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, &default_black_texture_data[0]);
 
-    default_black_texture_cache = std::make_shared<TextureHandle>(texture_id, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, false, false, BLACK_TEXTURE_NAME);
+    default_black_texture_cache = std::make_shared<TextureHandle>(texture_id, DEFAULT_TEXTURE_SIZE, DEFAULT_TEXTURE_SIZE, GL_RGB8, 1, false, false, BLACK_TEXTURE_NAME);
     return default_black_texture_cache;
 }
 
+void TextureLoader::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Texture Loader")) {
+        ImGui::DragFloat("Upload Budget (ms)", &upload_budget_ms, 0.05f, 0.0f, 100.0f, "%.2f");
+        ImGui::Checkbox("Compress Textures", &compress_textures);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Encode image files to BC1, BC3, BC4 or BC5, by their channels, when they are next loaded, caching the result beside them");
+        }
+        if (compress_textures && !should_compress(false)) {
+            ImGui::TextDisabled("S3TC isn't supported by the GPU, so textures are left uncompressed");
+        } else if (compress_textures && !should_compress(true)) {
+            ImGui::TextDisabled("sRGB S3TC isn't supported by the GPU, so sRGB textures are left uncompressed");
+        }
+        ImGui::Checkbox("Log Compression", &log_compression);
+        ImGui::Text("Compressed Since Startup: %u (%.1f KiB -> %.1f KiB)", compressed_count, (double) compressed_from_bytes / 1024.0, (double) compressed_to_bytes / 1024.0);
+        ImGui::Text("Decoding In Background: %zu", pending_textures.size());
+        ImGui::Text("Uploaded Last Frame: %u (%.2f ms)", uploads_last_frame, upload_time_last_frame_ms);
+        residency.add_imgui_options("Kept Loaded While Unused");
+    }
+}
+
 void TextureLoader::cleanup() {
     default_black_texture_cache = nullptr;
     default_white_texture_cache = nullptr;
+    residency.clear();
+
+    // The decodes don't reference the loader, so any still running can be left to finish on their own
+    pending_textures.clear();
+    for (auto& staging: staging_buffers) {
+        if (staging.fence != nullptr) glDeleteSync(staging.fence);
+        glDeleteBuffers(1, &staging.pbo);
+        staging = {};
+    }
+    staging_allocation.resize(0);
 }
 
 void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::shared_ptr<TextureHandle>& texture_handle, bool prefer_srgb) {
@@ -157,10 +608,8 @@ void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::
 
     ImGui::PushItemWidth(ImGui::CalcItemWidth() - 132);
 
-    static bool just_opened = true;
     if (ImGui::BeginCombo(caption.c_str(), current_selection.c_str(), 0)) {
-        const auto& textures = get_available_textures(just_opened);
-        just_opened = false;
+        const auto& textures = get_available_textures();
 
         for (const auto& texture: textures) {
             const bool is_selected = texture_handle->get_filename().has_value() && current_selection == texture;
@@ -181,25 +630,27 @@ void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::
                 ImGui::SetItemDefaultFocus();
         }
         ImGui::EndCombo();
-    } else {
-        just_opened = true;
     }
 
     ImGui::PopItemWidth();
 }
 
-const std::vector<std::string>& TextureLoader::get_available_textures(bool force_refresh) {
-    if (!force_refresh && available_textures.has_value()) {
+const std::vector<std::string>& TextureLoader::get_available_textures() {
+    if (available_textures.has_value() && available_textures_generation == asset_registry.get_generation()) {
         return available_textures.value();
     }
     available_textures = std::vector<std::string>{};
+    available_textures_generation = asset_registry.get_generation();
     available_textures->push_back(WHITE_TEXTURE_NAME);
     available_textures->push_back(BLACK_TEXTURE_NAME);
 
-    for (auto const& dir_entry: std::filesystem::recursive_directory_iterator(import_path)) {
-        available_textures->push_back(std::filesystem::relative(dir_entry, import_path).string());
+    // Already sorted
+    auto cache_prefix = std::string(TextureCache::CACHE_DIRECTORY) + "/";
+    for (auto& file: asset_registry.list_files(import_path)) {
+        // Skip the texture caches, which would be loaded through their source files anyway
+        if (file.compare(0, cache_prefix.size(), cache_prefix) == 0) continue;
+        available_textures->push_back(std::move(file));
     }
-    std::sort(available_textures.value().begin() + 2, available_textures.value().end());
 
     return available_textures.value();
 }
@@ -1,20 +1,30 @@
 #ifndef TEXTURE_LOADER_H
 #define TEXTURE_LOADER_H
 
+#include <array>
+#include <deque>
 #include <string>
 #include <vector>
 #include <memory>
+#include <future>
 #include <optional>
 #include <algorithm>
 #include <filesystem>
 #include <unordered_set>
 #include <unordered_map>
 
+#include <glad/gl.h>
+
 #include "TextureHandle.h"
+#include "ResidencyCache.h"
+#include "BlockCompression.h"
+#include "utility/AssetRegistry.h"
+#include "rendering/memory/GpuMemory.h"
 
 /// A loader class intended for the use of loading textures from disk. Includes caching functionality.
 class TextureLoader {
     std::string import_path;
+    AssetRegistry& asset_registry;
 
     static constexpr int DEFAULT_TEXTURE_SIZE = 16;
     static constexpr int DEFAULT_TEXTURE_BPP = 3;
@@ -27,17 +37,144 @@ class TextureLoader {
     std::unordered_set<std::string> special_names;
 
     std::optional<std::vector<std::string>> available_textures{};
+    // The asset registry's generation when available_textures was listed
+    uint available_textures_generation = 0;
 
     // Map (relative_path, srgb, is_flipped) -> (last_modified, weak_handle)
     std::unordered_map<std::tuple<std::string, bool, bool>, std::pair<std::filesystem::file_time_type, std::weak_ptr<TextureHandle>>, TripleHash> cache{};
+    // Keeps the recently used textures alive, with the same keys as `cache`
+    ResidencyCache<std::tuple<std::string, bool, bool>, TripleHash> residency{DEFAULT_RESIDENCY_BUDGET};
+
+    /// An image file decoded to 8-bit pixels, or read as a block compressed texture, ready to upload
+    struct DecodedTexture {
+        int width;
+        int height;
+        // 1 to 4, with any alpha last
+        int channels;
+        // Whether the first channel holds a grey image, to be spread over RGB when sampled
+        bool grey;
+        // Unset if the texture is compressed
+        std::shared_ptr<unsigned char> pixels;
+        std::optional<CompressedTexture> compressed{};
+        // The size of the pixels the compressed texture was encoded from, if it was encoded by this decode rather than read from a file
+        size_t encoded_from_bytes = 0;
+    };
+
+    /// A texture whose file is being decoded on the thread pool, with its handle bound to a placeholder,
+    /// or to the previous version of the file if it is being reloaded, until it is uploaded
+    struct PendingTexture {
+        std::tuple<std::string, bool, bool> key;
+        std::filesystem::file_time_type last_write_time;
+        std::weak_ptr<TextureHandle> handle;
+        std::future<DecodedTexture> decoded;
+        bool reload = false;
+        // Set if the file changed after the decode started, which may then have read the old version, so it is decoded again once uploaded
+        bool stale = false;
+    };
+    std::deque<PendingTexture> pending_textures{};
+
+    /// A pixel buffer the decoded pixels are copied into, so glTexImage2D returns without waiting for the transfer.
+    /// The fence is signalled once the GPU has finished reading it, after which it can be reused.
+    struct StagingBuffer {
+        uint pbo = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+    };
+    static constexpr uint STAGING_BUFFER_COUNT = 4;
+    std::array<StagingBuffer, STAGING_BUFFER_COUNT> staging_buffers{};
+    uint next_staging_buffer = 0;
+    GpuAllocation staging_allocation{GpuResourceType::Buffer, "Texture Staging Buffers"};
+
+    // Whether image files are block compressed when they are loaded, through the texture cache
+    bool compress_textures = true;
+    // Whether each texture compressed is also printed, rather than only counted below
+    bool log_compression = false;
+    // Textures encoded since startup, and their size before and after
+    uint compressed_count = 0;
+    size_t compressed_from_bytes = 0;
+    size_t compressed_to_bytes = 0;
+
+    // The GL time process_uploads may spend each frame, though it always uploads at least one texture
+    float upload_budget_ms = 2.0f;
+    uint uploads_last_frame = 0;
+    double upload_time_last_frame_ms = 0.0;
+
+    /// The in memory copy of the texture, if it is still loaded and up to date.
+    /// Counts towards the residency hits, joins (if it is still decoding) or misses, and marks the texture as just used.
+    std::shared_ptr<TextureHandle> find_cached(const std::string& file, bool srgb, bool flip_vertical, std::filesystem::file_time_type last_write_time);
+
+    /// An estimate of the GPU memory used by a texture, as counted against the residency budget
+    static size_t get_resident_bytes(const TextureHandle& texture);
+
+    /// Decode the file, throwing if it can't be. Uses no GL and no shared state, so can run on any thread.
+    /// DDS and KTX2 files are read as they are, without being flipped. Other images are decoded with stb, keeping only the
+    /// channels they use (see reduce_channels in the .cpp), and if `compress` is set, encoded to the block format for that
+    /// many channels and kept in the TextureCache, or read from it if it was already encoded.
+    static DecodedTexture decode_file(const std::string& import_path, const std::string& file, bool srgb, bool flip_vertical, bool compress);
+
+    /// Whether to compress the image files loaded from now on as `srgb` or not, which may only be called on the GL thread.
+    /// Needs S3TC for the BC1 and BC3 images, and EXT_texture_sRGB for their sRGB forms, RGTC for grey images being core.
+    [[nodiscard]] bool should_compress(bool srgb) const;
+
+    /// Create the GL texture for a decoded image, and add it to the in memory cache
+    std::shared_ptr<TextureHandle> upload(const std::string& file, bool srgb, bool flip_vertical, std::filesystem::file_time_type last_write_time, const DecodedTexture& decoded);
+
+    /// Whether the GPU has finished reading the next staging buffer, waiting for it to if `wait` is set
+    bool acquire_staging_buffer(bool wait);
+
+    /// Create a mipmapped GL texture for a decoded image, copying the pixels through the next staging buffer.
+    /// Compressed textures are uploaded with the mip chain they came with, rather than generating one.
+    /// Counts, and optionally logs, any texture that was encoded by its decode.
+    std::shared_ptr<TextureHandle> create_texture(const std::string& file, bool srgb, bool flip_vertical, const DecodedTexture& decoded);
+
+    /// Move the texture, and everything describing it, from `replacement` into `existing`, so every user of `existing` sees it.
+    /// The old texture is freed along with `replacement`.
+    static void replace_texture(TextureHandle& existing, TextureHandle& replacement);
+
+    /// Decode the file on the thread pool, for process_uploads to then upload into `handle`
+    void queue_decode(const std::tuple<std::string, bool, bool>& key, std::filesystem::file_time_type last_write_time, const std::shared_ptr<TextureHandle>& handle, bool reload);
+
+    [[nodiscard]] bool is_pending(const std::tuple<std::string, bool, bool>& key) const;
+
+    /// Reload the textures in use whose files changed, in place, called by the asset registry
+    void on_files_changed(const std::vector<std::string>& changed_files);
 public:
+    /// The GPU memory the textures kept loaded after they go unused may add up to, before the least recently used are freed.
+    static constexpr size_t DEFAULT_RESIDENCY_BUDGET = 256 * 1024 * 1024;
+
+    /// A texture file and the flags to load it with, the same as the arguments of load_from_file
+    struct TextureRequest {
+        std::string file;
+        bool srgb;
+        bool flip_vertical;
+    };
+
     /// Construct the loader with a import_path which is prepended to any path you try and load.
-    /// It also scans the directory for all files, which is used to populate the list of get_available_textures()
-    explicit TextureLoader(std::string import_path);
+    /// Files are looked up in the asset_registry, which must cover import_path, and textures are reloaded in place when their files change.
+    TextureLoader(std::string import_path, AssetRegistry& asset_registry);
 
     /// Loads the file at the specified path into GPU memory, with flags for if the texture is sRGB and to flip it vertically.
+    /// If the file is already being loaded by load_from_file_async, returns that handle, which may still be the placeholder.
     std::shared_ptr<TextureHandle> load_from_file(const std::string& file, bool srgb = true, bool flip_vertical = false);
 
+    /// Start loading the file in the background, returning a handle that can be used straight away.
+    /// The file is decoded on the thread pool, and until process_uploads uploads it the handle is bound to a small grey
+    /// placeholder texture. Throws straight away if the file doesn't exist, any other error is printed when the decode
+    /// finishes, leaving the placeholder in place.
+    std::shared_ptr<TextureHandle> load_from_file_async(const std::string& file, bool srgb = true, bool flip_vertical = false);
+
+    /// Start loading every requested texture that isn't already loaded, with the files decoded concurrently on the thread pool.
+    /// Returns the handles, which must be kept alive for load_from_file to find them in the cache. Files that don't exist are
+    /// skipped, so that load_from_file reports the error when they are next requested.
+    std::vector<std::shared_ptr<TextureHandle>> load_all_from_files(const std::vector<TextureRequest>& requests);
+
+    /// Upload the textures that have finished decoding in the background, swapping them into their handles,
+    /// until upload_budget_ms has been spent, and trim the residency cache. Must be called on the GL thread, once per frame.
+    void process_uploads();
+
+    /// The number of textures still decoding in the background, or waiting for process_uploads to upload them
+    [[nodiscard]] size_t get_pending_count() const;
+
     /// Provides a pure white (0xFFFFFF) texture
     std::shared_ptr<TextureHandle> default_white_texture();
     /// Provides a pure black (0x000000) texture
@@ -47,8 +184,11 @@ public:
     /// If the prefer_srgb flag is selected, then when going from no texture to a valid texture it will default to enabling srgb.
     void add_imgui_texture_selector(const std::string& caption, std::shared_ptr<TextureHandle>& texture_handle, bool prefer_srgb = true);
     /// Helper method to provide a selector over all the texture files in the import_path directory.
-    /// if force_refresh is selected, it will rescan the directory, otherwise it just uses a cached list from the last scan.
-    const std::vector<std::string>& get_available_textures(bool force_refresh = false);
+    /// The list is rebuilt from the asset registry whenever a file has been added or removed since it was last built.
+    const std::vector<std::string>& get_available_textures();
+
+    /// Adds the ImGUI controls for the loader's residency budget and counters
+    void add_imgui_options_section();
 
     /// Free up any resources.
     void cleanup();
@@ -0,0 +1,105 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+
+/// The layout a model's vertices are stored with on the GPU.
+enum class VertexFormat {
+    /// Each VertexData is uploaded as is, full 32-bit floats for everything.
+    Full,
+    /// Each VertexData is converted to its VertexData::Packed layout,
+    /// with quantised positions, 10_10_10_2 normals, half float texture coordinates and 8-bit bone data.
+    Packed,
+};
+
+/// The transform that maps quantised [0, 1] positions back into model space, that is
+/// position = offset + scale * quantised_position
+struct PositionDequantisation {
+    glm::vec3 offset{0.0f};
+    glm::vec3 scale{1.0f};
+
+    /// Create a dequantisation that covers the bounding box [min, max]
+    static PositionDequantisation from_bounds(const glm::vec3& min, const glm::vec3& max) {
+        return {min, max - min};
+    }
+};
+
+/// Helpers for converting to the packed vertex attribute types
+namespace VertexPacking {
+    /// Convert a float to an IEEE half float, rounding to nearest, for use with GL_HALF_FLOAT
+    inline uint16_t float_to_half(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign = (bits >> 16) & 0x8000u;
+        uint32_t float_exponent = (bits >> 23) & 0xFFu;
+        uint32_t mantissa = bits & 0x7FFFFFu;
+
+        if (float_exponent == 0xFFu) {
+            // Inf or NaN
+            return (uint16_t) (sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u));
+        }
+
+        int32_t exponent = (int32_t) float_exponent - 127 + 15;
+        if (exponent >= 31) {
+            // Too large, so saturate to Inf
+            return (uint16_t) (sign | 0x7C00u);
+        }
+        if (exponent <= 0) {
+            // Subnormal half, or too small and flushes to zero
+            if (exponent < -10) return (uint16_t) sign;
+            mantissa |= 0x800000u;
+            uint32_t shift = (uint32_t) (14 - exponent);
+            uint32_t half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1u) half++;
+            return (uint16_t) (sign | half);
+        }
+
+        uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+        // Round to nearest, a carry into the exponent is still the correct result
+        if (mantissa & 0x1000u) half++;
+        return (uint16_t) half;
+    }
+
+    /// Pack a normalised vector into the signed GL_INT_2_10_10_10_REV format, w is left as 0
+    inline uint32_t pack_snorm_10_10_10_2(const glm::vec3& value) {
+        auto pack_component = [](float component) {
+            auto quantised = (int32_t) std::round(std::clamp(component, -1.0f, 1.0f) * 511.0f);
+            return (uint32_t) quantised & 0x3FFu;
+        };
+        return pack_component(value.x) | (pack_component(value.y) << 10) | (pack_component(value.z) << 20);
+    }
+
+    /// Quantise a position to 16-bit unsigned normalised values, using the inverse of the dequantisation
+    inline void quantise_position(const glm::vec3& position, const PositionDequantisation& dequantisation, uint16_t out[3]) {
+        for (auto i = 0; i < 3; ++i) {
+            float normalised = dequantisation.scale[i] == 0.0f ? 0.0f : (position[i] - dequantisation.offset[i]) / dequantisation.scale[i];
+            out[i] = (uint16_t) std::round(std::clamp(normalised, 0.0f, 1.0f) * 65535.0f);
+        }
+    }
+
+    /// Quantise bone weights to 8-bit unsigned normalised values, preserving the sum of the weights
+    /// by giving any rounding error to the largest weight.
+    inline void quantise_weights(const glm::vec4& weights, uint8_t out[4]) {
+        int total = 0;
+        int largest = 0;
+        for (auto i = 0; i < 4; ++i) {
+            out[i] = (uint8_t) std::round(std::clamp(weights[i], 0.0f, 1.0f) * 255.0f);
+            total += out[i];
+            if (weights[i] > weights[largest]) largest = i;
+        }
+
+        float weight_sum = weights.x + weights.y + weights.z + weights.w;
+        int target = (int) std::round(std::clamp(weight_sum, 0.0f, 1.0f) * 255.0f);
+        out[largest] = (uint8_t) std::clamp((int) out[largest] + target - total, 0, 255);
+    }
+}
+
+#endif //VERTEX_FORMAT_H
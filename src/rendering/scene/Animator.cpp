@@ -1,25 +1,156 @@
 #include "Animator.h"
 
 void Animator::animate(double dt) {
-    std::vector<std::shared_ptr<AnimatedEntityInterface>> to_remove{};
+    const size_t count = times.size();
+    bool any_finished = false;
 
-    for (auto& item: animated_entities) {
-        if (item.second.paused) continue;
+    // Only touches the dense arrays, never the entities, so it streams through memory whatever order the entities are in
+    for (size_t i = 0; i < count; ++i) {
+        double time = times[i] + ((flags[i] & PAUSED) != 0 ? 0.0 : dt * speeds[i]);
 
-        auto& time = item.first->get_animation_time_seconds();
-        auto dur = item.first->get_animation_duration_seconds();
-        time += dt * item.second.speed;
-        if (time > dur) {
-            if (item.second.loop && dur > 0) {
-                time = std::fmod(time, dur);
+        // Rarely true, once per playthrough, so the wrap is only paid for then
+        double duration = durations[i];
+        if (time > duration) {
+            if ((flags[i] & LOOP) != 0 && duration > 0.0) {
+                // Time is never negative, so truncating is the same as floor, but without a call into libm
+                time -= (double) (int64_t) (time / duration) * duration;
             } else {
-                time = dur;
-                to_remove.push_back(item.first);
+                time = duration;
+                finished[i] = true;
+                any_finished = true;
             }
         }
+        times[i] = time;
     }
 
-    for (const auto& item: to_remove) {
-        animated_entities.erase(item);
+    // Before removing the finished entities, so they are left at their final time
+    write_times();
+
+    if (!any_finished) return;
+
+    // Backwards, so the entity swapped into a removed entity's place has already been checked
+    for (size_t i = count; i > 0; --i) {
+        if (finished[i - 1]) {
+            remove((uint) i - 1);
+        }
+    }
+}
+
+void Animator::write_times() {
+    for (size_t i = 0; i < times.size(); ++i) {
+        *time_targets[i] = times[i];
+    }
+}
+
+bool Animator::is_valid(AnimationHandle handle) const {
+    return handle.slot < slot_generations.size() && slot_generations[handle.slot] == handle.generation && slot_to_dense[handle.slot] != UINT_MAX;
+}
+
+double Animator::get_time(AnimationHandle handle) const {
+    if (!is_valid(handle)) {
+        throw std::runtime_error("Invalid animation handle");
+    }
+    return times[slot_to_dense[handle.slot]];
+}
+
+uint Animator::get_animation_id(AnimationHandle handle) const {
+    if (!is_valid(handle)) {
+        throw std::runtime_error("Invalid animation handle");
+    }
+    return animation_ids[slot_to_dense[handle.slot]];
+}
+
+std::optional<uint> Animator::find_dense_index(const AnimatedEntityInterface* entity) const {
+    auto handle = handles.find(entity);
+    if (handle == handles.end()) {
+        return std::nullopt;
     }
+    return slot_to_dense[handle->second.slot];
+}
+
+AnimationHandle Animator::insert(const std::shared_ptr<AnimatedEntityInterface>& entity, const AnimationParameters& animation_parameters) {
+    auto dense_index = find_dense_index(entity.get());
+    if (dense_index.has_value()) {
+        // start and resume may have just written the entity's time
+        times[dense_index.value()] = entity->get_animation_time_seconds();
+        set_parameters(dense_index.value(), animation_parameters);
+        return handles[entity.get()];
+    }
+
+    uint slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        slot = (uint) slot_to_dense.size();
+        slot_to_dense.push_back(UINT_MAX);
+        slot_generations.push_back(0);
+    }
+
+    auto index = (uint) entities.size();
+    slot_to_dense[slot] = index;
+    dense_to_slot.push_back(slot);
+
+    times.push_back(entity->get_animation_time_seconds());
+    animation_ids.push_back(entity->get_animation_id());
+    speeds.push_back(0.0);
+    durations.push_back(0.0);
+    flags.push_back(0);
+    finished.push_back(0);
+    time_targets.push_back(&entity->get_animation_time_seconds());
+    entities.push_back(entity);
+    parameters.emplace_back();
+    set_parameters(index, animation_parameters);
+
+    AnimationHandle handle{slot, slot_generations[slot]};
+    handles[entity.get()] = handle;
+    return handle;
+}
+
+void Animator::set_parameters(uint dense_index, const AnimationParameters& animation_parameters) {
+    parameters[dense_index] = animation_parameters;
+    speeds[dense_index] = animation_parameters.speed;
+    flags[dense_index] = (animation_parameters.loop ? LOOP : 0) | (animation_parameters.paused ? PAUSED : 0);
+    // The animation may have changed, so the duration may have too
+    refresh_duration(dense_index);
+}
+
+void Animator::refresh_duration(uint dense_index) {
+    durations[dense_index] = entities[dense_index]->get_animation_duration_seconds();
+    animation_ids[dense_index] = entities[dense_index]->get_animation_id();
+}
+
+void Animator::remove(uint dense_index) {
+    uint slot = dense_to_slot[dense_index];
+    handles.erase(entities[dense_index].get());
+    slot_to_dense[slot] = UINT_MAX;
+    // Invalidate any outstanding handles to this slot before it is reused
+    slot_generations[slot]++;
+    free_slots.push_back(slot);
+
+    auto last = (uint) entities.size() - 1;
+    if (dense_index != last) {
+        times[dense_index] = times[last];
+        animation_ids[dense_index] = animation_ids[last];
+        speeds[dense_index] = speeds[last];
+        durations[dense_index] = durations[last];
+        flags[dense_index] = flags[last];
+        finished[dense_index] = finished[last];
+        time_targets[dense_index] = time_targets[last];
+        entities[dense_index] = std::move(entities[last]);
+        parameters[dense_index] = parameters[last];
+        dense_to_slot[dense_index] = dense_to_slot[last];
+        slot_to_dense[dense_to_slot[dense_index]] = dense_index;
+    }
+
+    times.pop_back();
+    animation_ids.pop_back();
+    speeds.pop_back();
+    durations.pop_back();
+    flags.pop_back();
+    finished.pop_back();
+    time_targets.pop_back();
+    entities.pop_back();
+    parameters.pop_back();
+    dense_to_slot.pop_back();
 }
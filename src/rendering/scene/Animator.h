@@ -1,6 +1,10 @@
 #ifndef ANIMATOR_H
 #define ANIMATOR_H
 
+#include <vector>
+#include <climits>
+#include <cstdint>
+#include <optional>
 #include <unordered_map>
 
 #include "rendering/scene/RenderedEntity.h"
@@ -12,16 +16,69 @@ struct AnimationParameters {
     double speed = 1.0;
 };
 
+/// Identifies an animating entity in an Animator. Stays valid until that entity stops animating,
+/// even as other entities are added and removed, after which it never refers to anything again.
+struct AnimationHandle {
+    uint slot = UINT_MAX;
+    uint generation = 0;
+};
+
 /// A class for controlling the animation for a set of animatable entities
+///
+/// The state of each animating entity is stored densely in parallel arrays, so advancing time is a single
+/// pass over them, and removing an entity swaps the last one into its place.
+/// The Animator owns the time and animation id of the entities it is animating. Changes made through it are written
+/// through to the entity straight away, and the times are copied to the entities once per frame after they advance,
+/// so writing to an animating entity's time or id directly is overwritten. Use set_time and set_animation instead.
 class Animator {
-    std::unordered_map<std::shared_ptr<AnimatedEntityInterface>, AnimationParameters> animated_entities{};
+    enum Flags : uint8_t {
+        LOOP = 1u << 0u,
+        PAUSED = 1u << 1u,
+    };
+
+    // [dense_index] -> state of one animating entity
+    std::vector<double> times{};
+    std::vector<uint> animation_ids{};
+    std::vector<double> speeds{};
+    std::vector<double> durations{};
+    std::vector<uint8_t> flags{};
+    std::vector<uint8_t> finished{};
+    // Where the entity keeps its time, fetched once on start so copying the times back needs no virtual call per entity
+    std::vector<double*> time_targets{};
+    std::vector<std::shared_ptr<AnimatedEntityInterface>> entities{};
+    std::vector<AnimationParameters> parameters{};
+    std::vector<uint> dense_to_slot{};
+
+    // [slot] -> dense_index, with a generation to detect stale handles
+    std::vector<uint> slot_to_dense{};
+    std::vector<uint> slot_generations{};
+    std::vector<uint> free_slots{};
+
+    std::unordered_map<const AnimatedEntityInterface*, AnimationHandle> handles{};
+
+    [[nodiscard]] std::optional<uint> find_dense_index(const AnimatedEntityInterface* entity) const;
+
+    /// Add or overwrite the state of an entity.
+    AnimationHandle insert(const std::shared_ptr<AnimatedEntityInterface>& entity, const AnimationParameters& animation_parameters);
+
+    /// Update the parameters of the entity at a dense index, refreshing its flags and duration.
+    void set_parameters(uint dense_index, const AnimationParameters& animation_parameters);
+
+    /// Look up the duration of the entity at a dense index again, for its current animation.
+    void refresh_duration(uint dense_index);
+
+    /// Copy every entity's time from `times` to the entity, for rendering
+    void write_times();
+
+    /// Swap remove the entity at a dense index, invalidating its handle.
+    void remove(uint dense_index);
 public:
-    /// Animated each playing entity, incrementing time by dt.
+    /// Animated each playing entity, incrementing time by dt, then write the new times to the entities.
     void animate(double dt);
 
     /// Start animating an entity with the given parameters. If it was already present then reset to t=0 and use new parameters.
     template<class AnimatedEntity>
-    void start(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters);
+    AnimationHandle start(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters);
 
     /// Update the parameters on an animating entity with the given parameters.
     /// If it was not already present then nothing happens.
@@ -44,54 +101,72 @@ public:
     /// Stop an entity from animationg, does nothing it it was already stopped.
     template<class AnimatedEntity>
     void stop(const std::shared_ptr<AnimatedEntity>& animated_entity);
+
+    /// Set the time of an entity, whether or not it is animating.
+    template<class AnimatedEntity>
+    void set_time(const std::shared_ptr<AnimatedEntity>& animated_entity, double time_seconds);
+
+    /// Change the animation an entity plays, keeping its time, whether or not it is animating.
+    template<class AnimatedEntity>
+    void set_animation(const std::shared_ptr<AnimatedEntity>& animated_entity, uint animation_id);
+
+    /// The handle of an animating entity, if it is animating
+    template<class AnimatedEntity>
+    std::optional<AnimationHandle> get_handle(const std::shared_ptr<AnimatedEntity>& animated_entity) const;
+
+    /// Whether a handle still refers to an animating entity
+    [[nodiscard]] bool is_valid(AnimationHandle handle) const;
+
+    /// The current time of the entity a handle refers to, which must be valid
+    [[nodiscard]] double get_time(AnimationHandle handle) const;
+
+    /// The animation the entity a handle refers to is playing, which must be valid
+    [[nodiscard]] uint get_animation_id(AnimationHandle handle) const;
+
+    [[nodiscard]] size_t get_animating_count() const {
+        return entities.size();
+    }
 };
 
 template<class AnimatedEntity>
-void Animator::start(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
-    stop(animated_entity);
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
+AnimationHandle Animator::start(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
+    std::shared_ptr<AnimatedEntityInterface> aei = animated_entity;
     aei->get_animation_id() = animation_parameters.animation_id;
     aei->get_animation_time_seconds() = 0.0;
-    animated_entities[aei] = animation_parameters;
+    return insert(aei, animation_parameters);
 }
 
 template<class AnimatedEntity>
 void Animator::update_param(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        param->second = animation_parameters;
+    auto dense_index = find_dense_index(animated_entity.get());
+    if (dense_index.has_value()) {
+        set_parameters(dense_index.value(), animation_parameters);
     }
 }
 
 template<class AnimatedEntity>
 void Animator::pause(std::shared_ptr<AnimatedEntity> animated_entity) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        param->second.paused = true;
+    auto dense_index = find_dense_index(animated_entity.get());
+    if (dense_index.has_value()) {
+        auto animation_parameters = parameters[dense_index.value()];
+        animation_parameters.paused = true;
+        set_parameters(dense_index.value(), animation_parameters);
     }
 }
 
 template<class AnimatedEntity>
 void Animator::resume(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        param->second = animation_parameters;
-        param->second.paused = false;
-    } else {
-        aei->get_animation_id() = animation_parameters.animation_id;
-        animated_entities[aei] = animation_parameters;
-    }
+    std::shared_ptr<AnimatedEntityInterface> aei = animated_entity;
+    animation_parameters.paused = false;
+    aei->get_animation_id() = animation_parameters.animation_id;
+    insert(aei, animation_parameters);
 }
 
 template<class AnimatedEntity>
 std::optional<AnimationParameters> Animator::is_animating(const std::shared_ptr<AnimatedEntity>& animated_entity) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        return param->second;
+    auto dense_index = find_dense_index(animated_entity.get());
+    if (dense_index.has_value()) {
+        return parameters[dense_index.value()];
     } else {
         return std::nullopt;
     }
@@ -99,10 +174,43 @@ std::optional<AnimationParameters> Animator::is_animating(const std::shared_ptr<
 
 template<class AnimatedEntity>
 void Animator::stop(const std::shared_ptr<AnimatedEntity>& animated_entity) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
+    std::shared_ptr<AnimatedEntityInterface> aei = animated_entity;
     aei->get_animation_id() = NONE_ANIMATION;
     aei->get_animation_time_seconds() = 0.0;
-    animated_entities.erase(aei);
+    auto dense_index = find_dense_index(aei.get());
+    if (dense_index.has_value()) {
+        remove(dense_index.value());
+    }
+}
+
+template<class AnimatedEntity>
+void Animator::set_time(const std::shared_ptr<AnimatedEntity>& animated_entity, double time_seconds) {
+    std::shared_ptr<AnimatedEntityInterface> aei = animated_entity;
+    aei->get_animation_time_seconds() = time_seconds;
+    auto dense_index = find_dense_index(aei.get());
+    if (dense_index.has_value()) {
+        times[dense_index.value()] = time_seconds;
+    }
+}
+
+template<class AnimatedEntity>
+void Animator::set_animation(const std::shared_ptr<AnimatedEntity>& animated_entity, uint animation_id) {
+    std::shared_ptr<AnimatedEntityInterface> aei = animated_entity;
+    aei->get_animation_id() = animation_id;
+    auto dense_index = find_dense_index(aei.get());
+    if (dense_index.has_value()) {
+        parameters[dense_index.value()].animation_id = animation_id;
+        refresh_duration(dense_index.value());
+    }
+}
+
+template<class AnimatedEntity>
+std::optional<AnimationHandle> Animator::get_handle(const std::shared_ptr<AnimatedEntity>& animated_entity) const {
+    auto handle = handles.find(animated_entity.get());
+    if (handle != handles.end()) {
+        return handle->second;
+    }
+    return std::nullopt;
 }
 
 #endif //ANIMATOR_H
@@ -10,6 +10,7 @@
 #include "rendering/renders/EntityRenderer.h"
 #include "rendering/renders/AnimatedEntityRenderer.h"
 #include "rendering/renders/EmissiveEntityRenderer.h"
+#include "rendering/renders/CrowdRenderer.h"
 
 /// The master render scene, which holds a copy of each renderers RenderScene,
 /// as well as the light scene, and offers an interface for adding/removing entities and lights.
@@ -18,6 +19,7 @@ class MasterRenderScene {
     EntityRenderer::RenderScene entity_scene{};
     AnimatedEntityRenderer::RenderScene animated_entity_scene{};
     EmissiveEntityRenderer::RenderScene emissive_entity_scene{};
+    CrowdRenderer::RenderScene crowd_scene{};
 
     LightScene light_scene{};
 public:
@@ -28,10 +30,12 @@ public:
     void insert_entity(std::shared_ptr<EntityRenderer::Entity> entity);
     void insert_entity(std::shared_ptr<AnimatedEntityRenderer::Entity> entity);
     void insert_entity(std::shared_ptr<EmissiveEntityRenderer::Entity> entity);
+    void insert_entity(std::shared_ptr<CrowdRenderer::Entity> entity);
 
     bool remove_entity(const std::shared_ptr<EntityRenderer::Entity>& entity);
     bool remove_entity(const std::shared_ptr<AnimatedEntityRenderer::Entity>& entity);
     bool remove_entity(const std::shared_ptr<EmissiveEntityRenderer::Entity>& entity);
+    bool remove_entity(const std::shared_ptr<CrowdRenderer::Entity>& entity);
 
     void insert_light(std::shared_ptr<PointLight> point_light);
 
@@ -13,6 +13,9 @@ struct RenderedEntity {
     InstanceData instance_data;
     RenderData render_data;
 
+    // The level of detail the model was last drawn at, updated by the renderer each frame
+    uint lod_level = 0;
+
     RenderedEntity(const std::shared_ptr<ModelHandle<VertexData>>& model, InstanceData instance_data, RenderData render_data);
 
     static std::shared_ptr<RenderedEntity<VertexData, InstanceData, RenderData>> create(std::shared_ptr<ModelHandle<VertexData>> model_handle, InstanceData instance_data, RenderData render_data);
@@ -36,6 +39,20 @@ struct AnimatedEntityInterface {
     virtual ~AnimatedEntityInterface() = default;
 };
 
+/// The two poses a reduced rate (animation LOD) instance interpolates between, which are evaluated
+/// at fixed steps of animation time so they only need updating once the time passes the later one.
+struct AnimationLodCache {
+    AnimationPose start_pose{};
+    AnimationPose end_pose{};
+    // The start pose is at start_step * interval, and the end pose one interval later
+    int64_t start_step = 0;
+    // The settings the cached poses were evaluated with, any change means they are out of date
+    uint animation_id = NONE_ANIMATION;
+    uint min_importance = 0;
+    double interval = 0.0;
+    bool valid = false;
+};
+
 /// A generic AnimatedRenderedEntity for use by animated renderers
 template<typename VertexData, typename InstanceData, typename RenderData>
 struct AnimatedRenderedEntity : public AnimatedEntityInterface {
@@ -46,6 +63,11 @@ struct AnimatedRenderedEntity : public AnimatedEntityInterface {
     // Animation Data
     uint animation_id = NONE_ANIMATION; // NONE_ANIMATION means disabled
     double animation_time_seconds = 0.0;
+    // Per node keyframe cursors, so this instance's playback can step through keys rather than search for them
+    std::vector<AnimationCursor> animation_cursors{};
+    // This instance's bone transforms, written by the renderer each frame
+    AnimationPose animation_pose{};
+    AnimationLodCache animation_lod_cache{};
 
     AnimatedRenderedEntity(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, InstanceData instance_data, RenderData render_data);
 
@@ -1,5 +1,7 @@
 #include "EditorScene.h"
 
+#include <chrono>
+
 #include <tinyfiledialogs/tinyfiledialogs.h>
 
 #include "rendering/imgui/ImGuiManager.h"
@@ -9,8 +11,10 @@
 #include "editor_scene/EntityElement.h"
 #include "editor_scene/AnimatedEntityElement.h"
 #include "editor_scene/EmissiveEntityElement.h"
+#include "editor_scene/CrowdElement.h"
 #include "editor_scene/PointLightElement.h"
 #include "editor_scene/GroupElement.h"
+#include "editor_scene/ScenePreload.h"
 #include "scene/SceneContext.h"
 
 EditorScene::EditorScene::EditorScene() {
@@ -96,6 +100,7 @@ void EditorScene::EditorScene::open(const SceneContext& scene_context) {
         {EntityElement::ELEMENT_TYPE_NAME,         [](const SceneContext& scene_context, ElementRef parent) { return EntityElement::new_default(scene_context, parent); }},
         {AnimatedEntityElement::ELEMENT_TYPE_NAME, [](const SceneContext& scene_context, ElementRef parent) { return AnimatedEntityElement::new_default(scene_context, parent); }},
         {EmissiveEntityElement::ELEMENT_TYPE_NAME, [](const SceneContext& scene_context, ElementRef parent) { return EmissiveEntityElement::new_default(scene_context, parent); }},
+        {CrowdElement::ELEMENT_TYPE_NAME,          [](const SceneContext& scene_context, ElementRef parent) { return CrowdElement::new_default(scene_context, parent); }},
     };
 
     /// All the light generators, new light types must be registered here to be able to be created in the UI
@@ -108,9 +113,19 @@ void EditorScene::EditorScene::open(const SceneContext& scene_context) {
         {EntityElement::ELEMENT_TYPE_NAME,         [](const SceneContext& scene_context, ElementRef parent, const json& j) { return EntityElement::from_json(scene_context, parent, j); }},
         {AnimatedEntityElement::ELEMENT_TYPE_NAME, [](const SceneContext& scene_context, ElementRef parent, const json& j) { return AnimatedEntityElement::from_json(scene_context, parent, j); }},
         {EmissiveEntityElement::ELEMENT_TYPE_NAME, [](const SceneContext& scene_context, ElementRef parent, const json& j) { return EmissiveEntityElement::from_json(scene_context, parent, j); }},
+        {CrowdElement::ELEMENT_TYPE_NAME,          [](const SceneContext& scene_context, ElementRef parent, const json& j) { return CrowdElement::from_json(scene_context, parent, j); }},
         {PointLightElement::ELEMENT_TYPE_NAME,     [](const SceneContext& scene_context, ElementRef parent, const json& j) { return PointLightElement::from_json(scene_context, parent, j); }},
         {GroupElement::ELEMENT_TYPE_NAME,          [](const SceneContext&, ElementRef parent, const json& j) { return GroupElement::from_json(parent, j); }},
     };
+
+    /// The preloaders for all the element types that load files from json
+    json_preloaders = {
+        {EntityElement::ELEMENT_TYPE_NAME,         [](ScenePreload& preload, const json& j) { EntityElement::preload_json(preload, j); }},
+        {AnimatedEntityElement::ELEMENT_TYPE_NAME, [](ScenePreload& preload, const json& j) { AnimatedEntityElement::preload_json(preload, j); }},
+        {EmissiveEntityElement::ELEMENT_TYPE_NAME, [](ScenePreload& preload, const json& j) { EmissiveEntityElement::preload_json(preload, j); }},
+        {CrowdElement::ELEMENT_TYPE_NAME,          [](ScenePreload& preload, const json& j) { CrowdElement::preload_json(preload, j); }},
+        {PointLightElement::ELEMENT_TYPE_NAME,     [](ScenePreload& preload, const json& j) { PointLightElement::preload_json(preload, j); }},
+    };
 }
 
 std::pair<TickResponseType, std::shared_ptr<SceneInterface>> EditorScene::EditorScene::tick(float /*delta_time*/, const SceneContext& scene_context) {
@@ -533,6 +548,24 @@ void EditorScene::EditorScene::add_labelled_json_element(const SceneContext& sce
     }
 }
 
+uint EditorScene::EditorScene::preload_labelled_json_element(ScenePreload& preload, const json& j) {
+    // Elements that can't be loaded are skipped, and reported by add_labelled_json_element
+    if (j.contains("error") || !j.contains("label")) return 0;
+
+    auto preloader = json_preloaders.find(j["label"]);
+    if (preloader != json_preloaders.end()) {
+        preloader->second(preload, j);
+    }
+
+    uint element_count = 1;
+    if (j.contains("children")) {
+        for (const auto& child: j["children"]) {
+            element_count += preload_labelled_json_element(preload, child);
+        }
+    }
+    return element_count;
+}
+
 void EditorScene::EditorScene::save_to_json_file() {
     auto old_path = save_path;
 
@@ -610,9 +643,20 @@ void EditorScene::EditorScene::load_from_json_file(const SceneContext& scene_con
     try {
         selected_element = NullElementRef;
 
+        auto start_time = std::chrono::steady_clock::now();
+
         std::ifstream f(save_path.value());
         json data = json::parse(f);
 
+        // Load every file the scene uses at once, in parallel, then build the elements from the loaded files
+        ScenePreload preload{scene_context};
+        uint element_count = 0;
+        for (const auto& item: data) {
+            element_count += preload_labelled_json_element(preload, item);
+        }
+        preload.load();
+        auto preload_time = std::chrono::steady_clock::now();
+
         for (const auto& item: data) {
             add_labelled_json_element(scene_context, NullElementRef, scene_root, item);
         }
@@ -620,6 +664,12 @@ void EditorScene::EditorScene::load_from_json_file(const SceneContext& scene_con
         for (auto& item: *scene_root) {
             item->update_instance_data();
         }
+        auto end_time = std::chrono::steady_clock::now();
+
+        std::cout << "Loaded scene [" << save_path.value() << "]: " << element_count << " elements, "
+                  << preload.get_model_count() << " models and " << preload.get_texture_count() << " textures loaded in "
+                  << std::chrono::duration<double, std::milli>(preload_time - start_time).count() << " ms, elements built in "
+                  << std::chrono::duration<double, std::milli>(end_time - preload_time).count() << " ms" << std::endl;
     } catch (const std::exception& e) {
         std::swap(save_path, old_path);
         render_scene = std::move(old_render_scene);
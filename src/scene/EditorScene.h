@@ -43,6 +43,9 @@ namespace EditorScene {
 
         /// A list fo generators that construct scene elements from json data
         std::unordered_map<std::string, std::function<std::unique_ptr<SceneElement>(const SceneContext& scene_context, ElementRef parent, const json& j)>> json_generators;
+        /// The files each type of element loads in its json generator, so they can all be loaded up front, see ScenePreload.
+        /// Element types that don't load any files don't need one.
+        std::unordered_map<std::string, std::function<void(ScenePreload& preload, const json& j)>> json_preloaders;
         /// The current save path
         std::optional<std::string> save_path{};
 
@@ -76,6 +79,8 @@ namespace EditorScene {
         /// Helpers to save an element to json, and add an element from json
         [[nodiscard]] static json element_to_labelled_json(const SceneElement& element);
         void add_labelled_json_element(const SceneContext& scene_context, ElementRef parent, const ElementList& list, const json& j);
+        /// Recursively request the files an element and its children will load, returning the number of elements
+        uint preload_labelled_json_element(ScenePreload& preload, const json& j);
 
         /// Main save/load calls, which use the current save_path or pop-up a native file dialog
         void save_to_json_file();
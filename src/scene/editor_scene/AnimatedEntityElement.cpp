@@ -1,9 +1,12 @@
 #include "AnimatedEntityElement.h"
 
+#include <iostream>
+
 #include <glm/gtx/transform.hpp>
 
 #include "rendering/imgui/ImGuiManager.h"
 #include "scene/SceneContext.h"
+#include "ScenePreload.h"
 
 std::unique_ptr<EditorScene::AnimatedEntityElement> EditorScene::AnimatedEntityElement::new_default(const SceneContext& scene_context, ElementRef parent) {
     auto rendered_entity = AnimatedEntityRenderer::Entity::create(
@@ -44,17 +47,31 @@ std::unique_ptr<EditorScene::AnimatedEntityElement> EditorScene::AnimatedEntityE
     new_entity->rendered_entity->render_data.specular_map_texture = texture_from_json(scene_context, j["specular_map_texture"]);
 
     json animation_parameters = j["animation_parameters"];
-    new_entity->animation_parameters.animation_id = animation_parameters["animation_id"];
+    uint animation_id = animation_parameters["animation_id"];
+    const auto& animations = new_entity->rendered_entity->mesh_hierarchy->animations;
+    if (animation_id != NONE_ANIMATION && animation_id >= animations.size()) {
+        std::cerr << "Animated Entity with model [" << j["model"].get<std::string>() << "] has animation id " << animation_id
+                  << ", but the model only has " << animations.size() << " animations, so it will not be animated" << std::endl;
+        animation_id = NONE_ANIMATION;
+    }
+    new_entity->animation_parameters.animation_id = animation_id;
     new_entity->animation_parameters.speed = animation_parameters["speed"];
     new_entity->animation_parameters.paused = animation_parameters["paused"];
     new_entity->animation_parameters.loop = animation_parameters["loop"];
-    new_entity->rendered_entity->animation_id = animation_parameters["animation_id"];
+    new_entity->rendered_entity->animation_id = animation_id;
     new_entity->rendered_entity->animation_time_seconds = animation_parameters["animation_time_seconds"];
 
     new_entity->update_instance_data();
     return new_entity;
 }
 
+void EditorScene::AnimatedEntityElement::preload_json(ScenePreload& preload, const json& j) {
+    preload.add_hierarchy<AnimatedEntityRenderer::VertexData>("cube.obj");
+    preload.add_hierarchy<AnimatedEntityRenderer::VertexData>(j["model"]);
+    preload.add_texture(j["diffuse_texture"]);
+    preload.add_texture(j["specular_map_texture"]);
+}
+
 json EditorScene::AnimatedEntityElement::into_json() const {
     if (!rendered_entity->mesh_hierarchy->filename.has_value()) {
         return {
@@ -86,9 +103,10 @@ void EditorScene::AnimatedEntityElement::add_imgui_edit_section(MasterRenderScen
     add_material_imgui_edit_section(render_scene, scene_context);
 
     ImGui::Text("Model & Textures");
-    if (scene_context.model_loader.add_imgui_hierarchy_selector("Model Selection", rendered_entity->mesh_hierarchy)) {
+    if (scene_context.model_loader.add_imgui_hierarchy_selector("Model Selection", rendered_entity->mesh_hierarchy, rendered_entity)) {
+        // The old animation means nothing to the new model, and its cached duration would be wrong
+        render_scene.animator.stop(rendered_entity);
         animation_parameters.animation_id = NONE_ANIMATION;
-        rendered_entity->animation_time_seconds = 0.0;
     }
     scene_context.texture_loader.add_imgui_texture_selector("Diffuse Texture", rendered_entity->render_data.diffuse_texture);
     scene_context.texture_loader.add_imgui_texture_selector("Specular Map", rendered_entity->render_data.specular_map_texture, false);
@@ -20,6 +20,8 @@ namespace EditorScene {
 
         static std::unique_ptr<AnimatedEntityElement> new_default(const SceneContext& scene_context, ElementRef parent);
         static std::unique_ptr<AnimatedEntityElement> from_json(const SceneContext& scene_context, ElementRef parent, const json& j);
+        /// Request the files from_json will load, so a whole scene's files can be loaded at once, see ScenePreload
+        static void preload_json(ScenePreload& preload, const json& j);
         [[nodiscard]] json into_json() const override;
 
         void add_imgui_edit_section(MasterRenderScene& render_scene, const SceneContext& scene_context) override;
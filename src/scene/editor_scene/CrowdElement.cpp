@@ -0,0 +1,202 @@
+#include "CrowdElement.h"
+
+#include <iostream>
+
+#include <glm/gtx/transform.hpp>
+
+#include "rendering/imgui/ImGuiManager.h"
+#include "scene/SceneContext.h"
+#include "ScenePreload.h"
+
+std::unique_ptr<EditorScene::CrowdElement> EditorScene::CrowdElement::new_default(const SceneContext& scene_context, ElementRef parent) {
+    auto rendered_entity = CrowdRenderer::Crowd::create(
+        scene_context.model_loader.load_hierarchy_from_file<CrowdRenderer::VertexData>("cube.obj"),
+        CrowdRenderer::InstanceData{glm::mat4{}, CrowdRenderer::EntityMaterial{
+            {1.0f, 1.0f, 1.0f, 1.0f},
+            {1.0f, 1.0f, 1.0f, 1.0f},
+            {1.0f, 1.0f, 1.0f, 1.0f},
+            512.0f,
+        }},
+        CrowdRenderer::RenderData{
+            scene_context.texture_loader.default_white_texture(),
+            scene_context.texture_loader.default_white_texture()
+        }
+    );
+
+    auto new_entity = std::make_unique<CrowdElement>(
+        parent,
+        "New Crowd",
+        glm::vec3{0.0f},
+        glm::vec3{0.0f},
+        glm::vec3{1.0f},
+        rendered_entity
+    );
+
+    new_entity->update_instance_data();
+    new_entity->update_instances();
+    return new_entity;
+}
+
+std::unique_ptr<EditorScene::CrowdElement> EditorScene::CrowdElement::from_json(const SceneContext& scene_context, EditorScene::ElementRef parent, const json& j) {
+    auto new_entity = new_default(scene_context, parent);
+
+    new_entity->update_local_transform_from_json(j);
+    new_entity->update_material_from_json(j);
+
+    new_entity->rendered_entity->mesh_hierarchy = scene_context.model_loader.load_hierarchy_from_file<CrowdRenderer::VertexData>(j["model"]);
+    new_entity->rendered_entity->render_data.diffuse_texture = texture_from_json(scene_context, j["diffuse_texture"]);
+    new_entity->rendered_entity->render_data.specular_map_texture = texture_from_json(scene_context, j["specular_map_texture"]);
+
+    json crowd = j["crowd"];
+    new_entity->columns = crowd["columns"];
+    new_entity->rows = crowd["rows"];
+    new_entity->spacing = crowd["spacing"];
+    uint animation_id = crowd["animation_id"];
+    const auto& animations = new_entity->rendered_entity->mesh_hierarchy->animations;
+    if (animation_id != NONE_ANIMATION && animation_id >= animations.size()) {
+        std::cerr << "Crowd with model [" << j["model"].get<std::string>() << "] has animation id " << animation_id
+                  << ", but the model only has " << animations.size() << " animations, so it will not be animated" << std::endl;
+        animation_id = NONE_ANIMATION;
+    } else if (animation_id != NONE_ANIMATION && animation_id >= MAX_CROWD_ANIMATIONS) {
+        // CrowdRenderer only uploads the first MAX_CROWD_ANIMATIONS animations, and would draw the rest in the bind pose
+        std::cerr << "Crowd with model [" << j["model"].get<std::string>() << "] has animation id " << animation_id
+                  << ", but crowds can only play the first " << MAX_CROWD_ANIMATIONS << " animations, so it will not be animated" << std::endl;
+        animation_id = NONE_ANIMATION;
+    }
+    new_entity->animation_id = animation_id;
+    new_entity->time_offset_spread = crowd["time_offset_spread"];
+    new_entity->rendered_entity->speed = crowd["speed"];
+
+    new_entity->update_instance_data();
+    new_entity->update_instances();
+    return new_entity;
+}
+
+void EditorScene::CrowdElement::preload_json(ScenePreload& preload, const json& j) {
+    preload.add_hierarchy<CrowdRenderer::VertexData>("cube.obj");
+    preload.add_hierarchy<CrowdRenderer::VertexData>(j["model"]);
+    preload.add_texture(j["diffuse_texture"]);
+    preload.add_texture(j["specular_map_texture"]);
+}
+
+json EditorScene::CrowdElement::into_json() const {
+    if (!rendered_entity->mesh_hierarchy->filename.has_value()) {
+        return {
+            {"error", Formatter() << "Crowd [" << name << "]'s model does not have a filename so can not be exported, and has been skipped."}
+        };
+    }
+
+    return {
+        local_transform_into_json(),
+        material_into_json(),
+        {"model", rendered_entity->mesh_hierarchy->filename.value()},
+        {"diffuse_texture", texture_to_json(rendered_entity->render_data.diffuse_texture)},
+        {"specular_map_texture", texture_to_json(rendered_entity->render_data.specular_map_texture)},
+        {"crowd", {
+            {"columns", columns},
+            {"rows", rows},
+            {"spacing", spacing},
+            {"animation_id", animation_id},
+            {"time_offset_spread", time_offset_spread},
+            {"speed", rendered_entity->speed},
+        }}
+    };
+}
+
+void EditorScene::CrowdElement::add_imgui_edit_section(MasterRenderScene& render_scene, const SceneContext& scene_context) {
+    ImGui::Text("Crowd");
+    SceneElement::add_imgui_edit_section(render_scene, scene_context);
+
+    add_local_transform_imgui_edit_section(render_scene, scene_context);
+    add_material_imgui_edit_section(render_scene, scene_context);
+
+    ImGui::Text("Model & Textures");
+    bool instances_changed = false;
+    if (scene_context.model_loader.add_imgui_hierarchy_selector("Model Selection", rendered_entity->mesh_hierarchy, rendered_entity)) {
+        animation_id = NONE_ANIMATION;
+        instances_changed = true;
+    }
+    scene_context.texture_loader.add_imgui_texture_selector("Diffuse Texture", rendered_entity->render_data.diffuse_texture);
+    scene_context.texture_loader.add_imgui_texture_selector("Specular Map", rendered_entity->render_data.specular_map_texture, false);
+    ImGui::Spacing();
+
+    ImGui::Text("Layout & Animation");
+    instances_changed |= ImGui::DragInt("Columns", &columns, 0.2f, 1, 1024);
+    instances_changed |= ImGui::DragInt("Rows", &rows, 0.2f, 1, 1024);
+    instances_changed |= ImGui::DragFloat("Spacing", &spacing, 0.05f, 0.0f, FLT_MAX);
+    columns = std::max(columns, 1);
+    rows = std::max(rows, 1);
+
+    const auto& animations = rendered_entity->mesh_hierarchy->animations;
+    std::string selected_animation = animation_id < animations.size() ? std::get<0>(animations[animation_id]) : "[NONE]";
+    if (ImGui::BeginCombo("Animation Selection", selected_animation.c_str(), 0)) {
+        // Only the animations CrowdRenderer can play are offered
+        for (auto i = 0u; i < std::min((uint) animations.size(), (uint) MAX_CROWD_ANIMATIONS); ++i) {
+            const bool is_selected = i == animation_id;
+            if (ImGui::Selectable(std::get<0>(animations[i]).c_str(), is_selected)) {
+                animation_id = i;
+                instances_changed = true;
+            }
+            if (is_selected)
+                ImGui::SetItemDefaultFocus();
+        }
+        if (ImGui::Selectable("[NONE]", animation_id == NONE_ANIMATION)) {
+            animation_id = NONE_ANIMATION;
+            instances_changed = true;
+        }
+        ImGui::EndCombo();
+    }
+    instances_changed |= ImGui::DragFloat("Time Offset Spread (sec)", &time_offset_spread, 0.01f, 0.0f, FLT_MAX);
+
+    auto float_speed = (float) rendered_entity->speed;
+    if (ImGui::SliderFloat("Speed", &float_speed, 0.0f, 10.0f)) {
+        rendered_entity->speed = float_speed;
+    }
+
+    if (instances_changed) {
+        update_instances();
+    }
+    ImGui::TextDisabled("Instances: %d", columns * rows);
+    ImGui::Spacing();
+}
+
+void EditorScene::CrowdElement::update_instance_data() {
+    transform = calc_model_matrix();
+
+    if (!EditorScene::is_null(parent)) {
+        // Post multiply by transform so that local transformations are applied first
+        transform = (*parent)->transform * transform;
+    }
+
+    rendered_entity->instance_data.model_matrix = transform;
+    rendered_entity->instance_data.material = material;
+}
+
+void EditorScene::CrowdElement::update_instances() {
+    auto max_instances = (int) CrowdRenderer::Crowd::MAX_INSTANCES;
+    rows = std::min(rows, std::max(max_instances / columns, 1));
+    columns = std::min(columns, max_instances);
+
+    std::vector<CrowdRenderer::CrowdInstance> instances{};
+    instances.reserve(columns * rows);
+
+    // Centre the grid on the element
+    glm::vec3 origin{-0.5f * spacing * (float) (columns - 1), 0.0f, -0.5f * spacing * (float) (rows - 1)};
+    for (auto row = 0; row < rows; ++row) {
+        for (auto column = 0; column < columns; ++column) {
+            // A cheap integer hash, so instances are out of step with each other, but the same every time the crowd is built
+            uint hash = (uint) (row * columns + column) * 2654435761u;
+            hash ^= hash >> 16u;
+            float offset = (float) (hash & 0xFFFFu) / 65535.0f * time_offset_spread;
+
+            glm::vec3 position = origin + glm::vec3{spacing * (float) column, 0.0f, spacing * (float) row};
+            instances.push_back({glm::translate(position), animation_id, offset});
+        }
+    }
+
+    rendered_entity->set_instances(std::move(instances));
+}
+
+const char* EditorScene::CrowdElement::element_type_name() const {
+    return ELEMENT_TYPE_NAME;
+}
@@ -0,0 +1,53 @@
+#ifndef CROWD_ELEMENT_H
+#define CROWD_ELEMENT_H
+
+#include "SceneElement.h"
+#include "scene/SceneContext.h"
+
+namespace EditorScene {
+    /// A grid of identical animated characters, drawn by the CrowdRenderer
+    class CrowdElement : virtual public SceneElement, public LocalTransformComponent, public LitMaterialComponent {
+    public:
+        /// NOTE: Must be unique per element type, as it is used to select generators,
+        ///       so if you are creating a new element type make sure to change this to a new unique name.
+        static constexpr const char* ELEMENT_TYPE_NAME = "Crowd";
+
+        std::shared_ptr<CrowdRenderer::Entity> rendered_entity;
+
+        // Layout of the grid of instances
+        int columns = 10;
+        int rows = 10;
+        float spacing = 2.0f;
+        // Every instance plays this animation, starting at a pseudo-random offset within the spread
+        uint animation_id = NONE_ANIMATION;
+        float time_offset_spread = 1.0f;
+
+        CrowdElement(const ElementRef& parent, std::string name, const glm::vec3& position, const glm::vec3& euler_rotation, const glm::vec3& scale, std::shared_ptr<CrowdRenderer::Entity> rendered_entity) :
+            SceneElement(parent, std::move(name)), LocalTransformComponent(position, euler_rotation, scale), LitMaterialComponent(rendered_entity->instance_data.material), rendered_entity(std::move(rendered_entity)) {}
+
+        static std::unique_ptr<CrowdElement> new_default(const SceneContext& scene_context, ElementRef parent);
+        static std::unique_ptr<CrowdElement> from_json(const SceneContext& scene_context, ElementRef parent, const json& j);
+        /// Request the files from_json will load, so a whole scene's files can be loaded at once, see ScenePreload
+        static void preload_json(ScenePreload& preload, const json& j);
+        [[nodiscard]] json into_json() const override;
+
+        void add_imgui_edit_section(MasterRenderScene& render_scene, const SceneContext& scene_context) override;
+
+        void update_instance_data() override;
+
+        /// Rebuild the crowd's instances from the grid layout and animation settings
+        void update_instances();
+
+        void add_to_render_scene(MasterRenderScene& target_render_scene) override {
+            target_render_scene.insert_entity(rendered_entity);
+        }
+
+        void remove_from_render_scene(MasterRenderScene& target_render_scene) override {
+            target_render_scene.remove_entity(rendered_entity);
+        }
+
+        [[nodiscard]] const char* element_type_name() const override;
+    };
+}
+
+#endif //CROWD_ELEMENT_H
@@ -4,6 +4,7 @@
 
 #include "rendering/imgui/ImGuiManager.h"
 #include "scene/SceneContext.h"
+#include "ScenePreload.h"
 
 std::unique_ptr<EditorScene::EmissiveEntityElement> EditorScene::EmissiveEntityElement::new_default(const SceneContext& scene_context, ElementRef parent) {
     auto rendered_entity = EmissiveEntityRenderer::Entity::create(
@@ -45,6 +46,12 @@ std::unique_ptr<EditorScene::EmissiveEntityElement> EditorScene::EmissiveEntityE
     return new_entity;
 }
 
+void EditorScene::EmissiveEntityElement::preload_json(ScenePreload& preload, const json& j) {
+    preload.add_model<EmissiveEntityRenderer::VertexData>("cube.obj");
+    preload.add_model<EmissiveEntityRenderer::VertexData>(j["model"]);
+    preload.add_texture(j["emission_texture"]);
+}
+
 json EditorScene::EmissiveEntityElement::into_json() const {
     if (!rendered_entity->model->get_filename().has_value()) {
         return {
@@ -69,7 +76,7 @@ void EditorScene::EmissiveEntityElement::add_imgui_edit_section(MasterRenderScen
     add_emissive_material_imgui_edit_section(render_scene, scene_context);
 
     ImGui::Text("Model & Textures");
-    scene_context.model_loader.add_imgui_model_selector("Model Selection", rendered_entity->model);
+    scene_context.model_loader.add_imgui_model_selector("Model Selection", rendered_entity->model, rendered_entity);
     scene_context.texture_loader.add_imgui_texture_selector("Emission Texture", rendered_entity->render_data.emission_texture);
     ImGui::Spacing();
 }
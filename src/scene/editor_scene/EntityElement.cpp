@@ -2,6 +2,7 @@
 
 #include "rendering/imgui/ImGuiManager.h"
 #include "scene/SceneContext.h"
+#include "ScenePreload.h"
 
 std::unique_ptr<EditorScene::EntityElement> EditorScene::EntityElement::new_default(const SceneContext& scene_context, ElementRef parent) {
     auto rendered_entity = EntityRenderer::Entity::create(
@@ -48,6 +49,13 @@ std::unique_ptr<EditorScene::EntityElement> EditorScene::EntityElement::from_jso
     return new_entity;
 }
 
+void EditorScene::EntityElement::preload_json(ScenePreload& preload, const json& j) {
+    preload.add_model<EntityRenderer::VertexData>("cube.obj");
+    preload.add_model<EntityRenderer::VertexData>(j["model"]);
+    preload.add_texture(j["diffuse_texture"]);
+    preload.add_texture(j["specular_map_texture"]);
+}
+
 json EditorScene::EntityElement::into_json() const {
     if (!rendered_entity->model->get_filename().has_value()) {
         return {
@@ -72,7 +80,7 @@ void EditorScene::EntityElement::add_imgui_edit_section(MasterRenderScene& rende
     add_material_imgui_edit_section(render_scene, scene_context);
 
     ImGui::Text("Model & Textures");
-    scene_context.model_loader.add_imgui_model_selector("Model Selection", rendered_entity->model);
+    scene_context.model_loader.add_imgui_model_selector("Model Selection", rendered_entity->model, rendered_entity);
     scene_context.texture_loader.add_imgui_texture_selector("Diffuse Texture", rendered_entity->render_data.diffuse_texture);
     scene_context.texture_loader.add_imgui_texture_selector("Specular Map", rendered_entity->render_data.specular_map_texture, false);
     ImGui::Spacing();
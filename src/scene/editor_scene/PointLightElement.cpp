@@ -5,6 +5,7 @@
 
 #include "rendering/imgui/ImGuiManager.h"
 #include "scene/SceneContext.h"
+#include "ScenePreload.h"
 
 std::unique_ptr<EditorScene::PointLightElement> EditorScene::PointLightElement::new_default(const SceneContext& scene_context, EditorScene::ElementRef parent) {
     auto light_element = std::make_unique<PointLightElement>(
@@ -45,6 +46,10 @@ std::unique_ptr<EditorScene::PointLightElement> EditorScene::PointLightElement::
     return light_element;
 }
 
+void EditorScene::PointLightElement::preload_json(ScenePreload& preload, const json& /*j*/) {
+    preload.add_model<EmissiveEntityRenderer::VertexData>("sphere.obj");
+}
+
 json EditorScene::PointLightElement::into_json() const {
     return {
         {"position",     position},
@@ -188,7 +188,7 @@ void EditorScene::AnimationComponent::add_animation_imgui_edit_section(MasterRen
             if (ImGui::Selectable(std::get<0>(animation).c_str(), is_selected)) {
                 render_scene.animator.stop(entity);
                 get_animation_parameters().animation_id = i;
-                entity->get_animation_time_seconds() = 0.0;
+                render_scene.animator.set_time(entity, 0.0);
             }
 
             // Set the initial focus when opening the combo (scrolling + keyboard navigation focus)
@@ -198,11 +198,11 @@ void EditorScene::AnimationComponent::add_animation_imgui_edit_section(MasterRen
         if (ImGui::Selectable("[NONE]", get_animation_parameters().animation_id == NONE_ANIMATION)) {
             render_scene.animator.stop(entity);
             get_animation_parameters().animation_id = NONE_ANIMATION;
-            entity->get_animation_time_seconds() = 0.0;
+            render_scene.animator.set_time(entity, 0.0);
         }
         ImGui::EndCombo();
 
-        entity->get_animation_id() = get_animation_parameters().animation_id;
+        render_scene.animator.set_animation(entity, get_animation_parameters().animation_id);
     }
     if (get_animation_parameters().animation_id != NONE_ANIMATION) {
         std::tie(selected_animation, ticks_per_second, duration_ticks) = animations[get_animation_parameters().animation_id];
@@ -210,7 +210,7 @@ void EditorScene::AnimationComponent::add_animation_imgui_edit_section(MasterRen
         auto float_time = (float) entity->get_animation_time_seconds();
         auto float_duration = (float) (duration_ticks / ticks_per_second);
         if (ImGui::SliderFloat("Animation Time (sec)", &float_time, 0.0f, float_duration, "%.3f", ImGuiSliderFlags_NoRoundToFormat)) {
-            entity->get_animation_time_seconds() = float_time;
+            render_scene.animator.set_time(entity, float_time);
         }
 
         bool is_playing = render_scene.animator.is_animating(entity).has_value();
@@ -12,6 +12,7 @@
 
 namespace EditorScene {
     class SceneElement;
+    class ScenePreload;
 
     using ElementList = std::shared_ptr<std::list<std::unique_ptr<SceneElement>>>;
     using ElementRef = ElementList::element_type::iterator;
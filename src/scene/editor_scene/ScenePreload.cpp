@@ -0,0 +1,20 @@
+#include "ScenePreload.h"
+
+void EditorScene::ScenePreload::add_texture(const json& j) {
+    if (j.contains("error")) return;
+    texture_requests.push_back({j["filename"], j["is_srgb"], j["is_flipped"]});
+}
+
+void EditorScene::ScenePreload::load() {
+    // The textures are decoded while the workers are still importing the models
+    textures = scene_context.texture_loader.load_all_from_files(texture_requests);
+    scene_context.model_loader.finish_all_loads();
+}
+
+size_t EditorScene::ScenePreload::get_model_count() const {
+    return model_loads.size();
+}
+
+size_t EditorScene::ScenePreload::get_texture_count() const {
+    return textures.size();
+}
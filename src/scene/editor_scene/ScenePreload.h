@@ -0,0 +1,70 @@
+#ifndef SCENE_PRELOAD_H
+#define SCENE_PRELOAD_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <typeindex>
+#include <unordered_set>
+
+#include "utility/JsonHelper.h"
+#include "scene/SceneContext.h"
+
+namespace EditorScene {
+    /// Loads every model and texture a scene file references, before any of its elements are built.
+    /// The models are imported on the thread pool all at once and the textures decoded alongside them, rather than each file
+    /// being loaded in turn as its element is created. They are then kept alive while the elements are built, so each
+    /// element's from_json finds them already loaded. The textures may still be placeholders at that point, and are
+    /// uploaded over the following frames as their decodes finish.
+    class ScenePreload {
+        const SceneContext& scene_context;
+
+        // (relative_path, resource_type) of every model already requested
+        std::unordered_set<std::pair<std::string, std::type_index>, PairHash> requested_models{};
+        std::vector<std::shared_ptr<BasePendingLoad>> model_loads{};
+
+        std::vector<TextureLoader::TextureRequest> texture_requests{};
+        std::vector<std::shared_ptr<TextureHandle>> textures{};
+    public:
+        explicit ScenePreload(const SceneContext& scene_context) : scene_context(scene_context) {}
+
+        /// Request a model, that will be loaded with load_from_file<VertexData>
+        template<typename VertexData>
+        void add_model(const std::string& file);
+
+        /// Request a model, that will be loaded with load_hierarchy_from_file<VertexData>
+        template<typename VertexData>
+        void add_hierarchy(const std::string& file);
+
+        /// Request a texture, in the form written by SceneElement::texture_to_json
+        void add_texture(const json& j);
+
+        /// Wait for every model to be loaded, and start loading every texture.
+        void load();
+
+        [[nodiscard]] size_t get_model_count() const;
+        [[nodiscard]] size_t get_texture_count() const;
+    };
+
+    template<typename VertexData>
+    void ScenePreload::add_model(const std::string& file) {
+        if (!requested_models.insert({file, std::type_index(typeid(ModelHandle<VertexData>))}).second) return;
+        try {
+            model_loads.push_back(scene_context.model_loader.load_from_file_async<VertexData>(file));
+        } catch (const std::exception&) {
+            // Reported when the element is built, and loads the file itself
+        }
+    }
+
+    template<typename VertexData>
+    void ScenePreload::add_hierarchy(const std::string& file) {
+        if (!requested_models.insert({file, std::type_index(typeid(MeshHierarchy<VertexData>))}).second) return;
+        try {
+            model_loads.push_back(scene_context.model_loader.load_hierarchy_from_file_async<VertexData>(file));
+        } catch (const std::exception&) {
+            // Reported when the element is built, and loads the file itself
+        }
+    }
+}
+
+#endif //SCENE_PRELOAD_H
@@ -0,0 +1,263 @@
+#include "AssetRegistry.h"
+
+#include <iostream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+AssetRegistry::AssetRegistry(std::string root) : root(normalise(root)) {
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0) {
+        // Adding the watches also records the files, and watching before reading each directory means no change is missed
+        watch_directory(this->root);
+    } else {
+        std::cerr << "Failed to start inotify, polling " << this->root << " for changes instead" << std::endl;
+        rescan();
+    }
+#else
+    rescan();
+#endif
+    // Nothing has changed yet, the initial scan only fills in the registry
+    changed.clear();
+    last_poll = std::chrono::steady_clock::now();
+}
+
+std::string AssetRegistry::normalise(const std::string& path) {
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+void AssetRegistry::update() {
+#ifdef __linux__
+    if (inotify_fd >= 0) {
+        read_events();
+    } else
+#endif
+    if (std::chrono::steady_clock::now() - last_poll >= POLL_INTERVAL) {
+        rescan();
+        last_poll = std::chrono::steady_clock::now();
+    }
+
+    if (changed.empty()) return;
+
+    std::vector<std::string> changed_paths(changed.begin(), changed.end());
+    changed.clear();
+    std::sort(changed_paths.begin(), changed_paths.end());
+
+    for (const auto& [directory, listener]: listeners) {
+        auto prefix = directory + "/";
+        std::vector<std::string> changed_files{};
+        for (const auto& path: changed_paths) {
+            if (path.compare(0, prefix.size(), prefix) == 0) {
+                changed_files.push_back(path.substr(prefix.size()));
+            }
+        }
+        if (!changed_files.empty()) {
+            listener(changed_files);
+        }
+    }
+}
+
+void AssetRegistry::rescan() {
+#ifdef __linux__
+    // After an overflow, directories may have been created, or removed and created again, while their events were lost.
+    // Watching each directory as it is reached, before the files in it are read, means no change is missed, and the kernel
+    // gives back the same descriptor for any that are already watched.
+    bool watching = inotify_fd >= 0;
+    std::unordered_set<int> watches{};
+    if (watching) watches.insert(add_watch(root));
+#endif
+
+    std::unordered_map<std::string, std::filesystem::file_time_type> scanned{};
+    std::error_code error{};
+    for (auto iter = std::filesystem::recursive_directory_iterator(root, error); iter != std::filesystem::recursive_directory_iterator(); iter.increment(error)) {
+        if (error) break;
+#ifdef __linux__
+        if (watching && iter->is_directory(error)) {
+            watches.insert(add_watch(iter->path().generic_string()));
+            continue;
+        }
+#endif
+        if (!iter->is_regular_file(error)) continue;
+        auto last_write_time = iter->last_write_time(error);
+        if (error) continue;
+        scanned[iter->path().generic_string()] = last_write_time;
+    }
+
+    bool files_changed = false;
+    for (const auto& [path, last_write_time]: scanned) {
+        auto existing = files.find(path);
+        if (existing == files.end()) {
+            files_changed = true;
+            changed.insert(path);
+        } else if (existing->second != last_write_time) {
+            changed.insert(path);
+        }
+    }
+    for (const auto& [path, last_write_time]: files) {
+        if (scanned.count(path) == 0) {
+            files_changed = true;
+            changed.insert(path);
+        }
+    }
+
+    files = std::move(scanned);
+    if (files_changed) generation++;
+
+#ifdef __linux__
+    // Forget the watches of directories that are gone, whose IN_IGNORED events may have been lost too
+    if (watching) {
+        for (auto iter = watched_directories.begin(); iter != watched_directories.end();) {
+            iter = watches.count(iter->first) == 0 ? watched_directories.erase(iter) : std::next(iter);
+        }
+    }
+#endif
+}
+
+void AssetRegistry::refresh_file(const std::string& path) {
+    std::error_code error{};
+    auto last_write_time = std::filesystem::last_write_time(path, error);
+    if (error || !std::filesystem::is_regular_file(path, error)) {
+        remove_file(path);
+        return;
+    }
+
+    auto [entry, inserted] = files.insert_or_assign(path, last_write_time);
+    if (inserted) generation++;
+    changed.insert(path);
+}
+
+void AssetRegistry::remove_file(const std::string& path) {
+    if (files.erase(path) != 0) {
+        generation++;
+        changed.insert(path);
+    }
+}
+
+#ifdef __linux__
+int AssetRegistry::add_watch(const std::string& directory) {
+    // IN_ATTRIB catches `touch` and tools that restore a file's timestamps, which never close a written file
+    int watch = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB);
+    if (watch < 0) {
+        std::cerr << "Failed to watch " << directory << " for changes" << std::endl;
+        return watch;
+    }
+    watched_directories[watch] = directory;
+    return watch;
+}
+
+void AssetRegistry::watch_directory(const std::string& directory) {
+    if (add_watch(directory) < 0) return;
+
+    std::error_code error{};
+    for (const auto& entry: std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_directory(error)) {
+            watch_directory(entry.path().generic_string());
+        } else if (entry.is_regular_file(error)) {
+            refresh_file(entry.path().generic_string());
+        }
+    }
+}
+
+void AssetRegistry::read_events() {
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        auto length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && errno != EAGAIN) {
+                std::cerr << "Failed to read file changes, polling " << root << " for changes instead" << std::endl;
+                close(inotify_fd);
+                inotify_fd = -1;
+            }
+            return;
+        }
+
+        for (char* pointer = buffer; pointer < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(pointer);
+            pointer += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped, so only a full scan can tell what changed
+                rescan();
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watched_directories.erase(event->wd);
+                continue;
+            }
+
+            auto directory = watched_directories.find(event->wd);
+            if (directory == watched_directories.end() || event->len == 0) continue;
+            auto path = directory->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_directory(path);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    // The directory's own watch is removed by the kernel, so only its files need forgetting
+                    auto prefix = path + "/";
+                    std::vector<std::string> removed{};
+                    for (const auto& [file, last_write_time]: files) {
+                        if (file.compare(0, prefix.size(), prefix) == 0) removed.push_back(file);
+                    }
+                    for (const auto& file: removed) remove_file(file);
+                }
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                remove_file(path);
+            } else if ((event->mask & ~IN_ATTRIB) == 0) {
+                // Permission and ownership changes are attribute changes too, so only a new write time counts
+                auto known = files.find(path);
+                std::error_code error{};
+                auto last_write_time = std::filesystem::last_write_time(path, error);
+                if (!error && (known == files.end() || known->second != last_write_time)) refresh_file(path);
+            } else {
+                refresh_file(path);
+            }
+        }
+    }
+}
+#endif
+
+bool AssetRegistry::exists(const std::string& path) const {
+    return get_last_write_time(path).has_value();
+}
+
+std::optional<std::filesystem::file_time_type> AssetRegistry::get_last_write_time(const std::string& path) const {
+    auto entry = files.find(path);
+    if (entry == files.end()) {
+        // Paths built with other separators, or with "./" or "..", are stored differently
+        entry = files.find(normalise(path));
+        if (entry == files.end()) return std::nullopt;
+    }
+    return entry->second;
+}
+
+std::vector<std::string> AssetRegistry::list_files(const std::string& directory) const {
+    auto prefix = normalise(directory) + "/";
+    std::vector<std::string> listed{};
+    for (const auto& [path, last_write_time]: files) {
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+            listed.push_back(path.substr(prefix.size()));
+        }
+    }
+    std::sort(listed.begin(), listed.end());
+    return listed;
+}
+
+uint AssetRegistry::get_generation() const {
+    return generation;
+}
+
+void AssetRegistry::add_listener(const std::string& directory, Listener listener) {
+    listeners.emplace_back(normalise(directory), std::move(listener));
+}
+
+AssetRegistry::~AssetRegistry() {
+#ifdef __linux__
+    if (inotify_fd >= 0) close(inotify_fd);
+#endif
+}
@@ -0,0 +1,95 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "HelperTypes.h"
+
+/// An in memory record of every file under a directory (e.g. "res") and when it was last written, so the loaders can look
+/// a file up without touching the filesystem. The tree is scanned once, then kept current with inotify on Linux, or
+/// otherwise by rescanning every POLL_INTERVAL. The changes found are passed on to listeners, for hot reloading.
+/// Only used from the main thread.
+class AssetRegistry : private NonCopyable {
+public:
+    /// Called with every file under the listener's directory that was created, written or removed since the last update,
+    /// as paths relative to that directory.
+    using Listener = std::function<void(const std::vector<std::string>& changed_files)>;
+
+    /// How often the tree is rescanned, when inotify isn't available
+    static constexpr std::chrono::seconds POLL_INTERVAL{1};
+
+private:
+    std::string root;
+
+    // Map path (root/relative, with '/' separators) -> last_modified
+    std::unordered_map<std::string, std::filesystem::file_time_type> files{};
+    // Incremented whenever a file is added or removed, so listings built from the registry know to rebuild
+    uint generation = 0;
+
+    // [(directory, listener)]
+    std::vector<std::pair<std::string, Listener>> listeners{};
+
+    // The paths changed since the last update
+    std::unordered_set<std::string> changed{};
+
+    std::chrono::steady_clock::time_point last_poll{};
+
+#ifdef __linux__
+    int inotify_fd = -1;
+    // Map watch_descriptor -> directory
+    std::unordered_map<int, std::string> watched_directories{};
+
+    /// Watch the directory (but not those below it), returning the watch descriptor, or -1 if it couldn't be watched
+    int add_watch(const std::string& directory);
+
+    /// Watch the directory and all those below it, adding their files to the registry
+    void watch_directory(const std::string& directory);
+
+    void read_events();
+#endif
+
+    /// Scan the whole tree, recording the difference to what was there before as changes.
+    /// With inotify, also watches any directory that isn't watched yet, since it is used to recover from lost events.
+    void rescan();
+
+    /// Record the file's new write time, or its removal if it no longer exists
+    void refresh_file(const std::string& path);
+
+    void remove_file(const std::string& path);
+
+    /// A path as it is stored in the registry
+    static std::string normalise(const std::string& path);
+
+public:
+    /// Scan `root`, and start watching it for changes
+    explicit AssetRegistry(std::string root);
+
+    /// Pick up any changes since the last call, and pass them on to the listeners. Call once per frame.
+    void update();
+
+    /// Whether the file exists, where `path` includes the root, e.g. "res/models/cube.obj"
+    [[nodiscard]] bool exists(const std::string& path) const;
+
+    /// When the file was last written, or nothing if it doesn't exist
+    [[nodiscard]] std::optional<std::filesystem::file_time_type> get_last_write_time(const std::string& path) const;
+
+    /// Every file below the directory, relative to it and sorted
+    [[nodiscard]] std::vector<std::string> list_files(const std::string& directory) const;
+
+    /// Changes whenever a file is added or removed
+    [[nodiscard]] uint get_generation() const;
+
+    /// Call `listener` from update with the files changed below `directory`
+    void add_listener(const std::string& directory, Listener listener);
+
+    ~AssetRegistry();
+};
+
+#endif //ASSET_REGISTRY_H
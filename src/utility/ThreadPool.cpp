@@ -0,0 +1,116 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint thread_count) {
+    workers.reserve(thread_count);
+    for (auto i = 0u; i < thread_count; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (auto& worker: workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool{};
+    return pool;
+}
+
+uint ThreadPool::default_thread_count() {
+    uint hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 1;
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // Finish any queued work before stopping, so no future is left without a result
+            if (tasks.empty()) return;
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, size_t min_batch_size, const std::function<void(size_t begin, size_t end)>& function) {
+    if (count == 0) return;
+
+    min_batch_size = std::max<size_t>(min_batch_size, 1);
+    size_t max_batches = (count + min_batch_size - 1) / min_batch_size;
+    // A few batches per thread, so that uneven batches still balance out
+    size_t batch_count = std::min(max_batches, (size_t) (workers.size() + 1) * 4);
+
+    if (batch_count <= 1 || workers.empty()) {
+        function(0, count);
+        return;
+    }
+
+    size_t batch_size = (count + batch_count - 1) / batch_count;
+    batch_count = (count + batch_size - 1) / batch_size;
+
+    // Shared so that any helper that only starts after everything is done can still safely look at it
+    struct State {
+        std::atomic<size_t> next_batch{0};
+        std::atomic<size_t> completed_batches{0};
+        std::mutex mutex{};
+        std::condition_variable condition{};
+        // The first exception thrown by a batch, guarded by `mutex`
+        std::exception_ptr exception{};
+    };
+    auto state = std::make_shared<State>();
+
+    // Returns once there are no more batches to claim
+    auto run_batches = [state, batch_count, batch_size, count, &function]() {
+        while (true) {
+            size_t batch = state->next_batch.fetch_add(1);
+            if (batch >= batch_count) return;
+
+            size_t begin = batch * batch_size;
+            // Caught so that a throwing batch can't escape a worker, and is still counted as complete, so the caller
+            // always waits for every batch to finish with `function` before rethrowing
+            try {
+                function(begin, std::min(begin + batch_size, count));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock{state->mutex};
+                if (!state->exception) state->exception = std::current_exception();
+            }
+
+            if (state->completed_batches.fetch_add(1) + 1 == batch_count) {
+                std::lock_guard<std::mutex> lock{state->mutex};
+                state->condition.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(batch_count - 1, workers.size());
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto i = 0u; i < helpers; ++i) {
+            // `function` may be out of scope by the time a late helper runs, but by then
+            // every batch has been claimed, so the helper returns without calling it.
+            tasks.emplace_back(run_batches);
+        }
+    }
+    condition.notify_all();
+
+    run_batches();
+
+    std::unique_lock<std::mutex> lock{state->mutex};
+    state->condition.wait(lock, [&state, batch_count]() { return state->completed_batches.load() == batch_count; });
+    if (state->exception) std::rethrow_exception(state->exception);
+}
@@ -0,0 +1,77 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include "HelperTypes.h"
+
+/// A fixed size pool of worker threads, for spreading CPU work (culling, animation, asset loading) across cores.
+/// Nothing submitted to the pool may use OpenGL, since the context is only current on the main thread.
+class ThreadPool : private NonCopyable {
+    std::vector<std::thread> workers{};
+    std::deque<std::function<void()>> tasks{};
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    bool stopping = false;
+
+    void worker_loop();
+public:
+    /// Create a pool with `thread_count` workers, defaulting to one less than the number of hardware threads,
+    /// since the calling thread also participates in parallel_for.
+    explicit ThreadPool(uint thread_count = default_thread_count());
+
+    ~ThreadPool();
+
+    /// The pool shared by the whole application
+    static ThreadPool& global();
+
+    static uint default_thread_count();
+
+    [[nodiscard]] uint get_thread_count() const {
+        return (uint) workers.size();
+    }
+
+    /// Queue a task, returning a future for its result.
+    template<typename Function>
+    std::future<std::invoke_result_t<Function>> submit(Function&& function);
+
+    /// Call `function(begin, end)` over [0, count) split into batches of at least `min_batch_size`,
+    /// blocking until every batch is complete. The calling thread works on batches too, so this never
+    /// deadlocks even if every worker is busy, and can be nested inside a task.
+    /// If any batch throws, the rest still run, and the first exception is rethrown once they have all finished.
+    void parallel_for(size_t count, size_t min_batch_size, const std::function<void(size_t begin, size_t end)>& function);
+};
+
+template<typename Function>
+std::future<std::invoke_result_t<Function>> ThreadPool::submit(Function&& function) {
+    using Result = std::invoke_result_t<Function>;
+
+    // packaged_task is move only, but std::function requires copyable, so share it
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+    auto future = task->get_future();
+
+    if (workers.empty()) {
+        (*task)();
+        return future;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        tasks.emplace_back([task]() { (*task)(); });
+    }
+    condition.notify_one();
+
+    return future;
+}
+
+#endif //THREAD_POOL_H
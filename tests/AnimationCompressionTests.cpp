@@ -0,0 +1,121 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TestHelpers.h"
+#include "rendering/resources/MeshHierarchy.h"
+
+namespace {
+    /// A rotation of `angle` radians about the unit vector `axis`
+    glm::quat axis_rotation(float angle, const glm::vec3& axis) {
+        float s = std::sin(angle * 0.5f);
+        return glm::quat{std::cos(angle * 0.5f), axis.x * s, axis.y * s, axis.z * s};
+    }
+
+    /// Densely sampled smooth motion, like a baked mocap clip, which reduction should remove most of
+    AnimationKeys make_smooth_keys(uint key_count) {
+        AnimationKeys keys{};
+        glm::vec3 axis = glm::normalize(glm::vec3{0.3f, 1.0f, 0.2f});
+        for (auto i = 0u; i < key_count; ++i) {
+            auto t = (float) i;
+            keys.add_position_key(t, {std::sin(t * 0.01f) * 0.5f, t * 0.01f, std::cos(t * 0.01f) * 0.5f});
+            keys.add_rotation_key(t, axis_rotation(std::sin(t * 0.005f) * 1.5f, axis));
+            keys.add_scaling_key(t, glm::vec3{1.0f + 0.05f * std::sin(t * 0.01f)});
+        }
+        keys.sort_keys();
+        return keys;
+    }
+
+    /// Keys with no relation to their neighbours, so reduction can remove almost none of them
+    AnimationKeys make_noisy_keys(uint key_count) {
+        AnimationKeys keys{};
+        std::mt19937 random{42};
+        std::uniform_real_distribution<float> value{-1.0f, 1.0f};
+        for (auto i = 0u; i < key_count; ++i) {
+            auto t = (float) i * 0.5f;
+            keys.add_position_key(t, {value(random) * 10.0f, value(random) * 10.0f, value(random) * 10.0f});
+            keys.add_rotation_key(t, glm::normalize(glm::quat{value(random), value(random), value(random), value(random)}));
+            keys.add_scaling_key(t, {1.0f + value(random) * 0.5f, 1.0f, 1.0f});
+        }
+        keys.sort_keys();
+        return keys;
+    }
+
+    /// The largest error in the sampled translation at each position key, checked independently of measure_error.
+    /// Sampled at the time each key was quantised to, since quantising a time moves the key rather than changing its value.
+    float max_sampled_position_error(const AnimationData& data, const AnimationKeys& keys) {
+        float error = 0.0f;
+        for (auto i = 0u; i < keys.positions.size(); ++i) {
+            double time = data.start_time + (double) data.quantise_time(keys.position_times[i]) / data.time_scale;
+            glm::vec3 translation = data.sample(time)[3];
+            error = std::max(error, glm::distance(translation, keys.positions[i]));
+        }
+        return error;
+    }
+
+    void check_within_tolerance(const AnimationKeys& keys, const AnimationCompressionSettings& settings) {
+        AnimationData data = AnimationData::compress(keys, settings);
+        AnimationError error = data.measure_error(keys);
+
+        CHECK_LE(error.position, settings.position_tolerance);
+        CHECK_LE(error.rotation, settings.rotation_tolerance);
+        CHECK_LE(error.scaling, settings.scaling_tolerance);
+        CHECK(error.within(settings));
+        // Slack for the float error in composing the matrix
+        CHECK_LE(max_sampled_position_error(data, keys), settings.position_tolerance + 1e-5f);
+    }
+
+    AnimationCompressionSettings make_settings(float position, float rotation, float scaling) {
+        AnimationCompressionSettings settings{};
+        settings.position_tolerance = position;
+        settings.rotation_tolerance = rotation;
+        settings.scaling_tolerance = scaling;
+        return settings;
+    }
+}
+
+TEST_CASE("Smooth keys stay within the default tolerances") {
+    check_within_tolerance(make_smooth_keys(301), AnimationCompressionSettings{});
+}
+
+TEST_CASE("Smooth keys stay within loose and tight tolerances") {
+    auto keys = make_smooth_keys(301);
+    check_within_tolerance(keys, make_settings(0.01f, 0.01f, 0.01f));
+    check_within_tolerance(keys, make_settings(0.0001f, 0.0005f, 0.0001f));
+}
+
+TEST_CASE("Noisy keys stay within the default tolerances") {
+    check_within_tolerance(make_noisy_keys(200), AnimationCompressionSettings{});
+}
+
+TEST_CASE("Reduction removes most smooth keys, and none without reduction") {
+    auto keys = make_smooth_keys(301);
+    AnimationData reduced = AnimationData::compress(keys, AnimationCompressionSettings{});
+    CHECK_LE(reduced.get_key_count() * 4, keys.get_key_count());
+
+    AnimationCompressionSettings no_reduction{};
+    no_reduction.reduce_keys = false;
+    AnimationData quantised = AnimationData::compress(keys, no_reduction);
+    CHECK_EQ(quantised.get_key_count(), keys.get_key_count());
+    check_within_tolerance(keys, no_reduction);
+}
+
+TEST_CASE("Quaternion packing stays within its documented error") {
+    std::mt19937 random{7};
+    std::uniform_real_distribution<float> value{-1.0f, 1.0f};
+    for (auto i = 0; i < 10000; ++i) {
+        glm::quat rotation = glm::normalize(glm::quat{value(random), value(random), value(random), value(random)});
+        glm::quat unpacked = QuantisedQuat::pack(rotation).unpack();
+        // q and -q are the same rotation. In double and with atan2, since acos(dot) in float can't resolve angles this small
+        if (glm::dot(rotation, unpacked) < 0.0f) unpacked = -unpacked;
+        double difference = glm::length(rotation - unpacked);
+        double sum = glm::length(rotation + unpacked);
+        CHECK_LE(4.0 * std::atan2(difference, sum), QuantisedQuat::MAX_ERROR);
+    }
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
@@ -0,0 +1,153 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TestHelpers.h"
+#include "rendering/resources/MeshHierarchy.h"
+
+namespace {
+    /// Only needed to instantiate a MeshHierarchy, nothing is uploaded
+    struct TestVertexData {
+        glm::vec3 position;
+    };
+
+    glm::quat random_rotation(std::mt19937& random) {
+        std::uniform_real_distribution<float> value{-1.0f, 1.0f};
+        return glm::normalize(glm::quat{value(random), value(random), value(random), value(random)});
+    }
+
+    /// A channel with keys at random values, and times spread unevenly over [0, duration]
+    AnimationData make_channel(std::mt19937& random, float duration) {
+        std::uniform_real_distribution<float> value{-1.0f, 1.0f};
+        std::uniform_real_distribution<float> time{0.0f, duration};
+        AnimationKeys keys{};
+        for (auto i = 0; i < 12; ++i) {
+            float t = i == 0 ? 0.0f : i == 1 ? duration : time(random);
+            keys.add_position_key(t, {value(random), value(random), value(random)});
+            keys.add_rotation_key(t, random_rotation(random));
+            keys.add_scaling_key(t, {1.0f + 0.5f * value(random), 1.0f, 1.0f + 0.5f * value(random)});
+        }
+        keys.sort_keys();
+
+        AnimationCompressionSettings no_reduction{};
+        no_reduction.reduce_keys = false;
+        return AnimationData::compress(keys, no_reduction);
+    }
+
+    /// translate(p) * toMat4(q) * scale(s), with the rotation found by scalar nlerp, as the reference for the batched sampler
+    glm::mat4 sample_nlerp(const AnimationData& channel, double time) {
+        AnimationCursor cursor{UINT_MAX, UINT_MAX, UINT_MAX};
+        AnimationKeyPair keys{};
+        channel.find_keys(time, cursor, keys);
+
+        glm::vec3 position = glm::mix(keys.positions[0], keys.positions[1], keys.position_factor);
+        glm::vec3 scaling = glm::mix(keys.scalings[0], keys.scalings[1], keys.scaling_factor);
+        glm::quat to = glm::dot(keys.rotations[0], keys.rotations[1]) < 0.0f ? -keys.rotations[1] : keys.rotations[1];
+        glm::quat rotation = glm::normalize(keys.rotations[0] * (1.0f - keys.rotation_factor) + to * keys.rotation_factor);
+        return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scaling);
+    }
+
+    float max_difference(const glm::mat4& lhs, const glm::mat4& rhs) {
+        float difference = 0.0f;
+        for (auto column = 0; column < 4; ++column) {
+            for (auto row = 0; row < 4; ++row) {
+                difference = std::max(difference, std::abs(lhs[column][row] - rhs[column][row]));
+            }
+        }
+        return difference;
+    }
+
+    /// Sample every (channel, time) pair through one shared sampler, with more channels than a batch holds
+    std::vector<glm::mat4> sample_batched(const std::vector<AnimationData>& channels, const std::vector<double>& times, bool slerp_correction) {
+        std::vector<glm::mat4> transforms(channels.size() * times.size());
+        std::vector<AnimationCursor> cursors(channels.size(), AnimationCursor{UINT_MAX, UINT_MAX, UINT_MAX});
+        AnimationBatchSampler sampler{slerp_correction};
+        for (auto t = 0u; t < times.size(); ++t) {
+            for (auto c = 0u; c < channels.size(); ++c) {
+                sampler.add(channels[c], times[t], cursors[c], transforms[t * channels.size() + c]);
+            }
+        }
+        sampler.flush();
+        return transforms;
+    }
+}
+
+TEST_CASE("Batched nlerp matches scalar nlerp") {
+    std::mt19937 random{3};
+    std::vector<AnimationData> channels{};
+    for (auto i = 0; i < 21; ++i) channels.push_back(make_channel(random, 10.0f));
+    std::vector<double> times{};
+    for (auto i = 0; i <= 200; ++i) times.push_back(i * 0.05);
+
+    auto batched = sample_batched(channels, times, false);
+    float max_error = 0.0f;
+    for (auto t = 0u; t < times.size(); ++t) {
+        for (auto c = 0u; c < channels.size(); ++c) {
+            max_error = std::max(max_error, max_difference(batched[t * channels.size() + c], sample_nlerp(channels[c], times[t])));
+        }
+    }
+    CHECK_LE(max_error, 1e-5f);
+}
+
+TEST_CASE("Batched nlerp with slerp correction is close to slerp") {
+    std::mt19937 random{5};
+    std::vector<AnimationData> channels{};
+    for (auto i = 0; i < 21; ++i) channels.push_back(make_channel(random, 10.0f));
+    std::vector<double> times{};
+    for (auto i = 0; i <= 200; ++i) times.push_back(i * 0.05);
+
+    auto batched = sample_batched(channels, times, true);
+    float max_error = 0.0f;
+    for (auto t = 0u; t < times.size(); ++t) {
+        for (auto c = 0u; c < channels.size(); ++c) {
+            max_error = std::max(max_error, max_difference(batched[t * channels.size() + c], channels[c].sample(times[t])));
+        }
+    }
+    // The random keys are up to 180 degrees apart, far more than real animation keys, where the correction does best.
+    // 1e-3 in a unit rotation matrix is still well within the fraction of a degree the sampler documents.
+    CHECK_LE(max_error, 1e-3f);
+}
+
+TEST_CASE("Poses sharing a sampler match poses sampled on their own") {
+    std::mt19937 random{11};
+    MeshHierarchy<TestVertexData> hierarchy{};
+    // A chain of 6 nodes, then 5 more off the root, with two animations that each animate most of them
+    for (auto node = 0; node < 11; ++node) {
+        hierarchy.add_node(node == 0 ? -1 : node < 6 ? node - 1 : 0, glm::translate(glm::vec3{0.0f, 1.0f, 0.0f}));
+    }
+    hierarchy.animations = {{"first", 30.0, 60.0}, {"second", 24.0, 96.0}};
+    hierarchy.finalise_nodes();
+    for (auto animation_id = 0u; animation_id < 2; ++animation_id) {
+        for (auto node = 0u; node < hierarchy.get_node_count(); ++node) {
+            if ((node + animation_id) % 4 == 3) continue;
+            hierarchy.channel_indices[animation_id * hierarchy.get_node_count() + node] = (uint) hierarchy.channels.size();
+            hierarchy.channels.push_back(make_channel(random, (float) std::get<2>(hierarchy.animations[animation_id])));
+        }
+    }
+
+    // Instances of both clips at different times, as a crowd would have
+    std::vector<std::pair<uint, double>> instances{};
+    for (auto i = 0; i < 9; ++i) instances.emplace_back(i % 2, 0.13 * i);
+
+    std::vector<AnimationPose> shared(instances.size());
+    AnimationBatchSampler sampler{};
+    for (auto i = 0u; i < instances.size(); ++i) {
+        hierarchy.sample_local_transforms(instances[i].first, instances[i].second, shared[i].local_transforms, sampler);
+    }
+    sampler.flush();
+
+    for (auto i = 0u; i < instances.size(); ++i) {
+        hierarchy.calculate_pose(shared[i].local_transforms, shared[i]);
+        AnimationPose alone{};
+        hierarchy.calculate_animation(instances[i].first, instances[i].second, alone);
+        for (auto node = 0u; node < hierarchy.get_node_count(); ++node) {
+            CHECK_EQ(max_difference(shared[i].world_transforms[node], alone.world_transforms[node]), 0.0f);
+        }
+    }
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
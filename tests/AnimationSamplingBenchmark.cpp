@@ -0,0 +1,103 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#include "AnimationSamplingReference.h"
+#include "rendering/resources/MeshHierarchy.h"
+
+/// Times sampling a 64 bone clip with 300 keys per channel, played back by 100 instances, through the std::map sampler
+/// AnimationData replaced, and through AnimationData with a binary search and with a cursor per instance.
+namespace {
+    constexpr uint BONE_COUNT = 64;
+    constexpr uint KEY_COUNT = 300;
+    constexpr uint INSTANCE_COUNT = 100;
+    constexpr uint FRAMES = 300;
+    constexpr double TICKS_PER_SECOND = 30.0;
+    constexpr double FRAME_SECONDS = 1.0 / 60.0;
+    constexpr int RUNS = 5;
+
+    /// A bone's keys, evenly spaced a tick apart with random values
+    AnimationKeys make_bone(std::mt19937& random) {
+        std::uniform_real_distribution<float> value{-1.0f, 1.0f};
+        AnimationKeys keys{};
+        for (auto i = 0u; i < KEY_COUNT; ++i) {
+            keys.add_position_key(i, {value(random), value(random), value(random)});
+            keys.add_rotation_key(i, glm::normalize(glm::quat{value(random), value(random), value(random), value(random)}));
+            keys.add_scaling_key(i, {1.0f + 0.5f * value(random), 1.0f, 1.0f});
+        }
+        keys.sort_keys();
+        return keys;
+    }
+
+    /// The looping time of each instance at a frame, with the instances spread out across the clip
+    double instance_time_ticks(uint instance, uint frame) {
+        double duration_ticks = KEY_COUNT - 1;
+        double time_ticks = (instance * duration_ticks / INSTANCE_COUNT) + frame * FRAME_SECONDS * TICKS_PER_SECOND;
+        return std::fmod(time_ticks, duration_ticks);
+    }
+
+    /// Call `sample(instance, bone, time_ticks)` for every bone of every instance, for every frame
+    float play(const std::function<glm::mat4(uint instance, uint bone, double time_ticks)>& sample) {
+        float sink = 0.0f;
+        for (auto frame = 0u; frame < FRAMES; ++frame) {
+            for (auto instance = 0u; instance < INSTANCE_COUNT; ++instance) {
+                double time_ticks = instance_time_ticks(instance, frame);
+                for (auto bone = 0u; bone < BONE_COUNT; ++bone) {
+                    sink += sample(instance, bone, time_ticks)[3][0];
+                }
+            }
+        }
+        return sink;
+    }
+
+    /// The median time of `function` over RUNS runs, in milliseconds
+    double median_ms(const std::function<void()>& function) {
+        std::vector<double> times{};
+        for (auto run = 0; run < RUNS; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+}
+
+int main() {
+    std::mt19937 random{1};
+    // Keys are kept as they are, so both samplers interpolate between the same number of keys
+    AnimationCompressionSettings no_reduction{};
+    no_reduction.reduce_keys = false;
+
+    std::vector<AnimationSamplingReference::MapAnimationData> map_bones{};
+    std::vector<AnimationData> bones{};
+    for (auto bone = 0u; bone < BONE_COUNT; ++bone) {
+        auto keys = make_bone(random);
+        map_bones.emplace_back(keys);
+        bones.push_back(AnimationData::compress(keys, no_reduction));
+    }
+
+    std::vector<std::vector<AnimationCursor>> cursors(INSTANCE_COUNT, std::vector<AnimationCursor>(BONE_COUNT));
+
+    float sink = 0.0f;
+    double map_ms = median_ms([&]() {
+        sink += play([&](uint /*instance*/, uint bone, double time_ticks) { return map_bones[bone].sample(time_ticks); });
+    });
+    double search_ms = median_ms([&]() {
+        sink += play([&](uint /*instance*/, uint bone, double time_ticks) { return bones[bone].sample(time_ticks); });
+    });
+    double cursor_ms = median_ms([&]() {
+        sink += play([&](uint instance, uint bone, double time_ticks) { return bones[bone].sample(time_ticks, cursors[instance][bone]); });
+    });
+
+    double samples = (double) FRAMES * INSTANCE_COUNT * BONE_COUNT;
+    std::cout << BONE_COUNT << " bones, " << KEY_COUNT << " keys per channel, " << INSTANCE_COUNT << " instances, " << FRAMES << " frames (median of " << RUNS << " runs)" << std::endl;
+    std::cout << "  std::map sampler:        " << map_ms << " ms, " << map_ms * 1e6 / samples << " ns per bone" << std::endl;
+    std::cout << "  AnimationData search:    " << search_ms << " ms, " << search_ms * 1e6 / samples << " ns per bone" << std::endl;
+    std::cout << "  AnimationData cursors:   " << cursor_ms << " ms, " << cursor_ms * 1e6 / samples << " ns per bone" << std::endl;
+    return std::isfinite(sink) ? 0 : 1;
+}
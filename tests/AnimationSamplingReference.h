@@ -0,0 +1,79 @@
+#ifndef ANIMATION_SAMPLING_REFERENCE_H
+#define ANIMATION_SAMPLING_REFERENCE_H
+
+#include <map>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "rendering/resources/MeshHierarchy.h"
+
+/// The std::map based keyframe storage and sampler that AnimationData's flat arrays and cursors replaced.
+namespace AnimationSamplingReference {
+    /// AnimationData as it was, with each channel a map from time (in ticks) to value
+    struct MapAnimationData {
+        std::map<double, glm::vec3> positions{};
+        std::map<double, glm::quat> rotations{};
+        std::map<double, glm::vec3> scalings{};
+
+        /// Copy the keys of an imported node, with duplicate times already removed by sort_keys
+        explicit MapAnimationData(const AnimationKeys& keys) {
+            for (auto i = 0u; i < keys.positions.size(); ++i) positions[keys.position_times[i]] = keys.positions[i];
+            for (auto i = 0u; i < keys.rotations.size(); ++i) rotations[keys.rotation_times[i]] = keys.rotations[i];
+            for (auto i = 0u; i < keys.scalings.size(); ++i) scalings[keys.scaling_times[i]] = keys.scalings[i];
+        }
+
+        /// The sampler as it was in MeshHierarchy.cpp, unchanged
+        [[nodiscard]] glm::mat4 sample(double time) const {
+            glm::vec3 position{0.0f};
+            if (!positions.empty()) {
+                auto next_key = positions.lower_bound(time);
+                if (next_key == positions.end()) {
+                    position = positions.rbegin()->second;
+                } else if (next_key->first == time || next_key == positions.begin()) {
+                    position = next_key->second;
+                } else {
+                    auto next = *next_key;
+                    auto prev = *(--next_key);
+
+                    position = glm::mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+                }
+            }
+
+            glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+            if (!rotations.empty()) {
+                auto next_key = rotations.lower_bound(time);
+                if (next_key == rotations.end()) {
+                    rotation = rotations.rbegin()->second;
+                } else if (next_key->first == time || next_key == rotations.begin()) {
+                    rotation = next_key->second;
+                } else {
+                    auto next = *next_key;
+                    auto prev = *(--next_key);
+
+                    rotation = glm::slerp(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+                }
+            }
+
+            glm::vec3 scaling{1.0f};
+            if (!scalings.empty()) {
+                auto next_key = scalings.lower_bound(time);
+                if (next_key == scalings.end()) {
+                    scaling = scalings.rbegin()->second;
+                } else if (next_key->first == time || next_key == scalings.begin()) {
+                    scaling = next_key->second;
+                } else {
+                    auto next = *next_key;
+                    auto prev = *(--next_key);
+
+                    scaling = glm::mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+                }
+            }
+
+            return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scaling);
+        }
+    };
+}
+
+#endif //ANIMATION_SAMPLING_REFERENCE_H
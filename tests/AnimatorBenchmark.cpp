@@ -0,0 +1,128 @@
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#include "rendering/scene/Animator.h"
+
+/// Times Animator::animate over 100k looping entities against the map based Animator it replaced,
+/// with the entities both allocated back to back and spread out through the heap as in a real scene.
+namespace {
+    constexpr size_t ENTITY_COUNT = 100000;
+    constexpr int FRAMES = 200;
+
+    using Animations = std::vector<std::tuple<std::string, double, double>>;
+
+    /// Sized and laid out like an AnimatedRenderedEntity, whose pose and instance data sit between the animation state of neighbouring entities
+    struct BenchmarkEntity : public AnimatedEntityInterface {
+        std::shared_ptr<Animations> animations;
+        std::array<char, 256> instance_and_pose_data{};
+        uint animation_id = 0;
+        double animation_time_seconds = 0.0;
+
+        explicit BenchmarkEntity(std::shared_ptr<Animations> animations) : animations(std::move(animations)) {}
+
+        [[nodiscard]] const Animations& get_animations() const override {
+            return *animations;
+        }
+
+        [[nodiscard]] uint& get_animation_id() override {
+            return animation_id;
+        }
+
+        [[nodiscard]] double& get_animation_time_seconds() override {
+            return animation_time_seconds;
+        }
+
+        [[nodiscard]] double get_animation_duration_seconds() const override {
+            if (animation_id >= animations->size()) return 0.0;
+            const auto& [animation_name, ticks_per_second, duration_ticks] = (*animations)[animation_id];
+            return duration_ticks / ticks_per_second;
+        }
+    };
+
+    /// The Animator before it stored its state densely, kept to measure against
+    struct MapAnimator {
+        std::unordered_map<std::shared_ptr<AnimatedEntityInterface>, AnimationParameters> animated_entities{};
+
+        void animate(double dt) {
+            std::vector<std::shared_ptr<AnimatedEntityInterface>> to_remove{};
+            for (auto& item: animated_entities) {
+                if (item.second.paused) continue;
+
+                auto& time = item.first->get_animation_time_seconds();
+                auto dur = item.first->get_animation_duration_seconds();
+                time += dt * item.second.speed;
+                if (time > dur) {
+                    if (item.second.loop && dur > 0) {
+                        time = std::fmod(time, dur);
+                    } else {
+                        time = dur;
+                        to_remove.push_back(item.first);
+                    }
+                }
+            }
+            for (const auto& item: to_remove) {
+                animated_entities.erase(item);
+            }
+        }
+    };
+
+    std::vector<std::shared_ptr<BenchmarkEntity>> make_entities(bool spread) {
+        auto animations = std::make_shared<Animations>(Animations{{"walk", 30.0, 45.0}, {"run", 30.0, 20.0}});
+        std::vector<std::shared_ptr<BenchmarkEntity>> entities{};
+        // Unrelated allocations between entities, freed afterwards, leave them scattered like a scene built up over time
+        std::vector<std::unique_ptr<char[]>> gaps{};
+        std::mt19937 random{1234};
+        for (auto i = 0u; i < ENTITY_COUNT; ++i) {
+            entities.push_back(std::make_shared<BenchmarkEntity>(animations));
+            if (spread) gaps.emplace_back(new char[64 + random() % 2048]);
+        }
+        if (spread) std::shuffle(entities.begin(), entities.end(), random);
+        return entities;
+    }
+
+    template<typename Animate>
+    double time_frames(Animate&& animate) {
+        std::vector<double> frame_ms{};
+        for (auto frame = 0; frame < FRAMES; ++frame) {
+            auto start = std::chrono::steady_clock::now();
+            animate(1.0 / 60.0);
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(frame_ms.begin(), frame_ms.end());
+        return frame_ms[frame_ms.size() / 2];
+    }
+
+    void run(bool spread) {
+        auto entities = make_entities(spread);
+        MapAnimator map_animator{};
+        for (auto i = 0u; i < entities.size(); ++i) {
+            map_animator.animated_entities[entities[i]] = {i % 2, true, false, 1.0 + (i % 7) * 0.1};
+        }
+        double map_ms = time_frames([&](double dt) { map_animator.animate(dt); });
+
+        entities = make_entities(spread);
+        Animator animator{};
+        for (auto i = 0u; i < entities.size(); ++i) {
+            animator.start(entities[i], {i % 2, true, false, 1.0 + (i % 7) * 0.1});
+        }
+        double dense_ms = time_frames([&](double dt) { animator.animate(dt); });
+
+        std::cout << (spread ? "Spread out" : "Back to back") << " entities, median ms per frame: map " << map_ms << ", dense " << dense_ms << std::endl;
+    }
+}
+
+int main() {
+    std::cout << ENTITY_COUNT << " looping entities over " << FRAMES << " frames" << std::endl;
+    run(false);
+    run(true);
+    return 0;
+}
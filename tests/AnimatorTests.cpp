@@ -0,0 +1,118 @@
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "TestHelpers.h"
+#include "rendering/scene/Animator.h"
+
+namespace {
+    /// An animated entity with only what the Animator looks at
+    struct TestEntity : public AnimatedEntityInterface {
+        // Durations of 2 and 0.5 seconds
+        std::vector<std::tuple<std::string, double, double>> animations{{"long", 10.0, 20.0}, {"short", 10.0, 5.0}};
+        uint animation_id = NONE_ANIMATION;
+        double animation_time_seconds = 0.0;
+
+        [[nodiscard]] const std::vector<std::tuple<std::string, double, double>>& get_animations() const override {
+            return animations;
+        }
+
+        [[nodiscard]] uint& get_animation_id() override {
+            return animation_id;
+        }
+
+        [[nodiscard]] double& get_animation_time_seconds() override {
+            return animation_time_seconds;
+        }
+
+        [[nodiscard]] double get_animation_duration_seconds() const override {
+            if (animation_id >= animations.size()) return 0.0;
+            return std::get<2>(animations[animation_id]) / std::get<1>(animations[animation_id]);
+        }
+    };
+
+    bool near(double a, double b) {
+        return std::abs(a - b) < 1e-9;
+    }
+}
+
+TEST_CASE("Time advances by speed, and a time set through the Animator is kept") {
+    Animator animator{};
+    auto entity = std::make_shared<TestEntity>();
+    auto handle = animator.start(entity, {0, true, false, 2.0});
+
+    animator.animate(0.1);
+    CHECK(near(entity->animation_time_seconds, 0.2));
+    CHECK(near(animator.get_time(handle), 0.2));
+
+    // Written through to the entity straight away, not only on the next animate
+    animator.set_time(entity, 0.5);
+    CHECK(near(entity->animation_time_seconds, 0.5));
+    animator.animate(0.1);
+    CHECK(near(entity->animation_time_seconds, 0.7));
+
+    // The Animator owns the time while animating, so a direct write is replaced on the next animate
+    entity->animation_time_seconds = 1.5;
+    animator.animate(0.1);
+    CHECK(near(entity->animation_time_seconds, 0.9));
+}
+
+TEST_CASE("Looping wraps, and a one shot animation stops at its end") {
+    Animator animator{};
+    auto looping = std::make_shared<TestEntity>();
+    auto once = std::make_shared<TestEntity>();
+    animator.start(looping, {0, true, false, 1.0});
+    auto handle = animator.start(once, {0, false, false, 1.0});
+
+    animator.animate(2.5);
+    CHECK(near(looping->animation_time_seconds, 0.5));
+    CHECK(near(once->animation_time_seconds, 2.0));
+    CHECK(!animator.is_valid(handle));
+    CHECK(!animator.is_animating(once).has_value());
+    CHECK_EQ(animator.get_animating_count(), (size_t) 1);
+}
+
+TEST_CASE("Changing an entity's animation refreshes its duration") {
+    Animator animator{};
+    auto entity = std::make_shared<TestEntity>();
+    auto handle = animator.start(entity, {0, true, false, 1.0});
+    animator.animate(1.5);
+    CHECK(near(entity->animation_time_seconds, 1.5));
+
+    // Switching to the 0.5 second animation while it plays
+    animator.set_animation(entity, 1);
+    animator.set_time(entity, 0.0);
+    CHECK_EQ(entity->animation_id, 1u);
+    CHECK_EQ(animator.get_animation_id(handle), 1u);
+    animator.animate(0.75);
+    CHECK(near(entity->animation_time_seconds, 0.25));
+
+    // Restarting resets the time the Animator keeps, as well as the entity's
+    animator.start(entity, {0, true, false, 1.0});
+    animator.animate(0.5);
+    CHECK(near(entity->animation_time_seconds, 0.5));
+}
+
+TEST_CASE("Paused entities keep their time, and handles survive other entities being removed") {
+    Animator animator{};
+    std::vector<std::shared_ptr<TestEntity>> entities{};
+    std::vector<AnimationHandle> handles{};
+    for (auto i = 0u; i < 4; ++i) {
+        entities.push_back(std::make_shared<TestEntity>());
+        handles.push_back(animator.start(entities.back(), {0, true, false, 1.0}));
+    }
+
+    animator.pause(entities[3]);
+    animator.stop(entities[0]);
+    animator.animate(0.25);
+
+    CHECK(!animator.is_valid(handles[0]));
+    CHECK(near(animator.get_time(handles[1]), 0.25));
+    CHECK(near(animator.get_time(handles[3]), 0.0));
+    CHECK_EQ(entities[0]->animation_id, NONE_ANIMATION);
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
@@ -0,0 +1,211 @@
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "TestHelpers.h"
+#include "rendering/resources/BlockCompression.h"
+
+/// Encodes images with BlockCompression, then decodes them with a separate decoder written from the BCn spec,
+/// and checks the round trip stays within each format's expected error.
+namespace {
+    using Texel = std::array<int, 4>;
+
+    std::array<int, 3> unpack_565(uint16_t packed) {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+    }
+
+    /// Decode the colour of a BC1 block into the RGB of `out`. BC3's colour block is always in the four colour mode.
+    void decode_bc1(const unsigned char* block, std::array<Texel, 16>& out, bool force_four_colour) {
+        auto colour0 = (uint16_t) (block[0] | (block[1] << 8));
+        auto colour1 = (uint16_t) (block[2] | (block[3] << 8));
+        std::array<std::array<int, 3>, 4> palette{unpack_565(colour0), unpack_565(colour1)};
+        bool four_colour = force_four_colour || colour0 > colour1;
+        for (auto c = 0; c < 3; ++c) {
+            if (four_colour) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            } else {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t) block[7] << 24);
+        for (auto i = 0u; i < 16; ++i) {
+            const auto& colour = palette[(indices >> (i * 2)) & 3u];
+            out[i][0] = colour[0];
+            out[i][1] = colour[1];
+            out[i][2] = colour[2];
+        }
+    }
+
+    /// Decode a BC4 block into `channel` of `out`
+    void decode_bc4(const unsigned char* block, std::array<Texel, 16>& out, int channel) {
+        int end0 = block[0];
+        int end1 = block[1];
+        std::array<int, 8> palette{end0, end1};
+        if (end0 > end1) {
+            for (auto i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * end0 + i * end1) / 7;
+        } else {
+            for (auto i = 1; i < 5; ++i) palette[i + 1] = ((5 - i) * end0 + i * end1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        uint64_t indices = 0;
+        for (auto i = 0; i < 6; ++i) indices |= (uint64_t) block[2 + i] << (i * 8);
+        for (auto i = 0u; i < 16; ++i) {
+            out[i][channel] = palette[(indices >> (i * 3)) & 7u];
+        }
+    }
+
+    /// Decode a whole level to `channels` interleaved channels
+    std::vector<unsigned char> decode_level(const CompressedTexture& texture, uint level_index, int channels) {
+        const auto& level = texture.levels[level_index];
+        uint blocks_x = (level.width + 3) / 4;
+        uint blocks_y = (level.height + 3) / 4;
+        size_t block_bytes = BlockCompression::get_block_bytes(texture.format);
+
+        std::vector<unsigned char> pixels((size_t) level.width * level.height * channels);
+        for (auto block_y = 0u; block_y < blocks_y; ++block_y) {
+            for (auto block_x = 0u; block_x < blocks_x; ++block_x) {
+                const unsigned char* block = texture.data.data() + level.offset + ((size_t) block_y * blocks_x + block_x) * block_bytes;
+                std::array<Texel, 16> texels{};
+                switch (texture.format) {
+                    case BlockFormat::BC1:
+                        decode_bc1(block, texels, false);
+                        break;
+                    case BlockFormat::BC3:
+                        decode_bc4(block, texels, 3);
+                        decode_bc1(block + 8, texels, true);
+                        break;
+                    case BlockFormat::BC4:
+                        decode_bc4(block, texels, 0);
+                        break;
+                    case BlockFormat::BC5:
+                        decode_bc4(block, texels, 0);
+                        decode_bc4(block + 8, texels, 1);
+                        break;
+                    case BlockFormat::BC7:
+                        break;
+                }
+                for (auto i = 0u; i < 16; ++i) {
+                    uint x = block_x * 4 + i % 4;
+                    uint y = block_y * 4 + i / 4;
+                    if (x >= level.width || y >= level.height) continue;
+                    for (auto c = 0; c < channels; ++c) {
+                        pixels[((size_t) y * level.width + x) * channels + c] = (unsigned char) texels[i][c];
+                    }
+                }
+            }
+        }
+        return pixels;
+    }
+
+    /// Smooth gradients in every channel, with a little noise, like most real textures.
+    /// The size isn't a multiple of 4, so the partial blocks at the edges are covered too.
+    std::vector<unsigned char> make_image(uint width, uint height, int channels) {
+        std::mt19937 rng{7};
+        std::uniform_int_distribution<int> noise{-4, 4};
+        std::vector<unsigned char> pixels((size_t) width * height * channels);
+        for (auto y = 0u; y < height; ++y) {
+            for (auto x = 0u; x < width; ++x) {
+                for (auto c = 0; c < channels; ++c) {
+                    float wave = std::sin((float) x * 0.11f * (float) (c + 1) + (float) y * 0.07f) * 0.5f + 0.5f;
+                    int value = (int) std::lround(wave * 200.0f + 28.0f) + noise(rng);
+                    pixels[((size_t) y * width + x) * channels + c] = (unsigned char) std::clamp(value, 0, 255);
+                }
+            }
+        }
+        return pixels;
+    }
+
+    /// Root mean square error of each channel
+    std::vector<double> rms_error(const std::vector<unsigned char>& expected, const std::vector<unsigned char>& actual, int channels) {
+        std::vector<double> sums(channels, 0.0);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            double difference = (double) expected[i] - (double) actual[i];
+            sums[i % channels] += difference * difference;
+        }
+        for (auto& sum: sums) sum = std::sqrt(sum / (double) (expected.size() / channels));
+        return sums;
+    }
+
+    /// Encode, decode and check every channel's error in the full size level is within `max_rms`
+    void check_round_trip(BlockFormat format, int channels, double max_rms) {
+        constexpr uint width = 62;
+        constexpr uint height = 46;
+        auto pixels = make_image(width, height, channels);
+        auto compressed = BlockCompression::encode(pixels.data(), width, height, channels, false, format);
+        auto decoded = decode_level(compressed, 0, channels);
+        for (auto error: rms_error(pixels, decoded, channels)) {
+            CHECK_LE(error, max_rms);
+        }
+    }
+
+    /// Encode a single colour, whose round trip should only lose what the endpoints' precision can't hold
+    void check_solid(BlockFormat format, int channels, const Texel& colour, const Texel& max_error) {
+        constexpr uint size = 8;
+        std::vector<unsigned char> pixels{};
+        for (auto i = 0u; i < size * size; ++i) {
+            for (auto c = 0; c < channels; ++c) pixels.push_back((unsigned char) colour[c]);
+        }
+        auto compressed = BlockCompression::encode(pixels.data(), size, size, channels, false, format);
+        auto decoded = decode_level(compressed, 0, channels);
+        for (size_t i = 0; i < decoded.size(); ++i) {
+            CHECK_LE(std::abs((int) decoded[i] - colour[i % channels]), max_error[i % channels]);
+        }
+    }
+}
+
+// The bounds leave some headroom over what the encoder gets on this image, which is about 5-7.5 for BC1's colour
+// (5-6-5 endpoints, 4 levels per block, and the image's higher frequency channels) and 1.5-4 for BC4 (8-bit endpoints, 8 levels).
+
+TEST_CASE("BC1 round trips within its error bound") {
+    check_round_trip(BlockFormat::BC1, 3, 10.0);
+}
+
+TEST_CASE("BC3 round trips within its error bound") {
+    check_round_trip(BlockFormat::BC3, 4, 10.0);
+}
+
+TEST_CASE("BC4 round trips within its error bound") {
+    check_round_trip(BlockFormat::BC4, 1, 4.0);
+}
+
+TEST_CASE("BC5 round trips within its error bound") {
+    check_round_trip(BlockFormat::BC5, 2, 5.0);
+}
+
+TEST_CASE("Solid colours only lose the endpoint precision") {
+    // Half a 5 or 6 bit step, rounded up
+    check_solid(BlockFormat::BC1, 3, {200, 100, 37, 255}, {4, 2, 4, 0});
+    check_solid(BlockFormat::BC3, 4, {200, 100, 37, 99}, {4, 2, 4, 0});
+    check_solid(BlockFormat::BC4, 1, {123, 0, 0, 0}, {0, 0, 0, 0});
+    check_solid(BlockFormat::BC5, 2, {17, 240, 0, 0}, {0, 0, 0, 0});
+}
+
+TEST_CASE("The encoded mip chain runs down to 1x1 with the right sizes") {
+    constexpr uint width = 62;
+    constexpr uint height = 46;
+    auto pixels = make_image(width, height, 3);
+    auto compressed = BlockCompression::encode(pixels.data(), width, height, 3, true, BlockFormat::BC1);
+
+    // 62x46, 31x23, 15x11, 7x5, 3x2, 1x1
+    CHECK_EQ(compressed.levels.size(), (size_t) 6);
+    CHECK(compressed.srgb && compressed.srgb_known);
+    size_t offset = 0;
+    for (const auto& level: compressed.levels) {
+        CHECK_EQ(level.offset, offset);
+        CHECK_EQ(level.size, BlockCompression::get_level_bytes(BlockFormat::BC1, level.width, level.height));
+        offset += level.size;
+    }
+    CHECK_EQ(offset, compressed.data.size());
+    CHECK(compressed.levels.back().width == 1 && compressed.levels.back().height == 1);
+}
+
+int main() { return TestHelpers::run_tests(); }
@@ -0,0 +1,95 @@
+#ifndef BONE_WEIGHTS_REFERENCE_H
+#define BONE_WEIGHTS_REFERENCE_H
+
+#include <map>
+#include <set>
+#include <memory>
+#include <random>
+#include <vector>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/component_wise.hpp>
+
+#include <assimp/scene.h>
+
+/// The std::map based bone weight gather that BoneWeights::gather replaced, and random rigs to compare them on.
+/// Shared by BoneWeightsTests and BoneWeightsBenchmark.
+namespace BoneWeightsReference {
+    /// The gather as it was in ModelLoader, unchanged apart from being pulled out into a function
+    inline std::vector<std::pair<glm::vec4, glm::uvec4>> gather(const aiMesh* mesh) {
+        // [vertex_id] -> (bone_weight -> bone_id)
+        std::vector<std::map<float, std::set<uint>>> bone_weights_total{};
+        bone_weights_total.resize(mesh->mNumVertices, {});
+        for (auto bone_i = 0u; bone_i < mesh->mNumBones; ++bone_i) {
+            const auto* bone = mesh->mBones[bone_i];
+            for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
+                const auto* weight = &bone->mWeights[weight_i];
+                bone_weights_total[weight->mVertexId][weight->mWeight].insert(bone_i);
+            }
+        }
+
+        // [vertex_id] -> ([bone_id; 4], [bone_weight; 4])
+        std::vector<std::pair<glm::vec4, glm::uvec4>> bone_weights;
+        bone_weights.resize(mesh->mNumVertices, {});
+        for (auto vert_i = 0u; vert_i < mesh->mNumVertices; ++vert_i) {
+            const auto& vert = bone_weights_total[vert_i];
+            auto i = 0;
+            for (auto iter = vert.rbegin(); i < 4 && iter != vert.rend(); ++iter) {
+                for (auto inner_iter = iter->second.begin(); i < 4 && inner_iter != iter->second.end(); ++inner_iter) {
+                    bone_weights[vert_i].first[i] = iter->first;
+                    bone_weights[vert_i].second[i] = *inner_iter;
+                    ++i;
+                }
+            }
+            float weight_sum = glm::compAdd(bone_weights[vert_i].first);
+            if (weight_sum != 0.0f) {
+                // Normalise the sum of the weights
+                bone_weights[vert_i].first /= weight_sum;
+            }
+        }
+        return bone_weights;
+    }
+
+    /// A mesh with only bone weights filled in, owning its bones in the way aiMesh's destructor expects
+    inline std::unique_ptr<aiMesh> make_mesh(uint vertex_count, const std::vector<std::vector<aiVertexWeight>>& bone_weights) {
+        auto mesh = std::make_unique<aiMesh>();
+        mesh->mNumVertices = vertex_count;
+        mesh->mNumBones = (uint) bone_weights.size();
+        mesh->mBones = new aiBone*[bone_weights.size()];
+        for (auto bone_i = 0u; bone_i < bone_weights.size(); ++bone_i) {
+            auto* bone = new aiBone();
+            bone->mNumWeights = (uint) bone_weights[bone_i].size();
+            bone->mWeights = new aiVertexWeight[bone_weights[bone_i].size()];
+            std::copy(bone_weights[bone_i].begin(), bone_weights[bone_i].end(), bone->mWeights);
+            mesh->mBones[bone_i] = bone;
+        }
+        return mesh;
+    }
+
+    /// A random rig where each vertex has 0 to `max_influences` weights, drawn from a few distinct values so that ties are common,
+    /// with the occasional (weight, bone) pair repeated, as some exporters do
+    inline std::unique_ptr<aiMesh> make_random_rig(uint vertex_count, uint bone_count, uint max_influences, uint seed) {
+        std::mt19937 rng{seed};
+        std::uniform_int_distribution<uint> influence_count{0, max_influences};
+        std::uniform_int_distribution<uint> bone_id{0, bone_count - 1};
+        std::uniform_int_distribution<uint> weight_step{1, 8};
+        std::uniform_int_distribution<uint> repeat{0, 15};
+
+        std::vector<std::vector<aiVertexWeight>> bone_weights(bone_count);
+        for (auto vert_i = 0u; vert_i < vertex_count; ++vert_i) {
+            auto count = influence_count(rng);
+            for (auto i = 0u; i < count; ++i) {
+                auto bone = bone_id(rng);
+                aiVertexWeight weight{};
+                weight.mVertexId = vert_i;
+                weight.mWeight = (float) weight_step(rng) / 8.0f;
+                bone_weights[bone].push_back(weight);
+                if (repeat(rng) == 0) bone_weights[bone].push_back(weight);
+            }
+        }
+        return make_mesh(vertex_count, bone_weights);
+    }
+}
+
+#endif //BONE_WEIGHTS_REFERENCE_H
@@ -0,0 +1,68 @@
+#include <vector>
+
+#include "TestHelpers.h"
+#include "BoneWeightsReference.h"
+#include "rendering/resources/BoneWeights.h"
+
+namespace {
+    /// Require the weights and bone ids of every vertex to be exactly those of the reference gather
+    void check_matches_reference(const aiMesh* mesh) {
+        auto expected = BoneWeightsReference::gather(mesh);
+        auto actual = BoneWeights::gather(mesh);
+        CHECK_EQ(actual.size(), expected.size());
+        if (actual.size() != expected.size()) return;
+
+        uint mismatches = 0;
+        for (auto vert_i = 0u; vert_i < actual.size(); ++vert_i) {
+            if (actual[vert_i].first != expected[vert_i].first || actual[vert_i].second != expected[vert_i].second) {
+                ++mismatches;
+            }
+        }
+        CHECK_EQ(mismatches, 0u);
+    }
+
+    aiVertexWeight weight(uint vertex, float value) {
+        aiVertexWeight result{};
+        result.mVertexId = vertex;
+        result.mWeight = value;
+        return result;
+    }
+}
+
+TEST_CASE("gather matches the reference on random rigs") {
+    for (auto seed = 0u; seed < 4; ++seed) {
+        // More vertices than one batch, so the threaded split is covered
+        auto mesh = BoneWeightsReference::make_random_rig(20000, 80, 8, seed);
+        check_matches_reference(mesh.get());
+    }
+}
+
+TEST_CASE("gather keeps the 4 largest weights, preferring the lower bone on a tie") {
+    // Vertex 0 has six influences, with 0.25 shared by bones 1, 3 and 4
+    auto mesh = BoneWeightsReference::make_mesh(1, {
+        {weight(0, 0.1f)},
+        {weight(0, 0.25f)},
+        {weight(0, 0.5f)},
+        {weight(0, 0.25f)},
+        {weight(0, 0.25f)},
+        {weight(0, 0.05f)},
+    });
+    auto result = BoneWeights::gather(mesh.get());
+    CHECK(result[0].second == glm::uvec4(2, 1, 3, 4));
+    CHECK(std::abs(glm::compAdd(result[0].first) - 1.0f) < 1e-6f);
+    check_matches_reference(mesh.get());
+}
+
+TEST_CASE("gather counts a repeated weight once, and leaves unweighted vertices at zero") {
+    auto mesh = BoneWeightsReference::make_mesh(2, {
+        {weight(0, 0.5f), weight(0, 0.5f)},
+        {weight(0, 0.25f)},
+    });
+    auto result = BoneWeights::gather(mesh.get());
+    CHECK(result[0].second == glm::uvec4(0, 1, 0, 0));
+    CHECK(result[0].first[2] == 0.0f && result[0].first[3] == 0.0f);
+    CHECK(result[1].first == glm::vec4(0.0f));
+    check_matches_reference(mesh.get());
+}
+
+int main() { return TestHelpers::run_tests(); }
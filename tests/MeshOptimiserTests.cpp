@@ -0,0 +1,147 @@
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "TestHelpers.h"
+#include "rendering/resources/MeshOptimiser.h"
+
+namespace {
+    struct Mesh {
+        std::vector<glm::vec3> vertices;
+        std::vector<uint> indices;
+    };
+
+    /// A (size x size) quad grid, with its triangles in row order
+    Mesh make_grid(uint size) {
+        Mesh mesh{};
+        for (auto y = 0u; y <= size; ++y) {
+            for (auto x = 0u; x <= size; ++x) {
+                mesh.vertices.emplace_back((float) x, (float) y, 0.0f);
+            }
+        }
+        for (auto y = 0u; y < size; ++y) {
+            for (auto x = 0u; x < size; ++x) {
+                uint corner = y * (size + 1) + x;
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + size + 1});
+                mesh.indices.insert(mesh.indices.end(), {corner + 1, corner + size + 2, corner + size + 1});
+            }
+        }
+        return mesh;
+    }
+
+    /// A UV sphere, with every triangle given its own vertices like an unwelded import
+    Mesh make_unwelded_sphere(uint rings, uint segments) {
+        auto position = [&](uint ring, uint segment) {
+            float theta = 3.14159265f * (float) ring / (float) rings;
+            float phi = 2.0f * 3.14159265f * (float) (segment % segments) / (float) segments;
+            return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        };
+        Mesh mesh{};
+        for (auto ring = 0u; ring < rings; ++ring) {
+            for (auto segment = 0u; segment < segments; ++segment) {
+                glm::vec3 quad[4] = {position(ring, segment), position(ring, segment + 1), position(ring + 1, segment), position(ring + 1, segment + 1)};
+                for (auto corner: {0, 2, 1, 1, 2, 3}) {
+                    mesh.indices.push_back((uint) mesh.vertices.size());
+                    mesh.vertices.push_back(quad[corner]);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    void shuffle_triangles(Mesh& mesh, uint seed) {
+        std::vector<std::array<uint, 3>> triangles{};
+        for (auto i = 0u; i < mesh.indices.size(); i += 3) {
+            triangles.push_back({mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]});
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+        mesh.indices.clear();
+        for (const auto& triangle: triangles) {
+            mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+        }
+    }
+
+    /// The sorted triangles as positions, which the optimisations may reorder but must never change
+    std::vector<std::array<float, 9>> get_triangles(const Mesh& mesh) {
+        std::vector<std::array<float, 9>> triangles{};
+        for (auto i = 0u; i < mesh.indices.size(); i += 3) {
+            // Rotated so the smallest corner comes first, since reordering may rotate a triangle's corners
+            std::array<glm::vec3, 3> corners = {mesh.vertices[mesh.indices[i]], mesh.vertices[mesh.indices[i + 1]], mesh.vertices[mesh.indices[i + 2]]};
+            auto less = [](const glm::vec3& a, const glm::vec3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+            std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+            triangles.push_back({corners[0].x, corners[0].y, corners[0].z, corners[1].x, corners[1].y, corners[1].z, corners[2].x, corners[2].y, corners[2].z});
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    /// The same steps, in the same order, as ModelLoader::optimise_mesh
+    void optimise(Mesh& mesh) {
+        std::vector<uint> remap{};
+        uint unique_vertices = MeshOptimiser::generate_weld_remap(mesh.vertices.data(), (uint) mesh.vertices.size(), sizeof(glm::vec3), remap);
+        MeshOptimiser::remap_indices(mesh.indices, remap);
+        MeshOptimiser::remap_vertices(mesh.vertices, remap, unique_vertices);
+
+        std::vector<uint> clusters{};
+        MeshOptimiser::optimise_vertex_cache(mesh.indices, (uint) mesh.vertices.size(), &clusters);
+        MeshOptimiser::optimise_overdraw(mesh.indices, mesh.vertices, clusters);
+
+        uint used_vertices = MeshOptimiser::generate_vertex_fetch_remap(mesh.indices, (uint) mesh.vertices.size(), remap);
+        MeshOptimiser::remap_indices(mesh.indices, remap);
+        MeshOptimiser::remap_vertices(mesh.vertices, remap, used_vertices);
+    }
+
+    /// Optimise the mesh, checking it has the same triangles after, and its ACMR is no worse.
+    /// The ATVR isn't compared, since welding changes the number of vertices it is a ratio of.
+    /// Returns the ACMR before and after.
+    std::pair<float, float> check_optimise(Mesh mesh) {
+        auto triangles_before = get_triangles(mesh);
+        auto before = MeshOptimiser::analyse_vertex_cache(mesh.indices, (uint) mesh.vertices.size());
+
+        optimise(mesh);
+
+        auto after = MeshOptimiser::analyse_vertex_cache(mesh.indices, (uint) mesh.vertices.size());
+        CHECK(get_triangles(mesh) == triangles_before);
+        CHECK(std::all_of(mesh.indices.begin(), mesh.indices.end(), [&mesh](uint index) { return index < mesh.vertices.size(); }));
+        CHECK_LE(after.acmr, before.acmr);
+        return {before.acmr, after.acmr};
+    }
+}
+
+TEST_CASE("Shuffled grid gets a better ACMR") {
+    auto grid = make_grid(64);
+    shuffle_triangles(grid, 1);
+    auto [before, after] = check_optimise(grid);
+    // A shuffled grid transforms nearly every corner, a cache ordered one about a vertex per triangle
+    CHECK_LE(after, 0.8f);
+    CHECK_LE(after, before * 0.5f);
+}
+
+TEST_CASE("Grid in row order doesn't get worse") {
+    check_optimise(make_grid(64));
+}
+
+TEST_CASE("Small grid that fits in the cache doesn't get worse") {
+    check_optimise(make_grid(2));
+}
+
+TEST_CASE("Unwelded sphere is welded and gets a better ACMR") {
+    auto sphere = make_unwelded_sphere(32, 48);
+    auto [before, after] = check_optimise(sphere);
+    CHECK_LE(before, 3.0f);
+    CHECK_LE(after, 1.0f);
+}
+
+TEST_CASE("Shuffled sphere doesn't get worse") {
+    auto sphere = make_unwelded_sphere(24, 24);
+    shuffle_triangles(sphere, 7);
+    check_optimise(sphere);
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
@@ -0,0 +1,149 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "TestHelpers.h"
+#include "rendering/resources/MeshSimplifier.h"
+
+namespace {
+    struct Mesh {
+        std::vector<glm::vec3> vertices;
+        std::vector<uint> indices;
+    };
+
+    /// A (size x size) quad grid in the xy plane, facing +z, with a small bump in the middle so there is something to simplify away
+    Mesh make_grid(uint size) {
+        Mesh mesh{};
+        for (auto y = 0u; y <= size; ++y) {
+            for (auto x = 0u; x <= size; ++x) {
+                float dx = (float) x - (float) size / 2.0f;
+                float dy = (float) y - (float) size / 2.0f;
+                mesh.vertices.emplace_back((float) x, (float) y, 0.5f * std::exp(-(dx * dx + dy * dy) / (float) size));
+            }
+        }
+        for (auto y = 0u; y < size; ++y) {
+            for (auto x = 0u; x < size; ++x) {
+                uint corner = y * (size + 1) + x;
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + size + 1});
+                mesh.indices.insert(mesh.indices.end(), {corner + 1, corner + size + 2, corner + size + 1});
+            }
+        }
+        return mesh;
+    }
+
+    /// A closed UV sphere, with its seam and poles welded so it has no border, and every triangle facing outwards
+    Mesh make_sphere(uint rings, uint segments) {
+        Mesh mesh{};
+        mesh.vertices.emplace_back(0.0f, 1.0f, 0.0f);
+        for (auto ring = 1u; ring < rings; ++ring) {
+            for (auto segment = 0u; segment < segments; ++segment) {
+                float theta = 3.14159265f * (float) ring / (float) rings;
+                float phi = 2.0f * 3.14159265f * (float) segment / (float) segments;
+                mesh.vertices.emplace_back(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            }
+        }
+        mesh.vertices.emplace_back(0.0f, -1.0f, 0.0f);
+        uint bottom = (uint) mesh.vertices.size() - 1;
+
+        auto vertex = [segments](uint ring, uint segment) { return 1 + (ring - 1) * segments + segment % segments; };
+        for (auto segment = 0u; segment < segments; ++segment) {
+            mesh.indices.insert(mesh.indices.end(), {0, vertex(1, segment + 1), vertex(1, segment)});
+            mesh.indices.insert(mesh.indices.end(), {bottom, vertex(rings - 1, segment), vertex(rings - 1, segment + 1)});
+        }
+        for (auto ring = 1u; ring + 1 < rings; ++ring) {
+            for (auto segment = 0u; segment < segments; ++segment) {
+                mesh.indices.insert(mesh.indices.end(), {vertex(ring, segment), vertex(ring, segment + 1), vertex(ring + 1, segment)});
+                mesh.indices.insert(mesh.indices.end(), {vertex(ring, segment + 1), vertex(ring + 1, segment + 1), vertex(ring + 1, segment)});
+            }
+        }
+        return mesh;
+    }
+
+    glm::vec3 triangle_normal(const std::vector<glm::vec3>& vertices, const std::vector<uint>& indices, size_t i) {
+        const auto& a = vertices[indices[i]];
+        const auto& b = vertices[indices[i + 1]];
+        const auto& c = vertices[indices[i + 2]];
+        return glm::cross(b - a, c - a);
+    }
+
+    /// Whether every triangle is whole, references a vertex and is not degenerate
+    bool is_valid(const Mesh& mesh, const std::vector<uint>& simplified) {
+        if (simplified.size() % 3 != 0) return false;
+        for (auto i = 0u; i < simplified.size(); i += 3) {
+            for (auto corner = 0u; corner < 3; ++corner) {
+                if (simplified[i + corner] >= mesh.vertices.size()) return false;
+            }
+            if (simplified[i] == simplified[i + 1] || simplified[i + 1] == simplified[i + 2] || simplified[i] == simplified[i + 2]) return false;
+        }
+        return true;
+    }
+}
+
+TEST_CASE("Closed mesh reaches the target index count") {
+    auto sphere = make_sphere(24, 32);
+    CHECK(is_valid(sphere, sphere.indices));
+
+    for (auto divisor: {2u, 4u, 10u}) {
+        size_t target = sphere.indices.size() / divisor;
+        float error = -1.0f;
+        auto simplified = MeshSimplifier::simplify(sphere.vertices, sphere.indices, target, &error);
+        CHECK(is_valid(sphere, simplified));
+        CHECK_LE(simplified.size(), target);
+        CHECK(!simplified.empty());
+        CHECK(error >= 0.0f && std::isfinite(error));
+    }
+}
+
+TEST_CASE("Border vertices survive") {
+    const uint size = 16;
+    auto grid = make_grid(size);
+    auto simplified = MeshSimplifier::simplify(grid.vertices, grid.indices, grid.indices.size() / 8);
+    CHECK(is_valid(grid, simplified));
+    CHECK_LE(simplified.size(), grid.indices.size() / 2);
+
+    std::vector<bool> used(grid.vertices.size(), false);
+    for (auto index: simplified) used[index] = true;
+    for (auto y = 0u; y <= size; ++y) {
+        for (auto x = 0u; x <= size; ++x) {
+            if (x == 0 || y == 0 || x == size || y == size) {
+                CHECK(used[y * (size + 1) + x]);
+            }
+        }
+    }
+}
+
+TEST_CASE("No triangle is flipped") {
+    auto sphere = make_sphere(16, 24);
+    auto simplified = MeshSimplifier::simplify(sphere.vertices, sphere.indices, sphere.indices.size() / 8);
+    CHECK(is_valid(sphere, simplified));
+    for (auto i = 0u; i < simplified.size(); i += 3) {
+        // Every triangle of the sphere faces away from its centre, so its normal points the same way as its corners
+        glm::vec3 centre = sphere.vertices[simplified[i]] + sphere.vertices[simplified[i + 1]] + sphere.vertices[simplified[i + 2]];
+        CHECK(glm::dot(triangle_normal(sphere.vertices, simplified, i), centre) > 0.0f);
+    }
+
+    auto grid = make_grid(16);
+    simplified = MeshSimplifier::simplify(grid.vertices, grid.indices, grid.indices.size() / 8);
+    for (auto i = 0u; i < simplified.size(); i += 3) {
+        CHECK(triangle_normal(grid.vertices, simplified, i).z > 0.0f);
+    }
+}
+
+TEST_CASE("Impossible target terminates") {
+    // Every vertex of a single quad is on its border, so nothing can be collapsed
+    Mesh quad{{{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}}, {0, 1, 2, 1, 3, 2}};
+    auto simplified = MeshSimplifier::simplify(quad.vertices, quad.indices, 0);
+    CHECK(is_valid(quad, simplified));
+    CHECK_EQ(simplified.size(), quad.indices.size());
+
+    auto sphere = make_sphere(8, 12);
+    simplified = MeshSimplifier::simplify(sphere.vertices, sphere.indices, 0);
+    CHECK(is_valid(sphere, simplified));
+    CHECK_LE(simplified.size(), sphere.indices.size());
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
@@ -0,0 +1,137 @@
+#include <array>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include "TestHelpers.h"
+#include "rendering/resources/Meshlets.h"
+
+namespace {
+    struct Mesh {
+        std::vector<glm::vec3> vertices;
+        std::vector<uint> indices;
+    };
+
+    /// A (size x size) quad grid of unit squares in the xy plane, centred on `centre` and facing +z
+    Mesh make_grid(uint size, const glm::vec3& centre = glm::vec3{0.0f}) {
+        Mesh mesh{};
+        for (auto y = 0u; y <= size; ++y) {
+            for (auto x = 0u; x <= size; ++x) {
+                mesh.vertices.push_back(centre + glm::vec3{(float) x - (float) size / 2.0f, (float) y - (float) size / 2.0f, 0.0f});
+            }
+        }
+        for (auto y = 0u; y < size; ++y) {
+            for (auto x = 0u; x < size; ++x) {
+                uint corner = y * (size + 1) + x;
+                mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + size + 1});
+                mesh.indices.insert(mesh.indices.end(), {corner + 1, corner + size + 2, corner + size + 1});
+            }
+        }
+        return mesh;
+    }
+
+    /// Shuffled triangles share few vertices with their neighbours, so fill up a meshlet's vertices long before its triangles
+    void shuffle_triangles(Mesh& mesh, uint seed) {
+        std::vector<std::array<uint, 3>> triangles{};
+        for (auto i = 0u; i < mesh.indices.size(); i += 3) {
+            triangles.push_back({mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]});
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+        mesh.indices.clear();
+        for (const auto& triangle: triangles) {
+            mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+        }
+    }
+
+    /// Check every meshlet is within the limits, and that together they cover the indices in order, with no gaps or overlaps
+    void check_build(const Mesh& mesh, uint max_vertices, uint max_triangles) {
+        auto meshlets = Meshlets::build(mesh.vertices, mesh.indices, (uint) mesh.indices.size(), max_vertices, max_triangles);
+        CHECK(!meshlets.empty());
+
+        uint next_offset = 0;
+        for (const auto& meshlet: meshlets) {
+            CHECK_EQ(meshlet.index_offset, next_offset);
+            CHECK(meshlet.index_count > 0);
+            CHECK_EQ(meshlet.index_count % 3, 0u);
+            CHECK_LE(meshlet.index_count / 3, max_triangles);
+
+            std::unordered_set<uint> vertices(mesh.indices.begin() + meshlet.index_offset, mesh.indices.begin() + meshlet.index_offset + meshlet.index_count);
+            CHECK_LE(vertices.size(), (size_t) max_vertices);
+            for (auto vertex: vertices) {
+                CHECK_LE(glm::distance(mesh.vertices[vertex], meshlet.centre), meshlet.radius * 1.0001f);
+            }
+
+            next_offset = meshlet.index_offset + meshlet.index_count;
+        }
+        CHECK_EQ(next_offset, (uint) mesh.indices.size());
+    }
+
+    /// A camera at `eye` looking at `target`, with the frustum in the grid's model space, which is world space here
+    MeshletFrustum make_frustum(const glm::vec3& eye, const glm::vec3& target) {
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+        glm::mat4 view = glm::lookAt(eye, target, glm::vec3{0.0f, 1.0f, 0.0f});
+        return MeshletFrustum::from_matrix(projection * view, eye);
+    }
+
+    /// The single meshlet of a small flat grid
+    Meshlet make_patch(const glm::vec3& centre) {
+        auto patch = make_grid(4, centre);
+        auto meshlets = Meshlets::build(patch.vertices, patch.indices, (uint) patch.indices.size());
+        CHECK_EQ(meshlets.size(), (size_t) 1);
+        return meshlets[0];
+    }
+}
+
+TEST_CASE("Meshlets respect the limits and cover every index") {
+    auto grid = make_grid(32);
+    check_build(grid, Meshlets::MAX_VERTICES, Meshlets::MAX_TRIANGLES);
+    check_build(grid, 16, 10);
+
+    shuffle_triangles(grid, 5);
+    check_build(grid, Meshlets::MAX_VERTICES, Meshlets::MAX_TRIANGLES);
+    check_build(grid, 16, 10);
+}
+
+TEST_CASE("Only the first index_count indices are split") {
+    auto grid = make_grid(8);
+    uint index_count = (uint) grid.indices.size() / 2;
+    auto meshlets = Meshlets::build(grid.vertices, grid.indices, index_count, 16, 10);
+    CHECK(!meshlets.empty());
+    CHECK_EQ(meshlets.back().index_offset + meshlets.back().index_count, index_count);
+}
+
+TEST_CASE("A meshlet behind a frustum plane is culled") {
+    auto frustum = make_frustum(glm::vec3{0.0f, 0.0f, 10.0f}, glm::vec3{0.0f});
+    // Infinite projections have no far plane, but this one has all 6
+    CHECK_EQ(frustum.plane_count, 6u);
+
+    CHECK(Meshlets::cull(make_patch(glm::vec3{0.0f}), frustum) == Meshlets::CullResult::Visible);
+    // Behind the camera, beside it, and past the far plane
+    CHECK(Meshlets::cull(make_patch(glm::vec3{0.0f, 0.0f, 20.0f}), frustum) == Meshlets::CullResult::Frustum);
+    CHECK(Meshlets::cull(make_patch(glm::vec3{50.0f, 0.0f, 0.0f}), frustum) == Meshlets::CullResult::Frustum);
+    CHECK(Meshlets::cull(make_patch(glm::vec3{0.0f, 0.0f, -200.0f}), frustum) == Meshlets::CullResult::Frustum);
+}
+
+TEST_CASE("A flat patch is backface culled only from behind") {
+    auto patch = make_patch(glm::vec3{0.0f});
+    CHECK(glm::dot(patch.cone_axis, glm::vec3{0.0f, 0.0f, 1.0f}) > 0.999f);
+    CHECK(patch.cone_cutoff < 0.01f);
+
+    // The patch faces +z, so is seen from the front from +z, and from behind from -z
+    auto front = make_frustum(glm::vec3{0.0f, 0.0f, 10.0f}, glm::vec3{0.0f});
+    auto behind = make_frustum(glm::vec3{0.0f, 0.0f, -10.0f}, glm::vec3{0.0f});
+    CHECK(Meshlets::cull(patch, front) == Meshlets::CullResult::Visible);
+    CHECK(Meshlets::cull(patch, behind) == Meshlets::CullResult::Backface);
+
+    // Edge on, some of its triangles might be visible, so it is kept
+    auto edge_on = make_frustum(glm::vec3{10.0f, 0.0f, 0.0f}, glm::vec3{0.0f});
+    CHECK(Meshlets::cull(patch, edge_on) == Meshlets::CullResult::Visible);
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
@@ -0,0 +1,242 @@
+#include <climits>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <functional>
+#include <filesystem>
+
+#include <glm/glm.hpp>
+
+#include "TestHelpers.h"
+#include "rendering/resources/ModelLoader.h"
+
+/// Has access to ModelLoader's cache reading and writing, see the friend declaration there
+struct ModelCacheTests {
+    /// Only needed to prepare a model, in the full format, so pack is never called
+    struct TestVertexData {
+        glm::vec3 position;
+
+        struct Packed {
+            uint16_t position[4];
+        };
+
+        static Packed pack(const TestVertexData& /*vertex*/, const PositionDequantisation& /*dequantisation*/) {
+            return {};
+        }
+    };
+
+    using PreparedModel = ModelLoader::PreparedModel;
+
+    /// A (size x size) quad grid, with a half detail LOD and meshlets, as prepare_model_from_file would give
+    static PreparedModel make_model(uint size) {
+        std::vector<TestVertexData> vertices{};
+        std::vector<glm::vec3> positions{};
+        for (auto y = 0u; y <= size; ++y) {
+            for (auto x = 0u; x <= size; ++x) {
+                positions.emplace_back((float) x, (float) y, 0.0f);
+                vertices.push_back({positions.back()});
+            }
+        }
+        std::vector<uint> indices{};
+        for (auto y = 0u; y < size; ++y) {
+            for (auto x = 0u; x < size; ++x) {
+                uint corner = y * (size + 1) + x;
+                indices.insert(indices.end(), {corner, corner + 1, corner + size + 1});
+                indices.insert(indices.end(), {corner + 1, corner + size + 2, corner + size + 1});
+            }
+        }
+        int full_count = (int) indices.size();
+        std::vector<ModelLod> lods{{0, full_count}, {0, full_count / 2}};
+
+        auto prepared = ModelLoader::prepare_model(vertices, indices, lods, VertexFormat::Full);
+        prepared.meshlets = Meshlets::build(positions, indices, (uint) full_count, 16, 10);
+        return prepared;
+    }
+
+    static ModelCache::Header make_header() {
+        ModelCache::Header header{};
+        std::memcpy(header.magic, ModelCache::MAGIC, sizeof(ModelCache::MAGIC));
+        header.version = ModelCache::VERSION;
+        header.format_hash = 1234;
+        header.source_write_time = 5678;
+        header.source_size = 42;
+        return header;
+    }
+
+    static BinaryWriter write(const PreparedModel& prepared) {
+        BinaryWriter writer{};
+        writer.write(make_header());
+        ModelLoader::write_model(writer, prepared);
+        return writer;
+    }
+
+    /// Read back the first `size` bytes of the cache file, or all of it
+    static PreparedModel read(const std::shared_ptr<const MappedFile>& mapped, size_t size = SIZE_MAX) {
+        BinaryReader reader{mapped->get_data(), std::min(size, mapped->get_size()), sizeof(ModelCache::Header)};
+        return ModelLoader::read_model(reader, mapped);
+    }
+
+    /// Save the model after letting `corrupt` change it, and check it is then rejected by read_model
+    static void check_rejected(const std::string& cache_path, const std::function<void(PreparedModel& prepared)>& corrupt) {
+        auto prepared = make_model(8);
+        corrupt(prepared);
+        // write_model writes as many bytes as the layout says, so the buffers have to hold that many
+        prepared.vertex_bytes.resize(prepared.layout.vertex_bytes());
+        prepared.index_bytes.resize(prepared.layout.index_bytes());
+        ModelCache::save(cache_path, write(prepared));
+        std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, make_header());
+        CHECK(mapped != nullptr);
+        if (mapped != nullptr) CHECK_THROWS(read(mapped));
+    }
+
+    static bool same_bytes(const void* lhs, const void* rhs, size_t size) {
+        return std::memcmp(lhs, rhs, size) == 0;
+    }
+};
+
+namespace {
+    using Tests = ModelCacheTests;
+
+    /// An empty directory to save caches into, removed again when done
+    struct TemporaryDirectory {
+        std::filesystem::path path;
+
+        explicit TemporaryDirectory(const std::string& name) : path(std::filesystem::temp_directory_path() / name) {
+            std::filesystem::remove_all(path);
+            std::filesystem::create_directories(path);
+        }
+
+        [[nodiscard]] size_t count_files() const {
+            return (size_t) std::distance(std::filesystem::directory_iterator(path), std::filesystem::directory_iterator());
+        }
+
+        ~TemporaryDirectory() {
+            std::error_code error{};
+            std::filesystem::remove_all(path, error);
+        }
+    };
+}
+
+TEST_CASE("Saved model reads back the same") {
+    TemporaryDirectory directory{"model_cache_round_trip"};
+    auto cache_path = (directory.path / "grid.obj.bin").string();
+
+    auto prepared = Tests::make_model(8);
+    ModelCache::save(cache_path, Tests::write(prepared));
+    // Only the cache is left, the temporary file it was written through having been renamed
+    CHECK_EQ(directory.count_files(), (size_t) 1);
+
+    std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, Tests::make_header());
+    CHECK(mapped != nullptr);
+    if (mapped == nullptr) return;
+    auto loaded = Tests::read(mapped);
+
+    CHECK_EQ(loaded.layout.vertex_count, prepared.layout.vertex_count);
+    CHECK_EQ(loaded.layout.index_total, prepared.layout.index_total);
+    CHECK_EQ(loaded.layout.index_type, prepared.layout.index_type);
+    CHECK_EQ(loaded.bounds.radius, prepared.bounds.radius);
+    CHECK_EQ(loaded.lods.size(), prepared.lods.size());
+    for (auto i = 0u; i < std::min(loaded.lods.size(), prepared.lods.size()); ++i) {
+        CHECK_EQ(loaded.lods[i].index_offset, prepared.lods[i].index_offset);
+        CHECK_EQ(loaded.lods[i].index_count, prepared.lods[i].index_count);
+    }
+    CHECK_EQ(loaded.meshlets.size(), prepared.meshlets.size());
+    CHECK(Tests::same_bytes(loaded.meshlets.data(), prepared.meshlets.data(), sizeof(Meshlet) * std::min(loaded.meshlets.size(), prepared.meshlets.size())));
+    // Used in place in the mapped file
+    CHECK(loaded.mapped_file == mapped);
+    CHECK(Tests::same_bytes(loaded.get_vertex_data(), prepared.get_vertex_data(), prepared.layout.vertex_bytes()));
+    CHECK(Tests::same_bytes(loaded.get_index_data(), prepared.get_index_data(), prepared.layout.index_bytes()));
+
+    // A cache built for other settings, or another version of the source file, is never opened
+    auto other_header = Tests::make_header();
+    other_header.format_hash++;
+    CHECK(ModelCache::open(cache_path, other_header) == nullptr);
+    other_header = Tests::make_header();
+    other_header.source_write_time++;
+    CHECK(ModelCache::open(cache_path, other_header) == nullptr);
+}
+
+TEST_CASE("Truncated cache is rejected") {
+    TemporaryDirectory directory{"model_cache_truncated"};
+    auto cache_path = (directory.path / "grid.obj.bin").string();
+    ModelCache::save(cache_path, Tests::write(Tests::make_model(4)));
+    std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, Tests::make_header());
+    CHECK(mapped != nullptr);
+    if (mapped == nullptr) return;
+
+    // Cut off at every length past the header that is too short to hold the whole model
+    for (auto size = sizeof(ModelCache::Header); size < mapped->get_size(); ++size) {
+        CHECK_THROWS(Tests::read(mapped, size));
+    }
+    Tests::read(mapped);
+}
+
+TEST_CASE("Out of range cache is rejected") {
+    TemporaryDirectory directory{"model_cache_out_of_range"};
+    auto cache_path = (directory.path / "grid.obj.bin").string();
+
+    // LODs past the end of the index buffer, or with a negative offset or count, including ones that overflow an int
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.lods[1].index_offset = (int) prepared.layout.index_total; });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.lods[1].index_offset = -3; });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.lods[1].index_count = -3; });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) {
+        prepared.lods[1].index_offset = 3;
+        prepared.lods[1].index_count = INT_MAX;
+    });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.lods.clear(); });
+
+    // Meshlets past the end of the index buffer, or that aren't whole triangles
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.meshlets.back().index_count += 3; });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.meshlets[0].index_count -= 1; });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.meshlets[0].index_offset = UINT_MAX - 2; });
+
+    // An index type glDrawElements can't draw with
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.layout.index_type = GL_FLOAT; });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.layout.index_type = GL_UNSIGNED_BYTE; });
+
+    // An index naming a vertex past the end of the vertex buffer
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) {
+        auto* indices = reinterpret_cast<uint16_t*>(prepared.index_bytes.data());
+        indices[prepared.layout.index_total - 1] = (uint16_t) prepared.layout.vertex_count;
+    });
+    Tests::check_rejected(cache_path, [](Tests::PreparedModel& prepared) { prepared.layout.vertex_count -= 1; });
+
+    // Buffers that don't match the sizes in the layout, which write_model can't produce, so the layout is changed in the file
+    auto bytes = Tests::write(Tests::make_model(8)).get_bytes();
+    auto* layout = reinterpret_cast<ModelLayout*>(bytes.data() + sizeof(ModelCache::Header));
+    layout->index_total += 1;
+    BinaryWriter writer{};
+    writer.write_bytes(bytes.data(), bytes.size());
+    ModelCache::save(cache_path, writer);
+    std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, Tests::make_header());
+    CHECK(mapped != nullptr);
+    if (mapped != nullptr) CHECK_THROWS(Tests::read(mapped));
+}
+
+TEST_CASE("Racing saves leave one whole cache") {
+    TemporaryDirectory directory{"model_cache_racing"};
+    auto cache_path = (directory.path / "grid.obj.bin").string();
+    auto writer = Tests::write(Tests::make_model(32));
+
+    std::vector<std::thread> threads{};
+    for (auto i = 0; i < 8; ++i) {
+        threads.emplace_back([&cache_path, &writer]() {
+            for (auto save = 0; save < 10; ++save) {
+                ModelCache::save(cache_path, writer);
+            }
+        });
+    }
+    for (auto& thread: threads) thread.join();
+
+    CHECK_EQ(directory.count_files(), (size_t) 1);
+    std::shared_ptr<const MappedFile> mapped = ModelCache::open(cache_path, Tests::make_header());
+    CHECK(mapped != nullptr);
+    if (mapped == nullptr) return;
+    CHECK_EQ(mapped->get_size(), writer.get_bytes().size());
+    CHECK(Tests::same_bytes(mapped->get_data(), writer.get_bytes().data(), writer.get_bytes().size()));
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
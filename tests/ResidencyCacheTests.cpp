@@ -0,0 +1,65 @@
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "TestHelpers.h"
+#include "rendering/resources/ResidencyCache.h"
+
+namespace {
+    using Cache = ResidencyCache<std::string, std::hash<std::string>>;
+    constexpr size_t MIB = 1024 * 1024;
+}
+
+TEST_CASE("Resources still in use don't count towards the budget") {
+    Cache cache{2 * MIB};
+    auto held_a = std::make_shared<int>(0);
+    auto held_b = std::make_shared<int>(0);
+    std::weak_ptr<int> weak_a = held_a;
+    std::weak_ptr<int> weak_b = held_b;
+    cache.touch("a", held_a, 2 * MIB);
+    cache.touch("b", held_b, 2 * MIB);
+
+    // Both are in use, so neither is let go, even though together they are twice the budget
+    held_a.reset();
+    held_b.reset();
+    CHECK(!weak_a.expired());
+    CHECK(!weak_b.expired());
+
+    // Now both are unused, and only the most recently used fits
+    cache.trim();
+    CHECK(weak_a.expired());
+    CHECK(!weak_b.expired());
+}
+
+TEST_CASE("Trimming skips over resources in use to the least recently used unused one") {
+    Cache cache{1 * MIB};
+    auto unused_old = std::make_shared<int>(0);
+    auto in_use = std::make_shared<int>(0);
+    auto unused_new = std::make_shared<int>(0);
+    std::weak_ptr<int> weak_old = unused_old;
+    std::weak_ptr<int> weak_new = unused_new;
+    cache.touch("old", unused_old, 1 * MIB);
+    cache.touch("in_use", in_use, 4 * MIB);
+    cache.touch("new", unused_new, 1 * MIB);
+    unused_old.reset();
+    unused_new.reset();
+
+    cache.trim();
+    CHECK(weak_old.expired());
+    CHECK(!weak_new.expired());
+    CHECK_EQ(in_use.use_count(), 2l);
+}
+
+TEST_CASE("A zero budget lets go of everything unused") {
+    Cache cache{0};
+    auto held = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = held;
+    cache.touch("a", held, 1);
+    CHECK(!weak.expired());
+
+    held.reset();
+    cache.trim();
+    CHECK(weak.expired());
+}
+
+int main() { return TestHelpers::run_tests(); }
@@ -0,0 +1,146 @@
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "system_interfaces/WindowManager.h"
+#include "utility/OpenGL.h"
+#include "utility/AssetRegistry.h"
+#include "rendering/resources/ModelLoader.h"
+#include "rendering/resources/TextureLoader.h"
+#include "scene/SceneContext.h"
+#include "scene/editor_scene/EntityElement.h"
+#include "scene/editor_scene/ScenePreload.h"
+
+/// Times building a 5k element scene with each element loading its own files, as EditorScene did before ScenePreload,
+/// against collecting every file with ScenePreload and loading them all at once first.
+/// Needs a GL context, so opens a hidden window, and must be run from the project directory so that res/ is found.
+namespace {
+    constexpr size_t ELEMENT_COUNT = 5000;
+    constexpr int RUNS = 5;
+
+    const std::array<const char*, 7> MODELS{"cone.obj", "crate.obj", "cube.obj", "cylinder.obj", "double_plane.obj", "plane.obj", "sphere.obj"};
+    const std::array<const char*, 6> TEXTURES{"cone_diffuse.png", "cone_retro_map.png", "cone_specular.png", "crate.png", "crate_specular.png", "cylinder_light.png"};
+
+    json texture_json(size_t i) {
+        // Varying the flags as well gives 24 distinct textures to load
+        return {
+            {"filename",   TEXTURES[i % TEXTURES.size()]},
+            {"is_srgb",    (i / TEXTURES.size()) % 2 == 0},
+            {"is_flipped", (i / TEXTURES.size() / 2) % 2 == 0},
+        };
+    }
+
+    /// Entities laid out in a grid, in the form EntityElement::into_json writes them
+    json make_scene() {
+        json scene = json::array();
+        for (size_t i = 0; i < ELEMENT_COUNT; ++i) {
+            scene.push_back({
+                {"local_transform", {
+                    {"position", glm::vec3{(float) (i % 100), 0.0f, (float) (i / 100)}},
+                    {"euler_rotation", glm::vec3{0.0f}},
+                    {"scale", glm::vec3{0.5f}},
+                }},
+                {"material", {
+                    {"diffuse_tint", glm::vec4{1.0f}},
+                    {"specular_tint", glm::vec4{1.0f}},
+                    {"ambient_tint", glm::vec4{1.0f}},
+                    {"shininess", 64.0f},
+                }},
+                {"model", MODELS[i % MODELS.size()]},
+                {"diffuse_texture", texture_json(i)},
+                {"specular_map_texture", texture_json(i * 7 + 3)},
+            });
+        }
+        return scene;
+    }
+
+    struct Timings {
+        double built_ms = 0.0;
+        double uploaded_ms = 0.0;
+    };
+
+    double ms_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Build every element of the scene, with new loaders so no file starts out in memory.
+    /// Times until the elements are built, and until every texture has been uploaded as well.
+    Timings build_scene(Window& window, WindowManager& window_manager, const json& scene, bool preload) {
+        AssetRegistry asset_registry{"res"};
+        ModelLoader model_loader{"res/models", asset_registry};
+        TextureLoader texture_loader{"res/textures", asset_registry};
+        SceneContext scene_context{window, window_manager, model_loader, texture_loader, false};
+
+        Timings timings{};
+        {
+            std::vector<std::unique_ptr<EditorScene::EntityElement>> elements{};
+            auto start = std::chrono::steady_clock::now();
+
+            EditorScene::ScenePreload scene_preload{scene_context};
+            if (preload) {
+                for (const auto& j: scene) {
+                    EditorScene::EntityElement::preload_json(scene_preload, j);
+                }
+                scene_preload.load();
+            }
+            for (const auto& j: scene) {
+                elements.push_back(EditorScene::EntityElement::from_json(scene_context, EditorScene::NullElementRef, j));
+            }
+            timings.built_ms = ms_since(start);
+
+            while (texture_loader.get_pending_count() > 0) {
+                texture_loader.process_uploads();
+                std::this_thread::yield();
+            }
+            glFinish();
+            timings.uploaded_ms = ms_since(start);
+        }
+
+        texture_loader.cleanup();
+        model_loader.cleanup();
+        return timings;
+    }
+
+    /// The median of each timing over RUNS runs, after a first run that fills the model and texture caches on disk
+    Timings median_timings(Window& window, WindowManager& window_manager, const json& scene, bool preload) {
+        build_scene(window, window_manager, scene, preload);
+
+        std::vector<double> built{};
+        std::vector<double> uploaded{};
+        for (auto run = 0; run < RUNS; ++run) {
+            auto timings = build_scene(window, window_manager, scene, preload);
+            built.push_back(timings.built_ms);
+            uploaded.push_back(timings.uploaded_ms);
+        }
+        std::sort(built.begin(), built.end());
+        std::sort(uploaded.begin(), uploaded.end());
+        return {built[built.size() / 2], uploaded[uploaded.size() / 2]};
+    }
+}
+
+int main() {
+    WindowManager::init();
+    WindowManager window_manager{};
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    auto window = window_manager.create_window("Scene Preload Benchmark", {64, 64});
+    window.make_context_current();
+    OpenGL::load_functions();
+
+    auto scene = make_scene();
+    auto synchronous = median_timings(window, window_manager, scene, false);
+    auto preloaded = median_timings(window, window_manager, scene, true);
+
+    std::cout << ELEMENT_COUNT << " entities, " << MODELS.size() << " models, " << TEXTURES.size() * 4 << " textures (median of " << RUNS << " runs)" << std::endl;
+    std::cout << "  loaded per element: " << synchronous.built_ms << " ms built, " << synchronous.uploaded_ms << " ms with textures uploaded" << std::endl;
+    std::cout << "  ScenePreload:       " << preloaded.built_ms << " ms built, " << preloaded.uploaded_ms << " ms with textures uploaded" << std::endl;
+
+    window_manager.destroy_window(window);
+    WindowManager::cleanup();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#ifndef TEST_HELPERS_H
+#define TEST_HELPERS_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <functional>
+
+/// A minimal test runner, since the tests only need to check conditions and report which failed.
+/// Each test file registers its cases with TEST_CASE, and calls run_tests from main, which returns the exit code for ctest.
+namespace TestHelpers {
+    struct TestCase {
+        const char* name;
+        std::function<void()> run;
+    };
+
+    inline std::vector<TestCase>& test_cases() {
+        static std::vector<TestCase> cases{};
+        return cases;
+    }
+
+    inline int& failure_count() {
+        static int failures = 0;
+        return failures;
+    }
+
+    struct Registration {
+        Registration(const char* name, std::function<void()> run) {
+            test_cases().push_back({name, std::move(run)});
+        }
+    };
+
+    inline void fail(const char* file, int line, const std::string& message) {
+        std::cerr << file << ":" << line << ": " << message << std::endl;
+        failure_count()++;
+    }
+
+    /// Run every registered case, returning non-zero if any check failed or any case threw
+    inline int run_tests() {
+        for (const auto& test_case: test_cases()) {
+            int failures_before = failure_count();
+            try {
+                test_case.run();
+            } catch (const std::exception& e) {
+                fail(__FILE__, __LINE__, std::string("Unexpected exception: ") + e.what());
+            }
+            std::cout << (failure_count() == failures_before ? "[PASS] " : "[FAIL] ") << test_case.name << std::endl;
+        }
+        return failure_count() == 0 ? 0 : 1;
+    }
+}
+
+#define TEST_CONCAT_INNER(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_INNER(a, b)
+
+#define TEST_CASE(name) \
+    static void TEST_CONCAT(test_case_, __LINE__)(); \
+    static TestHelpers::Registration TEST_CONCAT(test_registration_, __LINE__){name, TEST_CONCAT(test_case_, __LINE__)}; \
+    static void TEST_CONCAT(test_case_, __LINE__)()
+
+#define CHECK(condition) \
+    do { if (!(condition)) TestHelpers::fail(__FILE__, __LINE__, "CHECK(" #condition ") failed"); } while (false)
+
+/// Check `a <= b`, printing both values if it doesn't hold
+#define CHECK_LE(a, b) \
+    do { \
+        auto check_a = (a); \
+        auto check_b = (b); \
+        if (!(check_a <= check_b)) TestHelpers::fail(__FILE__, __LINE__, "CHECK_LE(" #a ", " #b ") failed: " + std::to_string(check_a) + " > " + std::to_string(check_b)); \
+    } while (false)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        auto check_a = (a); \
+        auto check_b = (b); \
+        if (!(check_a == check_b)) TestHelpers::fail(__FILE__, __LINE__, "CHECK_EQ(" #a ", " #b ") failed: " + std::to_string(check_a) + " != " + std::to_string(check_b)); \
+    } while (false)
+
+#define CHECK_THROWS(expression) \
+    do { \
+        bool check_threw = false; \
+        try { (void) (expression); } catch (const std::exception&) { check_threw = true; } \
+        if (!check_threw) TestHelpers::fail(__FILE__, __LINE__, "CHECK_THROWS(" #expression ") didn't throw"); \
+    } while (false)
+
+#endif //TEST_HELPERS_H
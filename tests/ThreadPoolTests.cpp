@@ -0,0 +1,51 @@
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+#include "TestHelpers.h"
+#include "utility/ThreadPool.h"
+
+TEST_CASE("parallel_for visits every index exactly once") {
+    ThreadPool pool{4};
+    std::vector<std::atomic<uint>> visits(10000);
+    pool.parallel_for(visits.size(), 16, [&visits](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) visits[i]++;
+    });
+
+    for (const auto& count: visits) {
+        CHECK_EQ(count.load(), 1u);
+    }
+}
+
+TEST_CASE("parallel_for rethrows a batch's exception after every batch has finished") {
+    ThreadPool pool{4};
+    std::atomic<size_t> completed{0};
+    size_t failed_size = 0;
+    auto run = [&]() {
+        pool.parallel_for(1000, 10, [&completed, &failed_size](size_t begin, size_t end) {
+            if (begin <= 500 && 500 < end) {
+                failed_size = end - begin;
+                throw std::runtime_error("batch failed");
+            }
+            completed += end - begin;
+        });
+    };
+    CHECK_THROWS(run());
+    // Every other batch ran, and finished before the exception reached the caller
+    CHECK_EQ(completed.load() + failed_size, (size_t) 1000);
+    CHECK(failed_size > 0);
+}
+
+TEST_CASE("parallel_for rethrows when every batch throws") {
+    ThreadPool pool{4};
+    CHECK_THROWS(pool.parallel_for(1000, 1, [](size_t, size_t) { throw std::runtime_error("batch failed"); }));
+
+    // The pool is still usable afterwards
+    std::atomic<size_t> total{0};
+    pool.parallel_for(1000, 1, [&total](size_t begin, size_t end) { total += end - begin; });
+    CHECK_EQ(total.load(), (size_t) 1000);
+}
+
+int main() {
+    return TestHelpers::run_tests();
+}
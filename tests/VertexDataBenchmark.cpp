@@ -0,0 +1,153 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#include <assimp/scene.h>
+
+#include "rendering/resources/ModelLoader.h"
+#include "rendering/renders/EntityRenderer.h"
+
+/// Times building EntityRenderer::VertexData for a 1M vertex mesh through a VertexCollection view of it, against copying
+/// each attribute into its own std::vector and pushing back every vertex as ModelLoader used to, counting the allocations each makes.
+namespace {
+    constexpr uint VERTEX_COUNT = 1000000;
+    constexpr int RUNS = 15;
+
+    std::atomic<size_t> allocation_count{0};
+    std::atomic<size_t> allocated_bytes{0};
+}
+
+// Every allocation in the benchmark goes through these, so the allocations made while building the vertices can be counted
+void* operator new(std::size_t size) {
+    allocation_count++;
+    allocated_bytes += size;
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t /*size*/) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+    /// VertexCollection as it was, holding a copy of each attribute
+    struct CopiedVertexCollection {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> tex_coords;
+    };
+
+    /// ModelLoader::load_node and EntityRenderer::VertexData::from_mesh as they were, for a single mesh
+    void build_copied(const aiMesh* mesh, const glm::mat4& transform, const glm::mat3& normal_matrix, std::vector<EntityRenderer::VertexData>& out_vertices) {
+        const auto v = reinterpret_cast<glm::vec3*>(mesh->mVertices);
+        const auto n = reinterpret_cast<glm::vec3*>(mesh->mNormals);
+        const auto t = reinterpret_cast<glm::vec3*>(mesh->mTextureCoords[0]);
+
+        CopiedVertexCollection vertex_collection{
+            v ? std::vector<glm::vec3>{v, v + mesh->mNumVertices} : std::vector<glm::vec3>{},
+            n ? std::vector<glm::vec3>{n, n + mesh->mNumVertices} : std::vector<glm::vec3>{},
+            t ? std::vector<glm::vec2>{t, t + mesh->mNumVertices} : std::vector<glm::vec2>{},
+        };
+
+        for (auto& position: vertex_collection.positions) {
+            position = transform * glm::vec4(position, 1.0f);
+        }
+
+        for (auto& normal: vertex_collection.normals) {
+            normal = normal_matrix * normal;
+        }
+
+        out_vertices.reserve(out_vertices.size() + vertex_collection.positions.size());
+        for (auto i = 0u; i < vertex_collection.positions.size(); i++) {
+            out_vertices.push_back(EntityRenderer::VertexData{
+                vertex_collection.positions[i],
+                vertex_collection.normals[i],
+                vertex_collection.tex_coords[i]
+            });
+        }
+    }
+
+    /// ModelLoader::load_node as it is now, for a single mesh
+    void build_viewed(const aiMesh* mesh, const glm::mat4& transform, const glm::mat3& normal_matrix, std::vector<EntityRenderer::VertexData>& out_vertices) {
+        auto vertex_collection = VertexCollection::from_mesh(mesh);
+        vertex_collection.transform = transform;
+        vertex_collection.normal_matrix = normal_matrix;
+
+        out_vertices.resize(mesh->mNumVertices);
+        EntityRenderer::VertexData::from_mesh(vertex_collection, out_vertices.data());
+    }
+
+    /// A mesh with random positions, normals and texture coordinates, allocated as Assimp does so aiMesh frees it
+    std::unique_ptr<aiMesh> make_mesh(uint vertex_count) {
+        std::mt19937 random{1};
+        std::uniform_real_distribution<float> value{-1.0f, 1.0f};
+
+        auto mesh = std::make_unique<aiMesh>();
+        mesh->mNumVertices = vertex_count;
+        mesh->mVertices = new aiVector3D[vertex_count];
+        mesh->mNormals = new aiVector3D[vertex_count];
+        mesh->mTextureCoords[0] = new aiVector3D[vertex_count];
+        for (auto i = 0u; i < vertex_count; ++i) {
+            mesh->mVertices[i] = {value(random), value(random), value(random)};
+            mesh->mNormals[i] = {value(random), value(random), value(random)};
+            mesh->mTextureCoords[0][i] = {value(random), value(random), 0.0f};
+        }
+        return mesh;
+    }
+
+    struct Result {
+        double median_ms = 0.0;
+        size_t allocations = 0;
+        size_t allocated_bytes = 0;
+    };
+
+    /// The median time of building the vertices over RUNS runs, and the allocations made by one build
+    Result measure(const std::function<void(std::vector<EntityRenderer::VertexData>& out_vertices)>& build) {
+        Result result{};
+        std::vector<double> times{};
+        for (auto run = 0; run < RUNS; ++run) {
+            std::vector<EntityRenderer::VertexData> vertices{};
+            size_t allocations_before = allocation_count;
+            size_t bytes_before = allocated_bytes;
+
+            auto start = std::chrono::steady_clock::now();
+            build(vertices);
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            result.allocations = allocation_count - allocations_before;
+            result.allocated_bytes = allocated_bytes - bytes_before;
+        }
+        std::sort(times.begin(), times.end());
+        result.median_ms = times[times.size() / 2];
+        return result;
+    }
+
+    void print(const char* name, const Result& result) {
+        std::cout << name << result.median_ms << " ms, " << result.allocations << " allocations, " << result.allocated_bytes / (1024 * 1024) << " MiB" << std::endl;
+    }
+}
+
+int main() {
+    auto mesh = make_mesh(VERTEX_COUNT);
+    // A node transform, so that both apply it to every vertex
+    glm::mat4 transform = glm::translate(glm::vec3{1.0f, 2.0f, 3.0f}) * glm::rotate(0.5f, glm::vec3{0.0f, 1.0f, 0.0f}) * glm::scale(glm::vec3{2.0f});
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+    auto copied = measure([&](std::vector<EntityRenderer::VertexData>& vertices) { build_copied(mesh.get(), transform, normal_matrix, vertices); });
+    auto viewed = measure([&](std::vector<EntityRenderer::VertexData>& vertices) { build_viewed(mesh.get(), transform, normal_matrix, vertices); });
+
+    std::cout << VERTEX_COUNT << " vertices (median of " << RUNS << " runs)" << std::endl;
+    print("  copied attributes:     ", copied);
+    print("  VertexCollection view: ", viewed);
+    return 0;
+}